@@ -0,0 +1,144 @@
+// Compares loading the examples' assets with files read on the loading workers and through
+// the engine's async I/O, with a cold and a warm page cache. Runs headless, see scene_render.c.
+// The cold runs evict the files from the page cache, which is only possible on Linux.
+
+#include <motor/base/time.h>
+#include <motor/base/api_types.h>
+#include <motor/base/async_io.h>
+#include <motor/engine/engine.h>
+#include <motor/engine/asset_manager.h>
+#include <stdio.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define ITERATIONS 3
+
+// The engine mounts this directory as "assets"
+#define ASSETS_DIR "../assets/"
+
+static const char *g_assets[] = {
+    "papermill_hdr16f_cube.ktx",
+    "helmet_ktx.glb",
+    "boombox_ktx.glb",
+    "lantern_ktx.glb",
+    "sponza_ktx.glb",
+};
+
+static bool evict(const char *path)
+{
+#if defined(__linux__)
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    // Dirty pages can't be dropped
+    fdatasync(fd);
+    bool evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return evicted;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+static bool evict_assets(void)
+{
+    bool evicted = true;
+    for (uint32_t i = 0; i < MT_LENGTH(g_assets); i++)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), ASSETS_DIR "%s", g_assets[i]);
+        evicted = evict(path) && evicted;
+    }
+
+    // Assets come from the pack when there is one
+    evict("motor.mtpack");
+
+    return evicted;
+}
+
+static uint64_t load(MtEngine *engine, bool sync_io)
+{
+    MtAssetManager am;
+    mt_asset_manager_init(&am, NULL, engine);
+    am.sync_io = sync_io;
+
+    char paths[MT_LENGTH(g_assets)][256];
+    MtAsset *assets[MT_LENGTH(g_assets)] = {0};
+
+    uint64_t start = mt_time_ns();
+    for (uint32_t i = 0; i < MT_LENGTH(g_assets); i++)
+    {
+        snprintf(paths[i], sizeof(paths[i]), "assets/%s", g_assets[i]);
+        mt_asset_manager_queue_load(&am, paths[i], &assets[i]);
+    }
+    mt_asset_manager_wait(&am);
+    uint64_t elapsed = mt_time_ns() - start;
+
+    mt_asset_manager_destroy(&am);
+
+    for (uint32_t i = 0; i < MT_LENGTH(g_assets); i++)
+    {
+        if (!assets[i])
+        {
+            printf("%s: failed to load\n", paths[i]);
+            return 0;
+        }
+    }
+
+    return elapsed;
+}
+
+static void run(MtEngine *engine, bool cold)
+{
+    uint64_t best[2] = {UINT64_MAX, UINT64_MAX};
+    uint64_t total[2] = {0, 0};
+
+    for (uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        for (uint32_t mode = 0; mode < 2; mode++)
+        {
+            if (cold && !evict_assets())
+            {
+                printf("cold: can't evict the assets from the page cache\n");
+                return;
+            }
+
+            uint64_t elapsed = load(engine, mode == 0);
+            if (elapsed == 0) return;
+
+            best[mode] = MT_MIN(best[mode], elapsed);
+            total[mode] += elapsed;
+        }
+    }
+
+    printf(
+        "%-5s sync %8.1f ms avg %8.1f ms best, async %8.1f ms avg %8.1f ms best (%.2fx)\n",
+        cold ? "cold" : "warm",
+        (double)total[0] / ITERATIONS / 1e6,
+        (double)best[0] / 1e6,
+        (double)total[1] / ITERATIONS / 1e6,
+        (double)best[1] / 1e6,
+        (double)best[0] / (double)best[1]);
+}
+
+int main()
+{
+    MtEngine engine = {0};
+    mt_engine_init(&engine, MT_ENGINE_HEADLESS);
+
+    printf("Async I/O through %s\n", mt_async_io_backend(engine.async_io));
+
+    // Once to warm the page cache
+    load(&engine, true);
+
+    run(&engine, false);
+    run(&engine, true);
+
+    mt_engine_destroy(&engine);
+
+    return 0;
+}
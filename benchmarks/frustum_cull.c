@@ -0,0 +1,98 @@
+#include <motor/base/frustum.h>
+#include <motor/base/math.h>
+#include <motor/base/rand.h>
+#include <motor/base/time.h>
+#include <motor/base/threads.h>
+#include <motor/base/thread_pool.h>
+#include <motor/base/allocator.h>
+#include <stdio.h>
+
+#define BOX_COUNT 100000
+#define ITERATIONS 100
+
+static MtAabb g_boxes[BOX_COUNT];
+static uint8_t g_visible[BOX_COUNT];
+
+static void cull_scalar(MtThreadPool *pool, const MtFrustum *frustum)
+{
+    for (uint32_t i = 0; i < BOX_COUNT; i++)
+    {
+        g_visible[i] = mt_frustum_test_aabb(frustum, &g_boxes[i]);
+    }
+}
+
+static void cull_simd(MtThreadPool *pool, const MtFrustum *frustum)
+{
+    mt_frustum_cull_aabbs(frustum, g_boxes, BOX_COUNT, g_visible);
+}
+
+static void cull_parallel(MtThreadPool *pool, const MtFrustum *frustum)
+{
+    mt_frustum_cull_aabbs_parallel(pool, frustum, g_boxes, BOX_COUNT, g_visible);
+}
+
+static void
+run(const char *name, void (*cull)(MtThreadPool *, const MtFrustum *), MtThreadPool *pool)
+{
+    Mat4 view = mat4_look_at(V3(0.0f, 0.0f, 0.0f), V3(0.0f, 0.0f, -1.0f), V3(0.0f, 1.0f, 0.0f));
+    Mat4 proj = mat4_perspective(MT_RAD(75.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+    Mat4 view_proj = mat4_mul(view, proj);
+
+    MtFrustum frustum;
+    mt_frustum_from_matrix(&frustum, &view_proj);
+
+    // Warm up
+    cull(pool, &frustum);
+
+    uint64_t best = UINT64_MAX;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        uint64_t start = mt_time_ns();
+        cull(pool, &frustum);
+        uint64_t elapsed = mt_time_ns() - start;
+
+        total += elapsed;
+        best = MT_MIN(best, elapsed);
+    }
+
+    uint32_t visible_count = 0;
+    for (uint32_t i = 0; i < BOX_COUNT; i++)
+    {
+        visible_count += g_visible[i];
+    }
+
+    printf(
+        "%-10s %8.1f us avg %8.1f us best (%u / %u visible)\n",
+        name,
+        (double)total / ITERATIONS / 1000.0,
+        (double)best / 1000.0,
+        visible_count,
+        BOX_COUNT);
+}
+
+int main()
+{
+    MtXorShift rng;
+    mt_xor_shift_init(&rng, 1);
+    for (uint32_t i = 0; i < BOX_COUNT; i++)
+    {
+        Vec3 pos = V3(
+            mt_xor_shift_float(&rng, -300.0f, 300.0f),
+            mt_xor_shift_float(&rng, -300.0f, 300.0f),
+            mt_xor_shift_float(&rng, -300.0f, 300.0f));
+        float size = mt_xor_shift_float(&rng, 0.1f, 5.0f);
+        g_boxes[i] = (MtAabb){.min = v3_subs(pos, size), .max = v3_adds(pos, size)};
+    }
+
+    MtThreadPool pool;
+    mt_thread_pool_init(&pool, mt_cpu_count(), NULL);
+
+    run("scalar", cull_scalar, &pool);
+    run("simd", cull_simd, &pool);
+    run("parallel", cull_parallel, &pool);
+
+    mt_thread_pool_destroy(&pool);
+
+    return 0;
+}
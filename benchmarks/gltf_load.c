@@ -0,0 +1,88 @@
+// Compares glTF load times with sub-resources decoded serially on the loading thread
+// and as child tasks on the engine's thread pool. Runs headless, see scene_render.c.
+
+#include <motor/base/time.h>
+#include <motor/base/api_types.h>
+#include <motor/engine/engine.h>
+#include <motor/engine/asset_manager.h>
+#include <stdio.h>
+
+#define ITERATIONS 3
+
+static const char *g_default_paths[] = {
+    "assets/sponza_ktx.glb",
+    "assets/helmet_ktx.glb",
+    "assets/boombox_ktx.glb",
+    "assets/lantern_ktx.glb",
+};
+
+static uint64_t load(MtEngine *engine, const char *path, bool serial)
+{
+    MtAssetManager am;
+    mt_asset_manager_init(&am, NULL, engine);
+    am.serial_loads = serial;
+
+    uint64_t start = mt_time_ns();
+    MtAsset *asset = mt_asset_manager_load(&am, path);
+    uint64_t elapsed = mt_time_ns() - start;
+
+    mt_asset_manager_destroy(&am);
+
+    return asset ? elapsed : 0;
+}
+
+static void run(MtEngine *engine, const char *path)
+{
+    uint64_t best[2] = {UINT64_MAX, UINT64_MAX};
+    uint64_t total[2] = {0, 0};
+
+    for (uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        for (uint32_t mode = 0; mode < 2; mode++)
+        {
+            uint64_t elapsed = load(engine, path, mode == 0);
+            if (elapsed == 0)
+            {
+                printf("%s: failed to load\n", path);
+                return;
+            }
+
+            best[mode] = MT_MIN(best[mode], elapsed);
+            total[mode] += elapsed;
+        }
+    }
+
+    printf(
+        "%-28s serial %8.1f ms avg %8.1f ms best, parallel %8.1f ms avg %8.1f ms best (%.2fx)\n",
+        path,
+        (double)total[0] / ITERATIONS / 1e6,
+        (double)best[0] / 1e6,
+        (double)total[1] / ITERATIONS / 1e6,
+        (double)best[1] / 1e6,
+        (double)best[0] / (double)best[1]);
+}
+
+int main(int argc, char *argv[])
+{
+    MtEngine engine = {0};
+    mt_engine_init(&engine, MT_ENGINE_HEADLESS);
+
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            run(&engine, argv[i]);
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < MT_LENGTH(g_default_paths); i++)
+        {
+            run(&engine, g_default_paths[i]);
+        }
+    }
+
+    mt_engine_destroy(&engine);
+
+    return 0;
+}
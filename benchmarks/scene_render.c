@@ -0,0 +1,283 @@
+// Renders fixed camera paths through the sample scenes with no window system.
+// To measure without a GPU, point the loader at a software implementation:
+//   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./scene_render_bench
+// Like the examples, asset paths are relative to the build directory.
+
+#include <motor/base/math.h>
+#include <motor/base/time.h>
+#include <motor/base/allocator.h>
+#include <motor/graphics/renderer.h>
+#include <motor/engine/engine.h>
+#include <motor/engine/scene.h>
+#include <motor/engine/camera.h>
+#include <motor/engine/environment.h>
+#include <motor/engine/asset_manager.h>
+#include <motor/engine/entities.h>
+#include <motor/engine/components.h>
+#include <motor/engine/systems.h>
+#include <motor/engine/gpu_culling.h>
+#include <motor/engine/imgui_impl.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define WARMUP_FRAMES 30
+#define DEFAULT_FRAMES 300
+
+typedef struct CountingAllocator
+{
+    atomic_uint_fast64_t allocs;
+    atomic_uint_fast64_t reallocs;
+    atomic_uint_fast64_t frees;
+} CountingAllocator;
+
+static void *counting_realloc(void *inst, void *ptr, uint64_t size)
+{
+    CountingAllocator *counter = inst;
+    if (size == 0)
+    {
+        if (ptr) atomic_fetch_add(&counter->frees, 1);
+        free(ptr);
+        return NULL;
+    }
+
+    if (ptr)
+        atomic_fetch_add(&counter->reallocs, 1);
+    else
+        atomic_fetch_add(&counter->allocs, 1);
+
+    return realloc(ptr, size);
+}
+
+typedef struct BenchScene
+{
+    /*base*/ MtScene scene;
+    const char *const *models;
+    uint32_t model_count;
+} BenchScene;
+
+typedef struct ScenePath
+{
+    const char *name;
+    const char *const *models;
+    uint32_t model_count;
+    Vec3 center;
+    float radius;
+    float height;
+} ScenePath;
+
+static void bench_init(MtScene *scene)
+{
+    BenchScene *s = (BenchScene *)scene;
+
+    MtEngine *engine = scene->engine;
+    MtAssetManager *am = scene->asset_manager;
+    MtEntityManager *em = scene->entity_manager;
+
+    MtImageAsset *skybox_asset = NULL;
+    mt_asset_manager_queue_load(
+        am, "assets/papermill_hdr16f_cube.ktx", (MtAsset **)&skybox_asset);
+
+    MtGltfAsset *models[8] = {0};
+    assert(s->model_count <= MT_LENGTH(models));
+    for (uint32_t i = 0; i < s->model_count; i++)
+    {
+        mt_asset_manager_queue_load(am, s->models[i], (MtAsset **)&models[i]);
+    }
+
+    mt_asset_manager_wait(am);
+
+    mt_environment_set_skybox(&scene->env, skybox_asset);
+
+    for (uint32_t i = 0; i < s->model_count; i++)
+    {
+        if (!models[i])
+        {
+            printf("failed to load %s\n", s->models[i]);
+            continue;
+        }
+
+        MtEntity e = mt_entity_manager_add_entity(
+            em,
+            MT_COMP_BIT(MtDefaultComponents, transform) |
+                MT_COMP_BIT(MtDefaultComponents, model));
+        MtDefaultComponents *comps = (MtDefaultComponents *)em->components;
+        comps->transform[e].pos = V3((float)i * 3.0f, 0.0f, 0.0f);
+        comps->model[e] = models[i];
+    }
+
+    MtRenderGraphImage depth_info = {
+        .size_class = MT_SIZE_CLASS_SWAPCHAIN_RELATIVE,
+        .width = 1.0f,
+        .height = 1.0f,
+        .format = MT_FORMAT_D32_SFLOAT,
+    };
+
+    mt_render.graph_add_image(scene->graph, "depth", &depth_info);
+
+    if (engine->bindless && engine->pbr_indirect_pipeline)
+    {
+        scene->gpu_culler = mt_gpu_culler_create(engine, scene->graph, "depth");
+    }
+
+    MtRenderGraphPass *color_pass =
+        mt_render.graph_add_pass(scene->graph, "color_pass", MT_PIPELINE_STAGE_ALL_GRAPHICS);
+    mt_render.pass_write(color_pass, MT_PASS_WRITE_DEPTH_STENCIL_ATTACHMENT, "depth");
+    if (scene->gpu_culler) mt_gpu_culler_add_reads(scene->gpu_culler, color_pass);
+}
+
+static void bench_destroy(MtScene *scene)
+{
+    MtAllocator *alloc = scene->engine->alloc;
+    mt_scene_destroy(scene);
+    mt_free(alloc, scene);
+}
+
+static void bench_on_event(MtScene *scene, const MtEvent *event)
+{
+}
+
+static void bench_draw_ui(MtScene *scene, float delta)
+{
+}
+
+static void bench_update(MtScene *scene, float delta)
+{
+    MtEntityManager *em = scene->entity_manager;
+
+    mt_light_system(em, scene, delta);
+    mt_model_cull_system(em, scene);
+
+    MtCmdBuffer *cb = mt_render.pass_begin(scene->graph, "color_pass");
+    mt_environment_draw_skybox(&scene->env, cb, &scene->cam.uniform);
+    mt_model_system(em, scene, cb);
+    mt_imgui_render(scene->engine->imgui_ctx, cb);
+    mt_render.pass_end(scene->graph, "color_pass");
+}
+
+static const MtSceneVT bench_vt = {
+    .init = bench_init,
+    .update = bench_update,
+    .draw_ui = bench_draw_ui,
+    .on_event = bench_on_event,
+    .destroy = bench_destroy,
+};
+
+// Orbits the center once over the run, looking at it
+static void camera_on_path(MtPerspectiveCamera *cam, const ScenePath *path, float t)
+{
+    float angle = t * 2.0f * MT_PI;
+    cam->pos = v3_add(
+        path->center,
+        V3(sinf(angle) * path->radius, path->height, cosf(angle) * path->radius));
+
+    Vec3 dir = v3_normalize(v3_sub(path->center, cam->pos));
+    cam->yaw = atan2f(dir.x, dir.z);
+    cam->pitch = asinf(dir.y);
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const ScenePath *path, MtEngineFlags flags, uint32_t frame_count)
+{
+    CountingAllocator counter = {0};
+    MtAllocator alloc = {.inst = &counter, .realloc = counting_realloc};
+
+    MtEngine engine = {0};
+    engine.alloc = &alloc;
+    mt_engine_init(&engine, flags | MT_ENGINE_HEADLESS);
+
+    BenchScene *s = mt_alloc(engine.alloc, sizeof(BenchScene));
+    memset(s, 0, sizeof(*s));
+    mt_scene_init(&s->scene, &engine);
+    s->models = path->models;
+    s->model_count = path->model_count;
+
+    MtIScene iscene = {.vt = &bench_vt, .inst = &s->scene};
+    mt_engine_set_scene(&engine, &iscene);
+
+    for (uint32_t i = 0; i < WARMUP_FRAMES; i++)
+    {
+        camera_on_path(&s->scene.cam, path, (float)i / (float)frame_count);
+        mt_engine_update(&engine);
+    }
+
+    uint64_t *times = mt_alloc(NULL, sizeof(uint64_t) * frame_count);
+    uint64_t draw_calls = 0;
+    uint64_t allocs_before = atomic_load(&counter.allocs) + atomic_load(&counter.reallocs);
+
+    for (uint32_t i = 0; i < frame_count; i++)
+    {
+        camera_on_path(&s->scene.cam, path, (float)i / (float)frame_count);
+
+        uint64_t start = mt_time_ns();
+        mt_engine_update(&engine);
+        times[i] = mt_time_ns() - start;
+
+        draw_calls += engine.model_stats.draw_calls;
+    }
+
+    uint64_t allocs =
+        atomic_load(&counter.allocs) + atomic_load(&counter.reallocs) - allocs_before;
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < frame_count; i++)
+    {
+        total += times[i];
+    }
+    qsort(times, frame_count, sizeof(uint64_t), compare_u64);
+
+    printf(
+        "%-8s %7.3f ms avg %7.3f ms p50 %7.3f ms p95 %7.3f ms p99 %7.1f draws %7.1f allocs\n",
+        path->name,
+        (double)total / frame_count / 1e6,
+        (double)times[frame_count / 2] / 1e6,
+        (double)times[frame_count * 95 / 100] / 1e6,
+        (double)times[frame_count * 99 / 100] / 1e6,
+        (double)draw_calls / frame_count,
+        (double)allocs / frame_count);
+
+    mt_free(NULL, times);
+
+    mt_engine_destroy(&engine);
+}
+
+static const char *const sponza_models[] = {"assets/sponza_ktx.glb"};
+static const char *const props_models[] = {
+    "assets/helmet_ktx.glb",
+    "assets/boombox_ktx.glb",
+    "assets/lantern_ktx.glb",
+};
+
+static const ScenePath paths[] = {
+    {"sponza", sponza_models, MT_LENGTH(sponza_models), {{0.0f, 2.0f, 0.0f}}, 6.0f, 1.0f},
+    {"props", props_models, MT_LENGTH(props_models), {{3.0f, 0.0f, 0.0f}}, 8.0f, 2.0f},
+};
+
+int main(int argc, char *argv[])
+{
+    MtEngineFlags flags = 0;
+    uint32_t frame_count = DEFAULT_FRAMES;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bindless") == 0) flags |= MT_ENGINE_BINDLESS;
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frame_count = MT_MAX((uint32_t)atoi(argv[++i]), 1u);
+        }
+    }
+
+    for (uint32_t i = 0; i < MT_LENGTH(paths); i++)
+    {
+        run(&paths[i], flags, frame_count);
+    }
+
+    return 0;
+}
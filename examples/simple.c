@@ -19,6 +19,7 @@
 #include <motor/engine/inspector.h>
 #include <motor/engine/picker.h>
 #include <motor/engine/systems.h>
+#include <motor/engine/gpu_culling.h>
 #include <motor/engine/physics.h>
 #include <motor/engine/assets/pipeline_asset.h>
 #include <time.h>
@@ -41,15 +42,15 @@ static void game_init(MtScene *scene)
 
     MtImageAsset *skybox_asset = NULL;
     mt_asset_manager_queue_load(
-        am, "../assets/papermill_hdr16f_cube.ktx", (MtAsset **)&skybox_asset);
+        am, "assets/papermill_hdr16f_cube.ktx", (MtAsset **)&skybox_asset);
 
-    mt_asset_manager_queue_load(am, "../assets/helmet_ktx.glb", NULL);
-    mt_asset_manager_queue_load(am, "../assets/boombox_ktx.glb", NULL);
-    mt_asset_manager_queue_load(am, "../assets/lantern_ktx.glb", NULL);
-    mt_asset_manager_queue_load(am, "../assets/sponza_ktx.glb", NULL);
+    mt_asset_manager_queue_load(am, "assets/helmet_ktx.glb", NULL);
+    mt_asset_manager_queue_load(am, "assets/boombox_ktx.glb", NULL);
+    mt_asset_manager_queue_load(am, "assets/lantern_ktx.glb", NULL);
+    mt_asset_manager_queue_load(am, "assets/sponza_ktx.glb", NULL);
 
     // Wait for assets to load
-    mt_thread_pool_wait_all(&engine->thread_pool);
+    mt_asset_manager_wait(am);
 
     mt_environment_set_skybox(&g->scene.env, skybox_asset);
 
@@ -64,10 +65,16 @@ static void game_init(MtScene *scene)
 
         mt_render.graph_add_image(scene->graph, "depth", &depth_info);
 
+        if (engine->bindless && engine->pbr_indirect_pipeline)
+        {
+            scene->gpu_culler = mt_gpu_culler_create(engine, scene->graph, "depth");
+        }
+
         {
             MtRenderGraphPass *color_pass = mt_render.graph_add_pass(
                 scene->graph, "color_pass", MT_PIPELINE_STAGE_ALL_GRAPHICS);
             mt_render.pass_write(color_pass, MT_PASS_WRITE_DEPTH_STENCIL_ATTACHMENT, "depth");
+            if (scene->gpu_culler) mt_gpu_culler_add_reads(scene->gpu_culler, color_pass);
         }
     }
 }
@@ -117,6 +124,7 @@ static void game_draw_ui(MtScene *scene, float delta)
     MtEntityManager *em = scene->entity_manager;
 
     mt_inspect_entities(engine, em);
+    mt_inspect_render_graph(engine, scene->graph);
 
     if (igBegin("Info", NULL, 0))
     {
@@ -188,6 +196,8 @@ static void game_update(MtScene *scene, float delta)
         mt_post_physics_sync_system(em);
     }
 
+    mt_model_cull_system(em, &g->scene);
+
     {
         MtCmdBuffer *cb = mt_render.pass_begin(scene->graph, "color_pass");
 
@@ -227,8 +237,15 @@ static MtIScene game_create(MtEngine *engine)
 
 int main(int argc, char *argv[])
 {
+    MtEngineFlags flags = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bindless") == 0) flags |= MT_ENGINE_BINDLESS;
+        if (strcmp(argv[i], "--compress-images") == 0) flags |= MT_ENGINE_COMPRESS_IMAGES;
+    }
+
     MtEngine engine = {0};
-    mt_engine_init(&engine);
+    mt_engine_init(&engine, flags);
 
     MtIScene game_scene = game_create(&engine);
     mt_engine_set_scene(&engine, &game_scene);
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "api_types.h"
+#include "threads.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtAllocator MtAllocator;
+typedef struct MtThreadPool MtThreadPool;
+typedef struct MtTaskGroup MtTaskGroup;
+
+// Reads files without blocking the thread pool's workers, and runs a continuation on the
+// pool for each read once its data is in memory. On Linux the reads go through io_uring,
+// elsewhere, or when io_uring is not available, through a few threads of its own.
+typedef struct MtAsyncIo MtAsyncIo;
+
+#define MT_ASYNC_READ_WHOLE_FILE UINT64_MAX
+
+typedef struct MtAsyncRead MtAsyncRead;
+
+typedef struct MtAsyncRead
+{
+    const char *path;
+    uint64_t offset;
+    // MT_ASYNC_READ_WHOLE_FILE reads from offset to the end of the file
+    uint64_t size;
+    // Allocates data
+    MtAllocator *alloc;
+
+    // Runs on the thread pool with the read as argument
+    MtThreadStart continuation;
+    void *user_data;
+
+    // Set before the continuation runs, which owns data. size is the number of bytes read.
+    uint8_t *data;
+    bool failed;
+
+    // Private
+    MtAsyncRead *next;
+    MtTaskGroup *group;
+    intptr_t fd;
+    uint64_t done;
+} MtAsyncRead;
+
+MT_BASE_API MtAsyncIo *mt_async_io_create(MtAllocator *alloc, MtThreadPool *pool);
+
+// Waits for the reads in flight, their continuations are enqueued but may not have run
+MT_BASE_API void mt_async_io_destroy(MtAsyncIo *io);
+
+// "io_uring" or "threads"
+MT_BASE_API const char *mt_async_io_backend(MtAsyncIo *io);
+
+// The reads are issued together and have to stay alive until their continuations run.
+// Waiting on group, or on the whole pool, also waits for the reads.
+MT_BASE_API void
+mt_async_io_submit(MtAsyncIo *io, MtAsyncRead **reads, uint32_t count, MtTaskGroup *group);
+
+#ifdef __cplusplus
+}
+#endif
@@ -6,8 +6,20 @@
 extern "C" {
 #endif
 
+typedef struct MtFileMapping
+{
+    const uint8_t *data;
+    size_t size;
+    void *handle;
+} MtFileMapping;
+
 MT_BASE_API const char *mt_path_ext(const char *path);
 
+// Maps a whole file read-only, returns false if it can't be opened or is empty
+MT_BASE_API bool mt_file_map(MtFileMapping *mapping, const char *path);
+
+MT_BASE_API void mt_file_unmap(MtFileMapping *mapping);
+
 #ifdef __cplusplus
 }
 #endif
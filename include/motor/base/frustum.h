@@ -0,0 +1,50 @@
+#pragma once
+
+#include "api_types.h"
+#include "math_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtThreadPool MtThreadPool;
+
+typedef struct MtAabb
+{
+    Vec3 min;
+    Vec3 max;
+} MtAabb;
+
+// Planes are (normal, distance) with normals pointing inwards:
+// left, right, bottom, top, near, far
+typedef struct MtFrustum
+{
+    Vec4 planes[6];
+} MtFrustum;
+
+// view_proj is mat4_mul(view, proj) with a [0, 1] clip space depth range,
+// as produced by MtPerspectiveCamera
+MT_BASE_API void mt_frustum_from_matrix(MtFrustum *frustum, const Mat4 *view_proj);
+
+MT_BASE_API MtAabb mt_aabb_transform(const MtAabb *aabb, const Mat4 *transform);
+
+MT_BASE_API bool mt_frustum_test_aabb(const MtFrustum *frustum, const MtAabb *aabb);
+
+// Writes 1 to visible[i] if boxes[i] intersects the frustum, 0 otherwise.
+// Tests 8 boxes at a time with AVX when the CPU supports it, else 4 at a time with SSE.
+MT_BASE_API void mt_frustum_cull_aabbs(
+    const MtFrustum *frustum, const MtAabb *boxes, uint32_t count, uint8_t *visible);
+
+// Same as mt_frustum_cull_aabbs, split in chunks over the pool's workers when there are
+// enough boxes to pay for it. The calling thread works on chunks too, so it doesn't stall
+// on a busy pool.
+MT_BASE_API void mt_frustum_cull_aabbs_parallel(
+    MtThreadPool *pool,
+    const MtFrustum *frustum,
+    const MtAabb *boxes,
+    uint32_t count,
+    uint8_t *visible);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "api_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// LZ4 block format, without the frame around it: the sizes are stored by the caller
+
+MT_BASE_API size_t mt_lz4_compress_bound(size_t size);
+
+// Returns the compressed size, 0 if it does not fit in dst_capacity
+MT_BASE_API size_t
+mt_lz4_compress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity);
+
+// Returns false unless src decompresses to exactly dst_size bytes
+MT_BASE_API bool
+mt_lz4_decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size);
+
+#ifdef __cplusplus
+}
+#endif
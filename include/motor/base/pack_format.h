@@ -0,0 +1,100 @@
+#pragma once
+
+#include "api_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pack files (.mtpack), written by tools/pack_builder.c and mounted with mt_vfs_mount_pack.
+//
+// Layout:
+//   MtPackHeader
+//   MtPackEntry[entry_count], sorted by path_hash
+//   names, names_size bytes of NUL terminated paths
+//   entry data at MT_PACK_ALIGNMENT boundaries
+//
+// The table of contents is searched in place. Stored entries are page aligned so a mapped
+// pack hands them out without a copy, compressed ones are decompressed on open.
+
+enum {
+    MT_PACK_MAGIC = 0x4b50544d, // "MTPK"
+    MT_PACK_VERSION = 1,
+    MT_PACK_ALIGNMENT = 4096,
+};
+
+typedef enum MtPackCompression {
+    MT_PACK_COMPRESSION_NONE = 0,
+    MT_PACK_COMPRESSION_LZ4 = 1,
+} MtPackCompression;
+
+typedef struct MtPackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t names_size;
+} MtPackHeader;
+
+typedef struct MtPackEntry
+{
+    // mt_hash_str of the path
+    uint64_t path_hash;
+    uint64_t offset;
+    uint64_t size;
+    // Size in the pack, equal to size unless compressed
+    uint64_t stored_size;
+    // Modification time of the source file, in seconds
+    uint64_t mtime;
+    uint32_t name_offset;
+    uint32_t compression;
+} MtPackEntry;
+
+static inline const MtPackEntry *mt_pack_entries(const MtPackHeader *header)
+{
+    return (const MtPackEntry *)(header + 1);
+}
+
+static inline const char *mt_pack_names(const MtPackHeader *header)
+{
+    return (const char *)(mt_pack_entries(header) + header->entry_count);
+}
+
+// Returns the header if data holds a complete pack of this version, NULL otherwise
+static inline const MtPackHeader *mt_pack_header(const uint8_t *data, size_t size)
+{
+    if (size < sizeof(MtPackHeader)) return NULL;
+
+    const MtPackHeader *header = (const MtPackHeader *)data;
+    if (header->magic != MT_PACK_MAGIC || header->version != MT_PACK_VERSION)
+    {
+        return NULL;
+    }
+
+    uint64_t toc_end = sizeof(MtPackHeader) +
+                       (uint64_t)header->entry_count * sizeof(MtPackEntry) + header->names_size;
+    if (toc_end > size ||
+        (header->names_size > 0 && mt_pack_names(header)[header->names_size - 1] != '\0'))
+    {
+        return NULL;
+    }
+
+    const MtPackEntry *entries = mt_pack_entries(header);
+    for (uint32_t i = 0; i < header->entry_count; i++)
+    {
+        if (entries[i].offset > size || entries[i].stored_size > size - entries[i].offset ||
+            entries[i].name_offset >= header->names_size ||
+            entries[i].compression > MT_PACK_COMPRESSION_LZ4 ||
+            (entries[i].compression == MT_PACK_COMPRESSION_NONE &&
+             entries[i].stored_size != entries[i].size))
+        {
+            return NULL;
+        }
+    }
+
+    return header;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,10 +8,17 @@ extern "C" {
 
 typedef struct MtAllocator MtAllocator;
 
+// Counts the unfinished tasks enqueued with it, guarded by the pool's queue mutex
+typedef struct MtTaskGroup
+{
+    uint32_t pending;
+} MtTaskGroup;
+
 typedef struct MtThreadPoolTask
 {
     void *arg;
     MtThreadStart routine;
+    MtTaskGroup *group;
 } MtThreadPoolTask;
 
 typedef struct MtThreadPool MtThreadPool;
@@ -49,6 +56,21 @@ MT_BASE_API void mt_thread_pool_destroy(MtThreadPool *pool);
 
 MT_BASE_API void mt_thread_pool_enqueue(MtThreadPool *pool, MtThreadStart routine, void *arg);
 
+MT_BASE_API void mt_thread_pool_enqueue_group(
+    MtThreadPool *pool, MtTaskGroup *group, MtThreadStart routine, void *arg);
+
+// Counts a task that will be enqueued later with mt_thread_pool_enqueue_deferred, so waiting
+// on the group or on the whole pool already waits for it. Used by work that runs outside of
+// the pool first, like reads of the async I/O service.
+MT_BASE_API void mt_thread_pool_defer(MtThreadPool *pool, MtTaskGroup *group);
+
+MT_BASE_API void mt_thread_pool_enqueue_deferred(
+    MtThreadPool *pool, MtTaskGroup *group, MtThreadStart routine, void *arg);
+
+// Runs queued tasks of the group on the calling thread until every one of them is done,
+// so a task can wait for the tasks it spawned without tying up a worker
+MT_BASE_API void mt_thread_pool_wait_group(MtThreadPool *pool, MtTaskGroup *group);
+
 MT_BASE_API bool mt_thread_pool_is_busy(MtThreadPool *pool);
 
 MT_BASE_API void mt_thread_pool_wait_all(MtThreadPool *pool);
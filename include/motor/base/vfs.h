@@ -0,0 +1,94 @@
+#pragma once
+
+#include "api_types.h"
+#include "async_io.h"
+#include "filesystem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtAllocator MtAllocator;
+typedef struct MtVfsMount MtVfsMount;
+
+// Virtual file system for read-only assets. A path like "assets/helmet.glb" is looked up in
+// the mount points whose name prefixes it, the most recently mounted first. Mount points
+// are backed by a directory or a pack file (pack_format.h). Paths that no mount point
+// resolves are opened from the filesystem as they are.
+//
+// Mounting is not thread safe, opening files is.
+typedef struct MtVfs
+{
+    MtAllocator *alloc;
+    /*array*/ MtVfsMount *mounts;
+} MtVfs;
+
+typedef struct MtVfsFile
+{
+    const uint8_t *data;
+    size_t size;
+
+    // Set for files from directories
+    MtFileMapping mapping;
+    // Set for compressed pack entries
+    uint8_t *buffer;
+} MtVfsFile;
+
+// Has to stay alive until its continuation runs
+typedef struct MtVfsAsyncOpen
+{
+    const char *path;
+    // Runs on the thread pool with the request as argument
+    MtThreadStart continuation;
+    void *user_data;
+
+    // Set before the continuation runs, which closes it with mt_vfs_close.
+    // Opening failed if data is NULL.
+    MtVfsFile file;
+
+    // Private
+    MtVfs *vfs;
+    MtAsyncRead read;
+    char real_path[1024];
+    uint64_t size;
+    uint32_t compression;
+} MtVfsAsyncOpen;
+
+typedef struct MtVfsStat
+{
+    uint64_t size;
+    // Modification time in seconds, for pack entries the one of the file they were made from
+    uint64_t mtime;
+} MtVfsStat;
+
+MT_BASE_API void mt_vfs_init(MtVfs *vfs, MtAllocator *alloc);
+
+MT_BASE_API void mt_vfs_destroy(MtVfs *vfs);
+
+// An empty name mounts at the root, where paths are looked up whole
+MT_BASE_API void mt_vfs_mount_dir(MtVfs *vfs, const char *name, const char *dir);
+
+// Maps the pack for as long as the VFS lives, returns false if it is missing or invalid
+MT_BASE_API bool mt_vfs_mount_pack(MtVfs *vfs, const char *name, const char *pack_path);
+
+// Stored pack entries point into the mapped pack, everything else is mapped or
+// decompressed here. Returns false if the file does not exist or is empty.
+MT_BASE_API bool mt_vfs_open(MtVfs *vfs, const char *path, MtVfsFile *file);
+
+// Reads whole files through io instead of mapping them, so the thread pool's workers don't
+// wait for the disk. Compressed pack entries are decompressed on the pool. Waiting on group
+// also waits for the continuations. Only worth it for files that mt_vfs_needs_read.
+MT_BASE_API void mt_vfs_open_async(
+    MtVfs *vfs, MtAsyncIo *io, MtVfsAsyncOpen **opens, uint32_t count, MtTaskGroup *group);
+
+MT_BASE_API void mt_vfs_close(MtVfs *vfs, MtVfsFile *file);
+
+// Whether mt_vfs_open has to read the whole file, as for compressed pack entries.
+// Other files are mapped, only the parts that are used get read.
+MT_BASE_API bool mt_vfs_needs_read(MtVfs *vfs, const char *path);
+
+MT_BASE_API bool mt_vfs_stat(MtVfs *vfs, const char *path, MtVfsStat *stat);
+
+#ifdef __cplusplus
+}
+#endif
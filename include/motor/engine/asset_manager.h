@@ -2,7 +2,7 @@
 
 #include "api_types.h"
 #include <motor/base/hashmap.h>
-#include <motor/base/threads.h>
+#include <motor/base/thread_pool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -11,6 +11,7 @@ extern "C" {
 typedef struct MtEngine MtEngine;
 typedef struct MtAllocator MtAllocator;
 typedef struct MtAssetManager MtAssetManager;
+typedef struct MtVfsFile MtVfsFile;
 
 typedef struct MtAssetVT MtAssetVT;
 
@@ -18,8 +19,37 @@ typedef struct MtAsset
 {
     MtAssetVT *vt;
     const char *path;
+
+    // Set by the loader, counted against the asset manager's budgets
+    uint64_t cpu_size;
+    uint64_t gpu_size;
 } MtAsset;
 
+// Counted reference to an asset of one asset manager.
+// Resolving a handle fails once its asset has been unloaded.
+typedef struct MtAssetHandle
+{
+    // Slot index + 1, 0 is the null handle
+    uint32_t index;
+    uint32_t generation;
+} MtAssetHandle;
+
+typedef enum MtAssetPriority {
+    // Needed before anything can be drawn, like fonts and shaders
+    MT_ASSET_PRIORITY_CRITICAL,
+    // Needed by what is in view
+    MT_ASSET_PRIORITY_VISIBLE,
+    // May be needed later
+    MT_ASSET_PRIORITY_PREFETCH,
+    MT_ASSET_PRIORITY_COUNT,
+} MtAssetPriority;
+
+// Runs on a thread pool worker when a request completes. The handle is null if loading
+// failed, otherwise the callback owns its reference.
+typedef void (*MtAssetCallback)(MtAssetManager *am, MtAssetHandle handle, void *user_data);
+
+typedef struct MtAssetLoad MtAssetLoad;
+
 typedef struct MtAssetVT
 {
     const char *name;
@@ -29,10 +59,23 @@ typedef struct MtAssetVT
 
     uint32_t size;
 
-    bool (*init)(MtAssetManager *, MtAsset *, const char *path);
+    // file holds the whole asset, it is closed by the asset manager once init returns
+    bool (*init)(MtAssetManager *, MtAsset *, const char *path, const MtVfsFile *file);
     void (*destroy)(MtAsset *);
 } MtAssetVT;
 
+typedef struct MtAssetSlot
+{
+    MtAsset *asset;
+    // Reloaded version, swapped in by mt_asset_manager_update
+    MtAsset *pending;
+    uint32_t generation;
+    uint32_t ref_count;
+    // Loaded through the pointer API, never unloaded
+    bool pinned;
+    uint64_t last_used_frame;
+} MtAssetSlot;
+
 typedef struct MtAssetManager
 {
     MtEngine *engine;
@@ -42,24 +85,102 @@ typedef struct MtAssetManager
     /*array*/ MtAssetVT **asset_types;
     MtHashMap asset_type_map;
 
-    /*array*/ MtAsset **assets;
+    /*array*/ MtAssetSlot *slots;
+    /*array*/ uint32_t *free_slots;
+    // Path hash to slot index
     MtHashMap asset_map;
 
     MtMutex mutex;
+
+    // Queued loads waiting to start, each in the queue of its most urgent request
+    /*array*/ MtAssetLoad **load_queues[MT_ASSET_PRIORITY_COUNT];
+    // Path hash to queued or running load, so requests for the same path share one
+    MtHashMap loads;
+    // Request id to its load
+    MtHashMap requests;
+    uint64_t next_request;
+    uint32_t running_loads;
+    // Counts the running loads, until their callbacks have run
+    MtTaskGroup load_group;
+
+    // Loads started at once, the rest wait in the queues. Defaults to the number of workers.
+    uint32_t max_running_loads;
+
+    uint64_t frame;
+
+    // Unreferenced assets are unloaded, least recently used first, while the usage
+    // is over budget. 0 means no limit.
+    uint64_t cpu_budget;
+    uint64_t gpu_budget;
+    uint64_t cpu_usage;
+    uint64_t gpu_usage;
+
+    // Decode the sub-resources of an asset on the loading thread instead of as child tasks
+    bool serial_loads;
+
+    // Queued loads that have to read their whole file, like compressed pack entries, read it
+    // on the worker that loads the asset instead of through the engine's async I/O.
+    // Other files are always mapped.
+    bool sync_io;
 } MtAssetManager;
 
 MT_ENGINE_API void
 mt_asset_manager_init(MtAssetManager *am, MtAssetManager *parent, MtEngine *engine);
 
+// Assets returned as pointers stay loaded until the asset manager is destroyed.
+// Loading a path that is already loaded reloads it, the new version replaces the old one
+// in place at the next mt_asset_manager_update.
 MT_ENGINE_API MtAsset *mt_asset_manager_load(MtAssetManager *am, const char *path);
 
-// Loads the asset through the engine's thread pool and
-// stores the asset in *out_asset when the load is complete
+// Requests a reference to the asset, loading it if needed. The file is read through the
+// engine's async I/O and the asset is loaded on the engine's thread pool, after the more
+// urgent requests. Concurrent requests for the same path share one load.
+// Returns the id of the request, never 0.
+MT_ENGINE_API uint64_t mt_asset_manager_request(
+    MtAssetManager *am,
+    const char *path,
+    MtAssetPriority priority,
+    MtAssetCallback callback,
+    void *user_data);
+
+// The callback of a cancelled request never runs, a load that no request needs anymore is
+// dropped if it did not start yet. Returns false if the request already completed.
+MT_ENGINE_API bool mt_asset_manager_cancel(MtAssetManager *am, uint64_t request);
+
+// Moves a request that did not complete to another priority, like a prefetch coming into view
+MT_ENGINE_API void
+mt_asset_manager_set_priority(MtAssetManager *am, uint64_t request, MtAssetPriority priority);
+
+// Waits for the queued and running loads, and their callbacks
+MT_ENGINE_API void mt_asset_manager_wait(MtAssetManager *am);
+
+// Requests the asset at MT_ASSET_PRIORITY_CRITICAL and stores it in *out_asset when the load
+// is complete. The asset stays loaded like the ones returned by mt_asset_manager_load,
+// but is not reloaded if it already was.
 MT_ENGINE_API void
 mt_asset_manager_queue_load(MtAssetManager *am, const char *path, MtAsset **out_asset);
 
 MT_ENGINE_API MtAsset *mt_asset_manager_get(MtAssetManager *am, const char *path);
 
+// Returns a reference to the asset, loading it if needed. The handle is null if loading failed.
+MT_ENGINE_API MtAssetHandle mt_asset_manager_acquire(MtAssetManager *am, const char *path);
+
+// Requests the asset at MT_ASSET_PRIORITY_CRITICAL and
+// stores the handle in *out_handle when the load is complete
+MT_ENGINE_API void
+mt_asset_manager_queue_acquire(MtAssetManager *am, const char *path, MtAssetHandle *out_handle);
+
+// Unreferenced assets stay cached until the budgets need their memory
+MT_ENGINE_API void mt_asset_manager_release(MtAssetManager *am, MtAssetHandle handle);
+
+// Returns NULL if the asset was unloaded. The pointer is valid until the next
+// mt_asset_manager_update, or for as long as the handle is held.
+MT_ENGINE_API MtAsset *mt_asset_manager_resolve(MtAssetManager *am, MtAssetHandle handle);
+
+// Called once per frame, when no other thread is using assets:
+// publishes reloaded assets and unloads assets to get back under the budgets.
+MT_ENGINE_API void mt_asset_manager_update(MtAssetManager *am);
+
 MT_ENGINE_API void
 mt_asset_manager_get_all(MtAssetManager *am, MtAssetVT *type, uint32_t *count, MtAsset **assets);
 
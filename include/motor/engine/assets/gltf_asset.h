@@ -2,6 +2,7 @@
 
 #include "../api_types.h"
 #include <motor/base/math_types.h>
+#include <motor/base/frustum.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -9,11 +10,23 @@ extern "C" {
 
 typedef struct MtAssetVT MtAssetVT;
 typedef struct MtCmdBuffer MtCmdBuffer;
+typedef struct MtDrawIndexedIndirectCommand MtDrawIndexedIndirectCommand;
+typedef struct MtCameraUniform MtCameraUniform;
 
 extern MtAssetVT *mt_gltf_asset_vt;
 
 typedef struct MtGltfAsset MtGltfAsset;
 
+// Per-draw data of the instanced and bindless paths, must match DrawData in shaders/pbr.hlsl
+typedef struct MtGltfDrawData
+{
+    Mat4 model;
+    // In the engine's material table, bindless only
+    uint32_t material_index;
+    float normal_mapped;
+    uint32_t pad[2];
+} MtGltfDrawData;
+
 MT_ENGINE_API void mt_gltf_asset_draw(
     MtGltfAsset *asset,
     MtCmdBuffer *cb,
@@ -21,6 +34,63 @@ MT_ENGINE_API void mt_gltf_asset_draw(
     uint32_t model_set,
     uint32_t material_set);
 
+// Requires MtEngine.bindless: records one draw per primitive, each reading its transform and
+// its index in the engine's material table from draws, found by instance index starting at
+// first_instance. Writes mt_gltf_asset_draw_count entries of draws, which the caller binds
+// along with the material table. Returns the number of draw calls recorded.
+MT_ENGINE_API uint32_t mt_gltf_asset_draw_bindless(
+    MtGltfAsset *asset,
+    MtCmdBuffer *cb,
+    const Mat4 *transform,
+    uint32_t first_instance,
+    MtGltfDrawData *draws);
+
+MT_ENGINE_API bool mt_gltf_asset_in_geometry_arena(MtGltfAsset *asset);
+
+// Number of primitives, i.e. draws per instance
+MT_ENGINE_API uint32_t mt_gltf_asset_draw_count(MtGltfAsset *asset);
+
+// Asks the texture streamer for the mips each material needs at the on-screen size
+// of its primitives, seen from camera in a viewport viewport_height pixels tall
+MT_ENGINE_API void mt_gltf_asset_request_mips(
+    MtGltfAsset *asset,
+    const Mat4 *transform,
+    const MtCameraUniform *camera,
+    float viewport_height);
+
+// Writes the world space bounds of every primitive of every instance, in the same
+// primitive-major layout as the draws written by mt_gltf_asset_write_draws
+MT_ENGINE_API void mt_gltf_asset_write_bounds(
+    MtGltfAsset *asset, const Mat4 *transforms, uint32_t instance_count, MtAabb *boxes);
+
+// Writes one indirect command per primitive, each drawing its visible instances,
+// and the per-instance data for them into draws (primitive-major). Instance data is
+// found in the shader by instance index, starting at first_instance.
+// visible is laid out like mt_gltf_asset_write_bounds, or NULL to draw everything.
+// Primitives with no visible instance are left out and the remaining commands are
+// zeroed, returns the number of commands to draw.
+MT_ENGINE_API uint32_t mt_gltf_asset_write_draws(
+    MtGltfAsset *asset,
+    const Mat4 *transforms,
+    uint32_t instance_count,
+    uint32_t first_instance,
+    const uint8_t *visible,
+    MtDrawIndexedIndirectCommand *commands,
+    MtGltfDrawData *draws);
+
+// Same layout as mt_gltf_asset_write_draws, but records one instanced draw per primitive
+// with its material bound at material_set. draws must be bound by the caller.
+// Returns the number of draw calls recorded.
+MT_ENGINE_API uint32_t mt_gltf_asset_draw_instanced(
+    MtGltfAsset *asset,
+    MtCmdBuffer *cb,
+    const Mat4 *transforms,
+    uint32_t instance_count,
+    uint32_t first_instance,
+    const uint8_t *visible,
+    MtGltfDrawData *draws,
+    uint32_t material_set);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "../api_types.h"
+#include <motor/base/math_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtAssetVT MtAssetVT;
+typedef struct MtCmdBuffer MtCmdBuffer;
+
+// Geometry of a cooked .mtmesh file, see motor/engine/mesh_format.h
+extern MtAssetVT *mt_mesh_asset_vt;
+
+typedef struct MtMeshAsset MtMeshAsset;
+
+// Draws every primitive with its mesh matrix bound at (model_set, 0), without materials
+MT_ENGINE_API void
+mt_mesh_asset_draw(MtMeshAsset *asset, MtCmdBuffer *cb, Mat4 *transform, uint32_t model_set);
+
+// Number of primitives, i.e. draws per instance
+MT_ENGINE_API uint32_t mt_mesh_asset_draw_count(MtMeshAsset *asset);
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,6 +5,7 @@
 #include "scene.h"
 #include "meshes.h"
 #include <motor/base/thread_pool.h>
+#include <motor/base/vfs.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -22,8 +23,32 @@ typedef struct MtPicker MtPicker;
 typedef struct MtAssetManager MtAssetManager;
 typedef struct MtImguiContext MtImguiContext;
 typedef struct shaderc_compiler *shaderc_compiler_t;
+typedef struct MtShaderCache MtShaderCache;
 typedef struct MtPipelineAsset MtPipelineAsset;
 typedef struct MtGltfAsset MtGltfAsset;
+typedef struct MtGeometryArena MtGeometryArena;
+typedef struct MtTextureStreamer MtTextureStreamer;
+typedef struct MtMaterialTable MtMaterialTable;
+typedef struct MtImageCache MtImageCache;
+
+typedef enum MtEngineFlags {
+    // Use the descriptor-indexed material path when the device supports it
+    MT_ENGINE_BINDLESS = 1,
+    // No window system, the scene renders offscreen at a fixed size and gets no input
+    MT_ENGINE_HEADLESS = 2,
+    // Compress loaded PNG/JPEG images to BC7 in the background, later runs load those instead
+    MT_ENGINE_COMPRESS_IMAGES = 4,
+} MtEngineFlags;
+
+typedef struct MtModelDrawStats
+{
+    uint32_t instances;
+    // One draw per primitive per entity, what was submitted before instancing
+    uint32_t naive_draw_calls;
+    uint32_t draw_calls;
+    // Primitive instances outside the camera frustum
+    uint32_t culled;
+} MtModelDrawStats;
 
 typedef struct MtEngine
 {
@@ -37,23 +62,43 @@ typedef struct MtEngine
 
     MtAllocator *alloc;
     MtThreadPool thread_pool;
+    // Reads asset files for queued loads, their continuations run on the thread pool
+    MtAsyncIo *async_io;
+    // Assets and shaders are loaded by their path in here: "assets/..." and "shaders/..."
+    MtVfs vfs;
     MtAssetManager *asset_manager;
 
+    MtGeometryArena *geometry_arena;
+    MtTextureStreamer *texture_streamer;
+    // NULL without bindless
+    MtMaterialTable *material_table;
+    // NULL without MT_ENGINE_COMPRESS_IMAGES
+    MtImageCache *image_cache;
+
     MtImguiContext *imgui_ctx;
     MtFileWatcher *watcher;
 
     shaderc_compiler_t compiler;
+    MtShaderCache *shader_cache;
 
     MtImage *white_image;
     MtImage *black_image;
     MtImage *default_cubemap;
     MtSampler *default_sampler;
 
+    bool bindless;
+    uint32_t white_image_index;
+    uint32_t black_image_index;
+    uint32_t default_sampler_index;
+
     MtMesh sphere_mesh;
 
     MtGltfAsset *default_cube;
 
     MtPipelineAsset *pbr_pipeline;
+    MtPipelineAsset *pbr_instanced_pipeline;
+    MtPipelineAsset *pbr_bindless_pipeline;
+    MtPipelineAsset *pbr_indirect_pipeline;
     MtPipelineAsset *wireframe_pipeline;
     MtPipelineAsset *gizmo_pipeline;
     MtPipelineAsset *skybox_pipeline;
@@ -63,13 +108,18 @@ typedef struct MtEngine
     MtPipelineAsset *imgui_pipeline;
     MtPipelineAsset *picking_pipeline;
     MtPipelineAsset *picking_transfer_pipeline;
+    MtPipelineAsset *hiz_pipeline;
+    MtPipelineAsset *gpu_cull_pipeline;
+
+    MtModelDrawStats model_stats;
 
     bool playing;
 
     MtIScene current_scene;
 } MtEngine;
 
-MT_ENGINE_API void mt_engine_init(MtEngine *engine);
+// engine->alloc may be set before, every other field is cleared
+MT_ENGINE_API void mt_engine_init(MtEngine *engine, MtEngineFlags flags);
 
 MT_ENGINE_API void mt_engine_destroy(MtEngine *engine);
 
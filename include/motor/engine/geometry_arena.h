@@ -0,0 +1,54 @@
+#pragma once
+
+#include "api_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtEngine MtEngine;
+typedef struct MtCmdBuffer MtCmdBuffer;
+
+// One device-local vertex buffer and one index buffer shared by every loaded mesh,
+// so draws of different meshes don't need to rebind buffers.
+typedef struct MtGeometryArena MtGeometryArena;
+
+typedef struct MtGeometryAllocation
+{
+    uint32_t first_vertex;
+    uint32_t vertex_count;
+    uint32_t first_index;
+    uint32_t index_count;
+} MtGeometryAllocation;
+
+MT_ENGINE_API MtGeometryArena *
+mt_geometry_arena_create(MtEngine *engine, uint32_t vertex_capacity, uint32_t index_capacity);
+
+MT_ENGINE_API void mt_geometry_arena_destroy(MtGeometryArena *arena);
+
+// Returns false if either buffer has no free range large enough
+MT_ENGINE_API bool mt_geometry_arena_alloc(
+    MtGeometryArena *arena,
+    uint32_t vertex_count,
+    uint32_t index_count,
+    MtGeometryAllocation *allocation);
+
+// The ranges are only reused once no frame in flight can draw from them
+MT_ENGINE_API void mt_geometry_arena_free(MtGeometryArena *arena, MtGeometryAllocation *allocation);
+
+// Called once per frame, when nothing is recording: gives back the ranges freed
+// more than MT_MAX_FRAMES_IN_FLIGHT frames ago
+MT_ENGINE_API void mt_geometry_arena_update(MtGeometryArena *arena);
+
+MT_ENGINE_API void mt_geometry_arena_upload(
+    MtGeometryArena *arena,
+    const MtGeometryAllocation *allocation,
+    const MtStandardVertex *vertices,
+    const uint32_t *indices);
+
+// Binds the shared vertex buffer and the shared uint32 index buffer
+MT_ENGINE_API void mt_geometry_arena_bind(MtGeometryArena *arena, MtCmdBuffer *cb);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "api_types.h"
+#include <motor/base/math_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtEngine MtEngine;
+typedef struct MtCmdBuffer MtCmdBuffer;
+typedef struct MtRenderGraph MtRenderGraph;
+typedef struct MtRenderGraphPass MtRenderGraphPass;
+typedef struct MtCameraUniform MtCameraUniform;
+
+// Frustum and Hi-Z occlusion culling of draws in compute passes of a render graph.
+// The Hi-Z pyramid is built from the depth of the previous frame, and the surviving
+// draws are compacted into one indirect command range per bucket.
+typedef struct MtGpuCuller MtGpuCuller;
+
+// One indexed draw of a single instance, must match CullItem in shaders/gpu_cull.hlsl
+typedef struct MtGpuCullItem
+{
+    Vec4 aabb_min;
+    Vec4 aabb_max;
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t bucket;
+    // First item of the bucket, where its commands get written
+    uint32_t command_base;
+    uint32_t pad[3];
+} MtGpuCullItem;
+
+// Consecutive items that are drawn with the same bindings
+typedef struct MtGpuCullBucket
+{
+    uint32_t first_item;
+    uint32_t item_count;
+    void *user_data;
+} MtGpuCullBucket;
+
+typedef void (*MtGpuCullBindCallback)(MtCmdBuffer *, void *bucket_user_data);
+
+// Adds the culling passes and their buffers to graph. depth_image must already be
+// in the graph, and the passes that draw must be added after this.
+MT_ENGINE_API MtGpuCuller *
+mt_gpu_culler_create(MtEngine *engine, MtRenderGraph *graph, const char *depth_image);
+
+MT_ENGINE_API void mt_gpu_culler_destroy(MtGpuCuller *culler);
+
+// The depth image is recreated, so the next frame is only frustum culled
+MT_ENGINE_API void mt_gpu_culler_on_resize(MtGpuCuller *culler);
+
+// Makes pass wait for the culled commands
+MT_ENGINE_API void mt_gpu_culler_add_reads(MtGpuCuller *culler, MtRenderGraphPass *pass);
+
+// Records the culling passes, must be called once every frame before the passes that draw.
+// draw_data holds data_size bytes per item and is bound for the draws, indexed by the
+// instance index. Returns false when there is too much to cull, then nothing gets drawn.
+MT_ENGINE_API bool mt_gpu_culler_cull(
+    MtGpuCuller *culler,
+    const MtCameraUniform *cam,
+    const MtGpuCullItem *items,
+    uint32_t item_count,
+    const MtGpuCullBucket *buckets,
+    uint32_t bucket_count,
+    const void *draw_data,
+    size_t data_size);
+
+// Whether the last mt_gpu_culler_cull succeeded and there is something to draw
+MT_ENGINE_API bool mt_gpu_culler_has_draws(MtGpuCuller *culler);
+
+// Records one indirect draw per bucket, calling bind before each one.
+// The pipeline and the vertex and index buffers must be bound by the caller.
+// Returns the number of draw calls recorded.
+MT_ENGINE_API uint32_t mt_gpu_culler_draw(
+    MtGpuCuller *culler, MtCmdBuffer *cb, MtGpuCullBindCallback bind, uint32_t data_set);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "api_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtEngine MtEngine;
+
+// On-disk cache of BC7 compressed images, one KTX file with a full mip chain per entry in
+// a directory. Entries are addressed by the hash of the encoded PNG/JPEG they were made
+// from, and are compressed on the thread pool the first time the source is loaded.
+typedef struct MtImageCache MtImageCache;
+
+MT_ENGINE_API MtImageCache *mt_image_cache_create(MtEngine *engine, const char *dir);
+
+// Waits for the compressions still running
+MT_ENGINE_API void mt_image_cache_destroy(MtImageCache *cache);
+
+MT_ENGINE_API uint64_t mt_image_cache_key(const uint8_t *source, size_t source_size);
+
+// Writes the path of the KTX file of key, returns false if it was not compressed yet
+MT_ENGINE_API bool
+mt_image_cache_get(MtImageCache *cache, uint64_t key, char *path, size_t path_size);
+
+// Starts compressing the RGBA8 pixels of key unless it is cached or already being
+// compressed. The pixels are copied.
+MT_ENGINE_API void mt_image_cache_compress(
+    MtImageCache *cache, uint64_t key, const uint8_t *pixels, uint32_t width, uint32_t height);
+
+#ifdef __cplusplus
+}
+#endif
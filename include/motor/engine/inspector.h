@@ -1,6 +1,7 @@
 #pragma once
 
 #include "api_types.h"
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -8,9 +9,21 @@ extern "C" {
 
 typedef struct MtEngine MtEngine;
 typedef struct MtEntityManager MtEntityManager;
+typedef struct MtRenderGraph MtRenderGraph;
 
 MT_ENGINE_API void mt_inspect_entities(MtEngine *engine, MtEntityManager *em);
 
+// GPU time of the passes and execution groups of graph, and its frame pacing
+MT_ENGINE_API void mt_inspect_render_graph(MtEngine *engine, MtRenderGraph *graph);
+
+// Creates or truncates a CSV file for mt_inspect_render_graph_csv and writes its header.
+// Returns NULL if it can't be opened, close it with fclose.
+MT_ENGINE_API FILE *mt_inspect_render_graph_csv_open(const char *path);
+
+// Appends a row for every pass of graph to the CSV file, so runs can be compared
+MT_ENGINE_API bool
+mt_inspect_render_graph_csv(MtEngine *engine, MtRenderGraph *graph, FILE *f, uint64_t frame);
+
 #ifdef __cplusplus
 }
 #endif
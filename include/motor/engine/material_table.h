@@ -0,0 +1,58 @@
+#pragma once
+
+#include "api_types.h"
+#include <motor/base/math_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtEngine MtEngine;
+typedef struct MtCmdBuffer MtCmdBuffer;
+
+// Bindless materials of every loaded asset in one storage buffer, so draws of different
+// assets select their material by index instead of rebinding material data.
+typedef struct MtMaterialTable MtMaterialTable;
+
+typedef struct MtMaterialTableEntry
+{
+    Vec4 base_color_factor;
+    Vec4 emissive_factor;
+    float metallic;
+    float roughness;
+    uint32_t sampler_index;
+
+    // Bindless image indices, read whenever the table is written since the texture
+    // streamer moves streamed images to new indices
+    const uint32_t *albedo_image;
+    const uint32_t *normal_image;
+    const uint32_t *metallic_roughness_image;
+    const uint32_t *occlusion_image;
+    const uint32_t *emissive_image;
+} MtMaterialTableEntry;
+
+MT_ENGINE_API MtMaterialTable *mt_material_table_create(MtEngine *engine);
+
+MT_ENGINE_API void mt_material_table_destroy(MtMaterialTable *table);
+
+// Copies count entries into consecutive slots and returns the index of the first one
+MT_ENGINE_API uint32_t mt_material_table_alloc(
+    MtMaterialTable *table, const MtMaterialTableEntry *entries, uint32_t count);
+
+// Frames in flight keep reading the table as it was when they were recorded
+MT_ENGINE_API void mt_material_table_free(MtMaterialTable *table, uint32_t first, uint32_t count);
+
+// Called when image indices referenced by the entries have changed
+MT_ENGINE_API void mt_material_table_invalidate(MtMaterialTable *table);
+
+// Called once per frame, when nothing is recording: writes the buffer of this frame
+// if the table changed since it was last written
+MT_ENGINE_API void mt_material_table_update(MtMaterialTable *table);
+
+// Binds the buffer of this frame at (set, 0), must match BindlessMaterial in
+// shaders/common.hlsl
+MT_ENGINE_API void mt_material_table_bind(MtMaterialTable *table, MtCmdBuffer *cb, uint32_t set);
+
+#ifdef __cplusplus
+}
+#endif
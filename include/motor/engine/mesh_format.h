@@ -0,0 +1,124 @@
+#pragma once
+
+#include "api_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cooked mesh files (.mtmesh), written by tools/gltf_mesh.c.
+//
+// Layout:
+//   MtMeshFileHeader
+//   MtMeshFileMesh[mesh_count]
+//   MtMeshFilePrimitive[primitive_count]
+//   vertices, MtStandardVertex[vertex_count] at vertex_offset
+//   indices, uint32_t[index_count] at index_offset
+//
+// Vertex and index blobs start on MT_MESH_FILE_ALIGNMENT boundaries so a mapped file
+// can be copied to GPU buffers as is. Indices are relative to the first vertex of the file.
+
+enum {
+    MT_MESH_FILE_MAGIC = 0x534d544d, // "MTMS"
+    MT_MESH_FILE_VERSION = 1,
+    MT_MESH_FILE_ALIGNMENT = 4096,
+};
+
+typedef struct MtMeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    // sizeof(MtStandardVertex) of the cooker, files from a different layout are rejected
+    uint32_t vertex_stride;
+    uint32_t mesh_count;
+    uint32_t primitive_count;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t pad;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+} MtMeshFileHeader;
+
+// One per glTF node with a mesh, in the order the glTF loader visits them
+typedef struct MtMeshFileMesh
+{
+    // Node to model space, column major
+    float matrix[16];
+    uint32_t first_primitive;
+    uint32_t primitive_count;
+} MtMeshFileMesh;
+
+typedef struct MtMeshFilePrimitive
+{
+    uint32_t first_index;
+    uint32_t index_count;
+    uint32_t vertex_count;
+    // Index into the source glTF materials, UINT32_MAX if none
+    uint32_t material_index;
+    uint32_t normal_mapped;
+    // Local to the mesh
+    float bounds_min[3];
+    float bounds_max[3];
+} MtMeshFilePrimitive;
+
+static inline const MtMeshFileMesh *mt_mesh_file_meshes(const MtMeshFileHeader *header)
+{
+    return (const MtMeshFileMesh *)(header + 1);
+}
+
+static inline const MtMeshFilePrimitive *mt_mesh_file_primitives(const MtMeshFileHeader *header)
+{
+    return (const MtMeshFilePrimitive *)(mt_mesh_file_meshes(header) + header->mesh_count);
+}
+
+// Returns the header if data holds a complete cooked mesh of this version, NULL otherwise
+static inline const MtMeshFileHeader *mt_mesh_file_header(const uint8_t *data, size_t size)
+{
+    if (size < sizeof(MtMeshFileHeader)) return NULL;
+
+    const MtMeshFileHeader *header = (const MtMeshFileHeader *)data;
+    if (header->magic != MT_MESH_FILE_MAGIC || header->version != MT_MESH_FILE_VERSION ||
+        header->vertex_stride != sizeof(MtStandardVertex))
+    {
+        return NULL;
+    }
+
+    uint64_t tables_end = sizeof(MtMeshFileHeader) +
+                          (uint64_t)header->mesh_count * sizeof(MtMeshFileMesh) +
+                          (uint64_t)header->primitive_count * sizeof(MtMeshFilePrimitive);
+    uint64_t vertices_end =
+        header->vertex_offset + (uint64_t)header->vertex_count * sizeof(MtStandardVertex);
+    uint64_t indices_end = header->index_offset + (uint64_t)header->index_count * sizeof(uint32_t);
+
+    if (tables_end > header->vertex_offset || vertices_end > header->index_offset ||
+        indices_end > size || header->vertex_offset % MT_MESH_FILE_ALIGNMENT != 0 ||
+        header->index_offset % MT_MESH_FILE_ALIGNMENT != 0)
+    {
+        return NULL;
+    }
+
+    const MtMeshFileMesh *meshes = mt_mesh_file_meshes(header);
+    for (uint32_t i = 0; i < header->mesh_count; i++)
+    {
+        if ((uint64_t)meshes[i].first_primitive + meshes[i].primitive_count >
+            header->primitive_count)
+        {
+            return NULL;
+        }
+    }
+
+    const MtMeshFilePrimitive *primitives = mt_mesh_file_primitives(header);
+    for (uint32_t i = 0; i < header->primitive_count; i++)
+    {
+        if ((uint64_t)primitives[i].first_index + primitives[i].index_count > header->index_count)
+        {
+            return NULL;
+        }
+    }
+
+    return header;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -13,6 +13,8 @@ typedef struct MtPhysicsScene MtPhysicsScene;
 typedef struct MtAssetManager MtAssetManager;
 typedef struct MtEntityManager MtEntityManager;
 typedef struct MtRenderGraph MtRenderGraph;
+typedef struct MtGpuCuller MtGpuCuller;
+typedef struct MtModelCull MtModelCull;
 typedef struct MtScene MtScene;
 typedef struct MtEvent MtEvent;
 
@@ -39,6 +41,10 @@ struct MtScene
     MtEnvironment env;
 
     MtRenderGraph *graph;
+    // Optional, created by the scene when building its graph
+    MtGpuCuller *gpu_culler;
+    // Created by mt_model_cull_system
+    MtModelCull *model_cull;
 
     MtPhysicsScene *physics_scene;
 
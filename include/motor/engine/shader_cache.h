@@ -0,0 +1,46 @@
+#pragma once
+
+#include "api_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtAllocator MtAllocator;
+typedef struct MtVfs MtVfs;
+
+// On-disk cache of compiled SPIR-V, one file per entry in a directory.
+// Entries are addressed by a key hashing the source and everything else that changes its
+// compilation. The files included by the source are recorded with the hash of their
+// contents, and the entry is only used while they are unchanged.
+typedef struct MtShaderCache MtShaderCache;
+
+typedef struct MtShaderDependency
+{
+    char *path;
+    uint64_t hash;
+} MtShaderDependency;
+
+// Dependencies are VFS paths, dir is a filesystem directory
+MT_ENGINE_API MtShaderCache *
+mt_shader_cache_create(MtAllocator *alloc, MtVfs *vfs, const char *dir);
+
+// Removes the entries that were not used since the cache was created and have not been
+// used for a while either
+MT_ENGINE_API void mt_shader_cache_destroy(MtShaderCache *cache);
+
+// Returns NULL if there is no entry for key or one of its dependencies changed,
+// otherwise the code to be freed with mt_free
+MT_ENGINE_API uint8_t *mt_shader_cache_get(MtShaderCache *cache, uint64_t key, size_t *code_size);
+
+MT_ENGINE_API void mt_shader_cache_put(
+    MtShaderCache *cache,
+    uint64_t key,
+    const MtShaderDependency *deps,
+    uint32_t dep_count,
+    const uint8_t *code,
+    size_t code_size);
+
+#ifdef __cplusplus
+}
+#endif
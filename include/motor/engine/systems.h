@@ -12,9 +12,18 @@ typedef struct MtPipeline MtPipeline;
 typedef struct MtEnvironment MtEnvironment;
 typedef struct MtPerspectiveCamera MtPerspectiveCamera;
 typedef struct MtScene MtScene;
+typedef struct MtModelCull MtModelCull;
 
 MT_ENGINE_API void mt_light_system(MtEntityManager *em, MtScene *scene, float delta);
 
+// Records the GPU culling passes of scene->gpu_culler for the models drawn by
+// mt_model_system, or starts culling them on the thread pool. Must be called every frame
+// before the pass that draws them, so the culling runs while the pass begins.
+MT_ENGINE_API void mt_model_cull_system(MtEntityManager *em, MtScene *scene);
+
+// Waits for the culling still running, called by mt_scene_destroy
+MT_ENGINE_API void mt_model_cull_destroy(MtModelCull *cull);
+
 MT_ENGINE_API void mt_model_system(MtEntityManager *em, MtScene *scene, MtCmdBuffer *cb);
 
 MT_ENGINE_API void mt_selected_entity_system(MtEntityManager *em, MtScene *scene, MtCmdBuffer *cb);
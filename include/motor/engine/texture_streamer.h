@@ -0,0 +1,70 @@
+#pragma once
+
+#include "api_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtEngine MtEngine;
+typedef struct MtImage MtImage;
+
+// Keeps only the mip tail of KTX textures resident at first. Finer mips are read back from
+// the file on the thread pool once draws ask for them, and given back under memory pressure.
+typedef struct MtTextureStreamer MtTextureStreamer;
+typedef struct MtStreamedTexture MtStreamedTexture;
+
+typedef struct MtTextureStreamerStats
+{
+    uint32_t texture_count;
+    uint32_t streaming_count;
+    uint64_t resident_bytes;
+    // What the textures would take with every mip resident
+    uint64_t full_bytes;
+} MtTextureStreamerStats;
+
+MT_ENGINE_API MtTextureStreamer *mt_texture_streamer_create(MtEngine *engine);
+
+MT_ENGINE_API void mt_texture_streamer_destroy(MtTextureStreamer *ts);
+
+// Bytes of texture memory the streamer may use for finer mips, 0 means no limit.
+// Mip tails always stay resident.
+MT_ENGINE_API void mt_texture_streamer_set_budget(MtTextureStreamer *ts, uint64_t budget);
+
+// data holds the KTX file stored at offset in the file at path, which is opened through the
+// engine VFS.
+// Uploads the mip tail and stores the image in *image, which is replaced with a new image
+// whenever a different set of mips becomes resident.
+// Returns NULL without uploading anything if the texture has nothing to stream.
+MT_ENGINE_API MtStreamedTexture *mt_texture_streamer_add(
+    MtTextureStreamer *ts,
+    MtImage **image,
+    const char *path,
+    uint64_t offset,
+    const uint8_t *data,
+    uint64_t size);
+
+// Destroys the resident image, the caller still unregisters its bindless index
+MT_ENGINE_API void mt_texture_streamer_remove(MtTextureStreamer *ts, MtStreamedTexture *texture);
+
+// Registers the resident image as a bindless image and stores its index in *index, which
+// gets the index of the new image on each swap. UINT32_MAX if the bindless table is full.
+MT_ENGINE_API void mt_texture_streamer_register_bindless(
+    MtTextureStreamer *ts, MtStreamedTexture *texture, uint32_t *index);
+
+// Asks for enough mips to cover pixel_size pixels on screen this frame.
+// Called from the thread that calls mt_texture_streamer_update.
+MT_ENGINE_API void
+mt_texture_streamer_request(MtTextureStreamer *ts, MtStreamedTexture *texture, float pixel_size);
+
+// Called once per frame, when nothing is recording: swaps in the mips streamed since
+// the last call and starts streaming what the last frame asked for.
+// Replaced images and their bindless slots are freed once no frame in flight can use them.
+MT_ENGINE_API void mt_texture_streamer_update(MtTextureStreamer *ts);
+
+MT_ENGINE_API void
+mt_texture_streamer_get_stats(MtTextureStreamer *ts, MtTextureStreamerStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
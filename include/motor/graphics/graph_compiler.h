@@ -0,0 +1,139 @@
+#pragma once
+
+#include "api_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtAllocator MtAllocator;
+
+// Device independent description of a render graph pass, resources are referred to by index
+typedef struct MtGraphCompilerPass
+{
+    // Passes on the same queue can be recorded in the same execution group
+    uint32_t queue;
+    const uint32_t *reads;
+    uint32_t read_count;
+    const uint32_t *writes;
+    uint32_t write_count;
+    // Has effects outside of the graph, like writing host visible memory
+    bool root;
+    // Scheduled as soon as its dependencies are done, so that it overlaps with the
+    // passes of the other queues
+    bool async;
+} MtGraphCompilerPass;
+
+typedef struct MtGraphGroupWait
+{
+    uint32_t group;
+    // Earlier group, on another queue, that group waits for before it starts
+    uint32_t wait_for;
+} MtGraphGroupWait;
+
+typedef struct MtGraphSchedule
+{
+    // Live passes, in execution order
+    /*array*/ uint32_t *order;
+    // Index in order of the first pass of each group, a group being consecutive passes
+    // on the same queue
+    /*array*/ uint32_t *group_starts;
+    // Sorted by group. A group only waits for the last group of each other queue that
+    // it depends on, and the last group waits for the last group of every other queue.
+    /*array*/ MtGraphGroupWait *group_waits;
+    // One per pass, true when nothing live depends on its results
+    /*array*/ bool *culled;
+} MtGraphSchedule;
+
+// Passes are declared in recording order. A pass depends on the earlier passes that
+// write what it reads, and on the earlier passes that read or write what it writes.
+// The last pass is the output of the graph: it is always live and executes last.
+// Passes that neither are roots nor produce anything a live pass reads are culled.
+// The rest is ordered to keep passes of the same queue together, without ever
+// swapping two passes of the same group relative to the declaration order.
+// Async passes are taken as soon as they are ready. A group ends before a pass that
+// depends on a group of another queue it does not wait for yet, so that the passes
+// before it do not wait for that group too.
+MT_GRAPHICS_API void mt_graph_compile(
+    MtAllocator *alloc,
+    const MtGraphCompilerPass *passes,
+    uint32_t pass_count,
+    uint32_t resource_count,
+    MtGraphSchedule *schedule);
+
+MT_GRAPHICS_API void mt_graph_schedule_destroy(MtAllocator *alloc, MtGraphSchedule *schedule);
+
+typedef struct MtGraphAliasResource
+{
+    // Memory requirements of the resource
+    uint64_t size;
+    uint64_t alignment;
+    uint32_t memory_type_bits;
+    // Only resources of the same kind share a heap, e.g. to keep buffers and images apart
+    uint32_t kind;
+    // Whether the resource may share memory at all
+    bool can_alias;
+} MtGraphAliasResource;
+
+typedef struct MtGraphAliasHeap
+{
+    uint64_t size;
+    uint64_t alignment;
+    uint32_t memory_type_bits;
+} MtGraphAliasHeap;
+
+typedef struct MtGraphAliasPlacement
+{
+    // UINT32_MAX when the resource is not transient and needs memory of its own
+    uint32_t heap;
+    uint64_t offset;
+    // Positions in the schedule order of the first and last live pass using the resource,
+    // UINT32_MAX when no live pass does
+    uint32_t first_use;
+    uint32_t last_use;
+} MtGraphAliasPlacement;
+
+// Use of the memory of a transient resource that its first use in a frame must wait for
+typedef struct MtGraphAliasWait
+{
+    uint32_t resource;
+    // Resource whose last use overlaps the same memory, possibly the resource itself
+    uint32_t wait_for;
+    // The heaps are reused every frame, so resources used later in the frame, and the
+    // resource itself, last used the memory during the previous frame
+    bool previous_frame;
+} MtGraphAliasWait;
+
+typedef struct MtGraphAliasing
+{
+    /*array*/ MtGraphAliasHeap *heaps;
+    // One per resource
+    /*array*/ MtGraphAliasPlacement *placements;
+    // Sorted by resource
+    /*array*/ MtGraphAliasWait *waits;
+    // Memory the transient resources would take without aliasing
+    uint64_t transient_size;
+    // Most memory the transient resources need at the same time
+    uint64_t peak_size;
+    // Memory the heaps take
+    uint64_t heap_size;
+} MtGraphAliasing;
+
+// Places the transient resources of a compiled graph into shared heaps. A resource is
+// transient when its first use in a frame is a write, so that its previous contents are
+// never needed, and when the last pass does not use it, so that it is not an output of
+// the graph. Resources of the same kind whose lifetimes do not overlap may end up in the
+// same memory.
+MT_GRAPHICS_API void mt_graph_alias(
+    MtAllocator *alloc,
+    const MtGraphCompilerPass *passes,
+    const MtGraphSchedule *schedule,
+    const MtGraphAliasResource *resources,
+    uint32_t resource_count,
+    MtGraphAliasing *aliasing);
+
+MT_GRAPHICS_API void mt_graph_aliasing_destroy(MtAllocator *alloc, MtGraphAliasing *aliasing);
+
+#ifdef __cplusplus
+}
+#endif
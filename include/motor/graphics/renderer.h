@@ -19,6 +19,9 @@ typedef struct MtSwapchain MtSwapchain;
 typedef struct MtRenderGraph MtRenderGraph;
 typedef struct MtRenderGraphPass MtRenderGraphPass;
 
+// Frames a graph may have recorded that the GPU did not finish yet
+#define MT_MAX_FRAMES_IN_FLIGHT 4
+
 typedef union MtClearColorValue
 {
     float float32[4];
@@ -137,6 +140,8 @@ typedef enum MtBufferUsage {
     MT_BUFFER_USAGE_UNIFORM,
     MT_BUFFER_USAGE_STORAGE,
     MT_BUFFER_USAGE_TRANSFER,
+    // Indirect draw arguments, also bindable as a storage buffer
+    MT_BUFFER_USAGE_INDIRECT,
 } MtBufferUsage;
 
 typedef enum MtBufferMemory {
@@ -151,6 +156,16 @@ typedef struct MtBufferCreateInfo
     size_t size;
 } MtBufferCreateInfo;
 
+// Matches VkDrawIndexedIndirectCommand
+typedef struct MtDrawIndexedIndirectCommand
+{
+    uint32_t index_count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t first_instance;
+} MtDrawIndexedIndirectCommand;
+
 typedef enum MtImageUsage {
     MT_IMAGE_USAGE_SAMPLED_BIT = 1 << 0,
     MT_IMAGE_USAGE_STORAGE_BIT = 1 << 1,
@@ -281,10 +296,46 @@ typedef struct MtRenderGraphImage
     MtImageAspect aspect;
 } MtRenderGraphImage;
 
+// Measurements of the last frame a graph finished
+typedef struct MtFrameStats
+{
+    uint32_t frames_in_flight;
+    // Time the CPU spent blocked on the GPU before recording the frame, including the
+    // swapchain image acquisition
+    double cpu_wait_ms;
+    // Time between the first and last commands of the frame on the GPU, 0 when the device
+    // has no timestamps
+    double gpu_busy_ms;
+    // From the start of the recording of the frame to the CPU seeing it finished. Only an
+    // upper bound when the CPU did not have to wait for it.
+    double present_latency_ms;
+} MtFrameStats;
+
+// GPU measurements of a render graph pass, from the frame that last used the frame slot
+typedef struct MtPassStats
+{
+    const char *name;
+    MtQueueType queue_type;
+    double gpu_ms;
+    // Only counted for graphics passes, when the device supports pipeline statistics
+    uint64_t primitives;
+    uint64_t fragment_invocations;
+} MtPassStats;
+
+// Passes of an execution group are recorded one after the other in a command buffer
+typedef struct MtGroupStats
+{
+    MtQueueType queue_type;
+    uint32_t pass_count;
+    double gpu_ms;
+} MtGroupStats;
+
 typedef struct MtRenderer
 {
     void (*destroy_device)(MtDevice *);
     void (*device_wait_idle)(MtDevice *);
+    // Whether cmd_draw_indexed_indirect_count reads its count on the GPU
+    bool (*device_draw_indirect_count_enabled)(MtDevice *);
 
     MtSwapchain *(*create_swapchain)(MtDevice *, MtWindow *, MtAllocator *);
     void (*destroy_swapchain)(MtSwapchain *);
@@ -302,6 +353,8 @@ typedef struct MtRenderer
 
     MtImage *(*create_image)(MtDevice *, MtImageCreateInfo *);
     void (*destroy_image)(MtDevice *, MtImage *);
+    // Does not wait for the device, no submitted work may use the image anymore
+    void (*destroy_image_no_wait)(MtDevice *, MtImage *);
 
     MtSampler *(*create_sampler)(MtDevice *, MtSamplerCreateInfo *);
     void (*destroy_sampler)(MtDevice *, MtSampler *);
@@ -310,6 +363,17 @@ typedef struct MtRenderer
         MtDevice *, MtBuffer *, size_t offset, size_t size, const void *data);
     void (*transfer_to_image)(
         MtDevice *, const MtImageCopyView *dst, size_t size, const void *data);
+    // Fills the mips of an image from its first one, which was transferred already.
+    // The image needs the transfer source and destination usages.
+    void (*generate_mipmaps)(MtDevice *, MtImage *);
+
+    // Bindless: images and samplers are registered into a global table and
+    // referenced from shaders by index. Only valid when device_bindless_enabled.
+    bool (*device_bindless_enabled)(MtDevice *);
+    uint32_t (*register_bindless_image)(MtDevice *, MtImage *);
+    void (*unregister_bindless_image)(MtDevice *, uint32_t index);
+    uint32_t (*register_bindless_sampler)(MtDevice *, MtSampler *);
+    void (*unregister_bindless_sampler)(MtDevice *, uint32_t index);
 
     MtPipeline *(*create_graphics_pipeline)(
         MtDevice *,
@@ -347,8 +411,10 @@ typedef struct MtRenderer
     void (*cmd_bind_sampler)(MtCmdBuffer *, MtSampler *, uint32_t set, uint32_t binding);
     void (*cmd_bind_image)(MtCmdBuffer *, MtImage *, uint32_t set, uint32_t binding);
     void (*cmd_bind_storage_buffer)(MtCmdBuffer *, MtBuffer *, uint32_t set, uint32_t binding);
+    void *(*cmd_bind_storage_data)(MtCmdBuffer *, size_t size, uint32_t set, uint32_t binding);
 
     void (*cmd_bind_pipeline)(MtCmdBuffer *, MtPipeline *pipeline);
+    void (*cmd_push_constants)(MtCmdBuffer *, const void *data, size_t size);
 
     void (*cmd_bind_vertex_buffer)(MtCmdBuffer *, MtBuffer *, size_t offset);
     void (*cmd_bind_index_buffer)(MtCmdBuffer *, MtBuffer *, MtIndexType index_type, size_t offset);
@@ -356,6 +422,11 @@ typedef struct MtRenderer
     void *(*cmd_bind_vertex_data)(MtCmdBuffer *, size_t size);
     void *(*cmd_bind_index_data)(MtCmdBuffer *, size_t size, MtIndexType index_type);
 
+    // Host-visible memory that lives until the command buffer is reused.
+    // Usable as indirect arguments or storage buffer data.
+    void *(*cmd_alloc_transient_data)(
+        MtCmdBuffer *, size_t size, MtBuffer **buffer, size_t *offset);
+
     void (*cmd_draw)(
         MtCmdBuffer *,
         uint32_t vertex_count,
@@ -369,6 +440,17 @@ typedef struct MtRenderer
         uint32_t first_index,
         int32_t vertex_offset,
         uint32_t first_instance);
+    void (*cmd_draw_indexed_indirect)(
+        MtCmdBuffer *, MtBuffer *buffer, size_t offset, uint32_t draw_count);
+    // Reads the draw count from count_buffer. Without VK_KHR_draw_indirect_count this
+    // draws max_draw_count commands, so unused commands must have an instance_count of 0.
+    void (*cmd_draw_indexed_indirect_count)(
+        MtCmdBuffer *,
+        MtBuffer *buffer,
+        size_t offset,
+        MtBuffer *count_buffer,
+        size_t count_offset,
+        uint32_t max_draw_count);
 
     void (*cmd_dispatch)(
         MtCmdBuffer *, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z);
@@ -383,7 +465,17 @@ typedef struct MtRenderer
     void (*graph_execute)(MtRenderGraph *);
     void (*graph_wait_all)(MtRenderGraph *);
     void (*graph_on_resize)(MtRenderGraph *);
-
+    // Trades latency for throughput, from 1 to MT_MAX_FRAMES_IN_FLIGHT.
+    // Only graphs that present have more than one.
+    void (*graph_set_frames_in_flight)(MtRenderGraph *, uint32_t frames_in_flight);
+    void (*graph_get_frame_stats)(MtRenderGraph *, MtFrameStats *stats);
+    // Only write the count when stats is NULL
+    void (*graph_get_pass_stats)(MtRenderGraph *, uint32_t *count, MtPassStats *stats);
+    void (*graph_get_group_stats)(MtRenderGraph *, uint32_t *count, MtGroupStats *stats);
+
+    // Resources only used between passes of a frame share memory with each other, their
+    // contents are only meaningful during that frame. Only resources used by the last pass
+    // or read before being written in a frame keep their own memory, and can be consumed.
     MtImage *(*graph_get_image)(MtRenderGraph *, const char *name);
     MtImage *(*graph_consume_image)(MtRenderGraph *, const char *name);
     MtBuffer *(*graph_get_buffer)(MtRenderGraph *, const char *name);
@@ -391,6 +483,10 @@ typedef struct MtRenderer
     MtRenderGraphPass *(*graph_add_pass)(MtRenderGraph *, const char *name, MtPipelineStage stage);
     void (*pass_set_color_clearer)(MtRenderGraphPass *, MtRenderGraphColorClearer);
     void (*pass_set_depth_stencil_clearer)(MtRenderGraphPass *, MtRenderGraphDepthStencilClearer);
+    // Compute passes are recorded with the graphics passes unless they opt into async compute.
+    // Then they run on the compute queue, next to the graphics passes they do not depend on.
+    // Only graph resources are shared with the compute queue, not external buffers.
+    void (*pass_set_async_compute)(MtRenderGraphPass *, bool async_compute);
 
     void (*pass_read)(MtRenderGraphPass *, MtRenderGraphPassRead, const char *name);
     void (*pass_write)(MtRenderGraphPass *, MtRenderGraphPassWrite, const char *name);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <motor/graphics/api_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Window system without a display, for devices created with MT_DEVICE_HEADLESS.
+// Windows only have a size, never receive events or input, and are rendered to offscreen.
+MT_GRAPHICS_API void mt_headless_vulkan_window_system_init(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,15 +8,27 @@ extern "C" {
 
 typedef struct MtAllocator MtAllocator;
 typedef struct MtDevice MtDevice;
+typedef struct MtThreadPool MtThreadPool;
 
 typedef enum MtVulkanDeviceFlags {
     MT_DEVICE_HEADLESS = 1,
+    // Enables descriptor indexing (global texture/sampler table) if the device supports it
+    MT_DEVICE_BINDLESS = 2,
 } MtVulkanDeviceFlags;
 
 typedef struct MtVulkanDeviceCreateInfo
 {
     MtVulkanDeviceFlags flags;
     uint32_t num_threads;
+    // Frames the CPU may record ahead of the GPU, from 1 to 4. 0 picks the default of 2.
+    uint32_t frames_in_flight;
+    // File the pipeline cache is loaded from and saved to, NULL to not keep it across runs
+    const char *pipeline_cache_path;
+    // File the pipeline instances created in a run are recorded to, so that the next run
+    // creates them up front. NULL to not record them.
+    const char *pipeline_manifest_path;
+    // Optional, used to create pipeline instances in parallel
+    MtThreadPool *thread_pool;
 } MtVulkanDeviceCreateInfo;
 
 MT_GRAPHICS_API MtDevice *
@@ -30,6 +30,20 @@ struct Material
     float normal_mapped;
 };
 
+struct BindlessMaterial
+{
+    float4 base_color;
+    float4 emissive;
+    float metallic;
+    float roughness;
+    uint sampler_index;
+    uint albedo_texture;
+    uint normal_texture;
+    uint metallic_roughness_texture;
+    uint occlusion_texture;
+    uint emissive_texture;
+};
+
 struct Environment
 {
     float3 sun_direction;
@@ -0,0 +1,146 @@
+#pragma motor compute_entry main
+
+#include "hiz_common.hlsl"
+
+// Must match MtGpuCullItem
+struct CullItem
+{
+    float4 aabb_min;
+    float4 aabb_max;
+    uint index_count;
+    uint first_index;
+    int vertex_offset;
+    uint bucket;
+    uint command_base;
+    uint3 pad;
+};
+
+struct DrawCommand
+{
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+[[vk::binding(0, 0)]] StructuredBuffer<CullItem> items;
+[[vk::binding(1, 0)]] RWStructuredBuffer<DrawCommand> commands;
+[[vk::binding(2, 0)]] RWStructuredBuffer<uint> counts;
+[[vk::binding(3, 0)]] StructuredBuffer<float> hiz;
+[[vk::binding(4, 0)]] cbuffer params
+{
+    float4 frustum[6];
+    // The Hi-Z pyramid was built from the depth of the previous frame
+    float4x4 prev_view_proj;
+    uint2 depth_size;
+    uint item_count;
+    uint occlusion;
+    uint compact;
+};
+
+bool frustum_visible(float3 center, float3 extent)
+{
+    for (uint i = 0; i < 6; i++)
+    {
+        float dist = dot(frustum[i].xyz, center) + frustum[i].w;
+        float radius = dot(abs(frustum[i].xyz), extent);
+        if (dist + radius < 0.0f) return false;
+    }
+    return true;
+}
+
+bool occlusion_visible(float3 box_min, float3 box_max)
+{
+    float2 uv_min = float2(1.0f, 1.0f);
+    float2 uv_max = float2(0.0f, 0.0f);
+    float nearest = 1.0f;
+
+    for (uint i = 0; i < 8; i++)
+    {
+        float3 corner = float3(
+            (i & 1) ? box_max.x : box_min.x,
+            (i & 2) ? box_max.y : box_min.y,
+            (i & 4) ? box_max.z : box_min.z);
+
+        float4 clip = mul(prev_view_proj, float4(corner, 1.0f));
+
+        // Crosses the camera plane, there is no screen rect to test
+        if (clip.w <= 0.0f) return true;
+
+        float3 ndc = clip.xyz / clip.w;
+        float2 uv = ndc.xy * 0.5f + 0.5f;
+        uv_min = min(uv_min, uv);
+        uv_max = max(uv_max, uv);
+        nearest = min(nearest, ndc.z);
+    }
+
+    float2 px_min = saturate(uv_min) * float2(depth_size);
+    float2 px_max = saturate(uv_max) * float2(depth_size);
+    float rect_size = max(px_max.x - px_min.x, px_max.y - px_min.y);
+
+    // Pick the level where the rect covers about 2x2 texels
+    uint level = uint(ceil(log2(max(rect_size / float(HIZ_BASE_TEXEL), 1.0f))));
+    level = min(level, HIZ_LEVELS - 1u);
+
+    uint texel = HIZ_BASE_TEXEL << level;
+    uint2 size = hiz_level_size(depth_size, level);
+    uint2 t_min = min(uint2(px_min) / texel, size - 1u);
+    uint2 t_max = min(uint2(px_max) / texel, size - 1u);
+
+    // Too big even for the coarsest level
+    if (any(t_max - t_min >= 4u)) return true;
+
+    uint offset = hiz_level_offset(depth_size, level);
+    float max_depth = 0.0f;
+    for (uint y = t_min.y; y <= t_max.y; y++)
+    {
+        for (uint x = t_min.x; x <= t_max.x; x++)
+        {
+            max_depth = max(max_depth, hiz[offset + y * size.x + x]);
+        }
+    }
+
+    return nearest <= max_depth;
+}
+
+[numthreads(64, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    uint i = id.x;
+    if (i >= item_count) return;
+
+    CullItem item = items[i];
+
+    float3 center = (item.aabb_min.xyz + item.aabb_max.xyz) * 0.5f;
+    float3 extent = (item.aabb_max.xyz - item.aabb_min.xyz) * 0.5f;
+
+    bool visible = frustum_visible(center, extent);
+    if (visible && occlusion != 0)
+    {
+        visible = occlusion_visible(item.aabb_min.xyz, item.aabb_max.xyz);
+    }
+
+    DrawCommand command;
+    command.index_count = item.index_count;
+    command.instance_count = 1;
+    command.first_index = item.first_index;
+    command.vertex_offset = item.vertex_offset;
+    // Draw data is laid out like the items
+    command.first_instance = i;
+
+    if (compact != 0)
+    {
+        if (!visible) return;
+
+        uint slot;
+        InterlockedAdd(counts[item.bucket], 1, slot);
+        commands[item.command_base + slot] = command;
+    }
+    else
+    {
+        // Every command gets drawn, culled ones just have no instance
+        command.instance_count = visible ? 1 : 0;
+        commands[i] = command;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma motor compute_entry main
+
+#include "hiz_common.hlsl"
+
+[[vk::binding(0, 0)]] Texture2D<float> depth;
+[[vk::binding(1, 0)]] RWStructuredBuffer<float> hiz;
+[[vk::binding(2, 0)]] cbuffer params
+{
+    uint2 depth_size;
+};
+
+// Level 0 texels of the 64x64 depth texels covered by a group
+groupshared float tile[16][16];
+
+void store(uint level, uint2 coord, float value)
+{
+    uint2 size = hiz_level_size(depth_size, level);
+    if (all(coord < size))
+    {
+        hiz[hiz_level_offset(depth_size, level) + coord.y * size.x + coord.x] = value;
+    }
+}
+
+[numthreads(16, 16, 1)]
+void main(uint3 group : SV_GroupID, uint3 local : SV_GroupThreadID)
+{
+    uint2 coord = group.xy * 16 + local.xy;
+
+    float max_depth = 0.0f;
+    for (uint y = 0; y < HIZ_BASE_TEXEL; y++)
+    {
+        for (uint x = 0; x < HIZ_BASE_TEXEL; x++)
+        {
+            uint2 pos = coord * HIZ_BASE_TEXEL + uint2(x, y);
+            // Outside of the image counts as far, so it never occludes anything
+            float d = all(pos < depth_size) ? depth.Load(int3(pos, 0)) : 1.0f;
+            max_depth = max(max_depth, d);
+        }
+    }
+
+    tile[local.y][local.x] = max_depth;
+    store(0, coord, max_depth);
+
+    uint size = 8;
+    for (uint level = 1; level < HIZ_LEVELS; level++)
+    {
+        GroupMemoryBarrierWithGroupSync();
+
+        bool active = all(local.xy < size);
+        float value = 0.0f;
+        if (active)
+        {
+            uint2 src = local.xy * 2;
+            value = max(
+                max(tile[src.y][src.x], tile[src.y][src.x + 1]),
+                max(tile[src.y + 1][src.x], tile[src.y + 1][src.x + 1]));
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+
+        if (active)
+        {
+            tile[local.y][local.x] = value;
+            store(level, group.xy * size + local.xy, value);
+        }
+
+        size /= 2;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef HIZ_COMMON_HLSL
+#define HIZ_COMMON_HLSL
+
+// The Hi-Z pyramid is stored in a buffer, level after level. A texel of level 0
+// holds the farthest depth of 4x4 depth texels, each level above halves that.
+#define HIZ_LEVELS 5u
+#define HIZ_BASE_TEXEL 4u
+
+uint2 hiz_level_size(uint2 depth_size, uint level)
+{
+    uint texel = HIZ_BASE_TEXEL << level;
+    return (depth_size + texel - 1u) / texel;
+}
+
+uint hiz_level_offset(uint2 depth_size, uint level)
+{
+    uint offset = 0;
+    for (uint l = 0; l < level; l++)
+    {
+        uint2 size = hiz_level_size(depth_size, l);
+        offset += size.x * size.y;
+    }
+    return offset;
+}
+
+#endif
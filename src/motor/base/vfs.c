@@ -0,0 +1,357 @@
+#include <motor/base/vfs.h>
+
+#include <motor/base/allocator.h>
+#include <motor/base/array.h>
+#include <motor/base/hashmap.h>
+#include <motor/base/log.h>
+#include <motor/base/lz4.h>
+#include <motor/base/pack_format.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+struct MtVfsMount
+{
+    char *name;
+    size_t name_length;
+
+    // Either a directory or a pack
+    char *dir;
+    char *pack_path;
+    MtFileMapping pack_mapping;
+    const MtPackHeader *pack;
+};
+
+void mt_vfs_init(MtVfs *vfs, MtAllocator *alloc)
+{
+    memset(vfs, 0, sizeof(*vfs));
+    vfs->alloc = alloc;
+}
+
+void mt_vfs_destroy(MtVfs *vfs)
+{
+    for (uint32_t i = 0; i < mt_array_size(vfs->mounts); i++)
+    {
+        MtVfsMount *mount = &vfs->mounts[i];
+        mt_free(vfs->alloc, mount->name);
+        if (mount->dir) mt_free(vfs->alloc, mount->dir);
+        if (mount->pack_path) mt_free(vfs->alloc, mount->pack_path);
+        mt_file_unmap(&mount->pack_mapping);
+    }
+    mt_array_free(vfs->alloc, vfs->mounts);
+}
+
+void mt_vfs_mount_dir(MtVfs *vfs, const char *name, const char *dir)
+{
+    MtVfsMount mount = {
+        .name = mt_strdup(vfs->alloc, name),
+        .name_length = strlen(name),
+        .dir = mt_strdup(vfs->alloc, dir),
+    };
+    mt_array_push(vfs->alloc, vfs->mounts, mount);
+}
+
+bool mt_vfs_mount_pack(MtVfs *vfs, const char *name, const char *pack_path)
+{
+    MtVfsMount mount = {0};
+    if (!mt_file_map(&mount.pack_mapping, pack_path))
+    {
+        return false;
+    }
+
+    mount.pack = mt_pack_header(mount.pack_mapping.data, mount.pack_mapping.size);
+    if (!mount.pack)
+    {
+        mt_log_error("Invalid or outdated pack: %s", pack_path);
+        mt_file_unmap(&mount.pack_mapping);
+        return false;
+    }
+
+    mount.name = mt_strdup(vfs->alloc, name);
+    mount.name_length = strlen(name);
+    mount.pack_path = mt_strdup(vfs->alloc, pack_path);
+    mt_array_push(vfs->alloc, vfs->mounts, mount);
+
+    mt_log_debug("Mounted %s with %u files", pack_path, mount.pack->entry_count);
+
+    return true;
+}
+
+// Returns the part of path below the mount point, NULL if it is not under it
+static const char *relative_path(const MtVfsMount *mount, const char *path)
+{
+    if (mount->name_length == 0) return path;
+
+    if (strncmp(path, mount->name, mount->name_length) != 0 || path[mount->name_length] != '/')
+    {
+        return NULL;
+    }
+
+    return path + mount->name_length + 1;
+}
+
+static const MtPackEntry *find_entry(const MtPackHeader *pack, const char *path)
+{
+    const MtPackEntry *entries = mt_pack_entries(pack);
+    const char *names = mt_pack_names(pack);
+    uint64_t hash = mt_hash_str(path);
+
+    // First entry with a hash not below the path's
+    uint32_t first = 0;
+    uint32_t count = pack->entry_count;
+    while (count > 0)
+    {
+        uint32_t step = count / 2;
+        if (entries[first + step].path_hash < hash)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+
+    for (uint32_t i = first; i < pack->entry_count && entries[i].path_hash == hash; i++)
+    {
+        if (strcmp(&names[entries[i].name_offset], path) == 0) return &entries[i];
+    }
+
+    return NULL;
+}
+
+static void dir_path(const MtVfsMount *mount, const char *relative, char *path, size_t path_size)
+{
+    snprintf(path, path_size, "%s/%s", mount->dir, relative);
+}
+
+static bool
+open_entry(MtVfs *vfs, const MtVfsMount *mount, const MtPackEntry *entry, MtVfsFile *file)
+{
+    const uint8_t *stored = mount->pack_mapping.data + entry->offset;
+    if (entry->size == 0) return false;
+
+    if (entry->compression == MT_PACK_COMPRESSION_NONE)
+    {
+        file->data = stored;
+        file->size = entry->size;
+        return true;
+    }
+
+    file->buffer = mt_alloc(vfs->alloc, entry->size);
+    if (!mt_lz4_decompress(stored, entry->stored_size, file->buffer, entry->size))
+    {
+        mt_log_error("Corrupt pack entry: %s", &mt_pack_names(mount->pack)[entry->name_offset]);
+        mt_free(vfs->alloc, file->buffer);
+        file->buffer = NULL;
+        return false;
+    }
+
+    file->data = file->buffer;
+    file->size = entry->size;
+    return true;
+}
+
+static bool open_file(const char *path, MtVfsFile *file)
+{
+    if (!mt_file_map(&file->mapping, path)) return false;
+
+    file->data = file->mapping.data;
+    file->size = file->mapping.size;
+    return true;
+}
+
+bool mt_vfs_open(MtVfs *vfs, const char *path, MtVfsFile *file)
+{
+    memset(file, 0, sizeof(*file));
+
+    for (uint32_t i = mt_array_size(vfs->mounts); i-- > 0;)
+    {
+        const MtVfsMount *mount = &vfs->mounts[i];
+        const char *relative = relative_path(mount, path);
+        if (!relative) continue;
+
+        if (mount->pack)
+        {
+            const MtPackEntry *entry = find_entry(mount->pack, relative);
+            if (entry) return open_entry(vfs, mount, entry, file);
+        }
+        else
+        {
+            char real_path[1024];
+            dir_path(mount, relative, real_path, sizeof(real_path));
+            if (open_file(real_path, file)) return true;
+        }
+    }
+
+    return open_file(path, file);
+}
+
+void mt_vfs_close(MtVfs *vfs, MtVfsFile *file)
+{
+    mt_file_unmap(&file->mapping);
+    if (file->buffer) mt_free(vfs->alloc, file->buffer);
+    memset(file, 0, sizeof(*file));
+}
+
+static bool stat_file(const char *path, MtVfsStat *vfs_stat)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+
+    vfs_stat->size = (uint64_t)st.st_size;
+    vfs_stat->mtime = (uint64_t)st.st_mtime;
+    return true;
+}
+
+bool mt_vfs_stat(MtVfs *vfs, const char *path, MtVfsStat *vfs_stat)
+{
+    for (uint32_t i = mt_array_size(vfs->mounts); i-- > 0;)
+    {
+        const MtVfsMount *mount = &vfs->mounts[i];
+        const char *relative = relative_path(mount, path);
+        if (!relative) continue;
+
+        if (mount->pack)
+        {
+            const MtPackEntry *entry = find_entry(mount->pack, relative);
+            if (entry)
+            {
+                vfs_stat->size = entry->size;
+                vfs_stat->mtime = entry->mtime;
+                return true;
+            }
+        }
+        else
+        {
+            char real_path[1024];
+            dir_path(mount, relative, real_path, sizeof(real_path));
+            if (stat_file(real_path, vfs_stat)) return true;
+        }
+    }
+
+    return stat_file(path, vfs_stat);
+}
+
+bool mt_vfs_needs_read(MtVfs *vfs, const char *path)
+{
+    for (uint32_t i = mt_array_size(vfs->mounts); i-- > 0;)
+    {
+        const MtVfsMount *mount = &vfs->mounts[i];
+        const char *relative = relative_path(mount, path);
+        if (!relative) continue;
+
+        if (mount->pack)
+        {
+            const MtPackEntry *entry = find_entry(mount->pack, relative);
+            if (entry) return entry->compression != MT_PACK_COMPRESSION_NONE;
+        }
+        else
+        {
+            MtVfsStat st;
+            char real_path[1024];
+            dir_path(mount, relative, real_path, sizeof(real_path));
+            if (stat_file(real_path, &st)) return false;
+        }
+    }
+
+    return false;
+}
+
+// Finds where the file is stored, the read fails later if it is nowhere
+static void resolve_async_open(MtVfs *vfs, MtVfsAsyncOpen *open)
+{
+    open->read.offset = 0;
+    open->read.size = MT_ASYNC_READ_WHOLE_FILE;
+    open->compression = MT_PACK_COMPRESSION_NONE;
+
+    for (uint32_t i = mt_array_size(vfs->mounts); i-- > 0;)
+    {
+        const MtVfsMount *mount = &vfs->mounts[i];
+        const char *relative = relative_path(mount, open->path);
+        if (!relative) continue;
+
+        if (mount->pack)
+        {
+            const MtPackEntry *entry = find_entry(mount->pack, relative);
+            if (entry)
+            {
+                snprintf(open->real_path, sizeof(open->real_path), "%s", mount->pack_path);
+                open->read.offset = entry->offset;
+                open->read.size = entry->stored_size;
+                open->size = entry->size;
+                open->compression = entry->compression;
+                return;
+            }
+        }
+        else
+        {
+            MtVfsStat st;
+            dir_path(mount, relative, open->real_path, sizeof(open->real_path));
+            if (stat_file(open->real_path, &st)) return;
+        }
+    }
+
+    snprintf(open->real_path, sizeof(open->real_path), "%s", open->path);
+}
+
+static int32_t async_open_done(void *arg)
+{
+    MtAsyncRead *read = arg;
+    MtVfsAsyncOpen *open = read->user_data;
+    MtVfs *vfs = open->vfs;
+    MtVfsFile *file = &open->file;
+
+    memset(file, 0, sizeof(*file));
+
+    if (read->data && open->compression == MT_PACK_COMPRESSION_LZ4)
+    {
+        file->buffer = mt_alloc(vfs->alloc, open->size);
+        if (mt_lz4_decompress(read->data, read->size, file->buffer, open->size))
+        {
+            file->size = open->size;
+        }
+        else
+        {
+            mt_log_error("Corrupt pack entry: %s", open->path);
+            mt_free(vfs->alloc, file->buffer);
+            file->buffer = NULL;
+        }
+        mt_free(vfs->alloc, read->data);
+    }
+    else if (read->data)
+    {
+        file->buffer = read->data;
+        file->size = read->size;
+    }
+
+    file->data = file->buffer;
+
+    return open->continuation(open);
+}
+
+void mt_vfs_open_async(
+    MtVfs *vfs, MtAsyncIo *io, MtVfsAsyncOpen **opens, uint32_t count, MtTaskGroup *group)
+{
+    MtAsyncRead *reads[64];
+
+    for (uint32_t first = 0; first < count; first += MT_LENGTH(reads))
+    {
+        uint32_t batch_size = MT_MIN(count - first, (uint32_t)MT_LENGTH(reads));
+        for (uint32_t i = 0; i < batch_size; i++)
+        {
+            MtVfsAsyncOpen *open = opens[first + i];
+            open->vfs = vfs;
+            resolve_async_open(vfs, open);
+
+            open->read.path = open->real_path;
+            open->read.alloc = vfs->alloc;
+            open->read.continuation = async_open_done;
+            open->read.user_data = open;
+            reads[i] = &open->read;
+        }
+
+        mt_async_io_submit(io, reads, batch_size, group);
+    }
+}
@@ -1,6 +1,8 @@
 #include <motor/engine/asset_manager.h>
 
+#include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <motor/base/api_types.h>
@@ -9,6 +11,7 @@
 #include <motor/base/allocator.h>
 #include <motor/base/array.h>
 #include <motor/base/thread_pool.h>
+#include <motor/base/vfs.h>
 
 #include <motor/graphics/renderer.h>
 
@@ -17,6 +20,7 @@
 #include <motor/engine/assets/pipeline_asset.h>
 #include <motor/engine/assets/font_asset.h>
 #include <motor/engine/assets/gltf_asset.h>
+#include <motor/engine/assets/mesh_asset.h>
 
 static void register_asset_type(MtAssetManager *am, MtAssetVT *vt)
 {
@@ -38,14 +42,28 @@ void mt_asset_manager_init(MtAssetManager *am, MtAssetManager *parent, MtEngine
 
     mt_hash_init(&am->asset_type_map, 51, am->alloc);
     mt_hash_init(&am->asset_map, 51, am->alloc);
+    mt_hash_init(&am->loads, 51, am->alloc);
+    mt_hash_init(&am->requests, 51, am->alloc);
+
+    am->max_running_loads = MT_MAX((uint32_t)mt_array_size(engine->thread_pool.workers), 1u);
 
     register_asset_type(am, mt_image_asset_vt);
     register_asset_type(am, mt_pipeline_asset_vt);
     register_asset_type(am, mt_font_asset_vt);
     register_asset_type(am, mt_gltf_asset_vt);
+    register_asset_type(am, mt_mesh_asset_vt);
 }
 
-MtAsset *mt_asset_manager_load(MtAssetManager *am, const char *path)
+static void free_asset(MtAssetManager *am, MtAsset *asset)
+{
+    asset->vt->destroy(asset);
+    mt_free(am->alloc, (void *)asset->path);
+    mt_free(am->alloc, asset);
+}
+
+// Creates a new instance of the asset without publishing it.
+// The file is opened here unless it was already read.
+static MtAsset *load_asset(MtAssetManager *am, const char *path, const MtVfsFile *file)
 {
     mt_render.set_thread_id(mt_thread_pool_get_task_id());
 
@@ -60,97 +78,561 @@ MtAsset *mt_asset_manager_load(MtAssetManager *am, const char *path)
 
     mt_log_debug("Loading asset: %s", path);
 
-    MtAsset *temp_asset_ptr = mt_alloc(am->alloc, vt->size);
-    memset(temp_asset_ptr, 0, vt->size);
-    temp_asset_ptr->path = mt_strdup(am->alloc, path);
-    temp_asset_ptr->vt = vt;
+    MtVfs *vfs = &am->engine->vfs;
+    MtVfsFile opened = {0};
+    if (!file)
+    {
+        mt_vfs_open(vfs, path, &opened);
+        file = &opened;
+    }
 
-    bool initialized = vt->init(am, temp_asset_ptr, path);
+    if (!file->data)
+    {
+        mt_log_error("Failed to open asset: %s", path);
+        return NULL;
+    }
 
-    temp_asset_ptr->path = mt_strdup(am->alloc, path);
-    temp_asset_ptr->vt = vt;
+    char *asset_path = mt_strdup(am->alloc, path);
 
-    if (!initialized)
+    MtAsset *asset = mt_alloc(am->alloc, vt->size);
+    memset(asset, 0, vt->size);
+    asset->path = asset_path;
+    asset->vt = vt;
+
+    bool loaded = vt->init(am, asset, path, file);
+    mt_vfs_close(vfs, &opened);
+
+    if (!loaded)
     {
         mt_log_error("Failed to load asset: %s", path);
-        mt_free(am->alloc, temp_asset_ptr);
-        temp_asset_ptr = NULL;
+        mt_free(am->alloc, asset_path);
+        mt_free(am->alloc, asset);
+        return NULL;
     }
 
-    uint64_t path_hash = mt_hash_str(path);
+    // Loaders may have cleared the whole asset
+    asset->path = asset_path;
+    asset->vt = vt;
+    asset->cpu_size += vt->size;
+
+    return asset;
+}
+
+static uint32_t find_slot_no_lock(MtAssetManager *am, uint64_t path_hash)
+{
+    uint64_t index = mt_hash_get_uint(&am->asset_map, path_hash);
+    return index == MT_HASH_NOT_FOUND ? UINT32_MAX : (uint32_t)index;
+}
+
+static MtAssetSlot *slot_from_handle_no_lock(MtAssetManager *am, MtAssetHandle handle)
+{
+    if (handle.index == 0 || handle.index > mt_array_size(am->slots)) return NULL;
+
+    MtAssetSlot *slot = &am->slots[handle.index - 1];
+    if (slot->generation != handle.generation || !slot->asset) return NULL;
+
+    return slot;
+}
+
+// Stores a freshly loaded asset. If the path is already loaded, the new version either
+// waits for mt_asset_manager_update to replace the old one, or is discarded.
+static uint32_t publish_asset_no_lock(MtAssetManager *am, MtAsset *asset, bool replace)
+{
+    uint64_t path_hash = mt_hash_str(asset->path);
+
+    uint32_t index = find_slot_no_lock(am, path_hash);
+    if (index != UINT32_MAX)
+    {
+        MtAssetSlot *slot = &am->slots[index];
+        if (replace)
+        {
+            if (slot->pending) free_asset(am, slot->pending);
+            slot->pending = asset;
+        }
+        else
+        {
+            free_asset(am, asset);
+        }
+        return index;
+    }
+
+    uint32_t *free_slot = mt_array_pop(am->free_slots);
+    if (free_slot)
+    {
+        index = *free_slot;
+    }
+    else
+    {
+        index = (uint32_t)mt_array_size(am->slots);
+        mt_array_push(am->alloc, am->slots, (MtAssetSlot){0});
+    }
+
+    MtAssetSlot *slot = &am->slots[index];
+    slot->asset = asset;
+    slot->pending = NULL;
+    slot->ref_count = 0;
+    slot->pinned = false;
+    slot->last_used_frame = am->frame;
+
+    mt_hash_set_uint(&am->asset_map, path_hash, index);
+
+    am->cpu_usage += asset->cpu_size;
+    am->gpu_usage += asset->gpu_size;
+
+    return index;
+}
+
+static MtAsset *load_pinned(MtAssetManager *am, const char *path, const MtVfsFile *file)
+{
+    MtAsset *asset = load_asset(am, path, file);
+
+    mt_mutex_lock(&am->mutex);
+
+    uint32_t index = asset ? publish_asset_no_lock(am, asset, true)
+                           : find_slot_no_lock(am, mt_hash_str(path));
+
+    MtAsset *result = NULL;
+    if (index != UINT32_MAX)
+    {
+        am->slots[index].pinned = true;
+        result = am->slots[index].asset;
+    }
+
+    mt_mutex_unlock(&am->mutex);
+
+    return result;
+}
+
+MtAsset *mt_asset_manager_load(MtAssetManager *am, const char *path)
+{
+    return load_pinned(am, path, NULL);
+}
+
+static MtAssetHandle acquire_slot_no_lock(MtAssetManager *am, uint32_t index)
+{
+    MtAssetSlot *slot = &am->slots[index];
+    slot->ref_count++;
+    slot->last_used_frame = am->frame;
+    return (MtAssetHandle){.index = index + 1, .generation = slot->generation};
+}
+
+static MtAssetHandle acquire(MtAssetManager *am, const char *path, const MtVfsFile *file)
+{
+    MtAssetHandle handle = {0};
+
+    mt_mutex_lock(&am->mutex);
+    uint32_t index = find_slot_no_lock(am, mt_hash_str(path));
+    if (index != UINT32_MAX) handle = acquire_slot_no_lock(am, index);
+    mt_mutex_unlock(&am->mutex);
+
+    if (handle.index != 0) return handle;
+
+    MtAsset *asset = load_asset(am, path, file);
+    if (!asset) return handle;
+
+    mt_mutex_lock(&am->mutex);
+    // Another thread may have loaded the same path in the meantime
+    index = publish_asset_no_lock(am, asset, false);
+    handle = acquire_slot_no_lock(am, index);
+    mt_mutex_unlock(&am->mutex);
+
+    return handle;
+}
+
+MtAssetHandle mt_asset_manager_acquire(MtAssetManager *am, const char *path)
+{
+    return acquire(am, path, NULL);
+}
 
+void mt_asset_manager_release(MtAssetManager *am, MtAssetHandle handle)
+{
     mt_mutex_lock(&am->mutex);
-    MtAsset *existing = mt_hash_get_ptr(&am->asset_map, path_hash);
+
+    MtAssetSlot *slot = slot_from_handle_no_lock(am, handle);
+    if (slot)
+    {
+        assert(slot->ref_count > 0);
+        slot->ref_count--;
+    }
+
     mt_mutex_unlock(&am->mutex);
+}
+
+MtAsset *mt_asset_manager_resolve(MtAssetManager *am, MtAssetHandle handle)
+{
+    MtAsset *asset = NULL;
+
+    mt_mutex_lock(&am->mutex);
+
+    MtAssetSlot *slot = slot_from_handle_no_lock(am, handle);
+    if (slot)
+    {
+        slot->last_used_frame = am->frame;
+        asset = slot->asset;
+    }
+
+    mt_mutex_unlock(&am->mutex);
+
+    return asset;
+}
+
+typedef struct AssetRequest
+{
+    uint64_t id;
+    MtAssetPriority priority;
+    MtAssetCallback callback;
+    void *user_data;
+} AssetRequest;
+
+struct MtAssetLoad
+{
+    MtAssetManager *asset_manager;
+    char *path;
+    uint64_t path_hash;
+
+    // Most urgent priority of the requests
+    MtAssetPriority priority;
+    bool running;
+    /*array*/ AssetRequest *requests;
+
+    MtVfsAsyncOpen open;
+};
+
+static MtAssetPriority load_priority(const MtAssetLoad *load)
+{
+    MtAssetPriority priority = MT_ASSET_PRIORITY_PREFETCH;
+    for (uint32_t i = 0; i < mt_array_size(load->requests); i++)
+    {
+        priority = MT_MIN(priority, load->requests[i].priority);
+    }
+    return priority;
+}
+
+static void unqueue_load_no_lock(MtAssetManager *am, MtAssetLoad *load)
+{
+    MtAssetLoad **queue = am->load_queues[load->priority];
+    uint32_t size = (uint32_t)mt_array_size(queue);
 
-    if (existing)
+    for (uint32_t i = 0; i < size; i++)
     {
-        if (temp_asset_ptr)
+        if (queue[i] != load) continue;
+
+        // Keeps the queue in request order
+        memmove(&queue[i], &queue[i + 1], sizeof(*queue) * (size - i - 1));
+        mt_array_set_size(queue, size - 1);
+        return;
+    }
+
+    assert(!"Load is not queued");
+}
+
+static void free_load(MtAssetManager *am, MtAssetLoad *load)
+{
+    mt_array_free(am->alloc, load->requests);
+    mt_free(am->alloc, load->path);
+    mt_free(am->alloc, load);
+}
+
+static int32_t run_load(void *arg);
+
+// Starts queued loads, most urgent first, while fewer than the maximum are running
+static void start_loads_no_lock(MtAssetManager *am)
+{
+    assert(am->max_running_loads > 0);
+
+    for (uint32_t priority = 0; priority < MT_ASSET_PRIORITY_COUNT; priority++)
+    {
+        MtAssetLoad **queue = am->load_queues[priority];
+        while (mt_array_size(queue) > 0 && am->running_loads < am->max_running_loads)
         {
-            mt_mutex_lock(&am->mutex);
+            MtAssetLoad *load = queue[0];
+            unqueue_load_no_lock(am, load);
 
-            existing->vt->destroy(existing);
-            memcpy(existing, temp_asset_ptr, vt->size);
-            mt_free(am->alloc, temp_asset_ptr);
+            load->running = true;
+            am->running_loads++;
 
-            mt_mutex_unlock(&am->mutex);
+            // Only started loads are counted, waiting on the pool does not wait for the queues
+            mt_thread_pool_defer(&am->engine->thread_pool, &am->load_group);
+            mt_thread_pool_enqueue_deferred(
+                &am->engine->thread_pool, &am->load_group, run_load, load);
         }
+    }
+}
 
-        return existing;
+static void complete_load(MtAssetLoad *load, const MtVfsFile *file)
+{
+    MtAssetManager *am = load->asset_manager;
+    MtAssetHandle handle = {0};
+
+    mt_mutex_lock(&am->mutex);
+    if (mt_array_size(load->requests) > 0)
+    {
+        mt_mutex_unlock(&am->mutex);
+        handle = acquire(am, load->path, file);
+        mt_mutex_lock(&am->mutex);
+    }
+
+    // Requests can't be cancelled from here on, their callbacks run below
+    mt_hash_remove(&am->loads, load->path_hash);
+    for (uint32_t i = 0; i < mt_array_size(load->requests); i++)
+    {
+        mt_hash_remove(&am->requests, load->requests[i].id);
+    }
+
+    // One reference per request
+    MtAssetSlot *slot = slot_from_handle_no_lock(am, handle);
+    if (slot)
+    {
+        slot->ref_count += (uint32_t)mt_array_size(load->requests);
+        slot->ref_count--;
+    }
+
+    am->running_loads--;
+    start_loads_no_lock(am);
+
+    mt_mutex_unlock(&am->mutex);
+
+    for (uint32_t i = 0; i < mt_array_size(load->requests); i++)
+    {
+        AssetRequest *request = &load->requests[i];
+        request->callback(am, handle, request->user_data);
+    }
+
+    free_load(am, load);
+}
+
+// Continuation of the async read, the worker only decodes
+static int32_t load_read(void *arg)
+{
+    MtVfsAsyncOpen *open = arg;
+    MtAssetLoad *load = open->user_data;
+    MtVfs *vfs = open->vfs;
+
+    // The request is freed with the load
+    MtVfsFile file = open->file;
+    complete_load(load, &file);
+    mt_vfs_close(vfs, &file);
+
+    return 0;
+}
+
+static int32_t run_load(void *arg)
+{
+    MtAssetLoad *load = arg;
+    MtAssetManager *am = load->asset_manager;
+    MtEngine *engine = am->engine;
+
+    // Assets that are already loaded are only referenced, their file is not read again
+    mt_mutex_lock(&am->mutex);
+    bool loaded = find_slot_no_lock(am, load->path_hash) != UINT32_MAX;
+    bool needed = mt_array_size(load->requests) > 0;
+    mt_mutex_unlock(&am->mutex);
+
+    // Mapped files and stored pack entries are only paged in as the loader reads them,
+    // e.g. without the mips a texture streams later
+    if (!loaded && needed && !am->sync_io && engine->async_io &&
+        mt_vfs_needs_read(&engine->vfs, load->path))
+    {
+        load->open = (MtVfsAsyncOpen){
+            .path = load->path,
+            .continuation = load_read,
+            .user_data = load,
+        };
+
+        MtVfsAsyncOpen *open = &load->open;
+        mt_vfs_open_async(&engine->vfs, engine->async_io, &open, 1, &am->load_group);
+        return 0;
+    }
+
+    complete_load(load, NULL);
+    return 0;
+}
+
+static void set_load_priority_no_lock(MtAssetManager *am, MtAssetLoad *load)
+{
+    MtAssetPriority priority = load_priority(load);
+    if (load->running || priority == load->priority) return;
+
+    unqueue_load_no_lock(am, load);
+    load->priority = priority;
+    mt_array_push(am->alloc, am->load_queues[priority], load);
+}
+
+uint64_t mt_asset_manager_request(
+    MtAssetManager *am,
+    const char *path,
+    MtAssetPriority priority,
+    MtAssetCallback callback,
+    void *user_data)
+{
+    assert(priority < MT_ASSET_PRIORITY_COUNT && callback);
+
+    uint64_t path_hash = mt_hash_str(path);
+
+    mt_mutex_lock(&am->mutex);
+
+    AssetRequest request = {
+        .id = ++am->next_request,
+        .priority = priority,
+        .callback = callback,
+        .user_data = user_data,
+    };
+
+    MtAssetLoad *load = mt_hash_get_ptr(&am->loads, path_hash);
+    if (load)
+    {
+        mt_array_push(am->alloc, load->requests, request);
+        set_load_priority_no_lock(am, load);
     }
     else
     {
-        if (temp_asset_ptr)
+        load = mt_alloc(am->alloc, sizeof(*load));
+        memset(load, 0, sizeof(*load));
+        load->asset_manager = am;
+        load->path = mt_strdup(am->alloc, path);
+        load->path_hash = path_hash;
+        load->priority = priority;
+        mt_array_push(am->alloc, load->requests, request);
+
+        mt_hash_set_ptr(&am->loads, path_hash, load);
+        mt_array_push(am->alloc, am->load_queues[priority], load);
+        start_loads_no_lock(am);
+    }
+
+    mt_hash_set_ptr(&am->requests, request.id, load);
+
+    mt_mutex_unlock(&am->mutex);
+
+    return request.id;
+}
+
+// Queued loads without requests are dropped, running ones complete without a callback
+static void drop_load_no_lock(MtAssetManager *am, MtAssetLoad *load)
+{
+    if (load->running) return;
+
+    unqueue_load_no_lock(am, load);
+    mt_hash_remove(&am->loads, load->path_hash);
+    free_load(am, load);
+}
+
+bool mt_asset_manager_cancel(MtAssetManager *am, uint64_t request)
+{
+    mt_mutex_lock(&am->mutex);
+
+    MtAssetLoad *load = mt_hash_get_ptr(&am->requests, request);
+    bool found = load != NULL;
+    if (found)
+    {
+        mt_hash_remove(&am->requests, request);
+
+        uint32_t count = (uint32_t)mt_array_size(load->requests);
+        for (uint32_t i = 0; i < count; i++)
         {
-            mt_mutex_lock(&am->mutex);
+            if (load->requests[i].id != request) continue;
 
-            mt_array_push(am->alloc, am->assets, temp_asset_ptr);
-            MtAsset *asset_ptr = *mt_array_last(am->assets);
-            mt_hash_set_ptr(&am->asset_map, path_hash, asset_ptr);
+            load->requests[i] = load->requests[count - 1];
+            mt_array_set_size(load->requests, count - 1);
+            break;
+        }
 
-            mt_mutex_unlock(&am->mutex);
-            return asset_ptr;
+        if (mt_array_size(load->requests) == 0)
+        {
+            drop_load_no_lock(am, load);
+        }
+        else
+        {
+            set_load_priority_no_lock(am, load);
         }
+    }
 
-        mt_log_error("Failed to load asset: %s", path);
-        return NULL;
+    mt_mutex_unlock(&am->mutex);
+
+    return found;
+}
+
+void mt_asset_manager_set_priority(
+    MtAssetManager *am, uint64_t request, MtAssetPriority priority)
+{
+    assert(priority < MT_ASSET_PRIORITY_COUNT);
+
+    mt_mutex_lock(&am->mutex);
+
+    MtAssetLoad *load = mt_hash_get_ptr(&am->requests, request);
+    if (load)
+    {
+        for (uint32_t i = 0; i < mt_array_size(load->requests); i++)
+        {
+            if (load->requests[i].id == request) load->requests[i].priority = priority;
+        }
+        set_load_priority_no_lock(am, load);
     }
 
-    return NULL;
+    mt_mutex_unlock(&am->mutex);
 }
 
-typedef struct AssetLoadInfo
+static bool has_loads_no_lock(MtAssetManager *am)
 {
-    MtAssetManager *asset_manager;
-    MtAsset **out_asset;
-    const char *path;
-} AssetLoadInfo;
+    bool has_loads = am->running_loads > 0;
+    for (uint32_t priority = 0; priority < MT_ASSET_PRIORITY_COUNT; priority++)
+    {
+        has_loads |= mt_array_size(am->load_queues[priority]) > 0;
+    }
+    return has_loads;
+}
 
-static int32_t asset_load(void *arg)
+void mt_asset_manager_wait(MtAssetManager *am)
 {
-    AssetLoadInfo *info = arg;
-    MtAssetManager *am = info->asset_manager;
+    // A completing load starts the next queued one before its task ends, so the group only
+    // runs empty with the queues. Checked again for requests made by other threads meanwhile.
+    bool has_loads = true;
+    while (has_loads)
+    {
+        mt_thread_pool_wait_group(&am->engine->thread_pool, &am->load_group);
 
-    MtAsset *asset = mt_asset_manager_load(am, info->path);
+        mt_mutex_lock(&am->mutex);
+        has_loads = has_loads_no_lock(am);
+        mt_mutex_unlock(&am->mutex);
+    }
+}
 
-    if (info->out_asset)
+static void store_asset(MtAssetManager *am, MtAssetHandle handle, void *user_data)
+{
+    MtAsset **out_asset = user_data;
+
+    mt_mutex_lock(&am->mutex);
+
+    MtAsset *asset = NULL;
+    MtAssetSlot *slot = slot_from_handle_no_lock(am, handle);
+    if (slot)
     {
-        *info->out_asset = asset;
+        // Kept loaded like assets from mt_asset_manager_load
+        slot->pinned = true;
+        slot->ref_count--;
+        asset = slot->asset;
     }
 
-    mt_free(am->engine->alloc, info);
-    return 0;
+    mt_mutex_unlock(&am->mutex);
+
+    if (out_asset) *out_asset = asset;
 }
 
 void mt_asset_manager_queue_load(MtAssetManager *am, const char *path, MtAsset **out_asset)
 {
-    AssetLoadInfo *info = mt_alloc(am->engine->alloc, sizeof(AssetLoadInfo));
+    mt_asset_manager_request(am, path, MT_ASSET_PRIORITY_CRITICAL, store_asset, out_asset);
+}
 
-    info->asset_manager = am;
-    info->path = path;
-    info->out_asset = out_asset;
+static void store_handle(MtAssetManager *am, MtAssetHandle handle, void *user_data)
+{
+    (void)am;
+    *(MtAssetHandle *)user_data = handle;
+}
 
-    mt_thread_pool_enqueue(&am->engine->thread_pool, asset_load, info);
+void mt_asset_manager_queue_acquire(
+    MtAssetManager *am, const char *path, MtAssetHandle *out_handle)
+{
+    assert(out_handle);
+    mt_asset_manager_request(am, path, MT_ASSET_PRIORITY_CRITICAL, store_handle, out_handle);
 }
 
 MtAsset *mt_asset_manager_get(MtAssetManager *am, const char *path)
@@ -164,10 +646,17 @@ MtAsset *mt_asset_manager_get(MtAssetManager *am, const char *path)
         }
     }
 
-    uint64_t path_hash = mt_hash_str(path);
+    MtAsset *asset = NULL;
+
     mt_mutex_lock(&am->mutex);
-    MtAsset *asset = mt_hash_get_ptr(&am->asset_map, path_hash);
+    uint32_t index = find_slot_no_lock(am, mt_hash_str(path));
+    if (index != UINT32_MAX)
+    {
+        am->slots[index].pinned = true;
+        asset = am->slots[index].asset;
+    }
     mt_mutex_unlock(&am->mutex);
+
     return asset;
 }
 
@@ -180,13 +669,13 @@ static void asset_manager_get_all_internal(
     }
 
     mt_mutex_lock(&am->mutex);
-    for (MtAsset **asset = am->assets; asset != am->assets + mt_array_size(am->assets); ++asset)
+    for (MtAssetSlot *slot = am->slots; slot != am->slots + mt_array_size(am->slots); ++slot)
     {
-        if ((*asset)->vt == type)
+        if (slot->asset && slot->asset->vt == type)
         {
             if (assets)
             {
-                assets[*count] = *asset;
+                assets[*count] = slot->asset;
             }
             if (count) *count += 1;
         }
@@ -204,20 +693,150 @@ mt_asset_manager_get_all(MtAssetManager *am, MtAssetVT *type, uint32_t *count, M
     asset_manager_get_all_internal(am, type, count, assets);
 }
 
+static void unload_slot_no_lock(MtAssetManager *am, uint32_t index)
+{
+    MtAssetSlot *slot = &am->slots[index];
+    MtAsset *asset = slot->asset;
+
+    mt_log_debug("Unloading asset: %s", asset->path);
+
+    mt_hash_remove(&am->asset_map, mt_hash_str(asset->path));
+
+    am->cpu_usage -= asset->cpu_size;
+    am->gpu_usage -= asset->gpu_size;
+    free_asset(am, asset);
+
+    slot->asset = NULL;
+    slot->generation++;
+    mt_array_push(am->alloc, am->free_slots, index);
+}
+
+static bool over_budget(MtAssetManager *am)
+{
+    return (am->cpu_budget > 0 && am->cpu_usage > am->cpu_budget) ||
+           (am->gpu_budget > 0 && am->gpu_usage > am->gpu_budget);
+}
+
+typedef struct EvictionCandidate
+{
+    uint64_t last_used_frame;
+    uint32_t index;
+} EvictionCandidate;
+
+static int compare_candidates(const void *a, const void *b)
+{
+    uint64_t x = ((const EvictionCandidate *)a)->last_used_frame;
+    uint64_t y = ((const EvictionCandidate *)b)->last_used_frame;
+    return (x > y) - (x < y);
+}
+
+void mt_asset_manager_update(MtAssetManager *am)
+{
+    mt_mutex_lock(&am->mutex);
+
+    am->frame++;
+
+    // Reloaded assets replace the old version in place, so pointers to them stay valid
+    for (uint32_t i = 0; i < mt_array_size(am->slots); i++)
+    {
+        MtAssetSlot *slot = &am->slots[i];
+        if (!slot->pending) continue;
+
+        MtAsset *asset = slot->asset;
+        MtAsset *pending = slot->pending;
+        assert(asset->vt == pending->vt);
+
+        am->cpu_usage -= asset->cpu_size;
+        am->gpu_usage -= asset->gpu_size;
+
+        asset->vt->destroy(asset);
+        mt_free(am->alloc, (void *)asset->path);
+        memcpy(asset, pending, pending->vt->size);
+        mt_free(am->alloc, pending);
+        slot->pending = NULL;
+
+        am->cpu_usage += asset->cpu_size;
+        am->gpu_usage += asset->gpu_size;
+    }
+
+    if (over_budget(am))
+    {
+        /*array*/ EvictionCandidate *candidates = NULL;
+        for (uint32_t i = 0; i < mt_array_size(am->slots); i++)
+        {
+            MtAssetSlot *slot = &am->slots[i];
+            if (slot->asset && !slot->pinned && slot->ref_count == 0)
+            {
+                EvictionCandidate candidate = {slot->last_used_frame, i};
+                mt_array_push(am->alloc, candidates, candidate);
+            }
+        }
+
+        if (candidates)
+        {
+            qsort(
+                candidates,
+                mt_array_size(candidates),
+                sizeof(*candidates),
+                compare_candidates);
+        }
+
+        for (uint32_t i = 0; i < mt_array_size(candidates) && over_budget(am); i++)
+        {
+            unload_slot_no_lock(am, candidates[i].index);
+        }
+
+        if (over_budget(am))
+        {
+            mt_log_debug("Assets in use exceed the memory budget");
+        }
+
+        mt_array_free(am->alloc, candidates);
+    }
+
+    mt_mutex_unlock(&am->mutex);
+}
+
 void mt_asset_manager_destroy(MtAssetManager *am)
 {
+    // Queued loads are dropped, running ones complete before anything is freed
+    mt_mutex_lock(&am->mutex);
+    for (uint32_t priority = 0; priority < MT_ASSET_PRIORITY_COUNT; priority++)
+    {
+        while (mt_array_size(am->load_queues[priority]) > 0)
+        {
+            MtAssetLoad *load = am->load_queues[priority][0];
+            for (uint32_t i = 0; i < mt_array_size(load->requests); i++)
+            {
+                mt_hash_remove(&am->requests, load->requests[i].id);
+            }
+            drop_load_no_lock(am, load);
+        }
+    }
+    mt_mutex_unlock(&am->mutex);
+
+    mt_asset_manager_wait(am);
+
     mt_mutex_lock(&am->mutex);
 
+    for (uint32_t priority = 0; priority < MT_ASSET_PRIORITY_COUNT; priority++)
+    {
+        mt_array_free(am->alloc, am->load_queues[priority]);
+    }
+    mt_hash_destroy(&am->requests);
+    mt_hash_destroy(&am->loads);
+
     mt_hash_destroy(&am->asset_map);
     mt_hash_destroy(&am->asset_type_map);
 
-    for (uint32_t i = 0; i < mt_array_size(am->assets); i++)
+    for (uint32_t i = 0; i < mt_array_size(am->slots); i++)
     {
-        MtAsset *asset = am->assets[i];
-        asset->vt->destroy(asset);
-        mt_free(am->alloc, asset);
+        MtAssetSlot *slot = &am->slots[i];
+        if (slot->pending) free_asset(am, slot->pending);
+        if (slot->asset) free_asset(am, slot->asset);
     }
-    mt_array_free(am->alloc, am->assets);
+    mt_array_free(am->alloc, am->slots);
+    mt_array_free(am->alloc, am->free_slots);
     mt_array_free(am->alloc, am->asset_types);
 
     mt_mutex_unlock(&am->mutex);
@@ -1,31 +1,22 @@
 #include <motor/engine/assets/font_asset.h>
 
 #include <motor/base/api_types.h>
+#include <motor/base/vfs.h>
 #include <motor/engine/asset_manager.h>
 #include "font_asset.inl"
 #include <stdio.h>
 
-static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const char *path)
+static bool asset_init(
+    MtAssetManager *asset_manager, MtAsset *asset_, const char *path, const MtVfsFile *file)
 {
     MtFontAsset *asset = (MtFontAsset *)asset_;
     memset(asset, 0, sizeof(*asset));
     asset->asset_manager = asset_manager;
 
-    FILE *f = fopen(path, "rb");
-    if (!f)
-    {
-        printf("Failed to open font file: %s\n", path);
-        return false;
-    }
-
-    fseek(f, 0, SEEK_END);
-    size_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    asset->font_data = mt_alloc(asset_manager->alloc, size);
-    fread(asset->font_data, 1, size, f);
-
-    fclose(f);
+    // Atlases are baked from it later, after the file is closed
+    asset->font_data = mt_alloc(asset_manager->alloc, file->size);
+    memcpy(asset->font_data, file->data, file->size);
+    asset->asset.cpu_size = file->size;
 
     mt_hash_init(&asset->map, 11, asset_manager->alloc);
 
@@ -7,9 +7,20 @@
 #include <motor/base/array.h>
 #include <motor/base/allocator.h>
 #include <motor/base/math.h>
+#include <motor/base/log.h>
+#include <motor/base/frustum.h>
+#include <motor/base/filesystem.h>
+#include <motor/base/vfs.h>
+#include <motor/base/thread_pool.h>
 #include <motor/graphics/renderer.h>
 #include <motor/engine/asset_manager.h>
 #include <motor/engine/engine.h>
+#include <motor/engine/geometry_arena.h>
+#include <motor/engine/mesh_format.h>
+#include <motor/engine/camera.h>
+#include <motor/engine/texture_streamer.h>
+#include <motor/engine/material_table.h>
+#include <motor/engine/image_cache.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -28,19 +39,20 @@ typedef struct GltfMaterial
 {
     MaterialUniform uniform;
 
-    MtImage *albedo_image;
+    // Image slots of the asset or the engine, streamed images get replaced between frames
+    MtImage **albedo_image;
     MtSampler *albedo_sampler;
 
-    MtImage *normal_image;
+    MtImage **normal_image;
     MtSampler *normal_sampler;
 
-    MtImage *metallic_roughness_image;
+    MtImage **metallic_roughness_image;
     MtSampler *metallic_roughness_sampler;
 
-    MtImage *occlusion_image;
+    MtImage **occlusion_image;
     MtSampler *occlusion_sampler;
 
-    MtImage *emissive_image;
+    MtImage **emissive_image;
     MtSampler *emissive_sampler;
 } GltfMaterial;
 
@@ -50,8 +62,9 @@ typedef struct GltfPrimitive
     uint32_t index_count;
     uint32_t vertex_count;
     GltfMaterial *material;
-    bool has_indices;
     bool is_normal_mapped;
+    // Local to the mesh
+    MtAabb bounds;
 } GltfPrimitive;
 
 typedef struct GltfMesh
@@ -82,22 +95,54 @@ struct MtGltfAsset
     /*array*/ GltfNode **linear_nodes;
 
     /*array*/ MtImage **images;
+    // Parallel to images, NULL for images that are loaded whole
+    /*array*/ MtStreamedTexture **streamed_images;
     /*array*/ MtSampler **samplers;
     /*array*/ GltfMaterial *materials;
 
+    // Geometry lives in the engine's geometry arena unless it was full, in which
+    // case the asset owns vertex_buffer and index_buffer.
+    MtGeometryAllocation geometry;
     MtBuffer *vertex_buffer;
 
     uint32_t index_count;
     MtBuffer *index_buffer;
+
+    uint32_t primitive_count;
+
+    // Bindless mode only
+    /*array*/ uint32_t *bindless_images;
+    /*array*/ uint32_t *bindless_samplers;
+    // Slots of the materials in the engine's material table
+    uint32_t first_material;
+    uint32_t material_slots;
 };
 
+// Fills the vertex and index range reserved for one primitive
+typedef struct PrimitiveLoad
+{
+    cgltf_primitive *primitive;
+    GltfMesh *mesh;
+    uint32_t primitive_index;
+
+    MtStandardVertex *vertices;
+    uint32_t *indices;
+    uint32_t first_vertex;
+    uint32_t first_index;
+
+    MtAabb bounds;
+} PrimitiveLoad;
+
 static void load_node(
     MtGltfAsset *asset,
     GltfNode *parent,
     cgltf_node *node,
     cgltf_data *model,
-    uint32_t **index_buffer,
-    MtStandardVertex **vertex_buffer);
+    /*array*/ PrimitiveLoad **primitive_loads,
+    uint32_t *vertex_count,
+    uint32_t *index_count);
+
+static int32_t primitive_load_job(void *arg);
 
 static Mat4 node_local_matrix(GltfNode *node)
 {
@@ -134,210 +179,443 @@ static void node_update(GltfNode *node)
     }
 }
 
-static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const char *path)
+static const uint32_t *bindless_image_index(MtGltfAsset *asset, MtImage **image)
 {
-    MtGltfAsset *asset = (MtGltfAsset *)asset_;
-    asset->asset_manager = asset_manager;
+    MtEngine *engine = asset->asset_manager->engine;
+    if (image == &engine->white_image) return &engine->white_image_index;
+    if (image == &engine->black_image) return &engine->black_image_index;
 
-    MtEngine *engine = asset_manager->engine;
-    MtAllocator *alloc = asset_manager->alloc;
+    uint32_t index = (uint32_t)(image - asset->images);
+    assert(index < mt_array_size(asset->images));
+    return &asset->bindless_images[index];
+}
+
+static uint32_t bindless_sampler_index(MtGltfAsset *asset, MtSampler *sampler)
+{
+    MtEngine *engine = asset->asset_manager->engine;
+    if (sampler == engine->default_sampler) return engine->default_sampler_index;
 
-    FILE *f = fopen(path, "rb");
-    if (!f)
+    for (uint32_t i = 0; i < mt_array_size(asset->samplers); i++)
     {
-        return false;
+        if (asset->samplers[i] == sampler) return asset->bindless_samplers[i];
     }
 
-    fseek(f, 0, SEEK_END);
-    size_t gltf_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    assert(0);
+    return UINT32_MAX;
+}
 
-    uint8_t *gltf_data = mt_alloc(alloc, gltf_size);
-    fread(gltf_data, 1, gltf_size, f);
+static void init_bindless_materials(MtGltfAsset *asset)
+{
+    MtEngine *engine = asset->asset_manager->engine;
+    MtAllocator *alloc = asset->asset_manager->alloc;
+    MtDevice *dev = engine->device;
 
-    fclose(f);
+    // The streamer moves streamed images to a new index when it swaps them
+    mt_array_add(alloc, asset->bindless_images, mt_array_size(asset->images));
+    for (uint32_t i = 0; i < mt_array_size(asset->images); i++)
+    {
+        if (asset->streamed_images[i])
+        {
+            mt_texture_streamer_register_bindless(
+                engine->texture_streamer, asset->streamed_images[i], &asset->bindless_images[i]);
+        }
+        else
+        {
+            asset->bindless_images[i] = mt_render.register_bindless_image(dev, asset->images[i]);
+        }
+    }
 
-    cgltf_options gltf_options = {0};
-    cgltf_data *data = NULL;
-    cgltf_result result = cgltf_parse(&gltf_options, gltf_data, gltf_size, &data);
-    if (result != cgltf_result_success)
+    mt_array_add(alloc, asset->bindless_samplers, mt_array_size(asset->samplers));
+    for (uint32_t i = 0; i < mt_array_size(asset->samplers); i++)
     {
-        mt_free(alloc, gltf_data);
-        return false;
+        asset->bindless_samplers[i] = mt_render.register_bindless_sampler(dev, asset->samplers[i]);
     }
 
-    result = cgltf_load_buffers(&gltf_options, data, path);
-    if (result != cgltf_result_success)
+    uint32_t material_count = (uint32_t)mt_array_size(asset->materials);
+    if (material_count == 0) return;
+
+    MtMaterialTableEntry *entries = mt_alloc(alloc, sizeof(*entries) * material_count);
+    for (uint32_t i = 0; i < material_count; i++)
     {
-        cgltf_free(data);
-        mt_free(alloc, gltf_data);
-        return false;
+        GltfMaterial *mat = &asset->materials[i];
+        entries[i] = (MtMaterialTableEntry){
+            .base_color_factor = mat->uniform.base_color_factor,
+            .emissive_factor = mat->uniform.emissive_factor,
+            .metallic = mat->uniform.metallic,
+            .roughness = mat->uniform.roughness,
+            .sampler_index = bindless_sampler_index(asset, mat->albedo_sampler),
+            .albedo_image = bindless_image_index(asset, mat->albedo_image),
+            .normal_image = bindless_image_index(asset, mat->normal_image),
+            .metallic_roughness_image = bindless_image_index(asset, mat->metallic_roughness_image),
+            .occlusion_image = bindless_image_index(asset, mat->occlusion_image),
+            .emissive_image = bindless_image_index(asset, mat->emissive_image),
+        };
     }
 
-    // TODO: support .gltf
-    assert(data->file_type == cgltf_file_type_glb);
+    asset->first_material =
+        mt_material_table_alloc(engine->material_table, entries, material_count);
+    asset->material_slots = material_count;
 
-    // Load samplers
-    mt_array_add(alloc, asset->samplers, data->samplers_count);
-    for (uint32_t i = 0; i < data->samplers_count; i++)
+    mt_free(alloc, entries);
+}
+
+// Index of the primitive's material in the engine's material table
+static uint32_t material_index(MtGltfAsset *asset, GltfPrimitive *primitive)
+{
+    return asset->first_material + (uint32_t)(primitive->material - asset->materials);
+}
+
+static void upload_geometry(
+    MtGltfAsset *asset,
+    const char *path,
+    const MtStandardVertex *vertices,
+    uint32_t vertex_count,
+    const uint32_t *indices)
+{
+    MtEngine *engine = asset->asset_manager->engine;
+    MtDevice *dev = engine->device;
+
+    size_t vertex_buffer_size = vertex_count * sizeof(MtStandardVertex);
+    size_t index_buffer_size = asset->index_count * sizeof(uint32_t);
+
+    assert(vertex_buffer_size > 0);
+
+    if (mt_geometry_arena_alloc(
+            engine->geometry_arena, vertex_count, asset->index_count, &asset->geometry))
     {
-        cgltf_sampler *sampler = &data->samplers[i];
-        MtSamplerCreateInfo ci = {0};
-        ci.anisotropy = true;
-        switch (sampler->mag_filter)
-        {
-            case 0x2601: {
-                ci.mag_filter = MT_FILTER_LINEAR;
-            }
-            break;
-            case 0x2600: {
-                ci.mag_filter = MT_FILTER_NEAREST;
-            }
-            break;
-            default: break;
-        }
+        mt_geometry_arena_upload(engine->geometry_arena, &asset->geometry, vertices, indices);
+        return;
+    }
 
-        switch (sampler->min_filter)
-        {
-            case 0x2601: {
-                ci.min_filter = MT_FILTER_LINEAR;
-            }
-            break;
-            case 0x2600: {
-                ci.min_filter = MT_FILTER_NEAREST;
-            }
-            break;
-            default: break;
-        }
+    mt_log_warn("Geometry arena is full, \"%s\" gets its own buffers", path);
 
-        asset->samplers[i] = mt_render.create_sampler(engine->device, &ci);
+    asset->vertex_buffer = mt_render.create_buffer(
+        dev,
+        &(MtBufferCreateInfo){
+            .usage = MT_BUFFER_USAGE_VERTEX,
+            .memory = MT_BUFFER_MEMORY_DEVICE,
+            .size = vertex_buffer_size,
+        });
+
+    asset->index_buffer = mt_render.create_buffer(
+        dev,
+        &(MtBufferCreateInfo){
+            .usage = MT_BUFFER_USAGE_INDEX,
+            .memory = MT_BUFFER_MEMORY_DEVICE,
+            .size = index_buffer_size,
+        });
+
+    mt_render.transfer_to_buffer(dev, asset->vertex_buffer, 0, vertex_buffer_size, vertices);
+    mt_render.transfer_to_buffer(dev, asset->index_buffer, 0, index_buffer_size, indices);
+}
+
+// A cooked mesh next to the glTF file (tools/gltf_mesh.c) replaces the geometry in it,
+// as long as it is not older than the glTF file and refers to its materials
+static const MtMeshFileHeader *
+open_cooked_mesh(MtVfs *vfs, const char *path, cgltf_data *data, MtVfsFile *file)
+{
+    char cooked_path[1024];
+    int stem_length = (int)(mt_path_ext(path) - path);
+    snprintf(cooked_path, sizeof(cooked_path), "%.*s.mtmesh", stem_length, path);
+
+    MtVfsStat source_stat, cooked_stat;
+    if (!mt_vfs_stat(vfs, cooked_path, &cooked_stat)) return NULL;
+    if (mt_vfs_stat(vfs, path, &source_stat) && cooked_stat.mtime < source_stat.mtime)
+    {
+        mt_log_warn("Ignoring stale cooked mesh: %s", cooked_path);
+        return NULL;
     }
 
-    // Load images
-    mt_array_add(alloc, asset->images, data->images_count);
-    for (uint32_t i = 0; i < data->images_count; i++)
+    if (!mt_vfs_open(vfs, cooked_path, file)) return NULL;
+
+    const MtMeshFileHeader *header = mt_mesh_file_header(file->data, file->size);
+    bool valid = header && header->vertex_count > 0;
+    for (uint32_t i = 0; valid && i < header->primitive_count; i++)
     {
-        cgltf_image *image = &data->images[i];
+        uint32_t material_index = mt_mesh_file_primitives(header)[i].material_index;
+        valid = material_index == UINT32_MAX || material_index < data->materials_count;
+    }
 
-        if (strcmp(image->mime_type, "image/png") == 0 ||
-            strcmp(image->mime_type, "image/jpeg") == 0)
-        {
-            uint8_t *buffer_data =
-                ((uint8_t *)image->buffer_view->buffer->data) + image->buffer_view->offset;
-            size_t buffer_size = image->buffer_view->size;
+    if (!valid)
+    {
+        mt_log_warn("Ignoring invalid or outdated cooked mesh: %s", cooked_path);
+        mt_vfs_close(vfs, file);
+        return NULL;
+    }
 
-            int width, height, n_channels;
-            uint8_t *image_data = stbi_load_from_memory(
-                buffer_data, (int)buffer_size, &width, &height, &n_channels, 4);
-            assert(image_data);
+    return header;
+}
 
-            asset->images[i] = mt_render.create_image(
-                engine->device,
-                &(MtImageCreateInfo){
-                    .width = (uint32_t)width,
-                    .height = (uint32_t)height,
-                    .format = MT_FORMAT_RGBA8_UNORM,
-                });
+// Cooked meshes have their node transforms baked, so each becomes a root node
+static void load_cooked_nodes(MtGltfAsset *asset, const MtMeshFileHeader *header)
+{
+    MtAllocator *alloc = asset->asset_manager->alloc;
 
-            mt_render.transfer_to_image(
-                engine->device,
-                &(MtImageCopyView){.image = asset->images[i]},
-                (uint32_t)(4 * width * height),
-                image_data);
+    const MtMeshFileMesh *meshes = mt_mesh_file_meshes(header);
+    const MtMeshFilePrimitive *primitives = mt_mesh_file_primitives(header);
 
-            stbi_image_free(image_data);
-        }
-        else if (strcmp(image->mime_type, "image/ktx") == 0)
+    for (uint32_t i = 0; i < header->mesh_count; i++)
+    {
+        GltfNode *new_node = mt_alloc(alloc, sizeof(GltfNode));
+        memset(new_node, 0, sizeof(*new_node));
+
+        memcpy(&new_node->matrix, meshes[i].matrix, sizeof(Mat4));
+        new_node->translation = V3(0.0f, 0.0f, 0.0f);
+        new_node->rotation = (Quat){0.0f, 0.0f, 0.0f, 1.0f};
+        new_node->scale = V3(1.0f, 1.0f, 1.0f);
+
+        GltfMesh *new_mesh = mt_alloc(alloc, sizeof(GltfMesh));
+        memset(new_mesh, 0, sizeof(*new_mesh));
+        new_mesh->matrix = new_node->matrix;
+
+        for (uint32_t j = 0; j < meshes[i].primitive_count; j++)
         {
-            uint8_t *buffer_data =
-                ((uint8_t *)image->buffer_view->buffer->data) + image->buffer_view->offset;
-            size_t buffer_size = image->buffer_view->size;
+            const MtMeshFilePrimitive *primitive = &primitives[meshes[i].first_primitive + j];
 
-            ktx_data_t data = {0};
-            ktx_result_t result = ktx_read(buffer_data, buffer_size, &data);
-            if (result != KTX_SUCCESS)
+            GltfPrimitive new_primitive = {0};
+            new_primitive.first_index = primitive->first_index;
+            new_primitive.index_count = primitive->index_count;
+            new_primitive.vertex_count = primitive->vertex_count;
+            new_primitive.is_normal_mapped = primitive->normal_mapped != 0;
+            memcpy(&new_primitive.bounds.min, primitive->bounds_min, sizeof(float) * 3);
+            memcpy(&new_primitive.bounds.max, primitive->bounds_max, sizeof(float) * 3);
+            if (primitive->material_index != UINT32_MAX)
             {
-                return false;
+                new_primitive.material = &asset->materials[primitive->material_index];
             }
+            mt_array_push(alloc, new_mesh->primitives, new_primitive);
+            asset->primitive_count++;
+        }
 
-            uint32_t texel_width = data.pixel_width;
-            uint32_t texel_height = data.pixel_height;
+        new_node->mesh = new_mesh;
 
-            uint32_t block_size = 0;
-            MtFormat format;
-            switch (data.internal_format)
-            {
-                case KTX_RGBA8:
-                    format = MT_FORMAT_RGBA8_UNORM;
-                    block_size = sizeof(uint32_t);
-                    break;
-                case KTX_RGBA16F:
-                    format = MT_FORMAT_RGBA16_SFLOAT;
-                    block_size = 2 * sizeof(uint32_t);
-                    break;
-                case KTX_COMPRESSED_RGBA_BPTC_UNORM:
-                    format = MT_FORMAT_BC7_UNORM_BLOCK;
-                    block_size = 16;
-                    texel_width >>= 2;
-                    texel_height >>= 2;
-                    break;
-                case KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
-                    format = MT_FORMAT_BC7_SRGB_BLOCK;
-                    block_size = 16;
-                    texel_width >>= 2;
-                    texel_height >>= 2;
-                    break;
-                default: assert(!"Unsupported image format");
-            }
+        mt_array_push(alloc, asset->nodes, new_node);
+        mt_array_push(alloc, asset->linear_nodes, new_node);
+    }
+}
+
+static MtImage *
+load_ktx_image(MtEngine *engine, const uint8_t *ktx, size_t ktx_size, uint64_t *size)
+{
+    MtImage *result = NULL;
+
+    ktx_data_t data;
+    ktx_result_t ktx_result = ktx_read(ktx, ktx_size, &data);
+    if (ktx_result != KTX_SUCCESS)
+    {
+        return NULL;
+    }
+
+    MtFormat format;
+    switch (data.internal_format)
+    {
+        case KTX_RGBA8:
+            format = MT_FORMAT_RGBA8_UNORM;
+            break;
+        case KTX_RGBA16F:
+            format = MT_FORMAT_RGBA16_SFLOAT;
+            break;
+        case KTX_COMPRESSED_RGBA_BPTC_UNORM:
+            format = MT_FORMAT_BC7_UNORM_BLOCK;
+            break;
+        case KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+            format = MT_FORMAT_BC7_SRGB_BLOCK;
+            break;
+        default: assert(!"Unsupported image format");
+    }
 
-            asset->images[i] = mt_render.create_image(
-                engine->device,
-                &(MtImageCreateInfo){
-                    .width = data.pixel_width,
-                    .height = data.pixel_height,
-                    .depth = data.pixel_depth,
-                    .mip_count = data.mipmap_level_count,
-                    .layer_count = data.face_count,
-                    .format = format,
-                });
-
-            for (uint32_t li = 0; li < data.mipmap_level_count; li++)
+    result = mt_render.create_image(
+        engine->device,
+        &(MtImageCreateInfo){
+            .width = data.pixel_width,
+            .height = data.pixel_height,
+            .depth = data.pixel_depth,
+            .mip_count = data.mipmap_level_count,
+            .layer_count = data.face_count,
+            .format = format,
+        });
+
+    for (uint32_t li = 0; li < data.mipmap_level_count; li++)
+    {
+        for (uint32_t fi = 0; fi < data.face_count; fi++)
+        {
+            for (uint32_t si = 0; si < data.pixel_depth; si++)
             {
-                for (uint32_t fi = 0; fi < data.face_count; fi++)
-                {
-                    for (uint32_t si = 0; si < data.pixel_depth; si++)
-                    {
-                        uint32_t mip_width = texel_width >> li;
-                        uint32_t mip_height = texel_height >> li;
-
-                        ktx_slice_t *slice =
-                            &data.mip_levels[li].array_elements[0].faces[fi].slices[si];
-
-                        mt_render.transfer_to_image(
-                            engine->device,
-                            &(MtImageCopyView){
-                                .image = asset->images[i],
-                                .mip_level = li,
-                                .array_layer = fi,
-                                .offset = {.z = si},
-                            },
-                            mip_width * mip_height * block_size,
-                            slice->data);
-                    }
-                }
+                uint32_t slice_size = (uint32_t)ktx_get_slice_size(&data, li);
+
+                mt_render.transfer_to_image(
+                    engine->device,
+                    &(MtImageCopyView){
+                        .image = result,
+                        .mip_level = li,
+                        .array_layer = fi,
+                        .offset = {.z = si},
+                    },
+                    slice_size,
+                    ktx_get_slice(&data, li, 0, fi, si));
+
+                *size += slice_size;
             }
-
-            ktx_data_destroy(&data);
         }
-        else
+    }
+
+    ktx_data_destroy(&data);
+
+    return result;
+}
+
+static uint32_t full_mip_count(uint32_t width, uint32_t height)
+{
+    uint32_t mip_count = 1;
+    while ((MT_MAX(width, height) >> mip_count) > 0)
+    {
+        mip_count++;
+    }
+    return mip_count;
+}
+
+static MtImage *load_image(MtEngine *engine, cgltf_image *image, uint64_t *size)
+{
+    MtImage *result = NULL;
+
+    uint8_t *buffer_data =
+        ((uint8_t *)image->buffer_view->buffer->data) + image->buffer_view->offset;
+    size_t buffer_size = image->buffer_view->size;
+
+    if (strcmp(image->mime_type, "image/png") == 0 ||
+        strcmp(image->mime_type, "image/jpeg") == 0)
+    {
+        int width, height, n_channels;
+        uint8_t *image_data = stbi_load_from_memory(
+            buffer_data, (int)buffer_size, &width, &height, &n_channels, 4);
+        assert(image_data);
+
+        result = mt_render.create_image(
+            engine->device,
+            &(MtImageCreateInfo){
+                .width = (uint32_t)width,
+                .height = (uint32_t)height,
+                .mip_count = full_mip_count((uint32_t)width, (uint32_t)height),
+                .format = MT_FORMAT_RGBA8_UNORM,
+                .usage = MT_IMAGE_USAGE_SAMPLED_BIT | MT_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                         MT_IMAGE_USAGE_TRANSFER_DST_BIT,
+            });
+
+        mt_render.transfer_to_image(
+            engine->device,
+            &(MtImageCopyView){.image = result},
+            (uint32_t)(4 * width * height),
+            image_data);
+        mt_render.generate_mipmaps(engine->device, result);
+        *size = (uint64_t)(4 * width * height) * 4 / 3;
+
+        if (engine->image_cache)
         {
-            printf("%s\n", image->mime_type);
-            assert(0);
+            mt_image_cache_compress(
+                engine->image_cache,
+                mt_image_cache_key(buffer_data, buffer_size),
+                image_data,
+                (uint32_t)width,
+                (uint32_t)height);
         }
+
+        stbi_image_free(image_data);
+    }
+    else if (strcmp(image->mime_type, "image/ktx") == 0)
+    {
+        result = load_ktx_image(engine, buffer_data, buffer_size, size);
+    }
+    else
+    {
+        mt_log_error("Unsupported glTF image type: %s", image->mime_type);
     }
 
-    // Load materials
-    mt_array_add(alloc, asset->materials, data->materials_count);
+    return result;
+}
+
+typedef struct ImageLoad
+{
+    MtEngine *engine;
+    cgltf_image *image;
+    // The .glb file and its contents, embedded KTX images are streamed from it
+    const char *path;
+    const uint8_t *file_data;
+    MtImage **out_image;
+    MtStreamedTexture **out_streamed;
+    uint64_t size;
+} ImageLoad;
+
+static bool stream_image(
+    ImageLoad *load,
+    const char *path,
+    const uint8_t *file_data,
+    const uint8_t *ktx,
+    size_t ktx_size)
+{
+    if (!load->engine->texture_streamer) return false;
+
+    *load->out_streamed = mt_texture_streamer_add(
+        load->engine->texture_streamer,
+        load->out_image,
+        path,
+        (uint64_t)(ktx - file_data),
+        ktx,
+        ktx_size);
+    return *load->out_streamed != NULL;
+}
+
+// PNG/JPEG images compressed by an earlier run
+static bool load_cached_image(ImageLoad *load, const uint8_t *source, size_t source_size)
+{
+    MtImageCache *cache = load->engine->image_cache;
+    if (!cache) return false;
+
+    char path[1024];
+    MtFileMapping mapping;
+    if (!mt_image_cache_get(cache, mt_image_cache_key(source, source_size), path, sizeof(path)) ||
+        !mt_file_map(&mapping, path))
+    {
+        return false;
+    }
+
+    if (!stream_image(load, path, mapping.data, mapping.data, mapping.size))
+    {
+        *load->out_image = load_ktx_image(load->engine, mapping.data, mapping.size, &load->size);
+    }
+
+    mt_file_unmap(&mapping);
+    return *load->out_image != NULL;
+}
+
+static int32_t image_load_job(void *arg)
+{
+    ImageLoad *load = arg;
+    mt_render.set_thread_id(mt_thread_pool_get_task_id());
+
+    cgltf_image *image = load->image;
+    const uint8_t *buffer_data =
+        ((uint8_t *)image->buffer_view->buffer->data) + image->buffer_view->offset;
+    size_t buffer_size = image->buffer_view->size;
+
+    bool ktx = strcmp(image->mime_type, "image/ktx") == 0;
+    if (ktx && image->buffer_view->buffer->uri == NULL &&
+        stream_image(load, load->path, load->file_data, buffer_data, buffer_size))
+    {
+        return 0;
+    }
+    if (!ktx && load_cached_image(load, buffer_data, buffer_size))
+    {
+        return 0;
+    }
+
+    *load->out_image = load_image(load->engine, image, &load->size);
+    return 0;
+}
+
+static void load_materials(MtGltfAsset *asset, cgltf_data *data)
+{
+    MtEngine *engine = asset->asset_manager->engine;
+
     for (uint32_t i = 0; i < data->materials_count; i++)
     {
         cgltf_material *material = &data->materials[i];
@@ -355,7 +633,7 @@ static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const cha
         {
             uint32_t image_index =
                 material->pbr_metallic_roughness.base_color_texture.texture->image - data->images;
-            mat->albedo_image = asset->images[image_index];
+            mat->albedo_image = &asset->images[image_index];
 
             if (material->pbr_metallic_roughness.base_color_texture.texture->sampler)
             {
@@ -371,14 +649,14 @@ static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const cha
         }
         else
         {
-            mat->albedo_image = engine->white_image;
+            mat->albedo_image = &engine->white_image;
             mat->albedo_sampler = engine->default_sampler;
         }
 
         if (material->normal_texture.texture != NULL)
         {
             uint32_t image_index = material->normal_texture.texture->image - data->images;
-            mat->normal_image = asset->images[image_index];
+            mat->normal_image = &asset->images[image_index];
 
             if (material->normal_texture.texture->sampler)
             {
@@ -392,7 +670,7 @@ static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const cha
         }
         else
         {
-            mat->normal_image = engine->white_image;
+            mat->normal_image = &engine->white_image;
             mat->normal_sampler = engine->default_sampler;
         }
 
@@ -401,7 +679,7 @@ static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const cha
             uint32_t image_index =
                 material->pbr_metallic_roughness.metallic_roughness_texture.texture->image -
                 data->images;
-            mat->metallic_roughness_image = asset->images[image_index];
+            mat->metallic_roughness_image = &asset->images[image_index];
 
             if (material->pbr_metallic_roughness.metallic_roughness_texture.texture->sampler)
             {
@@ -417,14 +695,14 @@ static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const cha
         }
         else
         {
-            mat->metallic_roughness_image = engine->white_image;
+            mat->metallic_roughness_image = &engine->white_image;
             mat->metallic_roughness_sampler = engine->default_sampler;
         }
 
         if (material->occlusion_texture.texture != NULL)
         {
             uint32_t image_index = material->occlusion_texture.texture->image - data->images;
-            mat->occlusion_image = asset->images[image_index];
+            mat->occlusion_image = &asset->images[image_index];
 
             if (material->occlusion_texture.texture->sampler)
             {
@@ -439,14 +717,14 @@ static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const cha
         }
         else
         {
-            mat->occlusion_image = engine->white_image;
+            mat->occlusion_image = &engine->white_image;
             mat->occlusion_sampler = engine->default_sampler;
         }
 
         if (material->emissive_texture.texture != NULL)
         {
             uint32_t image_index = material->emissive_texture.texture->image - data->images;
-            mat->emissive_image = asset->images[image_index];
+            mat->emissive_image = &asset->images[image_index];
 
             if (material->emissive_texture.texture->sampler)
             {
@@ -461,74 +739,234 @@ static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const cha
         }
         else
         {
-            mat->emissive_image = engine->black_image;
+            mat->emissive_image = &engine->black_image;
             mat->emissive_sampler = engine->default_sampler;
         }
     }
+}
 
-    // Load nodes
-    MtStandardVertex *vertices = NULL;
-    uint32_t *indices = NULL;
-
-    cgltf_scene *scene = data->scene;
-    for (uint32_t i = 0; i < scene->nodes_count; i++)
-    {
-        cgltf_node *node = scene->nodes[i];
-        load_node(asset, NULL, node, data, &indices, &vertices);
-    }
-
-    for (uint32_t i = 0; i < mt_array_size(asset->linear_nodes); i++)
+// Sub-resources load as child tasks, waited on with mt_thread_pool_wait_group
+static void
+spawn(MtAssetManager *asset_manager, MtTaskGroup *group, MtThreadStart routine, void *arg)
+{
+    if (asset_manager->serial_loads)
     {
-        GltfNode *node = asset->linear_nodes[i];
-        if (node->mesh)
-        {
-            node_update(node);
-        }
+        routine(arg);
+        return;
     }
 
-    size_t vertex_buffer_size = mt_array_size(vertices) * sizeof(MtStandardVertex);
-    size_t index_buffer_size = mt_array_size(indices) * sizeof(uint32_t);
-    asset->index_count = (uint32_t)mt_array_size(indices);
-
-    assert(vertex_buffer_size > 0);
-
-    MtDevice *dev = engine->device;
-
-    asset->vertex_buffer = mt_render.create_buffer(
-        dev,
-        &(MtBufferCreateInfo){
-            .usage = MT_BUFFER_USAGE_VERTEX,
-            .memory = MT_BUFFER_MEMORY_DEVICE,
-            .size = vertex_buffer_size,
-        });
-
-    asset->index_buffer = mt_render.create_buffer(
-        dev,
-        &(MtBufferCreateInfo){
-            .usage = MT_BUFFER_USAGE_INDEX,
-            .memory = MT_BUFFER_MEMORY_DEVICE,
-            .size = index_buffer_size,
-        });
-
-    mt_render.transfer_to_buffer(dev, asset->vertex_buffer, 0, vertex_buffer_size, vertices);
-    mt_render.transfer_to_buffer(dev, asset->index_buffer, 0, index_buffer_size, indices);
-
-    mt_array_free(alloc, vertices);
-    mt_array_free(alloc, indices);
-
-    cgltf_free(data);
-    mt_free(alloc, gltf_data);
-
-    return true;
+    mt_thread_pool_enqueue_group(&asset_manager->engine->thread_pool, group, routine, arg);
 }
 
-static void asset_destroy(MtAsset *asset_)
+static void asset_destroy(MtAsset *asset_);
+
+static bool asset_init(
+    MtAssetManager *asset_manager, MtAsset *asset_, const char *path, const MtVfsFile *gltf_file)
 {
     MtGltfAsset *asset = (MtGltfAsset *)asset_;
-    if (!asset) return;
+    asset->asset_manager = asset_manager;
 
-    MtDevice *dev = asset->asset_manager->engine->device;
-    MtAllocator *alloc = asset->asset_manager->alloc;
+    MtEngine *engine = asset_manager->engine;
+    MtAllocator *alloc = asset_manager->alloc;
+
+    // The binary chunk is used in place, the asset manager closes the file after the load
+    cgltf_options gltf_options = {0};
+    cgltf_data *data = NULL;
+    cgltf_result result = cgltf_parse(&gltf_options, gltf_file->data, gltf_file->size, &data);
+    if (result != cgltf_result_success)
+    {
+        return false;
+    }
+
+    result = cgltf_load_buffers(&gltf_options, data, path);
+    if (result != cgltf_result_success)
+    {
+        cgltf_free(data);
+        return false;
+    }
+
+    // TODO: support .gltf
+    assert(data->file_type == cgltf_file_type_glb);
+
+    // Load samplers
+    mt_array_add(alloc, asset->samplers, data->samplers_count);
+    for (uint32_t i = 0; i < data->samplers_count; i++)
+    {
+        cgltf_sampler *sampler = &data->samplers[i];
+        MtSamplerCreateInfo ci = {0};
+        ci.anisotropy = true;
+        switch (sampler->mag_filter)
+        {
+            case 0x2601: {
+                ci.mag_filter = MT_FILTER_LINEAR;
+            }
+            break;
+            case 0x2600: {
+                ci.mag_filter = MT_FILTER_NEAREST;
+            }
+            break;
+            default: break;
+        }
+
+        switch (sampler->min_filter)
+        {
+            case 0x2601: {
+                ci.min_filter = MT_FILTER_LINEAR;
+            }
+            break;
+            case 0x2600: {
+                ci.min_filter = MT_FILTER_NEAREST;
+            }
+            break;
+            default: break;
+        }
+
+        asset->samplers[i] = mt_render.create_sampler(engine->device, &ci);
+    }
+
+    // Decode and upload images on the pool while the geometry is processed
+    MtTaskGroup image_group = {0};
+    /*array*/ ImageLoad *image_loads = NULL;
+    mt_array_add(alloc, image_loads, data->images_count);
+
+    mt_array_add_zeroed(alloc, asset->images, data->images_count);
+    mt_array_add_zeroed(alloc, asset->streamed_images, data->images_count);
+    for (uint32_t i = 0; i < data->images_count; i++)
+    {
+        image_loads[i] = (ImageLoad){
+            .engine = engine,
+            .image = &data->images[i],
+            .path = path,
+            .file_data = gltf_file->data,
+            .out_image = &asset->images[i],
+            .out_streamed = &asset->streamed_images[i],
+        };
+        spawn(asset_manager, &image_group, image_load_job, &image_loads[i]);
+    }
+
+    // Primitives point into the materials, which are filled in once the images are loaded
+    mt_array_add(alloc, asset->materials, data->materials_count);
+
+    // Load nodes, the geometry comes from a cooked mesh next to the file when there is one
+    MtTaskGroup geometry_group = {0};
+    /*array*/ PrimitiveLoad *primitive_loads = NULL;
+    MtStandardVertex *vertices = NULL;
+    uint32_t *indices = NULL;
+    uint32_t vertex_count = 0;
+
+    MtVfsFile cooked_file;
+    const MtMeshFileHeader *cooked = open_cooked_mesh(&engine->vfs, path, data, &cooked_file);
+    if (cooked)
+    {
+        load_cooked_nodes(asset, cooked);
+
+        vertices = (MtStandardVertex *)(cooked_file.data + cooked->vertex_offset);
+        indices = (uint32_t *)(cooked_file.data + cooked->index_offset);
+        vertex_count = cooked->vertex_count;
+        asset->index_count = cooked->index_count;
+    }
+    else
+    {
+        cgltf_scene *scene = data->scene;
+        for (uint32_t i = 0; i < scene->nodes_count; i++)
+        {
+            cgltf_node *node = scene->nodes[i];
+            load_node(
+                asset, NULL, node, data, &primitive_loads, &vertex_count, &asset->index_count);
+        }
+
+        vertices = mt_alloc(alloc, sizeof(MtStandardVertex) * vertex_count);
+        indices = mt_alloc(alloc, sizeof(uint32_t) * asset->index_count);
+        memset(vertices, 0, sizeof(MtStandardVertex) * vertex_count);
+
+        for (uint32_t i = 0; i < mt_array_size(primitive_loads); i++)
+        {
+            primitive_loads[i].vertices = vertices;
+            primitive_loads[i].indices = indices;
+            spawn(asset_manager, &geometry_group, primitive_load_job, &primitive_loads[i]);
+        }
+    }
+
+    mt_thread_pool_wait_group(&engine->thread_pool, &image_group);
+
+    bool images_loaded = true;
+    for (uint32_t i = 0; i < data->images_count; i++)
+    {
+        images_loaded &= asset->images[i] != NULL;
+        asset->asset.gpu_size += image_loads[i].size;
+    }
+
+    mt_array_free(alloc, image_loads);
+
+    if (images_loaded)
+    {
+        load_materials(asset, data);
+
+        if (engine->bindless)
+        {
+            init_bindless_materials(asset);
+        }
+    }
+
+    mt_thread_pool_wait_group(&engine->thread_pool, &geometry_group);
+
+    for (uint32_t i = 0; i < mt_array_size(primitive_loads); i++)
+    {
+        PrimitiveLoad *load = &primitive_loads[i];
+        load->mesh->primitives[load->primitive_index].bounds = load->bounds;
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(asset->linear_nodes); i++)
+    {
+        GltfNode *node = asset->linear_nodes[i];
+        if (node->mesh)
+        {
+            node_update(node);
+        }
+    }
+
+    if (images_loaded)
+    {
+        upload_geometry(asset, path, vertices, vertex_count, indices);
+    }
+
+    asset->asset.gpu_size += sizeof(MtStandardVertex) * vertex_count;
+    asset->asset.gpu_size += sizeof(uint32_t) * asset->index_count;
+    asset->asset.cpu_size += sizeof(GltfNode) * mt_array_size(asset->linear_nodes);
+    asset->asset.cpu_size += sizeof(GltfMaterial) * mt_array_size(asset->materials);
+
+    if (cooked)
+    {
+        mt_vfs_close(&engine->vfs, &cooked_file);
+    }
+    else
+    {
+        mt_free(alloc, vertices);
+        mt_free(alloc, indices);
+        mt_array_free(alloc, primitive_loads);
+    }
+
+    cgltf_free(data);
+
+    // The asset manager frees an asset that failed to load without destroying it,
+    // and the streamer must not keep pointers into it
+    if (!images_loaded)
+    {
+        asset_destroy(&asset->asset);
+    }
+
+    return images_loaded;
+}
+
+// Also destroys an asset that failed to load, everything it did not create is still zeroed
+static void asset_destroy(MtAsset *asset_)
+{
+    MtGltfAsset *asset = (MtGltfAsset *)asset_;
+    if (!asset) return;
+
+    MtEngine *engine = asset->asset_manager->engine;
+    MtDevice *dev = engine->device;
+    MtAllocator *alloc = asset->asset_manager->alloc;
 
     for (uint32_t i = 0; i < mt_array_size(asset->linear_nodes); i++)
     {
@@ -545,11 +983,38 @@ static void asset_destroy(MtAsset *asset_)
 
     mt_array_free(alloc, asset->materials);
 
+    // Its entries point into bindless_images
+    if (engine->material_table)
+    {
+        mt_material_table_free(
+            engine->material_table, asset->first_material, asset->material_slots);
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(asset->bindless_images); i++)
+    {
+        mt_render.unregister_bindless_image(dev, asset->bindless_images[i]);
+    }
+    mt_array_free(alloc, asset->bindless_images);
+
+    for (uint32_t i = 0; i < mt_array_size(asset->bindless_samplers); i++)
+    {
+        mt_render.unregister_bindless_sampler(dev, asset->bindless_samplers[i]);
+    }
+    mt_array_free(alloc, asset->bindless_samplers);
+
     for (uint32_t i = 0; i < mt_array_size(asset->images); i++)
     {
-        mt_render.destroy_image(dev, asset->images[i]);
+        if (asset->streamed_images[i])
+        {
+            mt_texture_streamer_remove(engine->texture_streamer, asset->streamed_images[i]);
+        }
+        else if (asset->images[i])
+        {
+            mt_render.destroy_image(dev, asset->images[i]);
+        }
     }
     mt_array_free(alloc, asset->images);
+    mt_array_free(alloc, asset->streamed_images);
 
     for (uint32_t i = 0; i < mt_array_size(asset->samplers); i++)
     {
@@ -557,17 +1022,179 @@ static void asset_destroy(MtAsset *asset_)
     }
     mt_array_free(alloc, asset->samplers);
 
-    mt_render.destroy_buffer(dev, asset->vertex_buffer);
-    mt_render.destroy_buffer(dev, asset->index_buffer);
+    if (asset->vertex_buffer)
+    {
+        mt_render.destroy_buffer(dev, asset->vertex_buffer);
+        mt_render.destroy_buffer(dev, asset->index_buffer);
+    }
+    else
+    {
+        mt_geometry_arena_free(asset->asset_manager->engine->geometry_arena, &asset->geometry);
+    }
 }
 
+static int32_t primitive_load_job(void *arg)
+{
+    PrimitiveLoad *load = arg;
+    cgltf_primitive *primitive = load->primitive;
+
+    uint8_t *buffer_pos = NULL;
+    uint32_t pos_byte_stride = 0;
+    uint32_t vertex_count = 0;
+
+    uint8_t *buffer_normals = NULL;
+    uint32_t normal_byte_stride = 0;
+
+    uint8_t *buffer_tangents = NULL;
+    uint32_t tangent_byte_stride = 0;
+
+    uint8_t *buffer_uv0 = NULL;
+    uint32_t uv0_byte_stride = 0;
+
+    for (uint32_t j = 0; j < primitive->attributes_count; j++)
+    {
+        cgltf_accessor *accessor = primitive->attributes[j].data;
+        cgltf_buffer_view *view = accessor->buffer_view;
+        uint8_t *data = &((uint8_t *)view->buffer->data)[accessor->offset + view->offset];
+
+        switch (primitive->attributes[j].type)
+        {
+            case cgltf_attribute_type_position:
+                buffer_pos = data;
+                pos_byte_stride = (uint32_t)accessor->stride;
+                vertex_count = (uint32_t)accessor->count;
+                break;
+            case cgltf_attribute_type_normal:
+                buffer_normals = data;
+                normal_byte_stride = (uint32_t)accessor->stride;
+                break;
+            case cgltf_attribute_type_tangent:
+                buffer_tangents = data;
+                tangent_byte_stride = (uint32_t)accessor->stride;
+                break;
+            case cgltf_attribute_type_texcoord:
+                buffer_uv0 = data;
+                uv0_byte_stride = (uint32_t)accessor->stride;
+                break;
+            default: break;
+        }
+    }
+
+    MtStandardVertex *vertices = &load->vertices[load->first_vertex];
+
+    MtAabb bounds = {0};
+    for (size_t v = 0; v < vertex_count; v++)
+    {
+        // Position
+        memcpy(&vertices[v].pos, &buffer_pos[v * pos_byte_stride], sizeof(vertices[v].pos));
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            float p = vertices[v].pos.v[k];
+            bounds.min.v[k] = (v == 0 || p < bounds.min.v[k]) ? p : bounds.min.v[k];
+            bounds.max.v[k] = (v == 0 || p > bounds.max.v[k]) ? p : bounds.max.v[k];
+        }
+    }
+    load->bounds = bounds;
+
+    if (buffer_normals)
+    {
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            // Normal
+            memcpy(
+                &vertices[v].normal,
+                &buffer_normals[v * normal_byte_stride],
+                sizeof(vertices[v].normal));
+        }
+    }
+
+    // Tangent
+    if (buffer_tangents)
+    {
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            memcpy(
+                &vertices[v].tangent,
+                &buffer_tangents[v * tangent_byte_stride],
+                sizeof(vertices[v].tangent));
+        }
+    }
+
+    // UV0
+    if (buffer_uv0)
+    {
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            memcpy(&vertices[v].uv0, &buffer_uv0[v * uv0_byte_stride], sizeof(vertices[v].uv0));
+        }
+    }
+
+    // Indices
+    uint32_t *indices = &load->indices[load->first_index];
+    uint32_t vertex_start = load->first_vertex;
+    if (primitive->indices)
+    {
+        cgltf_accessor *accessor = primitive->indices;
+        cgltf_buffer_view *buffer_view = accessor->buffer_view;
+        cgltf_buffer *buffer = buffer_view->buffer;
+
+        const void *data_ptr = &((uint8_t *)buffer->data)[accessor->offset + buffer_view->offset];
+
+        switch (accessor->component_type)
+        {
+            case cgltf_component_type_r_32u: {
+                const uint32_t *buf = data_ptr;
+                for (size_t index = 0; index < accessor->count; index++)
+                {
+                    indices[index] = buf[index] + vertex_start;
+                }
+            }
+            break;
+            case cgltf_component_type_r_16u: {
+                const uint16_t *buf = data_ptr;
+                for (size_t index = 0; index < accessor->count; index++)
+                {
+                    indices[index] = ((uint32_t)buf[index]) + vertex_start;
+                }
+            }
+            break;
+            case cgltf_component_type_r_8u: {
+                const uint8_t *buf = data_ptr;
+                for (size_t index = 0; index < accessor->count; index++)
+                {
+                    indices[index] = ((uint32_t)buf[index]) + vertex_start;
+                }
+            }
+            break;
+            default: {
+                assert(!"Invalid component type");
+            }
+            break;
+        }
+    }
+    else
+    {
+        // Index non-indexed primitives too so every primitive draws the same way
+        for (uint32_t index = 0; index < vertex_count; index++)
+        {
+            indices[index] = vertex_start + index;
+        }
+    }
+
+    return 0;
+}
+
+// Builds the node tree and reserves each primitive's vertex and index range,
+// the ranges are filled by primitive_load_job
 static void load_node(
     MtGltfAsset *asset,
     GltfNode *parent,
     cgltf_node *node,
     cgltf_data *model,
-    uint32_t **index_buffer,
-    MtStandardVertex **vertex_buffer)
+    /*array*/ PrimitiveLoad **primitive_loads,
+    uint32_t *vertex_count,
+    uint32_t *index_count)
 {
     MtAllocator *alloc = asset->asset_manager->alloc;
 
@@ -604,7 +1231,14 @@ static void load_node(
     {
         for (uint32_t i = 0; i < node->children_count; i++)
         {
-            load_node(asset, new_node, node->children[i], model, index_buffer, vertex_buffer);
+            load_node(
+                asset,
+                new_node,
+                node->children[i],
+                model,
+                primitive_loads,
+                vertex_count,
+                index_count);
         }
     }
 
@@ -620,185 +1254,47 @@ static void load_node(
         {
             cgltf_primitive *primitive = &mesh->primitives[i];
 
-            uint32_t index_start = (uint32_t)mt_array_size(*index_buffer);
-            uint32_t vertex_start = (uint32_t)mt_array_size(*vertex_buffer);
-
-            uint32_t index_count = 0;
-            uint32_t vertex_count = 0;
-
-            bool has_indices = primitive->indices != NULL;
-
-            // Vertices
-            cgltf_accessor *pos_accessor = NULL;
-            cgltf_buffer_view *pos_view = NULL;
-            uint32_t pos_byte_stride = 0;
-            uint8_t *buffer_pos = NULL;
-
-            cgltf_accessor *normal_accessor = NULL;
-            cgltf_buffer_view *normal_view = NULL;
-            uint32_t normal_byte_stride = 0;
-            uint8_t *buffer_normals = NULL;
-
-            cgltf_accessor *tangent_accessor = NULL;
-            cgltf_buffer_view *tangent_view = NULL;
-            uint32_t tangent_byte_stride = 0;
-            uint8_t *buffer_tangents = NULL;
-
-            cgltf_accessor *uv0_accessor = NULL;
-            cgltf_buffer_view *uv0_view = NULL;
-            uint32_t uv0_byte_stride = 0;
-            uint8_t *buffer_uv0 = NULL;
-
+            uint32_t primitive_vertex_count = 0;
+            bool has_normals = false;
+            bool has_tangents = false;
             for (uint32_t j = 0; j < primitive->attributes_count; j++)
             {
-                if (primitive->attributes[j].type == cgltf_attribute_type_position)
-                {
-                    pos_accessor = primitive->attributes[j].data;
-                    pos_view = pos_accessor->buffer_view;
-                    pos_byte_stride = pos_accessor->stride;
-                    buffer_pos = &(
-                        (uint8_t *)pos_view->buffer->data)[pos_accessor->offset + pos_view->offset];
-
-                    vertex_count = (uint32_t)pos_accessor->count;
-                }
-
-                if (primitive->attributes[j].type == cgltf_attribute_type_normal)
-                {
-                    normal_accessor = primitive->attributes[j].data;
-                    normal_view = normal_accessor->buffer_view;
-                    normal_byte_stride = normal_accessor->stride;
-                    buffer_normals = &((uint8_t *)normal_view->buffer
-                                           ->data)[normal_accessor->offset + normal_view->offset];
-                }
-
-                if (primitive->attributes[j].type == cgltf_attribute_type_tangent)
+                switch (primitive->attributes[j].type)
                 {
-                    tangent_accessor = primitive->attributes[j].data;
-                    tangent_view = tangent_accessor->buffer_view;
-                    tangent_byte_stride = tangent_accessor->stride;
-                    buffer_tangents =
-                        &((uint8_t *)tangent_view->buffer
-                              ->data)[tangent_accessor->offset + tangent_view->offset];
-                }
-
-                if (primitive->attributes[j].type == cgltf_attribute_type_texcoord)
-                {
-                    uv0_accessor = primitive->attributes[j].data;
-                    uv0_view = uv0_accessor->buffer_view;
-                    uv0_byte_stride = uv0_accessor->stride;
-                    buffer_uv0 = &(
-                        (uint8_t *)uv0_view->buffer->data)[uv0_accessor->offset + uv0_view->offset];
-                }
-            }
-
-            uint32_t first_vertex = mt_array_size(*vertex_buffer);
-            mt_array_add(alloc, *vertex_buffer, vertex_count);
-            MtStandardVertex *vertices = &(*vertex_buffer)[first_vertex];
-
-            for (size_t v = 0; v < vertex_count; v++)
-            {
-                // Position
-                memcpy(&vertices[v].pos, &buffer_pos[v * pos_byte_stride], sizeof(vertices[v].pos));
-            }
-
-            if (buffer_normals)
-            {
-                for (size_t v = 0; v < vertex_count; v++)
-                {
-                    // Normal
-                    memcpy(
-                        &vertices[v].normal,
-                        &buffer_normals[v * normal_byte_stride],
-                        sizeof(vertices[v].normal));
-                }
-            }
-
-            // Tangent
-            if (buffer_tangents)
-            {
-                for (size_t v = 0; v < vertex_count; v++)
-                {
-                    memcpy(
-                        &vertices[v].tangent,
-                        &buffer_tangents[v * tangent_byte_stride],
-                        sizeof(vertices[v].tangent));
-                }
-            }
-
-            // UV0
-            if (buffer_uv0)
-            {
-                for (size_t v = 0; v < vertex_count; v++)
-                {
-                    memcpy(
-                        &vertices[v].uv0,
-                        &buffer_uv0[v * uv0_byte_stride],
-                        sizeof(vertices[v].uv0));
-                }
-            }
-
-            // Indices
-            if (has_indices)
-            {
-                cgltf_accessor *accessor = primitive->indices;
-                cgltf_buffer_view *buffer_view = accessor->buffer_view;
-                cgltf_buffer *buffer = buffer_view->buffer;
-
-                index_count = (uint32_t)accessor->count;
-                const void *data_ptr =
-                    &((uint8_t *)buffer->data)[accessor->offset + buffer_view->offset];
-
-                uint32_t first_index = mt_array_size(*index_buffer);
-                mt_array_add(alloc, *index_buffer, accessor->count);
-
-                switch (accessor->component_type)
-                {
-                    case cgltf_component_type_r_32u: {
-                        const uint32_t *buf = data_ptr;
-                        for (size_t index = 0; index < accessor->count; index++)
-                        {
-                            (*index_buffer)[first_index] = buf[index] + vertex_start;
-                            ++first_index;
-                        }
-                    }
-                    break;
-                    case cgltf_component_type_r_16u: {
-                        const uint16_t *buf = data_ptr;
-                        for (size_t index = 0; index < accessor->count; index++)
-                        {
-                            (*index_buffer)[first_index] = ((uint32_t)buf[index]) + vertex_start;
-                            ++first_index;
-                        }
-                    }
-                    break;
-                    case cgltf_component_type_r_8u: {
-                        const uint8_t *buf = data_ptr;
-                        for (size_t index = 0; index < accessor->count; index++)
-                        {
-                            (*index_buffer)[first_index] = ((uint32_t)buf[index]) + vertex_start;
-                            ++first_index;
-                        }
-                    }
-                    break;
-                    default: {
-                        assert(!"Invalid component type");
-                    }
-                    break;
+                    case cgltf_attribute_type_position:
+                        primitive_vertex_count = (uint32_t)primitive->attributes[j].data->count;
+                        break;
+                    case cgltf_attribute_type_normal: has_normals = true; break;
+                    case cgltf_attribute_type_tangent: has_tangents = true; break;
+                    default: break;
                 }
             }
 
             GltfPrimitive new_primitive = {0};
-            new_primitive.first_index = index_start;
-            new_primitive.index_count = index_count;
-            new_primitive.vertex_count = vertex_count;
-            new_primitive.is_normal_mapped = buffer_normals != NULL && buffer_tangents != NULL;
+            new_primitive.first_index = *index_count;
+            new_primitive.index_count = primitive->indices ? (uint32_t)primitive->indices->count
+                                                           : primitive_vertex_count;
+            new_primitive.vertex_count = primitive_vertex_count;
+            new_primitive.is_normal_mapped = has_normals && has_tangents;
             if (primitive->material)
             {
                 new_primitive.material = &asset->materials[primitive->material - model->materials];
             }
-            new_primitive.has_indices = (index_count > 0);
+
+            PrimitiveLoad load = {
+                .primitive = primitive,
+                .mesh = new_mesh,
+                .primitive_index = (uint32_t)mt_array_size(new_mesh->primitives),
+                .first_vertex = *vertex_count,
+                .first_index = *index_count,
+            };
+            mt_array_push(alloc, *primitive_loads, load);
+
+            *vertex_count += new_primitive.vertex_count;
+            *index_count += new_primitive.index_count;
 
             mt_array_push(alloc, new_mesh->primitives, new_primitive);
+            asset->primitive_count++;
         }
 
         new_node->mesh = new_mesh;
@@ -816,8 +1312,40 @@ static void load_node(
     mt_array_push(alloc, asset->linear_nodes, new_node);
 }
 
+static void bind_geometry(MtGltfAsset *asset, MtCmdBuffer *cb)
+{
+    if (asset->vertex_buffer)
+    {
+        mt_render.cmd_bind_vertex_buffer(cb, asset->vertex_buffer, 0);
+        mt_render.cmd_bind_index_buffer(cb, asset->index_buffer, MT_INDEX_TYPE_UINT32, 0);
+    }
+    else
+    {
+        mt_geometry_arena_bind(asset->asset_manager->engine->geometry_arena, cb);
+    }
+}
+
+static void bind_material(MtCmdBuffer *cb, GltfPrimitive *primitive, uint32_t material_set)
+{
+    GltfMaterial *material = primitive->material;
+    material->uniform.normal_mapped = primitive->is_normal_mapped ? 1.0f : 0.0f;
+
+    mt_render.cmd_bind_uniform(cb, &material->uniform, sizeof(material->uniform), material_set, 0);
+    mt_render.cmd_bind_sampler(cb, material->albedo_sampler, material_set, 1);
+    mt_render.cmd_bind_image(cb, *material->albedo_image, material_set, 2);
+    mt_render.cmd_bind_image(cb, *material->normal_image, material_set, 3);
+    mt_render.cmd_bind_image(cb, *material->metallic_roughness_image, material_set, 4);
+    mt_render.cmd_bind_image(cb, *material->occlusion_image, material_set, 5);
+    mt_render.cmd_bind_image(cb, *material->emissive_image, material_set, 6);
+}
+
 static void node_draw(
-    GltfNode *node, MtCmdBuffer *cb, Mat4 *transform, uint32_t model_set, uint32_t material_set)
+    MtGltfAsset *asset,
+    GltfNode *node,
+    MtCmdBuffer *cb,
+    Mat4 *transform,
+    uint32_t model_set,
+    uint32_t material_set)
 {
     if (node->mesh)
     {
@@ -830,53 +1358,283 @@ static void node_draw(
 
             if (material_set != UINT32_MAX)
             {
-                primitive->material->uniform.normal_mapped =
-                    primitive->is_normal_mapped ? 1.0f : 0.0f;
-                mt_render.cmd_bind_uniform(
-                    cb,
-                    &primitive->material->uniform,
-                    sizeof(primitive->material->uniform),
-                    material_set,
-                    0);
-                mt_render.cmd_bind_sampler(
-                    cb, primitive->material->albedo_sampler, material_set, 1);
-                mt_render.cmd_bind_image(cb, primitive->material->albedo_image, material_set, 2);
-                mt_render.cmd_bind_image(cb, primitive->material->normal_image, material_set, 3);
-                mt_render.cmd_bind_image(
-                    cb, primitive->material->metallic_roughness_image, material_set, 4);
-                mt_render.cmd_bind_image(cb, primitive->material->occlusion_image, material_set, 5);
-                mt_render.cmd_bind_image(cb, primitive->material->emissive_image, material_set, 6);
+                bind_material(cb, primitive, material_set);
             }
 
-            if (primitive->has_indices)
-            {
-                mt_render.cmd_draw_indexed(
-                    cb, primitive->index_count, 1, primitive->first_index, 0, 0);
-            }
-            else
-            {
-                mt_render.cmd_draw(cb, primitive->vertex_count, 1, 0, 0);
-            }
+            mt_render.cmd_draw_indexed(
+                cb,
+                primitive->index_count,
+                1,
+                asset->geometry.first_index + primitive->first_index,
+                (int32_t)asset->geometry.first_vertex,
+                0);
         }
     }
     for (GltfNode **child = node->children; child != node->children + mt_array_size(node->children);
          ++child)
     {
-        node_draw(*child, cb, transform, model_set, material_set);
+        node_draw(asset, *child, cb, transform, model_set, material_set);
     }
 }
 
 void mt_gltf_asset_draw(
     MtGltfAsset *asset, MtCmdBuffer *cb, Mat4 *transform, uint32_t model_set, uint32_t material_set)
 {
-    mt_render.cmd_bind_vertex_buffer(cb, asset->vertex_buffer, 0);
-    mt_render.cmd_bind_index_buffer(cb, asset->index_buffer, MT_INDEX_TYPE_UINT32, 0);
+    bind_geometry(asset, cb);
     for (GltfNode **node = asset->nodes; node != asset->nodes + mt_array_size(asset->nodes); ++node)
     {
-        node_draw(*node, cb, transform, model_set, material_set);
+        node_draw(asset, *node, cb, transform, model_set, material_set);
+    }
+}
+
+uint32_t mt_gltf_asset_draw_bindless(
+    MtGltfAsset *asset,
+    MtCmdBuffer *cb,
+    const Mat4 *transform,
+    uint32_t first_instance,
+    MtGltfDrawData *draws)
+{
+    bind_geometry(asset, cb);
+
+    uint32_t draw = 0;
+    for (uint32_t i = 0; i < mt_array_size(asset->linear_nodes); i++)
+    {
+        GltfMesh *mesh = asset->linear_nodes[i]->mesh;
+        if (!mesh) continue;
+
+        for (uint32_t j = 0; j < mt_array_size(mesh->primitives); j++)
+        {
+            GltfPrimitive *primitive = &mesh->primitives[j];
+
+            draws[draw] = (MtGltfDrawData){
+                .model = mat4_mul(mesh->matrix, *transform),
+                .material_index = material_index(asset, primitive),
+                .normal_mapped = primitive->is_normal_mapped ? 1.0f : 0.0f,
+            };
+
+            mt_render.cmd_draw_indexed(
+                cb,
+                primitive->index_count,
+                1,
+                asset->geometry.first_index + primitive->first_index,
+                (int32_t)asset->geometry.first_vertex,
+                first_instance + draw);
+
+            draw++;
+        }
+    }
+
+    return draw;
+}
+
+bool mt_gltf_asset_in_geometry_arena(MtGltfAsset *asset)
+{
+    return asset->vertex_buffer == NULL;
+}
+
+uint32_t mt_gltf_asset_draw_count(MtGltfAsset *asset)
+{
+    return asset->primitive_count;
+}
+
+static void request_image_mips(MtGltfAsset *asset, MtImage **image, float pixel_size)
+{
+    // Default images belong to the engine
+    uintptr_t offset = (uintptr_t)image - (uintptr_t)asset->images;
+    uint32_t index = (uint32_t)(offset / sizeof(*image));
+    if (offset >= sizeof(*image) * mt_array_size(asset->images)) return;
+
+    if (asset->streamed_images[index])
+    {
+        mt_texture_streamer_request(
+            asset->asset_manager->engine->texture_streamer,
+            asset->streamed_images[index],
+            pixel_size);
     }
 }
 
+void mt_gltf_asset_request_mips(
+    MtGltfAsset *asset,
+    const Mat4 *transform,
+    const MtCameraUniform *camera,
+    float viewport_height)
+{
+    if (!asset->asset_manager->engine->texture_streamer) return;
+
+    // Pixels covered by one world unit at a distance of one
+    float pixels_per_unit = fabsf(camera->proj.cols[1][1]) * 0.5f * viewport_height;
+    Vec3 eye = camera->pos.xyz;
+
+    for (uint32_t i = 0; i < mt_array_size(asset->linear_nodes); i++)
+    {
+        GltfMesh *mesh = asset->linear_nodes[i]->mesh;
+        if (!mesh) continue;
+
+        Mat4 model = mat4_mul(mesh->matrix, *transform);
+
+        for (uint32_t j = 0; j < mt_array_size(mesh->primitives); j++)
+        {
+            GltfPrimitive *primitive = &mesh->primitives[j];
+            GltfMaterial *material = primitive->material;
+            if (!material) continue;
+
+            MtAabb box = mt_aabb_transform(&primitive->bounds, &model);
+            Vec3 center = v3_muls(v3_add(box.min, box.max), 0.5f);
+            float size = v3_distance(box.min, box.max);
+            float distance = MT_MAX(v3_distance(center, eye) - size * 0.5f, 0.01f);
+            float pixel_size = size * pixels_per_unit / distance;
+
+            request_image_mips(asset, material->albedo_image, pixel_size);
+            request_image_mips(asset, material->normal_image, pixel_size);
+            request_image_mips(asset, material->metallic_roughness_image, pixel_size);
+            request_image_mips(asset, material->occlusion_image, pixel_size);
+            request_image_mips(asset, material->emissive_image, pixel_size);
+        }
+    }
+}
+
+void mt_gltf_asset_write_bounds(
+    MtGltfAsset *asset, const Mat4 *transforms, uint32_t instance_count, MtAabb *boxes)
+{
+    uint32_t draw = 0;
+    for (uint32_t i = 0; i < mt_array_size(asset->linear_nodes); i++)
+    {
+        GltfMesh *mesh = asset->linear_nodes[i]->mesh;
+        if (!mesh) continue;
+
+        for (uint32_t j = 0; j < mt_array_size(mesh->primitives); j++)
+        {
+            GltfPrimitive *primitive = &mesh->primitives[j];
+
+            MtAabb *instances = &boxes[draw * instance_count];
+            for (uint32_t k = 0; k < instance_count; k++)
+            {
+                Mat4 model = mat4_mul(mesh->matrix, transforms[k]);
+                instances[k] = mt_aabb_transform(&primitive->bounds, &model);
+            }
+
+            draw++;
+        }
+    }
+}
+
+uint32_t mt_gltf_asset_write_draws(
+    MtGltfAsset *asset,
+    const Mat4 *transforms,
+    uint32_t instance_count,
+    uint32_t first_instance,
+    const uint8_t *visible,
+    MtDrawIndexedIndirectCommand *commands,
+    MtGltfDrawData *draws)
+{
+    assert(mt_gltf_asset_in_geometry_arena(asset));
+
+    uint32_t draw = 0;
+    uint32_t command_count = 0;
+    for (uint32_t i = 0; i < mt_array_size(asset->linear_nodes); i++)
+    {
+        GltfMesh *mesh = asset->linear_nodes[i]->mesh;
+        if (!mesh) continue;
+
+        for (uint32_t j = 0; j < mt_array_size(mesh->primitives); j++)
+        {
+            GltfPrimitive *primitive = &mesh->primitives[j];
+
+            MtGltfDrawData *instances = &draws[draw * instance_count];
+            uint32_t visible_count = 0;
+            for (uint32_t k = 0; k < instance_count; k++)
+            {
+                if (visible && !visible[draw * instance_count + k]) continue;
+
+                instances[visible_count++] = (MtGltfDrawData){
+                    .model = mat4_mul(mesh->matrix, transforms[k]),
+                    .material_index = material_index(asset, primitive),
+                    .normal_mapped = primitive->is_normal_mapped ? 1.0f : 0.0f,
+                };
+            }
+
+            if (visible_count > 0)
+            {
+                commands[command_count++] = (MtDrawIndexedIndirectCommand){
+                    .index_count = primitive->index_count,
+                    .instance_count = visible_count,
+                    .first_index = asset->geometry.first_index + primitive->first_index,
+                    .vertex_offset = (int32_t)asset->geometry.first_vertex,
+                    .first_instance = first_instance + draw * instance_count,
+                };
+            }
+
+            draw++;
+        }
+    }
+
+    assert(draw == asset->primitive_count);
+
+    // Without draw indirect count, all primitive_count commands get drawn
+    memset(
+        &commands[command_count],
+        0,
+        sizeof(MtDrawIndexedIndirectCommand) * (asset->primitive_count - command_count));
+
+    return command_count;
+}
+
+uint32_t mt_gltf_asset_draw_instanced(
+    MtGltfAsset *asset,
+    MtCmdBuffer *cb,
+    const Mat4 *transforms,
+    uint32_t instance_count,
+    uint32_t first_instance,
+    const uint8_t *visible,
+    MtGltfDrawData *draws,
+    uint32_t material_set)
+{
+    bind_geometry(asset, cb);
+
+    uint32_t draw = 0;
+    uint32_t draw_call_count = 0;
+    for (uint32_t i = 0; i < mt_array_size(asset->linear_nodes); i++)
+    {
+        GltfMesh *mesh = asset->linear_nodes[i]->mesh;
+        if (!mesh) continue;
+
+        for (uint32_t j = 0; j < mt_array_size(mesh->primitives); j++)
+        {
+            GltfPrimitive *primitive = &mesh->primitives[j];
+
+            MtGltfDrawData *instances = &draws[draw * instance_count];
+            uint32_t visible_count = 0;
+            for (uint32_t k = 0; k < instance_count; k++)
+            {
+                if (visible && !visible[draw * instance_count + k]) continue;
+
+                instances[visible_count++] = (MtGltfDrawData){
+                    .model = mat4_mul(mesh->matrix, transforms[k]),
+                };
+            }
+
+            if (visible_count > 0)
+            {
+                bind_material(cb, primitive, material_set);
+
+                mt_render.cmd_draw_indexed(
+                    cb,
+                    primitive->index_count,
+                    visible_count,
+                    asset->geometry.first_index + primitive->first_index,
+                    (int32_t)asset->geometry.first_vertex,
+                    first_instance + draw * instance_count);
+
+                draw_call_count++;
+            }
+
+            draw++;
+        }
+    }
+
+    return draw_call_count;
+}
+
 static const char *g_extensions[] = {
     ".gltf",
     ".glb",
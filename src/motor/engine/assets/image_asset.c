@@ -5,38 +5,167 @@
 
 #include <motor/base/api_types.h>
 #include <motor/base/filesystem.h>
+#include <motor/base/vfs.h>
 #include <motor/base/allocator.h>
 #include <motor/graphics/renderer.h>
 #include <motor/engine/engine.h>
 #include <motor/engine/asset_manager.h>
+#include <motor/engine/image_cache.h>
 
 #include "../stb_image.h"
 #include "../tinyktx.h"
 
-static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const char *path)
+static uint32_t full_mip_count(uint32_t width, uint32_t height)
+{
+    uint32_t mip_count = 1;
+    while ((MT_MAX(width, height) >> mip_count) > 0)
+    {
+        mip_count++;
+    }
+    return mip_count;
+}
+
+static bool init_from_ktx(MtImageAsset *asset, const MtVfsFile *file)
+{
+    MtAssetManager *asset_manager = asset->asset_manager;
+
+    ktx_data_t data;
+    ktx_result_t result = ktx_read(file->data, file->size, &data);
+    if (result != KTX_SUCCESS)
+    {
+        return false;
+    }
+
+    MtFormat format;
+    switch (data.internal_format)
+    {
+        case KTX_RGBA8:
+            format = MT_FORMAT_RGBA8_UNORM;
+            break;
+        case KTX_RGBA16F:
+            format = MT_FORMAT_RGBA16_SFLOAT;
+            break;
+        case KTX_COMPRESSED_RGBA_BPTC_UNORM:
+            format = MT_FORMAT_BC7_UNORM_BLOCK;
+            break;
+        case KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+            format = MT_FORMAT_BC7_SRGB_BLOCK;
+            break;
+        default: assert(!"Unsupported image format");
+    }
+
+    asset->image = mt_render.create_image(
+        asset_manager->engine->device,
+        &(MtImageCreateInfo){
+            .width = data.pixel_width,
+            .height = data.pixel_height,
+            .depth = data.pixel_depth,
+            .mip_count = data.mipmap_level_count,
+            .layer_count = data.face_count,
+            .format = format,
+        });
+
+    for (uint32_t li = 0; li < data.mipmap_level_count; li++)
+    {
+        for (uint32_t fi = 0; fi < data.face_count; fi++)
+        {
+            for (uint32_t si = 0; si < data.pixel_depth; si++)
+            {
+                uint32_t slice_size = (uint32_t)ktx_get_slice_size(&data, li);
+
+                mt_render.transfer_to_image(
+                    asset_manager->engine->device,
+                    &(MtImageCopyView){.image = asset->image,
+                                       .mip_level = li,
+                                       .array_layer = fi,
+                                       .offset = {.z = si}},
+                    slice_size,
+                    ktx_get_slice(&data, li, 0, fi, si));
+
+                asset->asset.gpu_size += slice_size;
+            }
+        }
+    }
+
+    ktx_data_destroy(&data);
+
+    return true;
+}
+
+static bool init_from_cache(MtImageAsset *asset, const char *cached_path)
+{
+    MtVfs *vfs = &asset->asset_manager->engine->vfs;
+
+    MtVfsFile file;
+    if (!mt_vfs_open(vfs, cached_path, &file))
+    {
+        return false;
+    }
+
+    bool result = init_from_ktx(asset, &file);
+    mt_vfs_close(vfs, &file);
+
+    return result;
+}
+
+static bool asset_init(
+    MtAssetManager *asset_manager, MtAsset *asset_, const char *path, const MtVfsFile *file)
 {
     MtImageAsset *asset = (MtImageAsset *)asset_;
     asset->asset_manager = asset_manager;
 
+    MtEngine *engine = asset_manager->engine;
+
     const char *ext = mt_path_ext(path);
     if (strcmp(ext, ".png") == 0 || strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0)
     {
+        uint64_t key = 0;
+        if (engine->image_cache)
+        {
+            key = mt_image_cache_key(file->data, file->size);
+
+            char cached_path[1024];
+            if (mt_image_cache_get(engine->image_cache, key, cached_path, sizeof(cached_path)) &&
+                init_from_cache(asset, cached_path))
+            {
+                return true;
+            }
+        }
+
         int32_t w, h, num_channels;
-        uint8_t *image_data = stbi_load(path, &w, &h, &num_channels, 4);
+        uint8_t *image_data =
+            stbi_load_from_memory(file->data, (int)file->size, &w, &h, &num_channels, 4);
+        if (!image_data)
+        {
+            return false;
+        }
 
         asset->image = mt_render.create_image(
-            asset_manager->engine->device,
+            engine->device,
             &(MtImageCreateInfo){
                 .width = (uint32_t)w,
                 .height = (uint32_t)h,
+                .mip_count = full_mip_count((uint32_t)w, (uint32_t)h),
                 .format = MT_FORMAT_RGBA8_UNORM,
+                .usage = MT_IMAGE_USAGE_SAMPLED_BIT | MT_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                         MT_IMAGE_USAGE_TRANSFER_DST_BIT,
             });
 
         mt_render.transfer_to_image(
-            asset_manager->engine->device,
+            engine->device,
             &(MtImageCopyView){.image = asset->image},
-            (uint32_t)(num_channels * w * h),
+            (uint32_t)(4 * w * h),
             image_data);
+        mt_render.generate_mipmaps(engine->device, asset->image);
+
+        // The mip chain adds a third
+        asset->asset.gpu_size = (uint64_t)(4 * w * h) * 4 / 3;
+
+        if (engine->image_cache)
+        {
+            mt_image_cache_compress(
+                engine->image_cache, key, image_data, (uint32_t)w, (uint32_t)h);
+        }
 
         free(image_data);
 
@@ -45,83 +174,7 @@ static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const cha
 
     if (strcmp(ext, ".ktx") == 0)
     {
-        ktx_data_t data = {0};
-        uint8_t *raw_data = NULL;
-        ktx_result_t result = ktx_read_from_file(path, &raw_data, &data);
-        if (result != KTX_SUCCESS)
-        {
-            return false;
-        }
-
-        uint32_t texel_width = data.pixel_width;
-        uint32_t texel_height = data.pixel_height;
-
-        uint32_t block_size = 0;
-        MtFormat format;
-        switch (data.internal_format)
-        {
-            case KTX_RGBA8:
-                format = MT_FORMAT_RGBA8_UNORM;
-                block_size = sizeof(uint32_t);
-                break;
-            case KTX_RGBA16F:
-                format = MT_FORMAT_RGBA16_SFLOAT;
-                block_size = 2 * sizeof(uint32_t);
-                break;
-            case KTX_COMPRESSED_RGBA_BPTC_UNORM:
-                format = MT_FORMAT_BC7_UNORM_BLOCK;
-                block_size = 16;
-                texel_width >>= 2;
-                texel_height >>= 2;
-                break;
-            case KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
-                format = MT_FORMAT_BC7_SRGB_BLOCK;
-                block_size = 16;
-                texel_width >>= 2;
-                texel_height >>= 2;
-                break;
-            default: assert(!"Unsupported image format");
-        }
-
-        asset->image = mt_render.create_image(
-            asset_manager->engine->device,
-            &(MtImageCreateInfo){
-                .width = data.pixel_width,
-                .height = data.pixel_height,
-                .depth = data.pixel_depth,
-                .mip_count = data.mipmap_level_count,
-                .layer_count = data.face_count,
-                .format = format,
-            });
-
-        for (uint32_t li = 0; li < data.mipmap_level_count; li++)
-        {
-            for (uint32_t fi = 0; fi < data.face_count; fi++)
-            {
-                for (uint32_t si = 0; si < data.pixel_depth; si++)
-                {
-                    uint32_t mip_width = texel_width >> li;
-                    uint32_t mip_height = texel_height >> li;
-
-                    ktx_slice_t *slice =
-                        &data.mip_levels[li].array_elements[0].faces[fi].slices[si];
-
-                    mt_render.transfer_to_image(
-                        asset_manager->engine->device,
-                        &(MtImageCopyView){.image = asset->image,
-                                           .mip_level = li,
-                                           .array_layer = fi,
-                                           .offset = {.z = si}},
-                        mip_width * mip_height * block_size,
-                        slice->data);
-                }
-            }
-        }
-
-        free(raw_data);
-        ktx_data_destroy(&data);
-
-        return true;
+        return init_from_ktx(asset, file);
     }
 
     return false;
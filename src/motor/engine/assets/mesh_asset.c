@@ -0,0 +1,173 @@
+#include <motor/engine/assets/mesh_asset.h>
+
+#include <motor/base/api_types.h>
+#include <motor/base/array.h>
+#include <motor/base/allocator.h>
+#include <motor/base/filesystem.h>
+#include <motor/base/vfs.h>
+#include <motor/base/math.h>
+#include <motor/base/log.h>
+#include <motor/graphics/renderer.h>
+#include <motor/engine/asset_manager.h>
+#include <motor/engine/engine.h>
+#include <motor/engine/geometry_arena.h>
+#include <motor/engine/mesh_format.h>
+#include <string.h>
+
+struct MtMeshAsset
+{
+    MtAsset asset;
+    MtAssetManager *asset_manager;
+
+    /*array*/ MtMeshFileMesh *meshes;
+    /*array*/ MtMeshFilePrimitive *primitives;
+
+    // Same ownership as glTF geometry: in the arena unless it was full
+    MtGeometryAllocation geometry;
+    MtBuffer *vertex_buffer;
+    MtBuffer *index_buffer;
+};
+
+static bool asset_init(
+    MtAssetManager *asset_manager, MtAsset *asset_, const char *path, const MtVfsFile *file)
+{
+    MtMeshAsset *asset = (MtMeshAsset *)asset_;
+    asset->asset_manager = asset_manager;
+
+    MtEngine *engine = asset_manager->engine;
+    MtAllocator *alloc = asset_manager->alloc;
+    MtDevice *dev = engine->device;
+
+    const MtMeshFileHeader *header = mt_mesh_file_header(file->data, file->size);
+    if (!header || header->vertex_count == 0)
+    {
+        mt_log_error("Invalid or outdated cooked mesh: %s", path);
+        return false;
+    }
+
+    mt_array_add(alloc, asset->meshes, header->mesh_count);
+    memcpy(asset->meshes, mt_mesh_file_meshes(header), sizeof(MtMeshFileMesh) * header->mesh_count);
+
+    mt_array_add(alloc, asset->primitives, header->primitive_count);
+    memcpy(
+        asset->primitives,
+        mt_mesh_file_primitives(header),
+        sizeof(MtMeshFilePrimitive) * header->primitive_count);
+
+    // The blobs are already in GPU layout, they are copied from the file to staging as is
+    const MtStandardVertex *vertices =
+        (const MtStandardVertex *)(file->data + header->vertex_offset);
+    const uint32_t *indices = (const uint32_t *)(file->data + header->index_offset);
+    size_t vertex_buffer_size = sizeof(MtStandardVertex) * header->vertex_count;
+    size_t index_buffer_size = sizeof(uint32_t) * header->index_count;
+
+    asset->asset.cpu_size = sizeof(MtMeshFileMesh) * header->mesh_count +
+                            sizeof(MtMeshFilePrimitive) * header->primitive_count;
+    asset->asset.gpu_size = vertex_buffer_size + index_buffer_size;
+
+    if (mt_geometry_arena_alloc(
+            engine->geometry_arena, header->vertex_count, header->index_count, &asset->geometry))
+    {
+        mt_geometry_arena_upload(engine->geometry_arena, &asset->geometry, vertices, indices);
+        return true;
+    }
+
+    mt_log_warn("Geometry arena is full, \"%s\" gets its own buffers", path);
+
+    asset->vertex_buffer = mt_render.create_buffer(
+        dev,
+        &(MtBufferCreateInfo){
+            .usage = MT_BUFFER_USAGE_VERTEX,
+            .memory = MT_BUFFER_MEMORY_DEVICE,
+            .size = vertex_buffer_size,
+        });
+
+    asset->index_buffer = mt_render.create_buffer(
+        dev,
+        &(MtBufferCreateInfo){
+            .usage = MT_BUFFER_USAGE_INDEX,
+            .memory = MT_BUFFER_MEMORY_DEVICE,
+            .size = index_buffer_size,
+        });
+
+    mt_render.transfer_to_buffer(dev, asset->vertex_buffer, 0, vertex_buffer_size, vertices);
+    mt_render.transfer_to_buffer(dev, asset->index_buffer, 0, index_buffer_size, indices);
+
+    return true;
+}
+
+static void asset_destroy(MtAsset *asset_)
+{
+    MtMeshAsset *asset = (MtMeshAsset *)asset_;
+    if (!asset) return;
+
+    MtEngine *engine = asset->asset_manager->engine;
+    MtAllocator *alloc = asset->asset_manager->alloc;
+
+    mt_array_free(alloc, asset->meshes);
+    mt_array_free(alloc, asset->primitives);
+
+    if (asset->vertex_buffer)
+    {
+        mt_render.destroy_buffer(engine->device, asset->vertex_buffer);
+        mt_render.destroy_buffer(engine->device, asset->index_buffer);
+    }
+    else
+    {
+        mt_geometry_arena_free(engine->geometry_arena, &asset->geometry);
+    }
+}
+
+void mt_mesh_asset_draw(MtMeshAsset *asset, MtCmdBuffer *cb, Mat4 *transform, uint32_t model_set)
+{
+    if (asset->vertex_buffer)
+    {
+        mt_render.cmd_bind_vertex_buffer(cb, asset->vertex_buffer, 0);
+        mt_render.cmd_bind_index_buffer(cb, asset->index_buffer, MT_INDEX_TYPE_UINT32, 0);
+    }
+    else
+    {
+        mt_geometry_arena_bind(asset->asset_manager->engine->geometry_arena, cb);
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(asset->meshes); i++)
+    {
+        MtMeshFileMesh *mesh = &asset->meshes[i];
+
+        Mat4 matrix;
+        memcpy(&matrix, mesh->matrix, sizeof(matrix));
+        Mat4 model = mat4_mul(matrix, *transform);
+        mt_render.cmd_bind_uniform(cb, &model, sizeof(model), model_set, 0);
+
+        for (uint32_t j = 0; j < mesh->primitive_count; j++)
+        {
+            MtMeshFilePrimitive *primitive = &asset->primitives[mesh->first_primitive + j];
+            mt_render.cmd_draw_indexed(
+                cb,
+                primitive->index_count,
+                1,
+                asset->geometry.first_index + primitive->first_index,
+                (int32_t)asset->geometry.first_vertex,
+                0);
+        }
+    }
+}
+
+uint32_t mt_mesh_asset_draw_count(MtMeshAsset *asset)
+{
+    return (uint32_t)mt_array_size(asset->primitives);
+}
+
+static const char *g_extensions[] = {
+    ".mtmesh",
+};
+
+static MtAssetVT g_asset_vt = {
+    .name = "Cooked mesh",
+    .extensions = g_extensions,
+    .extension_count = MT_LENGTH(g_extensions),
+    .size = sizeof(MtMeshAsset),
+    .init = asset_init,
+    .destroy = asset_destroy,
+};
+MtAssetVT *mt_mesh_asset_vt = &g_asset_vt;
@@ -4,6 +4,7 @@
 #include <motor/base/allocator.h>
 #include <motor/base/array.h>
 #include <motor/base/math_types.h>
+#include <motor/base/vfs.h>
 #include <motor/graphics/renderer.h>
 #include <motor/engine/asset_manager.h>
 #include <motor/engine/engine.h>
@@ -21,29 +22,15 @@ static void asset_destroy(MtAsset *asset_)
     mt_render.destroy_pipeline(asset->asset_manager->engine->device, asset->pipeline);
 }
 
-static bool asset_init(MtAssetManager *asset_manager, MtAsset *asset_, const char *path)
+static bool asset_init(
+    MtAssetManager *asset_manager, MtAsset *asset_, const char *path, const MtVfsFile *file)
 {
     MtPipelineAsset *asset = (MtPipelineAsset *)asset_;
     asset->asset_manager = asset_manager;
 
-    // Read file
-    FILE *f = fopen(path, "rb");
-    if (!f)
-    {
-        printf("Failed to open file: %s\n", path);
-        return false;
-    }
-
-    fseek(f, 0, SEEK_END);
-    size_t input_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    char *input = mt_alloc(asset_manager->alloc, input_size);
-    fread(input, input_size, 1, f);
-    fclose(f);
-
-    asset->pipeline = create_pipeline(asset_manager->engine, path, input, input_size);
+    MtEngine *engine = asset_manager->engine;
 
-    mt_free(asset_manager->alloc, input);
+    asset->pipeline = create_pipeline(engine, path, (const char *)file->data, file->size);
 
     if (!asset->pipeline)
     {
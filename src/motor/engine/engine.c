@@ -3,20 +3,33 @@
 #include <motor/base/log.h>
 #include <motor/base/arena.h>
 #include <motor/base/allocator.h>
+#include <motor/base/async_io.h>
 #include <motor/graphics/window.h>
 #include <motor/graphics/renderer.h>
 #include <motor/graphics/vulkan/vulkan_device.h>
 #include <motor/graphics/vulkan/glfw_window.h>
+#include <motor/graphics/vulkan/headless_window.h>
 #include <motor/engine/file_watcher.h>
 #include <motor/engine/physics.h>
 #include <motor/engine/picker.h>
 #include <motor/engine/asset_manager.h>
 #include <motor/engine/imgui_impl.h>
 #include <motor/engine/meshes.h>
+#include <motor/engine/geometry_arena.h>
+#include <motor/engine/texture_streamer.h>
+#include <motor/engine/material_table.h>
+#include <motor/engine/image_cache.h>
+#include <motor/engine/gpu_culling.h>
+#include <motor/engine/shader_cache.h>
 #include <shaderc/shaderc.h>
 #include <string.h>
 #include <stdio.h>
 
+#define ASSETS_DIR "../assets"
+#define SHADERS_DIR "../shaders"
+// Built by tools/pack_builder.c from the directories above
+#define PACK_PATH "motor.mtpack"
+
 void asset_watcher_handler(MtFileWatcherEvent *e, void *user_data)
 {
     MtEngine *engine = (MtEngine *)user_data;
@@ -24,16 +37,24 @@ void asset_watcher_handler(MtFileWatcherEvent *e, void *user_data)
     switch (e->type)
     {
         case MT_FILE_WATCHER_EVENT_MODIFY: {
-            mt_asset_manager_load(engine->asset_manager, e->src);
+            // Assets are loaded by their path in the VFS
+            const char *prefix = ASSETS_DIR "/";
+            if (strncmp(e->src, prefix, strlen(prefix)) != 0) break;
+
+            char path[1024];
+            snprintf(path, sizeof(path), "assets/%s", e->src + strlen(prefix));
+            mt_asset_manager_load(engine->asset_manager, path);
             break;
         }
         default: break;
     }
 }
 
-void mt_engine_init(MtEngine *engine)
+void mt_engine_init(MtEngine *engine, MtEngineFlags flags)
 {
+    MtAllocator *alloc = engine->alloc;
     memset(engine, 0, sizeof(*engine));
+    engine->alloc = alloc;
 #if 0
     engine->alloc = mt_alloc(NULL, sizeof(MtAllocator));
     mt_arena_init(engine->alloc, 1 << 16);
@@ -45,18 +66,51 @@ void mt_engine_init(MtEngine *engine)
 
     mt_log_debug("Using %u threads", num_threads);
 
-    mt_glfw_vulkan_window_system_init();
+    mt_thread_pool_init(&engine->thread_pool, num_threads, engine->alloc);
+    engine->async_io = mt_async_io_create(engine->alloc, &engine->thread_pool);
+
+    // A pack replaces the directories, files missing from it are still read from them
+    mt_vfs_init(&engine->vfs, engine->alloc);
+    mt_vfs_mount_dir(&engine->vfs, "assets", ASSETS_DIR);
+    mt_vfs_mount_dir(&engine->vfs, "shaders", SHADERS_DIR);
+    if (mt_vfs_mount_pack(&engine->vfs, "", PACK_PATH))
+    {
+        mt_log_info("Loading assets from %s", PACK_PATH);
+    }
+
+    MtVulkanDeviceFlags device_flags = 0;
+    if (flags & MT_ENGINE_BINDLESS)
+    {
+        device_flags |= MT_DEVICE_BINDLESS;
+    }
+
+    if (flags & MT_ENGINE_HEADLESS)
+    {
+        mt_headless_vulkan_window_system_init();
+        device_flags |= MT_DEVICE_HEADLESS;
+    }
+    else
+    {
+        mt_glfw_vulkan_window_system_init();
+    }
 
     engine->device = mt_vulkan_device_init(
         &(MtVulkanDeviceCreateInfo){
+            .flags = device_flags,
             .num_threads = num_threads,
+            .pipeline_cache_path = "pipeline_cache.bin",
+            .pipeline_manifest_path = "pipeline_manifest.bin",
+            .thread_pool = &engine->thread_pool,
         },
         engine->alloc);
 
+    engine->bindless = mt_render.device_bindless_enabled(engine->device);
+
     engine->window = mt_window.create(1280, 720, "Motor", engine->alloc);
     engine->swapchain = mt_render.create_swapchain(engine->device, engine->window, engine->alloc);
 
     engine->compiler = shaderc_compiler_initialize();
+    engine->shader_cache = mt_shader_cache_create(engine->alloc, &engine->vfs, "shader_cache");
 
     {
         engine->white_image = mt_render.create_image(
@@ -115,12 +169,31 @@ void mt_engine_init(MtEngine *engine)
             .border_color = MT_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
         });
 
+    if (engine->bindless)
+    {
+        engine->white_image_index =
+            mt_render.register_bindless_image(engine->device, engine->white_image);
+        engine->black_image_index =
+            mt_render.register_bindless_image(engine->device, engine->black_image);
+        engine->default_sampler_index =
+            mt_render.register_bindless_sampler(engine->device, engine->default_sampler);
+    }
+
     mt_mesh_init_sphere(&engine->sphere_mesh, engine);
 
-    mt_thread_pool_init(&engine->thread_pool, num_threads, engine->alloc);
+    engine->geometry_arena = mt_geometry_arena_create(engine, 1 << 20, 1 << 22);
+    engine->texture_streamer = mt_texture_streamer_create(engine);
+    if (engine->bindless)
+    {
+        engine->material_table = mt_material_table_create(engine);
+    }
+    if (flags & MT_ENGINE_COMPRESS_IMAGES)
+    {
+        engine->image_cache = mt_image_cache_create(engine, "image_cache");
+    }
 
     engine->watcher = mt_file_watcher_create(
-        engine->alloc, MT_FILE_WATCHER_EVENT_MODIFY, asset_watcher_handler, "../assets");
+        engine->alloc, MT_FILE_WATCHER_EVENT_MODIFY, asset_watcher_handler, ASSETS_DIR);
 
     engine->physics = mt_physics_create(engine->alloc);
     engine->picker = mt_picker_create(engine);
@@ -130,24 +203,36 @@ void mt_engine_init(MtEngine *engine)
 
     MtAssetManager *am = engine->asset_manager;
     mt_asset_manager_queue_load(
-        am, "../assets/default_cube.glb", (MtAsset **)&engine->default_cube);
-    mt_asset_manager_queue_load(am, "../shaders/pbr.hlsl", (MtAsset **)&engine->pbr_pipeline);
-    mt_asset_manager_queue_load(am, "../shaders/gizmo.hlsl", (MtAsset **)&engine->gizmo_pipeline);
+        am, "assets/default_cube.glb", (MtAsset **)&engine->default_cube);
+    mt_asset_manager_queue_load(am, "shaders/pbr.hlsl", (MtAsset **)&engine->pbr_pipeline);
     mt_asset_manager_queue_load(
-        am, "../shaders/wireframe.hlsl", (MtAsset **)&engine->wireframe_pipeline);
-    mt_asset_manager_queue_load(am, "../shaders/skybox.hlsl", (MtAsset **)&engine->skybox_pipeline);
-    mt_asset_manager_queue_load(am, "../shaders/brdf.hlsl", (MtAsset **)&engine->brdf_pipeline);
+        am, "shaders/pbr_instanced.hlsl", (MtAsset **)&engine->pbr_instanced_pipeline);
+    if (engine->bindless)
+    {
+        mt_asset_manager_queue_load(
+            am, "shaders/pbr_bindless.hlsl", (MtAsset **)&engine->pbr_bindless_pipeline);
+        mt_asset_manager_queue_load(
+            am, "shaders/pbr_indirect.hlsl", (MtAsset **)&engine->pbr_indirect_pipeline);
+        mt_asset_manager_queue_load(am, "shaders/hiz.hlsl", (MtAsset **)&engine->hiz_pipeline);
+        mt_asset_manager_queue_load(
+            am, "shaders/gpu_cull.hlsl", (MtAsset **)&engine->gpu_cull_pipeline);
+    }
+    mt_asset_manager_queue_load(am, "shaders/gizmo.hlsl", (MtAsset **)&engine->gizmo_pipeline);
     mt_asset_manager_queue_load(
-        am, "../shaders/irradiance_cube.hlsl", (MtAsset **)&engine->irradiance_pipeline);
+        am, "shaders/wireframe.hlsl", (MtAsset **)&engine->wireframe_pipeline);
+    mt_asset_manager_queue_load(am, "shaders/skybox.hlsl", (MtAsset **)&engine->skybox_pipeline);
+    mt_asset_manager_queue_load(am, "shaders/brdf.hlsl", (MtAsset **)&engine->brdf_pipeline);
     mt_asset_manager_queue_load(
-        am, "../shaders/prefilter_env_map.hlsl", (MtAsset **)&engine->prefilter_env_pipeline);
-    mt_asset_manager_queue_load(am, "../shaders/imgui.hlsl", (MtAsset **)&engine->imgui_pipeline);
+        am, "shaders/irradiance_cube.hlsl", (MtAsset **)&engine->irradiance_pipeline);
     mt_asset_manager_queue_load(
-        am, "../shaders/picking.hlsl", (MtAsset **)&engine->picking_pipeline);
+        am, "shaders/prefilter_env_map.hlsl", (MtAsset **)&engine->prefilter_env_pipeline);
+    mt_asset_manager_queue_load(am, "shaders/imgui.hlsl", (MtAsset **)&engine->imgui_pipeline);
     mt_asset_manager_queue_load(
-        am, "../shaders/picking_transfer.hlsl", (MtAsset **)&engine->picking_transfer_pipeline);
+        am, "shaders/picking.hlsl", (MtAsset **)&engine->picking_pipeline);
+    mt_asset_manager_queue_load(
+        am, "shaders/picking_transfer.hlsl", (MtAsset **)&engine->picking_transfer_pipeline);
 
-    mt_thread_pool_wait_all(&engine->thread_pool);
+    mt_asset_manager_wait(am);
 
     engine->imgui_ctx = mt_imgui_create(engine);
 }
@@ -162,9 +247,24 @@ void mt_engine_destroy(MtEngine *engine)
     mt_picker_destroy(engine->picker);
     mt_physics_destroy(engine->physics);
 
+    // Queued loads still use the asset manager
+    mt_thread_pool_wait_all(&engine->thread_pool);
+
     mt_asset_manager_destroy(engine->asset_manager);
     mt_free(engine->alloc, engine->asset_manager);
 
+    mt_geometry_arena_destroy(engine->geometry_arena);
+    mt_texture_streamer_destroy(engine->texture_streamer);
+    if (engine->material_table)
+    {
+        mt_material_table_destroy(engine->material_table);
+    }
+    if (engine->image_cache)
+    {
+        mt_image_cache_destroy(engine->image_cache);
+    }
+
+    mt_async_io_destroy(engine->async_io);
     mt_thread_pool_destroy(&engine->thread_pool);
 
     mt_file_watcher_destroy(engine->watcher);
@@ -177,6 +277,7 @@ void mt_engine_destroy(MtEngine *engine)
     mt_render.destroy_sampler(engine->device, engine->default_sampler);
 
     shaderc_compiler_release(engine->compiler);
+    mt_shader_cache_destroy(engine->shader_cache);
 
     mt_render.destroy_swapchain(engine->swapchain);
     mt_window.destroy(engine->window);
@@ -184,6 +285,8 @@ void mt_engine_destroy(MtEngine *engine)
     mt_render.destroy_device(engine->device);
     mt_window.destroy_window_system();
 
+    mt_vfs_destroy(&engine->vfs);
+
 #if 0
     mt_arena_destroy(engine->alloc);
 #endif
@@ -216,6 +319,14 @@ void mt_engine_update(MtEngine *engine)
     MtScene *scene = engine->current_scene.inst;
 
     mt_file_watcher_poll(engine->watcher, engine);
+
+    // Nothing is recording yet, so reloads can be published and unused assets unloaded
+    mt_asset_manager_update(engine->asset_manager);
+    if (scene) mt_asset_manager_update(scene->asset_manager);
+    mt_texture_streamer_update(engine->texture_streamer);
+    mt_geometry_arena_update(engine->geometry_arena);
+    // After the streamer, which moves images to new bindless indices
+    if (engine->material_table) mt_material_table_update(engine->material_table);
     mt_window.poll_events();
 
     MtEvent event;
@@ -235,6 +346,7 @@ void mt_engine_update(MtEngine *engine)
             if (event.type == MT_EVENT_FRAMEBUFFER_RESIZED)
             {
                 mt_render.graph_on_resize(scene->graph);
+                if (scene->gpu_culler) mt_gpu_culler_on_resize(scene->gpu_culler);
             }
 
             engine->current_scene.vt->on_event(scene, &event);
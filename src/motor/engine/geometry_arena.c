@@ -0,0 +1,260 @@
+#include <motor/engine/geometry_arena.h>
+
+#include <motor/base/array.h>
+#include <motor/base/allocator.h>
+#include <motor/base/threads.h>
+#include <motor/graphics/renderer.h>
+#include <motor/engine/engine.h>
+#include <assert.h>
+#include <string.h>
+
+typedef struct FreeRange
+{
+    uint32_t offset;
+    uint32_t count;
+} FreeRange;
+
+// Allocation freed while frames recorded before it may still draw from it
+typedef struct RetiredRange
+{
+    MtGeometryAllocation allocation;
+    uint64_t frame;
+} RetiredRange;
+
+struct MtGeometryArena
+{
+    MtEngine *engine;
+    MtMutex mutex;
+
+    MtBuffer *vertex_buffer;
+    MtBuffer *index_buffer;
+
+    // Sorted by offset, adjacent ranges are always merged
+    /*array*/ FreeRange *free_vertices;
+    /*array*/ FreeRange *free_indices;
+
+    // In the order of their frames
+    /*array*/ RetiredRange *retired;
+    uint64_t frame;
+};
+
+static bool range_alloc(FreeRange *ranges, uint32_t count, uint32_t *offset)
+{
+    for (uint32_t i = 0; i < mt_array_size(ranges); i++)
+    {
+        FreeRange *range = &ranges[i];
+        if (range->count < count) continue;
+
+        *offset = range->offset;
+        range->offset += count;
+        range->count -= count;
+
+        if (range->count == 0)
+        {
+            memmove(
+                &ranges[i], &ranges[i + 1], sizeof(FreeRange) * (mt_array_size(ranges) - i - 1));
+            mt_array_set_size(ranges, mt_array_size(ranges) - 1);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+static void range_free(MtAllocator *alloc, FreeRange **ranges, uint32_t offset, uint32_t count)
+{
+    uint32_t size = (uint32_t)mt_array_size(*ranges);
+
+    uint32_t i = 0;
+    while (i < size && (*ranges)[i].offset < offset)
+    {
+        i++;
+    }
+
+    bool merge_prev = i > 0 && (*ranges)[i - 1].offset + (*ranges)[i - 1].count == offset;
+    bool merge_next = i < size && offset + count == (*ranges)[i].offset;
+
+    if (merge_prev && merge_next)
+    {
+        (*ranges)[i - 1].count += count + (*ranges)[i].count;
+        memmove(&(*ranges)[i], &(*ranges)[i + 1], sizeof(FreeRange) * (size - i - 1));
+        mt_array_set_size(*ranges, size - 1);
+    }
+    else if (merge_prev)
+    {
+        (*ranges)[i - 1].count += count;
+    }
+    else if (merge_next)
+    {
+        (*ranges)[i].offset = offset;
+        (*ranges)[i].count += count;
+    }
+    else
+    {
+        mt_array_add(alloc, *ranges, 1);
+        memmove(&(*ranges)[i + 1], &(*ranges)[i], sizeof(FreeRange) * (size - i));
+        (*ranges)[i] = (FreeRange){.offset = offset, .count = count};
+    }
+}
+
+MtGeometryArena *
+mt_geometry_arena_create(MtEngine *engine, uint32_t vertex_capacity, uint32_t index_capacity)
+{
+    MtGeometryArena *arena = mt_alloc(engine->alloc, sizeof(*arena));
+    memset(arena, 0, sizeof(*arena));
+
+    arena->engine = engine;
+    mt_mutex_init(&arena->mutex);
+
+    arena->vertex_buffer = mt_render.create_buffer(
+        engine->device,
+        &(MtBufferCreateInfo){
+            .usage = MT_BUFFER_USAGE_VERTEX,
+            .memory = MT_BUFFER_MEMORY_DEVICE,
+            .size = (size_t)vertex_capacity * sizeof(MtStandardVertex),
+        });
+
+    arena->index_buffer = mt_render.create_buffer(
+        engine->device,
+        &(MtBufferCreateInfo){
+            .usage = MT_BUFFER_USAGE_INDEX,
+            .memory = MT_BUFFER_MEMORY_DEVICE,
+            .size = (size_t)index_capacity * sizeof(uint32_t),
+        });
+
+    mt_array_push(
+        engine->alloc, arena->free_vertices, ((FreeRange){.offset = 0, .count = vertex_capacity}));
+    mt_array_push(
+        engine->alloc, arena->free_indices, ((FreeRange){.offset = 0, .count = index_capacity}));
+
+    return arena;
+}
+
+void mt_geometry_arena_destroy(MtGeometryArena *arena)
+{
+    MtEngine *engine = arena->engine;
+
+    mt_render.destroy_buffer(engine->device, arena->vertex_buffer);
+    mt_render.destroy_buffer(engine->device, arena->index_buffer);
+
+    mt_array_free(engine->alloc, arena->free_vertices);
+    mt_array_free(engine->alloc, arena->free_indices);
+    mt_array_free(engine->alloc, arena->retired);
+
+    mt_mutex_destroy(&arena->mutex);
+
+    mt_free(engine->alloc, arena);
+}
+
+bool mt_geometry_arena_alloc(
+    MtGeometryArena *arena,
+    uint32_t vertex_count,
+    uint32_t index_count,
+    MtGeometryAllocation *allocation)
+{
+    assert(vertex_count > 0);
+    memset(allocation, 0, sizeof(*allocation));
+
+    mt_mutex_lock(&arena->mutex);
+
+    uint32_t first_vertex = 0;
+    if (!range_alloc(arena->free_vertices, vertex_count, &first_vertex))
+    {
+        mt_mutex_unlock(&arena->mutex);
+        return false;
+    }
+
+    uint32_t first_index = 0;
+    if (index_count > 0 && !range_alloc(arena->free_indices, index_count, &first_index))
+    {
+        range_free(arena->engine->alloc, &arena->free_vertices, first_vertex, vertex_count);
+        mt_mutex_unlock(&arena->mutex);
+        return false;
+    }
+
+    mt_mutex_unlock(&arena->mutex);
+
+    allocation->first_vertex = first_vertex;
+    allocation->vertex_count = vertex_count;
+    allocation->first_index = first_index;
+    allocation->index_count = index_count;
+
+    return true;
+}
+
+void mt_geometry_arena_free(MtGeometryArena *arena, MtGeometryAllocation *allocation)
+{
+    if (allocation->vertex_count == 0) return;
+
+    mt_mutex_lock(&arena->mutex);
+
+    RetiredRange retired = {*allocation, arena->frame};
+    mt_array_push(arena->engine->alloc, arena->retired, retired);
+
+    mt_mutex_unlock(&arena->mutex);
+
+    memset(allocation, 0, sizeof(*allocation));
+}
+
+void mt_geometry_arena_update(MtGeometryArena *arena)
+{
+    mt_mutex_lock(&arena->mutex);
+
+    uint64_t frame = arena->frame++;
+    MtAllocator *alloc = arena->engine->alloc;
+
+    uint32_t done = 0;
+    while (done < mt_array_size(arena->retired) &&
+           arena->retired[done].frame + MT_MAX_FRAMES_IN_FLIGHT < frame)
+    {
+        MtGeometryAllocation *allocation = &arena->retired[done++].allocation;
+        range_free(
+            alloc, &arena->free_vertices, allocation->first_vertex, allocation->vertex_count);
+        if (allocation->index_count > 0)
+        {
+            range_free(
+                alloc, &arena->free_indices, allocation->first_index, allocation->index_count);
+        }
+    }
+
+    if (done > 0)
+    {
+        uint32_t left = (uint32_t)mt_array_size(arena->retired) - done;
+        memmove(arena->retired, arena->retired + done, sizeof(*arena->retired) * left);
+        mt_array_set_size(arena->retired, left);
+    }
+
+    mt_mutex_unlock(&arena->mutex);
+}
+
+void mt_geometry_arena_upload(
+    MtGeometryArena *arena,
+    const MtGeometryAllocation *allocation,
+    const MtStandardVertex *vertices,
+    const uint32_t *indices)
+{
+    MtDevice *dev = arena->engine->device;
+
+    mt_render.transfer_to_buffer(
+        dev,
+        arena->vertex_buffer,
+        (size_t)allocation->first_vertex * sizeof(MtStandardVertex),
+        (size_t)allocation->vertex_count * sizeof(MtStandardVertex),
+        vertices);
+
+    if (allocation->index_count > 0)
+    {
+        mt_render.transfer_to_buffer(
+            dev,
+            arena->index_buffer,
+            (size_t)allocation->first_index * sizeof(uint32_t),
+            (size_t)allocation->index_count * sizeof(uint32_t),
+            indices);
+    }
+}
+
+void mt_geometry_arena_bind(MtGeometryArena *arena, MtCmdBuffer *cb)
+{
+    mt_render.cmd_bind_vertex_buffer(cb, arena->vertex_buffer, 0);
+    mt_render.cmd_bind_index_buffer(cb, arena->index_buffer, MT_INDEX_TYPE_UINT32, 0);
+}
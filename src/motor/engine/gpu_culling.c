@@ -0,0 +1,327 @@
+#include <motor/engine/gpu_culling.h>
+
+#include <motor/base/log.h>
+#include <motor/base/math.h>
+#include <motor/base/allocator.h>
+#include <motor/base/frustum.h>
+#include <motor/graphics/renderer.h>
+#include <motor/graphics/window.h>
+#include <motor/engine/engine.h>
+#include <motor/engine/camera.h>
+#include <motor/engine/assets/pipeline_asset.h>
+#include <assert.h>
+#include <string.h>
+
+#define MAX_ITEMS 65536
+#define MAX_BUCKETS 4096
+
+// Must match shaders/hiz_common.hlsl
+#define HIZ_LEVELS 5
+#define HIZ_BASE_TEXEL 4
+// Occlusion culling is skipped for larger depth images
+#define HIZ_MAX_DEPTH_SIZE 4096
+
+typedef struct CullParams
+{
+    Vec4 frustum[6];
+    Mat4 prev_view_proj;
+    uint32_t depth_size[2];
+    uint32_t item_count;
+    uint32_t occlusion;
+    uint32_t compact;
+    uint32_t pad[3];
+} CullParams;
+
+struct MtGpuCuller
+{
+    MtEngine *engine;
+    MtRenderGraph *graph;
+    const char *depth_image;
+
+    // The depth image holds a frame drawn with prev_view_proj
+    bool depth_valid;
+    MtImage *prev_depth;
+    Mat4 prev_view_proj;
+
+    bool compact;
+    bool has_draws;
+
+    MtGpuCullBucket *buckets;
+    uint32_t bucket_count;
+    uint32_t bucket_capacity;
+
+    uint8_t *draw_data;
+    size_t draw_data_size;
+    size_t draw_data_capacity;
+};
+
+static uint32_t hiz_size(uint32_t depth_width, uint32_t depth_height)
+{
+    uint32_t size = 0;
+    for (uint32_t level = 0; level < HIZ_LEVELS; level++)
+    {
+        uint32_t texel = HIZ_BASE_TEXEL << level;
+        size += ((depth_width + texel - 1) / texel) * ((depth_height + texel - 1) / texel);
+    }
+    return size;
+}
+
+MtGpuCuller *mt_gpu_culler_create(MtEngine *engine, MtRenderGraph *graph, const char *depth_image)
+{
+    assert(engine->hiz_pipeline && engine->gpu_cull_pipeline);
+
+    MtGpuCuller *culler = mt_alloc(engine->alloc, sizeof(*culler));
+    memset(culler, 0, sizeof(*culler));
+
+    culler->engine = engine;
+    culler->graph = graph;
+    culler->depth_image = depth_image;
+    culler->prev_view_proj = mat4_identity();
+
+    // Without the count read on the GPU, culled commands are kept with no instances
+    culler->compact = mt_render.device_draw_indirect_count_enabled(engine->device);
+
+    mt_render.graph_add_buffer(
+        graph,
+        "gpu_cull_commands",
+        &(MtBufferCreateInfo){
+            .usage = MT_BUFFER_USAGE_INDIRECT,
+            .memory = MT_BUFFER_MEMORY_DEVICE,
+            .size = sizeof(MtDrawIndexedIndirectCommand) * MAX_ITEMS,
+        });
+
+    mt_render.graph_add_buffer(
+        graph,
+        "gpu_cull_counts",
+        &(MtBufferCreateInfo){
+            .usage = MT_BUFFER_USAGE_INDIRECT,
+            .memory = MT_BUFFER_MEMORY_DEVICE,
+            .size = sizeof(uint32_t) * MAX_BUCKETS,
+        });
+
+    mt_render.graph_add_buffer(
+        graph,
+        "gpu_cull_hiz",
+        &(MtBufferCreateInfo){
+            .usage = MT_BUFFER_USAGE_STORAGE,
+            .memory = MT_BUFFER_MEMORY_DEVICE,
+            .size = sizeof(float) * hiz_size(HIZ_MAX_DEPTH_SIZE, HIZ_MAX_DEPTH_SIZE),
+        });
+
+    {
+        MtRenderGraphPass *reset_pass =
+            mt_render.graph_add_pass(graph, "gpu_cull_reset_pass", MT_PIPELINE_STAGE_TRANSFER);
+        mt_render.pass_write(reset_pass, MT_PASS_WRITE_BUFFER, "gpu_cull_counts");
+    }
+
+    {
+        MtRenderGraphPass *hiz_pass =
+            mt_render.graph_add_pass(graph, "gpu_cull_hiz_pass", MT_PIPELINE_STAGE_COMPUTE);
+        mt_render.pass_read(hiz_pass, MT_PASS_READ_IMAGE_SAMPLED, depth_image);
+        mt_render.pass_write(hiz_pass, MT_PASS_WRITE_BUFFER, "gpu_cull_hiz");
+    }
+
+    {
+        MtRenderGraphPass *cull_pass =
+            mt_render.graph_add_pass(graph, "gpu_cull_pass", MT_PIPELINE_STAGE_COMPUTE);
+        mt_render.pass_read(cull_pass, MT_PASS_READ_BUFFER, "gpu_cull_hiz");
+        mt_render.pass_write(cull_pass, MT_PASS_WRITE_BUFFER, "gpu_cull_commands");
+        mt_render.pass_write(cull_pass, MT_PASS_WRITE_BUFFER, "gpu_cull_counts");
+    }
+
+    return culler;
+}
+
+void mt_gpu_culler_destroy(MtGpuCuller *culler)
+{
+    MtAllocator *alloc = culler->engine->alloc;
+
+    mt_free(alloc, culler->buckets);
+    mt_free(alloc, culler->draw_data);
+    mt_free(alloc, culler);
+}
+
+void mt_gpu_culler_on_resize(MtGpuCuller *culler)
+{
+    culler->depth_valid = false;
+}
+
+void mt_gpu_culler_add_reads(MtGpuCuller *culler, MtRenderGraphPass *pass)
+{
+    mt_render.pass_read(pass, MT_PASS_READ_BUFFER, "gpu_cull_commands");
+    mt_render.pass_read(pass, MT_PASS_READ_BUFFER, "gpu_cull_counts");
+}
+
+bool mt_gpu_culler_cull(
+    MtGpuCuller *culler,
+    const MtCameraUniform *cam,
+    const MtGpuCullItem *items,
+    uint32_t item_count,
+    const MtGpuCullBucket *buckets,
+    uint32_t bucket_count,
+    const void *draw_data,
+    size_t data_size)
+{
+    MtEngine *engine = culler->engine;
+    MtRenderGraph *graph = culler->graph;
+
+    bool fits = item_count <= MAX_ITEMS && bucket_count <= MAX_BUCKETS;
+    if (!fits)
+    {
+        mt_log_debug(
+            "Too many draws to cull on the GPU: %u items, %u buckets", item_count, bucket_count);
+        item_count = 0;
+        bucket_count = 0;
+    }
+
+    culler->has_draws = item_count > 0;
+    culler->bucket_count = bucket_count;
+
+    if (bucket_count > culler->bucket_capacity)
+    {
+        culler->bucket_capacity = bucket_count;
+        culler->buckets = mt_realloc(
+            engine->alloc, culler->buckets, sizeof(MtGpuCullBucket) * culler->bucket_capacity);
+    }
+    if (bucket_count > 0)
+    {
+        memcpy(culler->buckets, buckets, sizeof(MtGpuCullBucket) * bucket_count);
+    }
+
+    culler->draw_data_size = data_size * item_count;
+    if (culler->draw_data_size > culler->draw_data_capacity)
+    {
+        culler->draw_data_capacity = culler->draw_data_size;
+        culler->draw_data =
+            mt_realloc(engine->alloc, culler->draw_data, culler->draw_data_capacity);
+    }
+    if (culler->draw_data_size > 0)
+    {
+        memcpy(culler->draw_data, draw_data, culler->draw_data_size);
+    }
+
+    {
+        MtCmdBuffer *cb = mt_render.pass_begin(graph, "gpu_cull_reset_pass");
+        if (bucket_count > 0)
+        {
+            MtBuffer *counts = mt_render.graph_get_buffer(graph, "gpu_cull_counts");
+            mt_render.cmd_fill_buffer(cb, counts, 0, sizeof(uint32_t) * bucket_count, 0);
+        }
+        mt_render.pass_end(graph, "gpu_cull_reset_pass");
+    }
+
+    // Only valid after pass_begin, the graph gets recreated there on resize
+    MtImage *depth = mt_render.graph_get_image(graph, culler->depth_image);
+    uint32_t depth_width = 0, depth_height = 0;
+    mt_window.get_size(engine->window, &depth_width, &depth_height);
+
+    bool occlusion = culler->depth_valid && depth == culler->prev_depth &&
+                     depth_width <= HIZ_MAX_DEPTH_SIZE && depth_height <= HIZ_MAX_DEPTH_SIZE;
+
+    {
+        MtCmdBuffer *cb = mt_render.pass_begin(graph, "gpu_cull_hiz_pass");
+        if (occlusion && item_count > 0)
+        {
+            uint32_t depth_size[2] = {depth_width, depth_height};
+
+            mt_render.cmd_bind_pipeline(cb, engine->hiz_pipeline->pipeline);
+            mt_render.cmd_bind_image(cb, depth, 0, 0);
+            mt_render.cmd_bind_storage_buffer(
+                cb, mt_render.graph_get_buffer(graph, "gpu_cull_hiz"), 0, 1);
+            mt_render.cmd_bind_uniform(cb, depth_size, sizeof(depth_size), 0, 2);
+
+            uint32_t group_size = HIZ_BASE_TEXEL * 16;
+            mt_render.cmd_dispatch(
+                cb,
+                (depth_width + group_size - 1) / group_size,
+                (depth_height + group_size - 1) / group_size,
+                1);
+        }
+        mt_render.pass_end(graph, "gpu_cull_hiz_pass");
+    }
+
+    Mat4 view_proj = mat4_mul(cam->view, cam->proj);
+
+    {
+        MtCmdBuffer *cb = mt_render.pass_begin(graph, "gpu_cull_pass");
+        if (item_count > 0)
+        {
+            MtFrustum frustum;
+            mt_frustum_from_matrix(&frustum, &view_proj);
+
+            CullParams params = {
+                .prev_view_proj = culler->prev_view_proj,
+                .depth_size = {depth_width, depth_height},
+                .item_count = item_count,
+                .occlusion = occlusion,
+                .compact = culler->compact,
+            };
+            memcpy(params.frustum, frustum.planes, sizeof(params.frustum));
+
+            mt_render.cmd_bind_pipeline(cb, engine->gpu_cull_pipeline->pipeline);
+
+            MtGpuCullItem *item_data =
+                mt_render.cmd_bind_storage_data(cb, sizeof(MtGpuCullItem) * item_count, 0, 0);
+            memcpy(item_data, items, sizeof(MtGpuCullItem) * item_count);
+
+            mt_render.cmd_bind_storage_buffer(
+                cb, mt_render.graph_get_buffer(graph, "gpu_cull_commands"), 0, 1);
+            mt_render.cmd_bind_storage_buffer(
+                cb, mt_render.graph_get_buffer(graph, "gpu_cull_counts"), 0, 2);
+            mt_render.cmd_bind_storage_buffer(
+                cb, mt_render.graph_get_buffer(graph, "gpu_cull_hiz"), 0, 3);
+            mt_render.cmd_bind_uniform(cb, &params, sizeof(params), 0, 4);
+
+            mt_render.cmd_dispatch(cb, (item_count + 63) / 64, 1, 1);
+        }
+        mt_render.pass_end(graph, "gpu_cull_pass");
+    }
+
+    // The depth drawn this frame is what the next frame builds its Hi-Z from
+    culler->depth_valid = true;
+    culler->prev_depth = depth;
+    culler->prev_view_proj = view_proj;
+
+    return fits;
+}
+
+bool mt_gpu_culler_has_draws(MtGpuCuller *culler)
+{
+    return culler->has_draws;
+}
+
+uint32_t mt_gpu_culler_draw(
+    MtGpuCuller *culler, MtCmdBuffer *cb, MtGpuCullBindCallback bind, uint32_t data_set)
+{
+    if (!culler->has_draws) return 0;
+
+    MtBuffer *commands = mt_render.graph_get_buffer(culler->graph, "gpu_cull_commands");
+    MtBuffer *counts = mt_render.graph_get_buffer(culler->graph, "gpu_cull_counts");
+
+    void *data = mt_render.cmd_bind_storage_data(cb, culler->draw_data_size, data_set, 0);
+    memcpy(data, culler->draw_data, culler->draw_data_size);
+
+    uint32_t draw_call_count = 0;
+    for (uint32_t i = 0; i < culler->bucket_count; i++)
+    {
+        MtGpuCullBucket *bucket = &culler->buckets[i];
+        if (bucket->item_count == 0) continue;
+
+        if (bind) bind(cb, bucket->user_data);
+
+        size_t offset = sizeof(MtDrawIndexedIndirectCommand) * bucket->first_item;
+        if (culler->compact)
+        {
+            mt_render.cmd_draw_indexed_indirect_count(
+                cb, commands, offset, counts, sizeof(uint32_t) * i, bucket->item_count);
+        }
+        else
+        {
+            mt_render.cmd_draw_indexed_indirect(cb, commands, offset, bucket->item_count);
+        }
+
+        draw_call_count++;
+    }
+
+    return draw_call_count;
+}
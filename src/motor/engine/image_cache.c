@@ -0,0 +1,300 @@
+#include <motor/engine/image_cache.h>
+
+#include <motor/base/allocator.h>
+#include <motor/base/buffer_writer.h>
+#include <motor/base/hashmap.h>
+#include <motor/base/threads.h>
+#include <motor/base/thread_pool.h>
+#include <motor/base/log.h>
+#include <motor/engine/engine.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+#include "tinyktx.h"
+#include "../../../tools/bc7enc16.h"
+
+// Same layout as the header tinyktx reads
+typedef struct KtxHeader
+{
+    uint8_t identifier[12];
+    uint32_t endianness;
+    uint32_t gl_type;
+    uint32_t gl_type_size;
+    uint32_t gl_format;
+    uint32_t gl_internal_format;
+    uint32_t gl_base_internal_format;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t number_of_array_elements;
+    uint32_t number_of_faces;
+    uint32_t number_of_mipmap_levels;
+    uint32_t bytes_of_key_value_data;
+} KtxHeader;
+
+static const uint8_t ktx_identifier[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+struct MtImageCache
+{
+    MtEngine *engine;
+    MtAllocator *alloc;
+    char *dir;
+
+    MtTaskGroup jobs;
+
+    MtMutex mutex;
+    // Keys being compressed
+    MtHashMap pending;
+};
+
+typedef struct CompressJob
+{
+    MtImageCache *cache;
+    uint64_t key;
+    uint8_t *pixels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_count;
+} CompressJob;
+
+static void entry_path(MtImageCache *cache, uint64_t key, char *path, size_t path_size)
+{
+    snprintf(path, path_size, "%s/%016llx.ktx", cache->dir, (unsigned long long)key);
+}
+
+MtImageCache *mt_image_cache_create(MtEngine *engine, const char *dir)
+{
+    MtImageCache *cache = mt_alloc(engine->alloc, sizeof(*cache));
+    memset(cache, 0, sizeof(*cache));
+
+    cache->engine = engine;
+    cache->alloc = engine->alloc;
+    cache->dir = mt_strdup(engine->alloc, dir);
+
+    mt_mutex_init(&cache->mutex);
+    mt_hash_init(&cache->pending, 16, cache->alloc);
+
+    // Fails when it already exists
+    make_dir(dir);
+
+    bc7enc16_compress_block_init();
+
+    return cache;
+}
+
+void mt_image_cache_destroy(MtImageCache *cache)
+{
+    mt_thread_pool_wait_group(&cache->engine->thread_pool, &cache->jobs);
+
+    mt_hash_destroy(&cache->pending);
+    mt_mutex_destroy(&cache->mutex);
+    mt_free(cache->alloc, cache->dir);
+    mt_free(cache->alloc, cache);
+}
+
+uint64_t mt_image_cache_key(const uint8_t *source, size_t source_size)
+{
+    return mt_hash_strn((const char *)source, source_size);
+}
+
+bool mt_image_cache_get(MtImageCache *cache, uint64_t key, char *path, size_t path_size)
+{
+    entry_path(cache, key, path, path_size);
+
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+// Box filters an RGBA8 level with even dimensions down to half its size
+static uint8_t *
+downsample(MtAllocator *alloc, const uint8_t *pixels, uint32_t width, uint32_t height)
+{
+    uint32_t half_width = width / 2;
+    uint32_t half_height = height / 2;
+    uint8_t *result = mt_alloc(alloc, (size_t)half_width * half_height * 4);
+
+    for (uint32_t y = 0; y < half_height; y++)
+    {
+        const uint8_t *row0 = &pixels[(size_t)(y * 2 + 0) * width * 4];
+        const uint8_t *row1 = &pixels[(size_t)(y * 2 + 1) * width * 4];
+        uint8_t *out = &result[(size_t)y * half_width * 4];
+
+        for (uint32_t x = 0; x < half_width * 4; x++)
+        {
+            uint32_t c = x % 4;
+            uint32_t i = (x - c) * 2 + c;
+            out[x] = (uint8_t)((row0[i] + row0[i + 4] + row1[i] + row1[i + 4] + 2) / 4);
+        }
+    }
+
+    return result;
+}
+
+static void compress_level(
+    MtBufferWriter *bw,
+    const uint8_t *pixels,
+    uint32_t width,
+    uint32_t height,
+    bc7enc16_compress_block_params *params)
+{
+    uint32_t blocks_x = width / 4;
+    uint32_t blocks_y = height / 4;
+
+    uint32_t level_size = blocks_x * blocks_y * 16;
+    mt_buffer_writer_append(bw, &level_size, sizeof(level_size));
+
+    for (uint32_t by = 0; by < blocks_y; by++)
+    {
+        for (uint32_t bx = 0; bx < blocks_x; bx++)
+        {
+            uint8_t block_pixels[16 * 4];
+            for (uint32_t row = 0; row < 4; row++)
+            {
+                memcpy(
+                    &block_pixels[row * 16],
+                    &pixels[((size_t)(by * 4 + row) * width + bx * 4) * 4],
+                    16);
+            }
+
+            uint8_t block[16];
+            bc7enc16_compress_block(block, block_pixels, params);
+            mt_buffer_writer_append(bw, block, sizeof(block));
+        }
+    }
+}
+
+static int32_t compress_job(void *arg)
+{
+    CompressJob *job = arg;
+    MtImageCache *cache = job->cache;
+
+    bc7enc16_compress_block_params params;
+    bc7enc16_compress_block_params_init(&params);
+    bc7enc16_compress_block_params_init_linear_weights(&params);
+    params.m_max_partitions_mode1 = BC7ENC16_MAX_PARTITIONS1;
+    params.m_uber_level = 0;
+
+    KtxHeader header = {
+        .endianness = 0x04030201,
+        .gl_type = KTX_UNSIGNED_BYTE,
+        .gl_type_size = 1,
+        .gl_format = KTX_RGBA,
+        .gl_internal_format = KTX_COMPRESSED_RGBA_BPTC_UNORM,
+        .gl_base_internal_format = KTX_RGBA,
+        .pixel_width = job->width,
+        .pixel_height = job->height,
+        .pixel_depth = 1,
+        .number_of_array_elements = 1,
+        .number_of_faces = 1,
+        .number_of_mipmap_levels = job->mip_count,
+    };
+    memcpy(header.identifier, ktx_identifier, sizeof(ktx_identifier));
+
+    MtBufferWriter bw = {0};
+    mt_buffer_writer_init(&bw, cache->alloc);
+    mt_buffer_writer_append(&bw, &header, sizeof(header));
+
+    uint8_t *level = job->pixels;
+    uint32_t width = job->width;
+    uint32_t height = job->height;
+    for (uint32_t mip = 0; mip < job->mip_count; mip++)
+    {
+        if (mip > 0)
+        {
+            uint8_t *next = downsample(cache->alloc, level, width, height);
+            mt_free(cache->alloc, level);
+            level = next;
+            width /= 2;
+            height /= 2;
+        }
+
+        // BC7 levels are multiples of 16 bytes, they need no padding
+        compress_level(&bw, level, width, height, &params);
+    }
+    mt_free(cache->alloc, level);
+
+    char path[1024];
+    entry_path(cache, job->key, path, sizeof(path));
+
+    char tmp_path[1040];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    // Readers only ever see complete entries
+    FILE *f = fopen(tmp_path, "wb");
+    bool written = f && fwrite(bw.buf, bw.length, 1, f) == 1;
+    if (f) written = (fclose(f) == 0) && written;
+
+    if (written)
+    {
+        remove(path);
+        written = rename(tmp_path, path) == 0;
+    }
+
+    if (!written)
+    {
+        mt_log_warn("Failed to write image cache entry: %s", path);
+        remove(tmp_path);
+    }
+
+    mt_buffer_writer_destroy(&bw);
+
+    mt_mutex_lock(&cache->mutex);
+    mt_hash_remove(&cache->pending, job->key);
+    mt_mutex_unlock(&cache->mutex);
+
+    mt_free(cache->alloc, job);
+
+    return 0;
+}
+
+void mt_image_cache_compress(
+    MtImageCache *cache, uint64_t key, const uint8_t *pixels, uint32_t width, uint32_t height)
+{
+    // Every level has to be made of whole blocks, down to a 4 pixel wide or high one
+    uint32_t mip_count = 0;
+    while (width % (4u << mip_count) == 0 && height % (4u << mip_count) == 0)
+    {
+        mip_count++;
+    }
+
+    if (mip_count == 0)
+    {
+        mt_log_debug("Image of %ux%u pixels can't be compressed to BC7", width, height);
+        return;
+    }
+
+    char path[1024];
+    if (mt_image_cache_get(cache, key, path, sizeof(path))) return;
+
+    mt_mutex_lock(&cache->mutex);
+    bool pending = mt_hash_get_uint(&cache->pending, key) != MT_HASH_NOT_FOUND;
+    if (!pending) mt_hash_set_uint(&cache->pending, key, 1);
+    mt_mutex_unlock(&cache->mutex);
+
+    if (pending) return;
+
+    size_t size = (size_t)width * height * 4;
+
+    CompressJob *job = mt_alloc(cache->alloc, sizeof(*job));
+    *job = (CompressJob){
+        .cache = cache,
+        .key = key,
+        .pixels = mt_alloc(cache->alloc, size),
+        .width = width,
+        .height = height,
+        .mip_count = mip_count,
+    };
+    memcpy(job->pixels, pixels, size);
+
+    mt_thread_pool_enqueue_group(&cache->engine->thread_pool, &cache->jobs, compress_job, job);
+}
@@ -3,7 +3,9 @@
 #include <float.h>
 #include <stdio.h>
 #include <motor/base/allocator.h>
+#include <motor/base/log.h>
 #include <motor/base/math.h>
+#include <motor/graphics/renderer.h>
 #include <motor/graphics/window.h>
 #include <motor/engine/engine.h>
 #include <motor/engine/entities.h>
@@ -237,6 +239,19 @@ void mt_inspect_entities(MtEngine *engine, MtEntityManager *em)
 
     if (igBegin("Entities", NULL, window_flags))
     {
+        MtModelDrawStats *stats = &engine->model_stats;
+        igText("Model instances: %u", stats->instances);
+        igText("Model draw calls: %u / %u", stats->draw_calls, stats->naive_draw_calls);
+        igText("Culled primitives: %u", stats->culled);
+        if (stats->naive_draw_calls > 0)
+        {
+            igText(
+                "Saved by instancing and culling: %.1f%%",
+                100.0f * (float)(stats->naive_draw_calls - stats->draw_calls) /
+                    (float)stats->naive_draw_calls);
+        }
+        igSeparator();
+
         if (igButton("Add entity", (ImVec2){}))
         {
             mt_entity_manager_add_entity(em, 0);
@@ -274,3 +289,161 @@ void mt_inspect_entities(MtEngine *engine, MtEntityManager *em)
 
     igPopID();
 }
+
+static const char *queue_name(MtQueueType queue_type)
+{
+    switch (queue_type)
+    {
+        case MT_QUEUE_GRAPHICS: return "graphics";
+        case MT_QUEUE_COMPUTE: return "compute";
+        case MT_QUEUE_TRANSFER: return "transfer";
+    }
+    return "";
+}
+
+void mt_inspect_render_graph(MtEngine *engine, MtRenderGraph *graph)
+{
+    igPushIDPtr(graph);
+
+    if (igBegin("GPU profiler", NULL, 0))
+    {
+        MtFrameStats frame_stats;
+        mt_render.graph_get_frame_stats(graph, &frame_stats);
+
+        int frames_in_flight = (int)frame_stats.frames_in_flight;
+        if (igSliderInt("Frames in flight", &frames_in_flight, 1, 4, "%d"))
+        {
+            mt_render.graph_set_frames_in_flight(graph, (uint32_t)frames_in_flight);
+        }
+
+        igText("CPU wait: %.3f ms", frame_stats.cpu_wait_ms);
+        igText("GPU busy: %.3f ms", frame_stats.gpu_busy_ms);
+        igText("Latency : %.3f ms", frame_stats.present_latency_ms);
+
+        // Each recording starts the file over
+        static FILE *csv = NULL;
+        static uint64_t recorded_frames = 0;
+        bool recording = csv != NULL;
+        if (igCheckbox("Record to render_graph_stats.csv", &recording))
+        {
+            if (recording)
+            {
+                csv = mt_inspect_render_graph_csv_open("render_graph_stats.csv");
+                recorded_frames = 0;
+            }
+            else
+            {
+                fclose(csv);
+                csv = NULL;
+            }
+        }
+        if (csv)
+        {
+            mt_inspect_render_graph_csv(engine, graph, csv, recorded_frames++);
+        }
+
+        uint32_t group_count = 0;
+        mt_render.graph_get_group_stats(graph, &group_count, NULL);
+        MtGroupStats *groups = mt_alloc(engine->alloc, sizeof(MtGroupStats) * group_count);
+        mt_render.graph_get_group_stats(graph, &group_count, groups);
+
+        if (igCollapsingHeader("Execution groups", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            for (uint32_t i = 0; i < group_count; ++i)
+            {
+                igText(
+                    "%u (%s, %u passes): %.3f ms",
+                    i,
+                    queue_name(groups[i].queue_type),
+                    groups[i].pass_count,
+                    groups[i].gpu_ms);
+            }
+        }
+
+        mt_free(engine->alloc, groups);
+
+        uint32_t pass_count = 0;
+        mt_render.graph_get_pass_stats(graph, &pass_count, NULL);
+        MtPassStats *passes = mt_alloc(engine->alloc, sizeof(MtPassStats) * pass_count);
+        mt_render.graph_get_pass_stats(graph, &pass_count, passes);
+
+        if (igCollapsingHeader("Passes", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            igColumns(4, "passes", true);
+            igText("Pass");
+            igNextColumn();
+            igText("GPU ms");
+            igNextColumn();
+            igText("Primitives");
+            igNextColumn();
+            igText("Fragments");
+            igNextColumn();
+            igSeparator();
+
+            for (uint32_t i = 0; i < pass_count; ++i)
+            {
+                igText("%s", passes[i].name);
+                igNextColumn();
+                igText("%.3f", passes[i].gpu_ms);
+                igNextColumn();
+                igText("%llu", (unsigned long long)passes[i].primitives);
+                igNextColumn();
+                igText("%llu", (unsigned long long)passes[i].fragment_invocations);
+                igNextColumn();
+            }
+
+            igColumns(1, NULL, false);
+        }
+
+        mt_free(engine->alloc, passes);
+    }
+    igEnd();
+
+    igPopID();
+}
+
+FILE *mt_inspect_render_graph_csv_open(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        mt_log_warn("Failed to open %s", path);
+        return NULL;
+    }
+
+    fprintf(f, "frame,pass,queue,gpu_ms,primitives,fragment_invocations\n");
+    return f;
+}
+
+bool mt_inspect_render_graph_csv(MtEngine *engine, MtRenderGraph *graph, FILE *f, uint64_t frame)
+{
+
+    uint32_t pass_count = 0;
+    mt_render.graph_get_pass_stats(graph, &pass_count, NULL);
+    MtPassStats *passes = mt_alloc(engine->alloc, sizeof(MtPassStats) * pass_count);
+    mt_render.graph_get_pass_stats(graph, &pass_count, passes);
+
+    MtFrameStats frame_stats;
+    mt_render.graph_get_frame_stats(graph, &frame_stats);
+
+    for (uint32_t i = 0; i < pass_count; ++i)
+    {
+        fprintf(
+            f,
+            "%llu,%s,%s,%.4f,%llu,%llu\n",
+            (unsigned long long)frame,
+            passes[i].name,
+            queue_name(passes[i].queue_type),
+            passes[i].gpu_ms,
+            (unsigned long long)passes[i].primitives,
+            (unsigned long long)passes[i].fragment_invocations);
+    }
+
+    // The whole frame, as a pass of its own
+    fprintf(
+        f, "%llu,frame,graphics,%.4f,0,0\n", (unsigned long long)frame, frame_stats.gpu_busy_ms);
+
+    mt_free(engine->alloc, passes);
+
+    return !ferror(f);
+}
@@ -0,0 +1,261 @@
+#include <motor/engine/material_table.h>
+
+#include <motor/base/array.h>
+#include <motor/base/allocator.h>
+#include <motor/base/threads.h>
+#include <motor/graphics/renderer.h>
+#include <motor/engine/engine.h>
+#include <assert.h>
+#include <string.h>
+
+// The update of a frame may run while the frame MT_MAX_FRAMES_IN_FLIGHT before it is
+// still reading its buffer
+#define BUFFER_COUNT (MT_MAX_FRAMES_IN_FLIGHT + 1)
+#define MIN_CAPACITY 256
+
+// Must match BindlessMaterial in shaders/common.hlsl (std430)
+typedef struct BindlessMaterial
+{
+    Vec4 base_color_factor;
+    Vec4 emissive_factor;
+    float metallic;
+    float roughness;
+    uint32_t sampler_index;
+    uint32_t albedo_image;
+    uint32_t normal_image;
+    uint32_t metallic_roughness_image;
+    uint32_t occlusion_image;
+    uint32_t emissive_image;
+} BindlessMaterial;
+
+typedef struct FreeRange
+{
+    uint32_t first;
+    uint32_t count;
+} FreeRange;
+
+typedef struct FrameBuffer
+{
+    MtBuffer *buffer;
+    uint32_t capacity;
+    // Version of the table last written to it
+    uint64_t version;
+} FrameBuffer;
+
+struct MtMaterialTable
+{
+    MtEngine *engine;
+    MtMutex mutex;
+
+    /*array*/ MtMaterialTableEntry *entries;
+    // Sorted, adjacent ranges are always merged. Slots past the entries are free too.
+    /*array*/ FreeRange *free_ranges;
+
+    // Bumped on every change, buffers older than it get written again
+    uint64_t version;
+
+    FrameBuffer buffers[BUFFER_COUNT];
+    uint64_t frame;
+};
+
+MtMaterialTable *mt_material_table_create(MtEngine *engine)
+{
+    MtMaterialTable *table = mt_alloc(engine->alloc, sizeof(*table));
+    memset(table, 0, sizeof(*table));
+
+    table->engine = engine;
+    table->version = 1;
+    mt_mutex_init(&table->mutex);
+
+    return table;
+}
+
+void mt_material_table_destroy(MtMaterialTable *table)
+{
+    MtEngine *engine = table->engine;
+
+    for (uint32_t i = 0; i < BUFFER_COUNT; i++)
+    {
+        mt_render.destroy_buffer(engine->device, table->buffers[i].buffer);
+    }
+
+    mt_array_free(engine->alloc, table->free_ranges);
+    mt_array_free(engine->alloc, table->entries);
+
+    mt_mutex_destroy(&table->mutex);
+
+    mt_free(engine->alloc, table);
+}
+
+static uint32_t alloc_slots_no_lock(MtMaterialTable *table, uint32_t count)
+{
+    for (uint32_t i = 0; i < mt_array_size(table->free_ranges); i++)
+    {
+        FreeRange *range = &table->free_ranges[i];
+        if (range->count < count) continue;
+
+        uint32_t first = range->first;
+        range->first += count;
+        range->count -= count;
+
+        if (range->count == 0)
+        {
+            uint32_t left = (uint32_t)mt_array_size(table->free_ranges) - i - 1;
+            memmove(range, range + 1, sizeof(FreeRange) * left);
+            mt_array_set_size(table->free_ranges, mt_array_size(table->free_ranges) - 1);
+        }
+        return first;
+    }
+
+    uint32_t first = (uint32_t)mt_array_size(table->entries);
+    mt_array_add(table->engine->alloc, table->entries, count);
+    return first;
+}
+
+uint32_t mt_material_table_alloc(
+    MtMaterialTable *table, const MtMaterialTableEntry *entries, uint32_t count)
+{
+    assert(count > 0);
+
+    mt_mutex_lock(&table->mutex);
+
+    uint32_t first = alloc_slots_no_lock(table, count);
+    memcpy(&table->entries[first], entries, sizeof(*entries) * count);
+    table->version++;
+
+    mt_mutex_unlock(&table->mutex);
+
+    return first;
+}
+
+void mt_material_table_free(MtMaterialTable *table, uint32_t first, uint32_t count)
+{
+    if (count == 0) return;
+
+    MtEngine *engine = table->engine;
+
+    mt_mutex_lock(&table->mutex);
+
+    // The images of the freed entries may be gone, their slots are still written
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        table->entries[i] = (MtMaterialTableEntry){
+            .sampler_index = engine->default_sampler_index,
+            .albedo_image = &engine->white_image_index,
+            .normal_image = &engine->white_image_index,
+            .metallic_roughness_image = &engine->white_image_index,
+            .occlusion_image = &engine->white_image_index,
+            .emissive_image = &engine->white_image_index,
+        };
+    }
+
+    FreeRange **ranges = &table->free_ranges;
+    uint32_t size = (uint32_t)mt_array_size(*ranges);
+
+    uint32_t i = 0;
+    while (i < size && (*ranges)[i].first < first)
+    {
+        i++;
+    }
+
+    bool merge_prev = i > 0 && (*ranges)[i - 1].first + (*ranges)[i - 1].count == first;
+    bool merge_next = i < size && first + count == (*ranges)[i].first;
+
+    if (merge_prev && merge_next)
+    {
+        (*ranges)[i - 1].count += count + (*ranges)[i].count;
+        memmove(&(*ranges)[i], &(*ranges)[i + 1], sizeof(FreeRange) * (size - i - 1));
+        mt_array_set_size(*ranges, size - 1);
+    }
+    else if (merge_prev)
+    {
+        (*ranges)[i - 1].count += count;
+    }
+    else if (merge_next)
+    {
+        (*ranges)[i].first = first;
+        (*ranges)[i].count += count;
+    }
+    else
+    {
+        mt_array_add(engine->alloc, *ranges, 1);
+        memmove(&(*ranges)[i + 1], &(*ranges)[i], sizeof(FreeRange) * (size - i));
+        (*ranges)[i] = (FreeRange){.first = first, .count = count};
+    }
+
+    mt_mutex_unlock(&table->mutex);
+}
+
+void mt_material_table_invalidate(MtMaterialTable *table)
+{
+    mt_mutex_lock(&table->mutex);
+    table->version++;
+    mt_mutex_unlock(&table->mutex);
+}
+
+void mt_material_table_update(MtMaterialTable *table)
+{
+    MtDevice *dev = table->engine->device;
+
+    mt_mutex_lock(&table->mutex);
+
+    FrameBuffer *fb = &table->buffers[++table->frame % BUFFER_COUNT];
+    uint32_t count = (uint32_t)mt_array_size(table->entries);
+
+    if (fb->capacity < count || !fb->buffer)
+    {
+        uint32_t capacity = MT_MAX(fb->capacity, MIN_CAPACITY);
+        while (capacity < count)
+        {
+            capacity *= 2;
+        }
+
+        mt_render.destroy_buffer(dev, fb->buffer);
+
+        fb->buffer = mt_render.create_buffer(
+            dev,
+            &(MtBufferCreateInfo){
+                .usage = MT_BUFFER_USAGE_STORAGE,
+                .memory = MT_BUFFER_MEMORY_HOST,
+                .size = sizeof(BindlessMaterial) * capacity,
+            });
+        fb->capacity = capacity;
+        fb->version = 0;
+    }
+
+    if (fb->version != table->version)
+    {
+        BindlessMaterial *materials = mt_render.map_buffer(dev, fb->buffer);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            MtMaterialTableEntry *entry = &table->entries[i];
+            materials[i] = (BindlessMaterial){
+                .base_color_factor = entry->base_color_factor,
+                .emissive_factor = entry->emissive_factor,
+                .metallic = entry->metallic,
+                .roughness = entry->roughness,
+                .sampler_index = entry->sampler_index,
+                .albedo_image = *entry->albedo_image,
+                .normal_image = *entry->normal_image,
+                .metallic_roughness_image = *entry->metallic_roughness_image,
+                .occlusion_image = *entry->occlusion_image,
+                .emissive_image = *entry->emissive_image,
+            };
+        }
+        mt_render.unmap_buffer(dev, fb->buffer);
+
+        fb->version = table->version;
+    }
+
+    mt_mutex_unlock(&table->mutex);
+}
+
+void mt_material_table_bind(MtMaterialTable *table, MtCmdBuffer *cb, uint32_t set)
+{
+    mt_mutex_lock(&table->mutex);
+    MtBuffer *buffer = table->buffers[table->frame % BUFFER_COUNT].buffer;
+    mt_mutex_unlock(&table->mutex);
+
+    assert(buffer && "mt_material_table_update was not called yet");
+    mt_render.cmd_bind_storage_buffer(cb, buffer, set, 0);
+}
@@ -5,8 +5,14 @@
 #include <motor/base/string_builder.h>
 #include <motor/base/log.h>
 #include <motor/base/array.h>
+#include <motor/base/hashmap.h>
 #include <motor/base/filesystem.h>
+#include <motor/base/vfs.h>
 #include <motor/engine/config.h>
+#include <motor/engine/shader_cache.h>
+
+// Bump when the options given to shaderc change, to leave the old shader cache entries behind
+#define SHADER_OPTIONS_VERSION 1
 
 typedef struct PipelinePragma
 {
@@ -62,6 +68,13 @@ static PipelinePragma *parse_pragmas(MtAllocator *alloc, const char *input, size
 }
 
 // Include resolver {{{
+typedef struct IncludeContext
+{
+    MtEngine *engine;
+    // Every file included while compiling, recorded in the shader cache entry
+    /*array*/ MtShaderDependency *deps;
+} IncludeContext;
+
 static shaderc_include_result *include_resolver(
     void *user_data,
     const char *requested_source,
@@ -69,8 +82,8 @@ static shaderc_include_result *include_resolver(
     const char *requesting_source,
     size_t include_depth)
 {
-    MtEngine *engine = user_data;
-    MtAllocator *alloc = engine->alloc;
+    IncludeContext *ctx = user_data;
+    MtAllocator *alloc = ctx->engine->alloc;
 
     assert(type == shaderc_include_type_relative);
 
@@ -89,21 +102,33 @@ static shaderc_include_result *include_resolver(
     }
     path = mt_strcat(alloc, path, requested_source);
 
-    FILE *f = fopen(path, "rb");
-    if (!f)
+    MtVfsFile file;
+    if (!mt_vfs_open(&ctx->engine->vfs, path, &file))
     {
         mt_log_error("Could not open shader include: %s", path);
+        mt_free(alloc, path);
         return NULL;
     }
 
-    fseek(f, 0, SEEK_END);
-    uint64_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
+    // shaderc keeps the content until the result is released
+    uint64_t size = file.size;
     char *content = mt_alloc(alloc, size);
-    fread(content, size, 1, f);
+    memcpy(content, file.data, size);
+    mt_vfs_close(&ctx->engine->vfs, &file);
 
-    fclose(f);
+    bool recorded = false;
+    for (uint32_t i = 0; i < mt_array_size(ctx->deps); i++)
+    {
+        recorded |= strcmp(ctx->deps[i].path, path) == 0;
+    }
+    if (!recorded)
+    {
+        MtShaderDependency dep = {
+            .path = mt_strdup(alloc, path),
+            .hash = mt_hash_strn(content, size),
+        };
+        mt_array_push(alloc, ctx->deps, dep);
+    }
 
     shaderc_include_result *result = mt_alloc(alloc, sizeof(*result));
     *result = (shaderc_include_result){
@@ -120,8 +145,8 @@ static shaderc_include_result *include_resolver(
 // An includer callback type for destroying an include result.
 static void include_result_releaser(void *user_data, shaderc_include_result *include_result)
 {
-    MtEngine *engine = user_data;
-    MtAllocator *alloc = engine->alloc;
+    IncludeContext *ctx = user_data;
+    MtAllocator *alloc = ctx->engine->alloc;
 
     mt_free(alloc, (void *)include_result->content);
     mt_free(alloc, (void *)include_result->source_name);
@@ -129,6 +154,77 @@ static void include_result_releaser(void *user_data, shaderc_include_result *inc
 }
 // }}}
 
+// Stage compilation {{{
+// Compiles a shader stage into SPIR-V, unless the shader cache has it already.
+// Returns NULL on failure, otherwise code to be freed with mt_free.
+static uint8_t *compile_hlsl_stage(
+    MtEngine *engine,
+    const char *path,
+    const char *input,
+    size_t input_size,
+    shaderc_shader_kind kind,
+    const char *entry_point,
+    size_t *code_size)
+{
+    unsigned int spv_version = 0, spv_revision = 0;
+    shaderc_get_spv_version(&spv_version, &spv_revision);
+
+    // Includes are not known before compiling, the cache entry checks them instead
+    uint64_t key_parts[] = {
+        SHADER_OPTIONS_VERSION,
+        spv_version,
+        spv_revision,
+        (uint64_t)kind,
+        mt_hash_str(entry_point),
+        mt_hash_str(path),
+        mt_hash_strn(input, input_size),
+    };
+    uint64_t key = mt_hash_strn((const char *)key_parts, sizeof(key_parts));
+
+    uint8_t *code = mt_shader_cache_get(engine->shader_cache, key, code_size);
+    if (code) return code;
+
+    IncludeContext ctx = {.engine = engine};
+
+    shaderc_compile_options_t options = shaderc_compile_options_initialize();
+    shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+    shaderc_compile_options_set_forced_version_profile(options, 450, shaderc_profile_none);
+    shaderc_compile_options_set_target_env(
+        options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
+    shaderc_compile_options_set_include_callbacks(
+        options, include_resolver, include_result_releaser, &ctx);
+    shaderc_compile_options_set_source_language(options, shaderc_source_language_hlsl);
+
+    shaderc_compilation_result_t result = shaderc_compile_into_spv(
+        engine->compiler, input, input_size, kind, path, entry_point, options);
+
+    if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success)
+    {
+        mt_log_error("%s", shaderc_result_get_error_message(result));
+    }
+    else
+    {
+        *code_size = shaderc_result_get_length(result);
+        code = mt_alloc(engine->alloc, *code_size);
+        memcpy(code, shaderc_result_get_bytes(result), *code_size);
+
+        mt_shader_cache_put(
+            engine->shader_cache, key, ctx.deps, mt_array_size(ctx.deps), code, *code_size);
+    }
+
+    shaderc_result_release(result);
+    shaderc_compile_options_release(options);
+
+    for (uint32_t i = 0; i < mt_array_size(ctx.deps); i++)
+    {
+        mt_free(engine->alloc, ctx.deps[i].path);
+    }
+    mt_array_free(engine->alloc, ctx.deps);
+
+    return code;
+}
+// }}}
+
 // HLSL graphics pipeline {{{
 static MtPipeline *create_graphics_pipeline_hlsl(
     MtEngine *engine,
@@ -253,64 +349,35 @@ static MtPipeline *create_graphics_pipeline_hlsl(
         return NULL;
     }
 
-    shaderc_compile_options_t options = shaderc_compile_options_initialize();
-    shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
-    shaderc_compile_options_set_forced_version_profile(options, 450, shaderc_profile_none);
-    shaderc_compile_options_set_target_env(
-        options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
-    shaderc_compile_options_set_include_callbacks(
-        options, include_resolver, include_result_releaser, engine);
-    shaderc_compile_options_set_source_language(options, shaderc_source_language_hlsl);
-
-    shaderc_compilation_result_t vertex_result = NULL, fragment_result = NULL;
-
     uint8_t *vertex_code = NULL, *fragment_code = NULL;
     size_t vertex_code_size = 0, fragment_code_size = 0;
+    MtPipeline *pipeline = NULL;
 
-    vertex_result = shaderc_compile_into_spv(
-        engine->compiler,
+    vertex_code = compile_hlsl_stage(
+        engine,
+        path,
         input,
         input_size,
         shaderc_vertex_shader,
-        path,
         vertex_entry_point,
-        options);
-
-    if (shaderc_result_get_compilation_status(vertex_result) ==
-        shaderc_compilation_status_compilation_error)
-    {
-        mt_log_error("%s", shaderc_result_get_error_message(vertex_result));
-        goto failed;
-    }
-
-    vertex_code = (uint8_t *)shaderc_result_get_bytes(vertex_result);
-    vertex_code_size = shaderc_result_get_length(vertex_result);
+        &vertex_code_size);
+    if (!vertex_code) goto end;
 
-    // Compile fragment shader
     if (fragment_entry_point)
     {
-        fragment_result = shaderc_compile_into_spv(
-            engine->compiler,
+        fragment_code = compile_hlsl_stage(
+            engine,
+            path,
             input,
             input_size,
             shaderc_fragment_shader,
-            path,
             fragment_entry_point,
-            options);
-
-        if (shaderc_result_get_compilation_status(fragment_result) ==
-            shaderc_compilation_status_compilation_error)
-        {
-            mt_log_error("%s", shaderc_result_get_error_message(fragment_result));
-            goto failed;
-        }
-
-        fragment_code = (uint8_t *)shaderc_result_get_bytes(fragment_result);
-        fragment_code_size = shaderc_result_get_length(fragment_result);
+            &fragment_code_size);
+        if (!fragment_code) goto end;
     }
 
     mt_render.device_wait_idle(engine->device);
-    MtPipeline *pipeline = mt_render.create_graphics_pipeline(
+    pipeline = mt_render.create_graphics_pipeline(
         engine->device,
         vertex_code,
         vertex_code_size,
@@ -318,22 +385,14 @@ static MtPipeline *create_graphics_pipeline_hlsl(
         fragment_code_size,
         &pipeline_create_info);
 
-    shaderc_compile_options_release(options);
-
-    shaderc_result_release(vertex_result);
-    shaderc_result_release(fragment_result);
+end:
+    if (vertex_code) mt_free(engine->alloc, vertex_code);
+    if (fragment_code) mt_free(engine->alloc, fragment_code);
 
     mt_free(engine->alloc, vertex_entry_point);
     mt_free(engine->alloc, fragment_entry_point);
 
     return pipeline;
-
-failed:
-    if (options) shaderc_compile_options_release(options);
-
-    if (vertex_result) shaderc_result_release(vertex_result);
-    if (fragment_result) shaderc_result_release(fragment_result);
-    return NULL;
 }
 // }}}
 
@@ -361,56 +420,28 @@ static MtPipeline *create_compute_pipeline_hlsl(
         return NULL;
     }
 
-    shaderc_compile_options_t options = shaderc_compile_options_initialize();
-    shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
-    shaderc_compile_options_set_forced_version_profile(options, 450, shaderc_profile_none);
-    shaderc_compile_options_set_target_env(
-        options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
-    shaderc_compile_options_set_include_callbacks(
-        options, include_resolver, include_result_releaser, engine);
-    shaderc_compile_options_set_source_language(options, shaderc_source_language_hlsl);
-
-    shaderc_compilation_result_t compute_result = NULL;
-
-    uint8_t *compute_code = NULL;
     size_t compute_code_size = 0;
-
-    compute_result = shaderc_compile_into_spv(
-        engine->compiler,
+    uint8_t *compute_code = compile_hlsl_stage(
+        engine,
+        path,
         input,
         input_size,
         shaderc_compute_shader,
-        path,
         compute_entry_point,
-        options);
+        &compute_code_size);
 
-    if (shaderc_result_get_compilation_status(compute_result) ==
-        shaderc_compilation_status_compilation_error)
+    MtPipeline *pipeline = NULL;
+    if (compute_code)
     {
-        mt_log_error("%s", shaderc_result_get_error_message(compute_result));
-        goto failed;
+        mt_render.device_wait_idle(engine->device);
+        pipeline =
+            mt_render.create_compute_pipeline(engine->device, compute_code, compute_code_size);
+        mt_free(engine->alloc, compute_code);
     }
 
-    compute_code = (uint8_t *)shaderc_result_get_bytes(compute_result);
-    compute_code_size = shaderc_result_get_length(compute_result);
-
-    mt_render.device_wait_idle(engine->device);
-    MtPipeline *pipeline =
-        mt_render.create_compute_pipeline(engine->device, compute_code, compute_code_size);
-
-    shaderc_compile_options_release(options);
-
-    shaderc_result_release(compute_result);
-
     mt_free(engine->alloc, compute_entry_point);
 
     return pipeline;
-
-failed:
-    if (options) shaderc_compile_options_release(options);
-
-    if (compute_result) shaderc_result_release(compute_result);
-    return NULL;
 }
 // }}}
 
@@ -7,6 +7,8 @@
 #include <motor/engine/entities.h>
 #include <motor/engine/components.h>
 #include <motor/engine/physics.h>
+#include <motor/engine/gpu_culling.h>
+#include <motor/engine/systems.h>
 
 void mt_scene_init(MtScene *scene, MtEngine *engine)
 {
@@ -33,6 +35,9 @@ void mt_scene_destroy(MtScene *scene)
 {
     MtAllocator *alloc = scene->engine->alloc;
 
+    // Its task reads the models
+    if (scene->model_cull) mt_model_cull_destroy(scene->model_cull);
+    if (scene->gpu_culler) mt_gpu_culler_destroy(scene->gpu_culler);
     mt_render.destroy_graph(scene->graph);
 
     mt_environment_destroy(&scene->env);
@@ -0,0 +1,303 @@
+#include <motor/engine/shader_cache.h>
+
+#include <motor/base/allocator.h>
+#include <motor/base/hashmap.h>
+#include <motor/base/threads.h>
+#include <motor/base/log.h>
+#include <motor/base/vfs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+#include <windows.h>
+#include <direct.h>
+#include <sys/utime.h>
+#define make_dir(path) _mkdir(path)
+#define touch_file(path) _utime(path, NULL)
+#else
+#include <dirent.h>
+#include <utime.h>
+#define make_dir(path) mkdir(path, 0755)
+#define touch_file(path) utime(path, NULL)
+#endif
+
+enum {
+    SHADER_CACHE_MAGIC = 0x5053544d, // "MTSP"
+    SHADER_CACHE_VERSION = 1,
+    // Entries unused for this long are removed, hits refresh the modification time
+    SHADER_CACHE_MAX_AGE = 14 * 24 * 60 * 60,
+};
+
+typedef struct EntryHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t code_size;
+    uint32_t dep_count;
+    uint32_t pad;
+} EntryHeader;
+
+// Followed by path_len bytes of path
+typedef struct EntryDependency
+{
+    uint64_t hash;
+    uint32_t path_len;
+    uint32_t pad;
+} EntryDependency;
+
+struct MtShaderCache
+{
+    MtAllocator *alloc;
+    MtVfs *vfs;
+    char *dir;
+
+    MtMutex mutex;
+    // Keys used since the cache was created, these are never pruned
+    MtHashMap used;
+};
+
+static char *read_file(MtAllocator *alloc, const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *data = mt_alloc(alloc, *size + 1);
+    if (*size > 0 && fread(data, *size, 1, f) != 1)
+    {
+        mt_free(alloc, data);
+        data = NULL;
+    }
+    fclose(f);
+
+    return data;
+}
+
+static void entry_path(MtShaderCache *cache, uint64_t key, char *path, size_t path_size)
+{
+    snprintf(path, path_size, "%s/%016llx.spv", cache->dir, (unsigned long long)key);
+}
+
+MtShaderCache *mt_shader_cache_create(MtAllocator *alloc, MtVfs *vfs, const char *dir)
+{
+    MtShaderCache *cache = mt_alloc(alloc, sizeof(*cache));
+    memset(cache, 0, sizeof(*cache));
+
+    cache->alloc = alloc;
+    cache->vfs = vfs;
+    cache->dir = mt_strdup(alloc, dir);
+
+    mt_mutex_init(&cache->mutex);
+    mt_hash_init(&cache->used, 64, alloc);
+
+    // Fails when it already exists
+    make_dir(dir);
+
+    return cache;
+}
+
+static bool entry_is_stale(MtShaderCache *cache, const char *name, time_t now)
+{
+    const char *ext = strrchr(name, '.');
+    if (!ext) return false;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", cache->dir, name);
+
+    if (strcmp(ext, ".tmp") == 0) return true;
+    if (strcmp(ext, ".spv") != 0) return false;
+
+    uint64_t key = strtoull(name, NULL, 16);
+    if (mt_hash_get_uint(&cache->used, key) != MT_HASH_NOT_FOUND) return false;
+
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+
+    return (now - st.st_mtime) > SHADER_CACHE_MAX_AGE;
+}
+
+static uint32_t prune_entry(MtShaderCache *cache, const char *name, time_t now)
+{
+    if (!entry_is_stale(cache, name, now)) return 0;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", cache->dir, name);
+    return remove(path) == 0 ? 1 : 0;
+}
+
+static void prune(MtShaderCache *cache)
+{
+    time_t now = time(NULL);
+    uint32_t removed = 0;
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+    char pattern[1024];
+    snprintf(pattern, sizeof(pattern), "%s/*", cache->dir);
+
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    if (find == INVALID_HANDLE_VALUE) return;
+    do
+    {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        removed += prune_entry(cache, data.cFileName, now);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR *dirp = opendir(cache->dir);
+    if (!dirp) return;
+
+    struct dirent *ent;
+    while ((ent = readdir(dirp)) != NULL)
+    {
+        if (ent->d_type == DT_DIR) continue;
+        removed += prune_entry(cache, ent->d_name, now);
+    }
+    closedir(dirp);
+#endif
+
+    if (removed > 0)
+    {
+        mt_log_debug("Pruned %u stale shader cache entries", removed);
+    }
+}
+
+void mt_shader_cache_destroy(MtShaderCache *cache)
+{
+    prune(cache);
+
+    mt_hash_destroy(&cache->used);
+    mt_mutex_destroy(&cache->mutex);
+    mt_free(cache->alloc, cache->dir);
+    mt_free(cache->alloc, cache);
+}
+
+static bool dependency_changed(MtShaderCache *cache, const char *path, uint64_t hash)
+{
+    MtVfsFile file;
+    if (!mt_vfs_open(cache->vfs, path, &file)) return true;
+
+    bool changed = mt_hash_strn((const char *)file.data, file.size) != hash;
+    mt_vfs_close(cache->vfs, &file);
+    return changed;
+}
+
+uint8_t *mt_shader_cache_get(MtShaderCache *cache, uint64_t key, size_t *code_size)
+{
+    char path[1024];
+    entry_path(cache, key, path, sizeof(path));
+
+    size_t size = 0;
+    char *data = read_file(cache->alloc, path, &size);
+    if (!data) return NULL;
+
+    uint8_t *code = NULL;
+
+    EntryHeader header;
+    if (size < sizeof(header)) goto end;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != SHADER_CACHE_MAGIC || header.version != SHADER_CACHE_VERSION ||
+        header.key != key)
+    {
+        goto end;
+    }
+
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.dep_count; i++)
+    {
+        EntryDependency dep;
+        if (size - offset < sizeof(dep)) goto end;
+        memcpy(&dep, data + offset, sizeof(dep));
+        offset += sizeof(dep);
+
+        if (size - offset < dep.path_len) goto end;
+        char *dep_path = mt_alloc(cache->alloc, dep.path_len + 1);
+        memcpy(dep_path, data + offset, dep.path_len);
+        dep_path[dep.path_len] = '\0';
+        offset += dep.path_len;
+
+        bool changed = dependency_changed(cache, dep_path, dep.hash);
+        mt_free(cache->alloc, dep_path);
+        if (changed) goto end;
+    }
+
+    if (size - offset != header.code_size) goto end;
+
+    code = mt_alloc(cache->alloc, header.code_size);
+    memcpy(code, data + offset, header.code_size);
+    *code_size = header.code_size;
+
+    mt_mutex_lock(&cache->mutex);
+    mt_hash_set_uint(&cache->used, key, 1);
+    mt_mutex_unlock(&cache->mutex);
+
+    touch_file(path);
+
+end:
+    mt_free(cache->alloc, data);
+    return code;
+}
+
+void mt_shader_cache_put(
+    MtShaderCache *cache,
+    uint64_t key,
+    const MtShaderDependency *deps,
+    uint32_t dep_count,
+    const uint8_t *code,
+    size_t code_size)
+{
+    char path[1024];
+    entry_path(cache, key, path, sizeof(path));
+
+    char tmp_path[1040];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    EntryHeader header = {
+        .magic = SHADER_CACHE_MAGIC,
+        .version = SHADER_CACHE_VERSION,
+        .key = key,
+        .code_size = code_size,
+        .dep_count = dep_count,
+    };
+
+    // Loads run on several threads, and two of them may compile the same shader
+    mt_mutex_lock(&cache->mutex);
+
+    mt_hash_set_uint(&cache->used, key, 1);
+
+    FILE *f = fopen(tmp_path, "wb");
+    bool written = f && fwrite(&header, sizeof(header), 1, f) == 1;
+    for (uint32_t i = 0; i < dep_count && written; i++)
+    {
+        EntryDependency dep = {
+            .hash = deps[i].hash,
+            .path_len = (uint32_t)strlen(deps[i].path),
+        };
+        written = fwrite(&dep, sizeof(dep), 1, f) == 1 &&
+                  fwrite(deps[i].path, dep.path_len, 1, f) == 1;
+    }
+    written = written && fwrite(code, code_size, 1, f) == 1;
+    if (f) written = (fclose(f) == 0) && written;
+
+    if (written)
+    {
+        remove(path);
+        written = rename(tmp_path, path) == 0;
+    }
+
+    if (!written)
+    {
+        mt_log_warn("Failed to write shader cache entry: %s", path);
+        remove(tmp_path);
+    }
+
+    mt_mutex_unlock(&cache->mutex);
+}
@@ -1,8 +1,14 @@
 #include <motor/engine/systems.h>
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 #include <motor/base/log.h>
+#include <motor/base/array.h>
+#include <motor/base/allocator.h>
+#include <motor/base/frustum.h>
 #include <motor/graphics/renderer.h>
+#include <motor/graphics/window.h>
 #include <motor/engine/engine.h>
 #include <motor/engine/scene.h>
 #include <motor/engine/camera.h>
@@ -10,6 +16,9 @@
 #include <motor/engine/components.h>
 #include <motor/engine/physics.h>
 #include <motor/engine/transform.h>
+#include <motor/engine/geometry_arena.h>
+#include <motor/engine/gpu_culling.h>
+#include <motor/engine/material_table.h>
 #include <motor/engine/assets/gltf_asset.h>
 #include <motor/engine/assets/pipeline_asset.h>
 
@@ -45,9 +54,557 @@ void mt_light_system(MtEntityManager *em, MtScene *scene, float delta)
     }
 }
 
+typedef struct ModelDraw
+{
+    MtGltfAsset *asset;
+    MtEntity entity;
+} ModelDraw;
+
+static int compare_model_draws(const void *a, const void *b)
+{
+    const ModelDraw *da = a;
+    const ModelDraw *db = b;
+    if (da->asset != db->asset) return (uintptr_t)da->asset < (uintptr_t)db->asset ? -1 : 1;
+    return (da->entity > db->entity) - (da->entity < db->entity);
+}
+
+static void gpu_cull_models(MtEntityManager *em, MtScene *scene)
+{
+    MtEngine *engine = scene->engine;
+    MtGpuCuller *culler = scene->gpu_culler;
+    MtDefaultComponents *comps = (MtDefaultComponents *)em->components;
+
+    MtComponentMask comp_mask =
+        MT_COMP_BIT(MtDefaultComponents, transform) | MT_COMP_BIT(MtDefaultComponents, model);
+
+    /*array*/ ModelDraw *model_draws = NULL;
+    uint32_t item_count = 0;
+
+    for (MtEntity e = 0; e < em->entity_count; ++e)
+    {
+        if ((em->masks[e] & comp_mask) != comp_mask) continue;
+
+        MtGltfAsset *asset = comps->model[e];
+        if (!mt_gltf_asset_in_geometry_arena(asset)) continue;
+
+        mt_array_push(engine->alloc, model_draws, ((ModelDraw){asset, e}));
+        item_count += mt_gltf_asset_draw_count(asset);
+    }
+
+    if (item_count == 0)
+    {
+        // The passes are still recorded, the graph expects all of them every frame
+        mt_gpu_culler_cull(culler, &scene->cam.uniform, NULL, 0, NULL, 0, NULL, 0);
+        mt_array_free(engine->alloc, model_draws);
+        return;
+    }
+
+    qsort(model_draws, mt_array_size(model_draws), sizeof(ModelDraw), compare_model_draws);
+
+    uint32_t draw_count = (uint32_t)mt_array_size(model_draws);
+
+    Mat4 *transforms = mt_alloc(engine->alloc, sizeof(Mat4) * draw_count);
+    MtAabb *boxes = mt_alloc(engine->alloc, sizeof(MtAabb) * item_count);
+    MtGpuCullItem *items = mt_alloc(engine->alloc, sizeof(MtGpuCullItem) * item_count);
+    MtGltfDrawData *draws = mt_alloc(engine->alloc, sizeof(MtGltfDrawData) * item_count);
+    // One per primitive of the current asset, never more than the items
+    MtDrawIndexedIndirectCommand *commands =
+        mt_alloc(engine->alloc, sizeof(MtDrawIndexedIndirectCommand) * item_count);
+    /*array*/ MtGpuCullBucket *buckets = NULL;
+
+    for (uint32_t i = 0; i < draw_count; i++)
+    {
+        transforms[i] = mt_transform_matrix(&comps->transform[model_draws[i].entity]);
+    }
+
+    uint32_t first_item = 0;
+    uint32_t i = 0;
+    while (i < draw_count)
+    {
+        MtGltfAsset *asset = model_draws[i].asset;
+        uint32_t primitive_count = mt_gltf_asset_draw_count(asset);
+
+        uint32_t first = i;
+        while (i < draw_count && model_draws[i].asset == asset)
+        {
+            i++;
+        }
+        uint32_t instance_count = i - first;
+
+        mt_gltf_asset_write_bounds(asset, &transforms[first], instance_count, &boxes[first_item]);
+        mt_gltf_asset_write_draws(
+            asset,
+            &transforms[first],
+            instance_count,
+            first_item,
+            NULL,
+            commands,
+            &draws[first_item]);
+
+        // Same primitive-major layout as the bounds and draws
+        for (uint32_t p = 0; p < primitive_count; p++)
+        {
+            for (uint32_t k = 0; k < instance_count; k++)
+            {
+                uint32_t item = first_item + p * instance_count + k;
+                MtAabb *box = &boxes[item];
+                items[item] = (MtGpuCullItem){
+                    .aabb_min = V4(box->min.x, box->min.y, box->min.z, 0.0f),
+                    .aabb_max = V4(box->max.x, box->max.y, box->max.z, 0.0f),
+                    .index_count = commands[p].index_count,
+                    .first_index = commands[p].first_index,
+                    .vertex_offset = commands[p].vertex_offset,
+                    .bucket = (uint32_t)mt_array_size(buckets),
+                    .command_base = first_item,
+                };
+            }
+        }
+
+        mt_array_push(
+            engine->alloc,
+            buckets,
+            ((MtGpuCullBucket){
+                .first_item = first_item,
+                .item_count = primitive_count * instance_count,
+                .user_data = asset,
+            }));
+
+        first_item += primitive_count * instance_count;
+    }
+
+    mt_gpu_culler_cull(
+        culler,
+        &scene->cam.uniform,
+        items,
+        item_count,
+        buckets,
+        (uint32_t)mt_array_size(buckets),
+        draws,
+        sizeof(MtGltfDrawData));
+
+    mt_array_free(engine->alloc, buckets);
+    mt_free(engine->alloc, commands);
+    mt_free(engine->alloc, draws);
+    mt_free(engine->alloc, items);
+    mt_free(engine->alloc, boxes);
+    mt_free(engine->alloc, transforms);
+    mt_array_free(engine->alloc, model_draws);
+}
+
+// Frustum culling of the instanced models. mt_model_cull_system starts it on the thread
+// pool, so that it runs while the frame waits in pass_begin, and mt_model_system consumes it.
+struct MtModelCull
+{
+    MtEngine *engine;
+    MtTaskGroup group;
+    // Started by mt_model_cull_system this frame and not consumed yet
+    bool pending;
+
+    MtFrustum frustum;
+    // Sorted by asset
+    /*array*/ ModelDraw *model_draws;
+    /*array*/ Mat4 *transforms;
+    // Per primitive and instance, primitive-major within each asset
+    /*array*/ MtAabb *boxes;
+    /*array*/ uint8_t *visible;
+};
+
+// Whether mt_model_system draws instanced, and then whether it draws indirect
+static bool models_instanced(MtEngine *engine, bool *indirect)
+{
+    bool bindless = engine->bindless && engine->pbr_bindless_pipeline;
+    *indirect = bindless && engine->pbr_indirect_pipeline;
+    return *indirect || (!bindless && engine->pbr_instanced_pipeline);
+}
+
+// Lists the models drawn instanced with their transforms, the rest is left to run_model_cull
+static void prepare_model_cull(MtEntityManager *em, MtScene *scene, bool indirect)
+{
+    MtEngine *engine = scene->engine;
+    MtModelCull *cull = scene->model_cull;
+    MtDefaultComponents *comps = (MtDefaultComponents *)em->components;
+
+    MtComponentMask comp_mask =
+        MT_COMP_BIT(MtDefaultComponents, transform) | MT_COMP_BIT(MtDefaultComponents, model);
+
+    mt_array_set_size(cull->model_draws, 0);
+    uint32_t instance_data_count = 0;
+
+    for (MtEntity e = 0; e < em->entity_count; ++e)
+    {
+        if ((em->masks[e] & comp_mask) != comp_mask) continue;
+
+        // Drawn one by one by mt_model_system
+        MtGltfAsset *asset = comps->model[e];
+        if (indirect && !mt_gltf_asset_in_geometry_arena(asset)) continue;
+
+        mt_array_push(engine->alloc, cull->model_draws, ((ModelDraw){asset, e}));
+        instance_data_count += mt_gltf_asset_draw_count(asset);
+    }
+
+    uint32_t draw_count = (uint32_t)mt_array_size(cull->model_draws);
+    if (draw_count > 0)
+    {
+        qsort(cull->model_draws, draw_count, sizeof(ModelDraw), compare_model_draws);
+    }
+
+    mt_array_set_size(cull->transforms, 0);
+    mt_array_add(engine->alloc, cull->transforms, draw_count);
+    mt_array_set_size(cull->boxes, 0);
+    mt_array_add(engine->alloc, cull->boxes, instance_data_count);
+    mt_array_set_size(cull->visible, 0);
+    mt_array_add(engine->alloc, cull->visible, instance_data_count);
+
+    for (uint32_t i = 0; i < draw_count; i++)
+    {
+        cull->transforms[i] = mt_transform_matrix(&comps->transform[cull->model_draws[i].entity]);
+    }
+
+    Mat4 view_proj = mat4_mul(scene->cam.uniform.view, scene->cam.uniform.proj);
+    mt_frustum_from_matrix(&cull->frustum, &view_proj);
+}
+
+static int32_t run_model_cull(void *arg)
+{
+    MtModelCull *cull = arg;
+
+    uint32_t draw_count = (uint32_t)mt_array_size(cull->model_draws);
+    uint32_t box_index = 0;
+    for (uint32_t i = 0; i < draw_count;)
+    {
+        MtGltfAsset *asset = cull->model_draws[i].asset;
+        uint32_t first = i;
+        while (i < draw_count && cull->model_draws[i].asset == asset)
+        {
+            i++;
+        }
+
+        mt_gltf_asset_write_bounds(
+            asset, &cull->transforms[first], i - first, &cull->boxes[box_index]);
+        box_index += mt_gltf_asset_draw_count(asset) * (i - first);
+    }
+
+    mt_frustum_cull_aabbs_parallel(
+        &cull->engine->thread_pool,
+        &cull->frustum,
+        cull->boxes,
+        (uint32_t)mt_array_size(cull->boxes),
+        cull->visible);
+
+    return 0;
+}
+
+static MtModelCull *get_model_cull(MtScene *scene)
+{
+    if (!scene->model_cull)
+    {
+        scene->model_cull = mt_alloc(scene->engine->alloc, sizeof(MtModelCull));
+        memset(scene->model_cull, 0, sizeof(MtModelCull));
+        scene->model_cull->engine = scene->engine;
+    }
+    return scene->model_cull;
+}
+
+void mt_model_cull_system(MtEntityManager *em, MtScene *scene)
+{
+    MtEngine *engine = scene->engine;
+
+    if (scene->gpu_culler) gpu_cull_models(em, scene);
+
+    bool indirect;
+    if (!models_instanced(engine, &indirect)) return;
+    if (indirect && scene->gpu_culler && mt_gpu_culler_has_draws(scene->gpu_culler)) return;
+
+    // The arrays are reused, the previous frame may not have consumed its cull
+    MtModelCull *cull = get_model_cull(scene);
+    mt_thread_pool_wait_group(&engine->thread_pool, &cull->group);
+
+    prepare_model_cull(em, scene, indirect);
+    cull->pending = true;
+    mt_thread_pool_enqueue_group(&engine->thread_pool, &cull->group, run_model_cull, cull);
+}
+
+void mt_model_cull_destroy(MtModelCull *cull)
+{
+    MtAllocator *alloc = cull->engine->alloc;
+
+    mt_thread_pool_wait_group(&cull->engine->thread_pool, &cull->group);
+    mt_array_free(alloc, cull->visible);
+    mt_array_free(alloc, cull->boxes);
+    mt_array_free(alloc, cull->transforms);
+    mt_array_free(alloc, cull->model_draws);
+    mt_free(alloc, cull);
+}
+
+// Draws models one by one with the bindless pipeline bound by the caller. Their per-draw
+// data goes in a single storage buffer at (1, 0) and their materials come from the engine's
+// material table, so nothing is bound per model. With outside_arena set, only the models
+// whose geometry is not in the geometry arena are drawn. Returns the number of draw calls.
+static uint32_t draw_models_bindless(
+    MtEntityManager *em, MtScene *scene, MtCmdBuffer *cb, bool outside_arena)
+{
+    MtEngine *engine = scene->engine;
+    MtDefaultComponents *comps = (MtDefaultComponents *)em->components;
+
+    MtComponentMask comp_mask =
+        MT_COMP_BIT(MtDefaultComponents, transform) | MT_COMP_BIT(MtDefaultComponents, model);
+
+    uint32_t draw_count = 0;
+    for (MtEntity e = 0; e < em->entity_count; ++e)
+    {
+        if ((em->masks[e] & comp_mask) != comp_mask) continue;
+        if (outside_arena && mt_gltf_asset_in_geometry_arena(comps->model[e])) continue;
+
+        draw_count += mt_gltf_asset_draw_count(comps->model[e]);
+    }
+
+    if (draw_count == 0) return 0;
+
+    MtGltfDrawData *draws =
+        mt_render.cmd_bind_storage_data(cb, sizeof(MtGltfDrawData) * draw_count, 1, 0);
+    mt_material_table_bind(engine->material_table, cb, 2);
+
+    uint32_t first_draw = 0;
+    for (MtEntity e = 0; e < em->entity_count; ++e)
+    {
+        if ((em->masks[e] & comp_mask) != comp_mask) continue;
+        if (outside_arena && mt_gltf_asset_in_geometry_arena(comps->model[e])) continue;
+
+        Mat4 mat = mt_transform_matrix(&comps->transform[e]);
+        first_draw += mt_gltf_asset_draw_bindless(
+            comps->model[e], cb, &mat, first_draw, &draws[first_draw]);
+    }
+
+    return draw_count;
+}
+
+// Every primitive of an asset is drawn once for all the entities using that asset.
+// Per-instance data goes in a single storage buffer at (1, 0), indexed by the instance
+// index. With indirect set, the draws of each asset are also submitted as one indirect draw.
+// Primitives are frustum culled per instance on the thread pool, started by
+// mt_model_cull_system before the pass began, or culled on the GPU there instead.
+static void model_system_instanced(
+    MtEntityManager *em, MtScene *scene, MtCmdBuffer *cb, MtPipeline *pipeline, bool indirect)
+{
+    MtEngine *engine = scene->engine;
+    MtDefaultComponents *comps = (MtDefaultComponents *)em->components;
+    MtModelDrawStats *stats = &engine->model_stats;
+
+    bool gpu_culled = indirect && scene->gpu_culler && mt_gpu_culler_has_draws(scene->gpu_culler);
+
+    MtComponentMask comp_mask =
+        MT_COMP_BIT(MtDefaultComponents, transform) | MT_COMP_BIT(MtDefaultComponents, model);
+
+    for (MtEntity e = 0; e < em->entity_count; ++e)
+    {
+        if ((em->masks[e] & comp_mask) != comp_mask) continue;
+
+        stats->instances++;
+        stats->naive_draw_calls += mt_gltf_asset_draw_count(comps->model[e]);
+    }
+
+    if (indirect)
+    {
+        // Expects the bindless pipeline to be bound by the caller
+        stats->draw_calls += draw_models_bindless(em, scene, cb, true);
+    }
+
+    if (gpu_culled)
+    {
+        mt_render.cmd_bind_pipeline(cb, pipeline);
+        mt_render.cmd_bind_uniform(cb, &scene->cam.uniform, sizeof(scene->cam.uniform), 0, 0);
+        mt_environment_bind(&scene->env, cb, 3);
+        mt_material_table_bind(engine->material_table, cb, 2);
+        mt_geometry_arena_bind(engine->geometry_arena, cb);
+
+        stats->draw_calls += mt_gpu_culler_draw(scene->gpu_culler, cb, NULL, 1);
+        return;
+    }
+
+    MtModelCull *cull = get_model_cull(scene);
+    if (cull->pending)
+    {
+        mt_thread_pool_wait_group(&engine->thread_pool, &cull->group);
+    }
+    else
+    {
+        // mt_model_cull_system was not called this frame
+        prepare_model_cull(em, scene, indirect);
+        run_model_cull(cull);
+    }
+    cull->pending = false;
+
+    ModelDraw *model_draws = cull->model_draws;
+    Mat4 *transforms = cull->transforms;
+    uint8_t *visible = cull->visible;
+
+    uint32_t draw_count = (uint32_t)mt_array_size(model_draws);
+    uint32_t instance_data_count = (uint32_t)mt_array_size(visible);
+    if (instance_data_count == 0) return;
+
+    uint32_t bucket_count = 0;
+    uint32_t command_count = 0;
+    for (uint32_t i = 0; i < draw_count;)
+    {
+        MtGltfAsset *asset = model_draws[i].asset;
+        while (i < draw_count && model_draws[i].asset == asset)
+        {
+            i++;
+        }
+
+        command_count += mt_gltf_asset_draw_count(asset);
+        bucket_count++;
+    }
+
+    for (uint32_t i = 0; i < instance_data_count; i++)
+    {
+        stats->culled += !visible[i];
+    }
+
+    mt_render.cmd_bind_pipeline(cb, pipeline);
+    mt_render.cmd_bind_uniform(cb, &scene->cam.uniform, sizeof(scene->cam.uniform), 0, 0);
+    mt_environment_bind(&scene->env, cb, 3);
+
+    MtGltfDrawData *draws =
+        mt_render.cmd_bind_storage_data(cb, sizeof(MtGltfDrawData) * instance_data_count, 1, 0);
+
+    MtBuffer *command_buffer = NULL;
+    size_t command_offset = 0;
+    MtDrawIndexedIndirectCommand *commands = NULL;
+
+    MtBuffer *count_buffer = NULL;
+    size_t count_offset = 0;
+    uint32_t *counts = NULL;
+
+    if (indirect)
+    {
+        commands = mt_render.cmd_alloc_transient_data(
+            cb,
+            sizeof(MtDrawIndexedIndirectCommand) * command_count,
+            &command_buffer,
+            &command_offset);
+        counts = mt_render.cmd_alloc_transient_data(
+            cb, sizeof(uint32_t) * bucket_count, &count_buffer, &count_offset);
+
+        mt_material_table_bind(engine->material_table, cb, 2);
+        mt_geometry_arena_bind(engine->geometry_arena, cb);
+    }
+
+    uint32_t instance_data_index = 0;
+    uint32_t command_index = 0;
+    uint32_t bucket = 0;
+    uint32_t i = 0;
+    while (i < draw_count)
+    {
+        MtGltfAsset *asset = model_draws[i].asset;
+        uint32_t primitive_count = mt_gltf_asset_draw_count(asset);
+
+        uint32_t first = i;
+        while (i < draw_count && model_draws[i].asset == asset)
+        {
+            i++;
+        }
+        uint32_t instance_count = i - first;
+
+        if (indirect)
+        {
+            uint32_t visible_commands = mt_gltf_asset_write_draws(
+                asset,
+                &transforms[first],
+                instance_count,
+                instance_data_index,
+                &visible[instance_data_index],
+                &commands[command_index],
+                &draws[instance_data_index]);
+
+            counts[bucket] = visible_commands;
+
+            if (visible_commands > 0)
+            {
+                mt_render.cmd_draw_indexed_indirect_count(
+                    cb,
+                    command_buffer,
+                    command_offset + sizeof(MtDrawIndexedIndirectCommand) * command_index,
+                    count_buffer,
+                    count_offset + sizeof(uint32_t) * bucket,
+                    primitive_count);
+            }
+
+            stats->draw_calls += visible_commands;
+        }
+        else
+        {
+            stats->draw_calls += mt_gltf_asset_draw_instanced(
+                asset,
+                cb,
+                &transforms[first],
+                instance_count,
+                instance_data_index,
+                &visible[instance_data_index],
+                &draws[instance_data_index],
+                2);
+        }
+
+        instance_data_index += primitive_count * instance_count;
+        command_index += primitive_count;
+        bucket++;
+    }
+}
+
+// Texture streaming feedback: every model asks for the mips its size on screen needs
+static void request_texture_mips(MtEntityManager *em, MtScene *scene)
+{
+    MtEngine *engine = scene->engine;
+    MtDefaultComponents *comps = (MtDefaultComponents *)em->components;
+
+    uint32_t width, height;
+    mt_window.get_size(engine->window, &width, &height);
+
+    MtComponentMask comp_mask =
+        MT_COMP_BIT(MtDefaultComponents, transform) | MT_COMP_BIT(MtDefaultComponents, model);
+
+    for (MtEntity e = 0; e < em->entity_count; ++e)
+    {
+        if ((em->masks[e] & comp_mask) != comp_mask) continue;
+
+        Mat4 transform = mt_transform_matrix(&comps->transform[e]);
+        mt_gltf_asset_request_mips(comps->model[e], &transform, &scene->cam.uniform, (float)height);
+    }
+}
+
 void mt_model_system(MtEntityManager *em, MtScene *scene, MtCmdBuffer *cb)
 {
-    mt_render.cmd_bind_pipeline(cb, scene->engine->pbr_pipeline->pipeline);
+    MtEngine *engine = scene->engine;
+    bool bindless = engine->bindless && engine->pbr_bindless_pipeline;
+
+    memset(&engine->model_stats, 0, sizeof(engine->model_stats));
+
+    request_texture_mips(em, scene);
+
+    if (bindless && engine->pbr_indirect_pipeline)
+    {
+        mt_render.cmd_bind_pipeline(cb, engine->pbr_bindless_pipeline->pipeline);
+        mt_render.cmd_bind_uniform(cb, &scene->cam.uniform, sizeof(scene->cam.uniform), 0, 0);
+        mt_environment_bind(&scene->env, cb, 3);
+
+        model_system_instanced(em, scene, cb, engine->pbr_indirect_pipeline->pipeline, true);
+        return;
+    }
+
+    if (!bindless && engine->pbr_instanced_pipeline)
+    {
+        model_system_instanced(em, scene, cb, engine->pbr_instanced_pipeline->pipeline, false);
+        return;
+    }
+
+    if (bindless)
+    {
+        mt_render.cmd_bind_pipeline(cb, engine->pbr_bindless_pipeline->pipeline);
+    }
+    else
+    {
+        mt_render.cmd_bind_pipeline(cb, engine->pbr_pipeline->pipeline);
+    }
     mt_render.cmd_bind_uniform(cb, &scene->cam.uniform, sizeof(scene->cam.uniform), 0, 0);
     mt_environment_bind(&scene->env, cb, 3);
 
@@ -59,9 +616,21 @@ void mt_model_system(MtEntityManager *em, MtScene *scene, MtCmdBuffer *cb)
     {
         if ((em->masks[e] & comp_mask) != comp_mask) continue;
 
-        Mat4 mat = mt_transform_matrix(&comps->transform[e]);
+        uint32_t primitive_count = mt_gltf_asset_draw_count(comps->model[e]);
+        engine->model_stats.instances++;
+        engine->model_stats.naive_draw_calls += primitive_count;
+
+        if (!bindless)
+        {
+            Mat4 mat = mt_transform_matrix(&comps->transform[e]);
+            mt_gltf_asset_draw(comps->model[e], cb, &mat, 1, 2);
+            engine->model_stats.draw_calls += primitive_count;
+        }
+    }
 
-        mt_gltf_asset_draw(comps->model[e], cb, &mat, 1, 2);
+    if (bindless)
+    {
+        engine->model_stats.draw_calls += draw_models_bindless(em, scene, cb, false);
     }
 }
 
@@ -0,0 +1,586 @@
+#include <motor/engine/texture_streamer.h>
+
+#include <motor/base/log.h>
+#include <motor/base/array.h>
+#include <motor/base/allocator.h>
+#include <motor/base/vfs.h>
+#include <motor/base/threads.h>
+#include <motor/base/thread_pool.h>
+#include <motor/graphics/renderer.h>
+#include <motor/engine/engine.h>
+#include <motor/engine/material_table.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tinyktx.h"
+
+// Mips up to this size are uploaded at load and never evicted
+#define TAIL_SIZE 64
+#define MAX_STREAMS_IN_FLIGHT 4
+
+struct MtStreamedTexture
+{
+    MtTextureStreamer *ts;
+    MtImage **image;
+    // Bindless slot of *image, NULL until registered
+    uint32_t *bindless_index;
+
+    // KTX file at offset in path
+    char *path;
+    uint64_t offset;
+    uint64_t size;
+
+    MtFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_count;
+    // BC7 stores 4x4 texel blocks
+    uint32_t block_dim;
+    uint32_t block_size;
+
+    uint32_t tail_mip;
+    // Finest mip of *image
+    uint32_t resident_mip;
+
+    // Finest mip asked for during the current frame
+    uint32_t requested_mip;
+    uint64_t last_requested_frame;
+
+    // Set while a stream job runs, the job leaves its result in streamed_image
+    bool streaming;
+    uint32_t streamed_mip;
+    MtImage *streamed_image;
+    // Bytes set aside for an upgrade until it is swapped in
+    uint64_t reserved;
+
+    // Reading the file failed, the texture stays at its current mips
+    bool failed;
+    // Removed while streaming, freed once the job is done
+    bool removed;
+};
+
+// Image replaced by a swap, which frames recorded before it may still sample
+typedef struct RetiredImage
+{
+    MtImage *image;
+    uint32_t bindless_index;
+    uint64_t frame;
+} RetiredImage;
+
+struct MtTextureStreamer
+{
+    MtEngine *engine;
+    MtAllocator *alloc;
+    MtMutex mutex;
+    MtTaskGroup jobs;
+
+    /*array*/ MtStreamedTexture **textures;
+    // In the order of their frames
+    /*array*/ RetiredImage *retired;
+
+    uint64_t frame;
+    uint64_t budget;
+    uint64_t usage;
+    uint64_t reserved;
+    uint32_t in_flight;
+};
+
+static uint64_t level_size(const MtStreamedTexture *tex, uint32_t mip)
+{
+    // Same rounding as the KTX reader
+    uint64_t width = (tex->width >> mip) / tex->block_dim;
+    uint64_t height = (tex->height >> mip) / tex->block_dim;
+    return width * height * tex->block_size;
+}
+
+static uint64_t image_size(const MtStreamedTexture *tex, uint32_t first_mip)
+{
+    uint64_t size = 0;
+    for (uint32_t mip = first_mip; mip < tex->mip_count; mip++)
+    {
+        size += level_size(tex, mip);
+    }
+    return size;
+}
+
+// Creates an image holding the mips from first_mip down
+static MtImage *upload_mips(MtStreamedTexture *tex, const ktx_data_t *data, uint32_t first_mip)
+{
+    MtDevice *dev = tex->ts->engine->device;
+
+    MtImage *image = mt_render.create_image(
+        dev,
+        &(MtImageCreateInfo){
+            .width = MT_MAX(tex->width >> first_mip, 1u),
+            .height = MT_MAX(tex->height >> first_mip, 1u),
+            .mip_count = tex->mip_count - first_mip,
+            .format = tex->format,
+        });
+
+    for (uint32_t mip = first_mip; mip < tex->mip_count; mip++)
+    {
+        mt_render.transfer_to_image(
+            dev,
+            &(MtImageCopyView){.image = image, .mip_level = mip - first_mip},
+            (uint32_t)ktx_get_slice_size(data, mip),
+            ktx_get_slice(data, mip, 0, 0, 0));
+    }
+
+    return image;
+}
+
+static int32_t stream_job(void *arg)
+{
+    MtStreamedTexture *tex = arg;
+    MtTextureStreamer *ts = tex->ts;
+
+    mt_render.set_thread_id(mt_thread_pool_get_task_id());
+
+    MtImage *image = NULL;
+
+    // The mips are copied straight from the mapped file or pack to the staging buffer
+    MtVfs *vfs = &ts->engine->vfs;
+    MtVfsFile file;
+    if (mt_vfs_open(vfs, tex->path, &file))
+    {
+        ktx_data_t data;
+        if (tex->offset <= file.size && tex->size <= file.size - tex->offset &&
+            ktx_read(file.data + tex->offset, tex->size, &data) == KTX_SUCCESS)
+        {
+            if (data.mipmap_level_count == tex->mip_count && data.pixel_width == tex->width &&
+                data.pixel_height == tex->height)
+            {
+                image = upload_mips(tex, &data, tex->streamed_mip);
+            }
+        }
+        mt_vfs_close(vfs, &file);
+    }
+
+    if (!image)
+    {
+        mt_log_error("Failed to stream texture mips from %s", tex->path);
+    }
+
+    mt_mutex_lock(&ts->mutex);
+    tex->streamed_image = image;
+    tex->failed = image == NULL;
+    tex->streaming = false;
+    ts->in_flight--;
+    mt_mutex_unlock(&ts->mutex);
+
+    return 0;
+}
+
+MtTextureStreamer *mt_texture_streamer_create(MtEngine *engine)
+{
+    MtTextureStreamer *ts = mt_alloc(engine->alloc, sizeof(MtTextureStreamer));
+    memset(ts, 0, sizeof(*ts));
+
+    ts->engine = engine;
+    ts->alloc = engine->alloc;
+    mt_mutex_init(&ts->mutex);
+
+    return ts;
+}
+
+static void free_texture(MtTextureStreamer *ts, MtStreamedTexture *tex)
+{
+    // Streamed images are only used once swapped in, their upload was waited for
+    if (tex->streamed_image)
+    {
+        mt_render.destroy_image_no_wait(ts->engine->device, tex->streamed_image);
+    }
+    mt_free(ts->alloc, tex->path);
+    mt_free(ts->alloc, tex);
+}
+
+void mt_texture_streamer_destroy(MtTextureStreamer *ts)
+{
+    MtDevice *dev = ts->engine->device;
+
+    mt_thread_pool_wait_group(&ts->engine->thread_pool, &ts->jobs);
+
+    if (mt_array_size(ts->retired) > 0)
+    {
+        mt_render.device_wait_idle(dev);
+    }
+    for (uint32_t i = 0; i < mt_array_size(ts->retired); i++)
+    {
+        mt_render.destroy_image_no_wait(dev, ts->retired[i].image);
+        mt_render.unregister_bindless_image(dev, ts->retired[i].bindless_index);
+    }
+    mt_array_free(ts->alloc, ts->retired);
+
+    // Only textures removed while streaming are left
+    for (uint32_t i = 0; i < mt_array_size(ts->textures); i++)
+    {
+        assert(ts->textures[i]->removed);
+        free_texture(ts, ts->textures[i]);
+    }
+    mt_array_free(ts->alloc, ts->textures);
+
+    mt_mutex_destroy(&ts->mutex);
+    mt_free(ts->alloc, ts);
+}
+
+void mt_texture_streamer_set_budget(MtTextureStreamer *ts, uint64_t budget)
+{
+    mt_mutex_lock(&ts->mutex);
+    ts->budget = budget;
+    mt_mutex_unlock(&ts->mutex);
+}
+
+MtStreamedTexture *mt_texture_streamer_add(
+    MtTextureStreamer *ts,
+    MtImage **image,
+    const char *path,
+    uint64_t offset,
+    const uint8_t *data,
+    uint64_t size)
+{
+    ktx_data_t ktx;
+    if (ktx_read(data, size, &ktx) != KTX_SUCCESS)
+    {
+        return NULL;
+    }
+
+    MtStreamedTexture tex = {
+        .ts = ts,
+        .image = image,
+        .offset = offset,
+        .size = size,
+        .width = ktx.pixel_width,
+        .height = ktx.pixel_height,
+        .mip_count = ktx.mipmap_level_count,
+        .block_dim = 1,
+    };
+
+    switch (ktx.internal_format)
+    {
+        case KTX_RGBA8:
+            tex.format = MT_FORMAT_RGBA8_UNORM;
+            tex.block_size = sizeof(uint32_t);
+            break;
+        case KTX_RGBA16F:
+            tex.format = MT_FORMAT_RGBA16_SFLOAT;
+            tex.block_size = 2 * sizeof(uint32_t);
+            break;
+        case KTX_COMPRESSED_RGBA_BPTC_UNORM:
+            tex.format = MT_FORMAT_BC7_UNORM_BLOCK;
+            tex.block_size = 16;
+            tex.block_dim = 4;
+            break;
+        case KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+            tex.format = MT_FORMAT_BC7_SRGB_BLOCK;
+            tex.block_size = 16;
+            tex.block_dim = 4;
+            break;
+        default: break;
+    }
+
+    // Cubemaps, arrays and volumes are loaded whole
+    if (tex.block_size == 0 || ktx.mipmap_level_count <= 1 || ktx.face_count != 1 ||
+        ktx.array_element_count != 1 || ktx.pixel_depth != 1)
+    {
+        return NULL;
+    }
+
+    while (tex.tail_mip + 1 < tex.mip_count &&
+           MT_MAX(tex.width, tex.height) >> tex.tail_mip > TAIL_SIZE)
+    {
+        tex.tail_mip++;
+    }
+    tex.resident_mip = tex.tail_mip;
+    tex.requested_mip = tex.tail_mip;
+
+    MtStreamedTexture *texture = mt_alloc(ts->alloc, sizeof(MtStreamedTexture));
+    *texture = tex;
+    texture->path = mt_strdup(ts->alloc, path);
+
+    *image = upload_mips(texture, &ktx, tex.tail_mip);
+
+    mt_mutex_lock(&ts->mutex);
+    mt_array_push(ts->alloc, ts->textures, texture);
+    ts->usage += image_size(texture, texture->resident_mip);
+    mt_mutex_unlock(&ts->mutex);
+
+    return texture;
+}
+
+void mt_texture_streamer_remove(MtTextureStreamer *ts, MtStreamedTexture *texture)
+{
+    mt_mutex_lock(&ts->mutex);
+
+    ts->usage -= image_size(texture, texture->resident_mip);
+    mt_render.destroy_image(ts->engine->device, *texture->image);
+    *texture->image = NULL;
+
+    if (texture->streaming)
+    {
+        ts->reserved -= texture->reserved;
+        texture->removed = true;
+        mt_mutex_unlock(&ts->mutex);
+        return;
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(ts->textures); i++)
+    {
+        if (ts->textures[i] == texture)
+        {
+            ts->textures[i] = *mt_array_last(ts->textures);
+            mt_array_pop(ts->textures);
+            break;
+        }
+    }
+
+    ts->reserved -= texture->reserved;
+    free_texture(ts, texture);
+
+    mt_mutex_unlock(&ts->mutex);
+}
+
+void mt_texture_streamer_register_bindless(
+    MtTextureStreamer *ts, MtStreamedTexture *texture, uint32_t *index)
+{
+    // Under the lock, so the image can't be swapped before its slot is tracked
+    mt_mutex_lock(&ts->mutex);
+    *index = mt_render.register_bindless_image(ts->engine->device, *texture->image);
+    texture->bindless_index = *index != UINT32_MAX ? index : NULL;
+    mt_mutex_unlock(&ts->mutex);
+}
+
+void mt_texture_streamer_request(
+    MtTextureStreamer *ts, MtStreamedTexture *texture, float pixel_size)
+{
+    if (pixel_size <= 0.0f) return;
+
+    // One texel per pixel, as if the texture was mapped once across the surface
+    float texels = (float)MT_MAX(texture->width, texture->height);
+    float lod = floorf(log2f(texels / pixel_size));
+    uint32_t mip = lod <= 0.0f ? 0 : MT_MIN((uint32_t)lod, texture->tail_mip);
+
+    texture->requested_mip = MT_MIN(texture->requested_mip, mip);
+    texture->last_requested_frame = ts->frame;
+}
+
+static void start_stream(MtTextureStreamer *ts, MtStreamedTexture *tex, uint32_t mip)
+{
+    assert(!tex->streaming && !tex->streamed_image);
+
+    uint64_t new_size = image_size(tex, mip);
+    uint64_t old_size = image_size(tex, tex->resident_mip);
+    tex->reserved = new_size > old_size ? new_size - old_size : 0;
+    ts->reserved += tex->reserved;
+
+    tex->streaming = true;
+    tex->streamed_mip = mip;
+    ts->in_flight++;
+
+    mt_thread_pool_enqueue_group(&ts->engine->thread_pool, &ts->jobs, stream_job, tex);
+}
+
+typedef struct StreamCandidate
+{
+    MtStreamedTexture *tex;
+    uint32_t mip;
+    uint64_t priority;
+} StreamCandidate;
+
+static int compare_candidates(const void *a, const void *b)
+{
+    uint64_t x = ((const StreamCandidate *)a)->priority;
+    uint64_t y = ((const StreamCandidate *)b)->priority;
+    return (x < y) - (x > y);
+}
+
+static void retire_image_no_lock(
+    MtTextureStreamer *ts, MtImage *image, uint32_t bindless_index, uint64_t frame)
+{
+    RetiredImage retired = {image, bindless_index, frame};
+    mt_array_push(ts->alloc, ts->retired, retired);
+}
+
+// The new image goes to a slot of its own, the old slot may still be read by frames in flight
+static void swap_image_no_lock(MtTextureStreamer *ts, MtStreamedTexture *tex, uint64_t frame)
+{
+    MtDevice *dev = ts->engine->device;
+
+    ts->reserved -= tex->reserved;
+    tex->reserved = 0;
+
+    uint32_t old_index = UINT32_MAX;
+    if (tex->bindless_index)
+    {
+        uint32_t index = mt_render.register_bindless_image(dev, tex->streamed_image);
+        if (index == UINT32_MAX)
+        {
+            // The table is full, the texture keeps its mips
+            retire_image_no_lock(ts, tex->streamed_image, UINT32_MAX, frame);
+            tex->streamed_image = NULL;
+            tex->failed = true;
+            return;
+        }
+
+        old_index = *tex->bindless_index;
+        *tex->bindless_index = index;
+        mt_material_table_invalidate(ts->engine->material_table);
+    }
+
+    ts->usage -= image_size(tex, tex->resident_mip);
+    ts->usage += image_size(tex, tex->streamed_mip);
+
+    retire_image_no_lock(ts, *tex->image, old_index, frame);
+    *tex->image = tex->streamed_image;
+    tex->streamed_image = NULL;
+    tex->resident_mip = tex->streamed_mip;
+}
+
+void mt_texture_streamer_update(MtTextureStreamer *ts)
+{
+    MtDevice *dev = ts->engine->device;
+
+    mt_mutex_lock(&ts->mutex);
+
+    uint64_t frame = ts->frame++;
+
+    // Frames recorded before a swap may still be in flight, the ones after it use the new image
+    uint32_t done = 0;
+    while (done < mt_array_size(ts->retired) &&
+           ts->retired[done].frame + MT_MAX_FRAMES_IN_FLIGHT < frame)
+    {
+        done++;
+    }
+
+    /*array*/ RetiredImage *old_images = NULL;
+    if (done > 0)
+    {
+        mt_array_add(ts->alloc, old_images, done);
+        memcpy(old_images, ts->retired, sizeof(*old_images) * done);
+
+        uint32_t left = (uint32_t)mt_array_size(ts->retired) - done;
+        memmove(ts->retired, ts->retired + done, sizeof(*ts->retired) * left);
+        mt_array_set_size(ts->retired, left);
+    }
+
+    /*array*/ StreamCandidate *upgrades = NULL;
+    /*array*/ StreamCandidate *evictions = NULL;
+
+    for (uint32_t i = 0; i < mt_array_size(ts->textures);)
+    {
+        MtStreamedTexture *tex = ts->textures[i];
+
+        if (tex->removed)
+        {
+            if (!tex->streaming)
+            {
+                ts->textures[i] = *mt_array_last(ts->textures);
+                mt_array_pop(ts->textures);
+                free_texture(ts, tex);
+                continue;
+            }
+            i++;
+            continue;
+        }
+
+        if (tex->streamed_image)
+        {
+            swap_image_no_lock(ts, tex, frame);
+        }
+
+        if (!tex->streaming && !tex->failed)
+        {
+            if (tex->last_requested_frame == frame && tex->requested_mip < tex->resident_mip)
+            {
+                // Textures furthest from what they need go first
+                StreamCandidate candidate = {
+                    tex, tex->requested_mip, tex->resident_mip - tex->requested_mip};
+                mt_array_push(ts->alloc, upgrades, candidate);
+            }
+            else if (tex->last_requested_frame < frame && tex->resident_mip < tex->tail_mip)
+            {
+                // Least recently used first
+                StreamCandidate candidate = {
+                    tex, tex->tail_mip, frame - tex->last_requested_frame};
+                mt_array_push(ts->alloc, evictions, candidate);
+            }
+        }
+
+        tex->requested_mip = tex->tail_mip;
+        i++;
+    }
+
+    if (upgrades)
+    {
+        qsort(upgrades, mt_array_size(upgrades), sizeof(*upgrades), compare_candidates);
+    }
+    if (evictions)
+    {
+        qsort(evictions, mt_array_size(evictions), sizeof(*evictions), compare_candidates);
+    }
+
+    // Bytes that have to be given back before the next upgrade fits
+    uint64_t needed = 0;
+    for (uint32_t i = 0; i < mt_array_size(upgrades); i++)
+    {
+        if (ts->in_flight >= MAX_STREAMS_IN_FLIGHT) break;
+
+        MtStreamedTexture *tex = upgrades[i].tex;
+        uint64_t growth = image_size(tex, upgrades[i].mip) - image_size(tex, tex->resident_mip);
+
+        if (ts->budget > 0 && ts->usage + ts->reserved + growth > ts->budget)
+        {
+            // Retried next frame, once unused mips were given back
+            needed = ts->usage + ts->reserved + growth - ts->budget;
+            break;
+        }
+
+        start_stream(ts, tex, upgrades[i].mip);
+    }
+
+    if (ts->budget > 0 && ts->usage + ts->reserved > ts->budget)
+    {
+        needed = MT_MAX(needed, ts->usage + ts->reserved - ts->budget);
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(evictions) && needed > 0; i++)
+    {
+        if (ts->in_flight >= MAX_STREAMS_IN_FLIGHT) break;
+
+        MtStreamedTexture *tex = evictions[i].tex;
+        uint64_t freed = image_size(tex, tex->resident_mip) - image_size(tex, evictions[i].mip);
+        start_stream(ts, tex, evictions[i].mip);
+        needed -= MT_MIN(needed, freed);
+    }
+
+    mt_mutex_unlock(&ts->mutex);
+
+    for (uint32_t i = 0; i < mt_array_size(old_images); i++)
+    {
+        mt_render.destroy_image_no_wait(dev, old_images[i].image);
+        mt_render.unregister_bindless_image(dev, old_images[i].bindless_index);
+    }
+
+    mt_array_free(ts->alloc, old_images);
+    mt_array_free(ts->alloc, upgrades);
+    mt_array_free(ts->alloc, evictions);
+}
+
+void mt_texture_streamer_get_stats(MtTextureStreamer *ts, MtTextureStreamerStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    mt_mutex_lock(&ts->mutex);
+    for (uint32_t i = 0; i < mt_array_size(ts->textures); i++)
+    {
+        MtStreamedTexture *tex = ts->textures[i];
+        if (tex->removed) continue;
+
+        stats->texture_count++;
+        stats->streaming_count += tex->streaming;
+        stats->full_bytes += image_size(tex, 0);
+    }
+    stats->resident_bytes = ts->usage;
+    mt_mutex_unlock(&ts->mutex);
+}
@@ -112,7 +112,8 @@ static inline uint32_t get_block_size(uint32_t internal_format)
     }
 }
 
-ktx_result_t ktx_read_from_file(const char *filename, uint8_t **raw_data, ktx_data_t *data)
+// Reads in chunks since the size of pipes and the like is not known up front
+static ktx_result_t read_whole_file(const char *filename, ktx_data_t *data)
 {
     FILE *file = fopen(filename, "rb");
     if (!file)
@@ -120,25 +121,67 @@ ktx_result_t ktx_read_from_file(const char *filename, uint8_t **raw_data, ktx_da
         return KTX_FAILED_TO_OPEN_FILE;
     }
 
-    fseek(file, 0, SEEK_END);
-    size_t size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    *raw_data = malloc(size);
-    fread(*raw_data, size, 1, file);
+    uint8_t *file_data = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    bool failed = false;
+    while (!failed)
+    {
+        if (size == capacity)
+        {
+            capacity = MAX(capacity * 2, 1 << 16);
+            uint8_t *new_data = realloc(file_data, capacity);
+            failed = !new_data;
+            if (failed) break;
+            file_data = new_data;
+        }
 
-    ktx_result_t result = ktx_read(*raw_data, size, data);
+        size_t read = fread(file_data + size, 1, capacity - size, file);
+        size += read;
+        if (read == 0) break;
+    }
 
+    failed = failed || ferror(file) || size == 0;
     fclose(file);
 
+    if (failed)
+    {
+        free(file_data);
+        return KTX_FAILED_TO_OPEN_FILE;
+    }
+
+    ktx_result_t result = ktx_read(file_data, size, data);
+    data->file_data = file_data;
     return result;
 }
 
-ktx_result_t ktx_read(uint8_t *raw_data, size_t raw_data_size, ktx_data_t *data)
+ktx_result_t ktx_read_from_file(const char *filename, ktx_data_t *data)
 {
+    memset(data, 0, sizeof(*data));
+
+    MtFileMapping mapping;
+    if (!mt_file_map(&mapping, filename))
+    {
+        // Not every file can be mapped, pipes and some network file systems among them
+        return read_whole_file(filename, data);
+    }
+
+    ktx_result_t result = ktx_read(mapping.data, mapping.size, data);
+    data->mapping = mapping;
+    return result;
+}
+
+ktx_result_t ktx_read(const uint8_t *raw_data, size_t raw_data_size, ktx_data_t *data)
+{
+    memset(data, 0, sizeof(*data));
+
     size_t pos = 0;
 
     ktx_header_t header;
+    if (raw_data_size < sizeof(ktx_header_t))
+    {
+        return KTX_WRONG_IDENTIFIER;
+    }
     memcpy(&header, raw_data, sizeof(ktx_header_t));
 
     pos += sizeof(ktx_header_t);
@@ -153,7 +196,8 @@ ktx_result_t ktx_read(uint8_t *raw_data, size_t raw_data_size, ktx_data_t *data)
     assert(header.endianness == 0x04030201);
 
     *data = (ktx_data_t){
-        .raw_data = raw_data,
+        .raw_data      = raw_data,
+        .raw_data_size = raw_data_size,
 
         .pixel_width  = header.pixel_width,
         .pixel_height = header.pixel_height,
@@ -171,41 +215,41 @@ ktx_result_t ktx_read(uint8_t *raw_data, size_t raw_data_size, ktx_data_t *data)
         .base_internal_format = header.gl_base_internal_format,
     };
 
-    uint32_t kv_bytes_left = header.bytes_of_key_value_data;
-
-    while (kv_bytes_left > 0)
+    if (data->mipmap_level_count > KTX_MAX_MIP_LEVELS || data->face_count > 6 ||
+        data->pixel_width > KTX_MAX_DIMENSION || data->pixel_height > KTX_MAX_DIMENSION ||
+        data->pixel_depth > KTX_MAX_DIMENSION ||
+        data->array_element_count > KTX_MAX_ARRAY_ELEMENTS ||
+        raw_data_size - pos < header.bytes_of_key_value_data)
     {
-        uint32_t key_and_value_byte_size = *((uint32_t *)(raw_data + pos));
-        pos += sizeof(key_and_value_byte_size);
-        kv_bytes_left -= sizeof(key_and_value_byte_size);
-
-        pos += key_and_value_byte_size;
-        kv_bytes_left -= key_and_value_byte_size;
-
-        uint32_t padding = 3 - ((key_and_value_byte_size + 3) % 4);
-        pos += padding;
-        kv_bytes_left -= padding;
+        return KTX_INVALID_DATA;
     }
 
-    uint32_t block_size = get_block_size(header.gl_internal_format);
-    assert(block_size > 0);
+    // Key/value pairs are skipped
+    pos += header.bytes_of_key_value_data;
 
-    data->mip_levels = malloc(sizeof(ktx_mip_level_t) * data->mipmap_level_count);
+    uint32_t block_size = get_block_size(header.gl_internal_format);
+    if (block_size == 0)
+    {
+        return KTX_INVALID_DATA;
+    }
 
     for (uint32_t mip_level = 0; mip_level < data->mipmap_level_count; mip_level++)
     {
-        data->mip_levels[mip_level].array_elements =
-            malloc(sizeof(ktx_array_element_t) * data->array_element_count);
+        if (raw_data_size - pos < sizeof(uint32_t))
+        {
+            return KTX_INVALID_DATA;
+        }
 
-        uint32_t image_size = *((uint32_t *)(raw_data + pos));
-        pos += sizeof(image_size);
+        // Only used to skip the level, which the sizes below already do
+        pos += sizeof(uint32_t);
 
-        uint32_t mip_width  = header.pixel_width / (1 << mip_level);
-        uint32_t mip_height = header.pixel_height / (1 << mip_level);
+        size_t mip_width  = header.pixel_width / ((size_t)1 << mip_level);
+        size_t mip_height = header.pixel_height / ((size_t)1 << mip_level);
 
         switch (header.gl_internal_format)
         {
             case KTX_COMPRESSED_RGBA_BPTC_UNORM:
+            case KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
             {
                 mip_width >>= 2;
                 mip_height >>= 2;
@@ -214,50 +258,64 @@ ktx_result_t ktx_read(uint8_t *raw_data, size_t raw_data_size, ktx_data_t *data)
             default: break;
         }
 
-        for (uint32_t layer = 0; layer < data->array_element_count; layer++)
+        // Each size is checked against what is left before it grows, so nothing can wrap
+        size_t left  = raw_data_size - pos;
+        size_t faces = (size_t)data->face_count * data->array_element_count;
+
+        uint64_t level_size = (uint64_t)mip_width * mip_height * block_size;
+        if (level_size > left / data->pixel_depth)
         {
-            for (uint32_t face = 0; face < data->face_count; face++)
-            {
-                data->mip_levels[mip_level].array_elements[layer].faces[face].slices =
-                    malloc(sizeof(ktx_slice_t) * data->pixel_depth);
-                for (uint32_t z_slice = 0; z_slice < data->pixel_depth; z_slice++)
-                {
-                    data->mip_levels[mip_level]
-                        .array_elements[layer]
-                        .faces[face]
-                        .slices[z_slice]
-                        .data = &data->raw_data[pos];
-
-                    uint32_t slice_size = mip_width * mip_height * block_size;
-                    pos += slice_size;
-                }
-
-                // cube padding
-                pos = ALIGN_MASK(pos, 3);
-            }
+            return KTX_INVALID_DATA;
+        }
+
+        size_t slice_size  = (size_t)level_size;
+        size_t face_stride = ALIGN_MASK(slice_size * data->pixel_depth, 3);
+        if (face_stride > left / faces)
+        {
+            return KTX_INVALID_DATA;
         }
 
+        data->level_offsets[mip_level] = pos;
+        data->slice_sizes[mip_level]   = slice_size;
+        data->face_strides[mip_level]  = face_stride;
+
+        // cube padding is part of the face stride
+        pos += face_stride * faces;
+
         // mip padding
         pos = ALIGN_MASK(pos, 3);
+
+        if (pos > raw_data_size)
+        {
+            return KTX_INVALID_DATA;
+        }
     }
 
     return KTX_SUCCESS;
 }
 
-void ktx_data_destroy(ktx_data_t *data)
+const uint8_t *ktx_get_slice(
+    const ktx_data_t *data, uint32_t mip_level, uint32_t layer, uint32_t face, uint32_t z_slice)
 {
-    for (uint32_t mip_level = 0; mip_level < data->mipmap_level_count; mip_level++)
-    {
-        for (uint32_t layer = 0; layer < data->array_element_count; layer++)
-        {
-            for (uint32_t face = 0; face < data->face_count; face++)
-            {
-                free(data->mip_levels[mip_level].array_elements[layer].faces[face].slices);
-            }
-        }
+    assert(mip_level < data->mipmap_level_count);
+    assert(layer < data->array_element_count);
+    assert(face < data->face_count);
+    assert(z_slice < data->pixel_depth);
+
+    size_t face_index = (size_t)layer * data->face_count + face;
+    return data->raw_data + data->level_offsets[mip_level] +
+           face_index * data->face_strides[mip_level] + z_slice * data->slice_sizes[mip_level];
+}
 
-        free(data->mip_levels[mip_level].array_elements);
-    }
+size_t ktx_get_slice_size(const ktx_data_t *data, uint32_t mip_level)
+{
+    assert(mip_level < data->mipmap_level_count);
+    return data->slice_sizes[mip_level];
+}
 
-    free(data->mip_levels);
+void ktx_data_destroy(ktx_data_t *data)
+{
+    mt_file_unmap(&data->mapping);
+    free(data->file_data);
+    data->file_data = NULL;
 }
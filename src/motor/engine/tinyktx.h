@@ -3,12 +3,14 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <motor/base/filesystem.h>
 
 typedef enum ktx_result_t
 {
     KTX_SUCCESS,
     KTX_FAILED_TO_OPEN_FILE,
     KTX_WRONG_IDENTIFIER,
+    KTX_INVALID_DATA,
 } ktx_result_t;
 
 #define KTX_ZERO 0
@@ -176,29 +178,16 @@ typedef enum ktx_result_t
 #define KTX_RGBA 0x1908
 #define KTX_STENCIL_INDEX 0x1901
 
-typedef struct ktx_slice_t
-{
-    uint8_t *data;
-} ktx_slice_t;
-
-typedef struct ktx_face_t
-{
-    ktx_slice_t *slices;
-} ktx_face_t;
-
-typedef struct ktx_array_element_t
-{
-    ktx_face_t faces[6];
-} ktx_array_element_t;
-
-typedef struct ktx_mip_level_t
-{
-    ktx_array_element_t *array_elements;
-} ktx_mip_level_t;
+#define KTX_MAX_MIP_LEVELS 32
+// Larger than any device supports, files beyond them are rejected
+#define KTX_MAX_DIMENSION (1u << 16)
+#define KTX_MAX_ARRAY_ELEMENTS 2048
 
+// Points into the data it was read from, nothing is copied
 typedef struct ktx_data_t
 {
-    uint8_t *raw_data;
+    const uint8_t *raw_data;
+    size_t raw_data_size;
 
     uint32_t pixel_width;
     uint32_t pixel_height;
@@ -215,12 +204,27 @@ typedef struct ktx_data_t
     uint32_t internal_format;
     uint32_t base_internal_format;
 
-    ktx_mip_level_t *mip_levels;
+    // Offsets of the first slice of each level
+    size_t level_offsets[KTX_MAX_MIP_LEVELS];
+    size_t slice_sizes[KTX_MAX_MIP_LEVELS];
+    // Faces are padded to 4 bytes
+    size_t face_strides[KTX_MAX_MIP_LEVELS];
+
+    // Owned when read with ktx_read_from_file: the file is mapped, or read into
+    // file_data when it can't be
+    MtFileMapping mapping;
+    uint8_t *file_data;
 } ktx_data_t;
 
-ktx_result_t ktx_read_from_file(const char *filename, uint8_t **raw_data, ktx_data_t *data);
+// ktx_data_destroy has to be called even when it fails
+ktx_result_t ktx_read_from_file(const char *filename, ktx_data_t *data);
+
+ktx_result_t ktx_read(const uint8_t *raw_data, size_t raw_data_size, ktx_data_t *data);
+
+const uint8_t *ktx_get_slice(
+    const ktx_data_t *data, uint32_t mip_level, uint32_t layer, uint32_t face, uint32_t z_slice);
 
-ktx_result_t ktx_read(uint8_t *raw_data, size_t raw_data_size, ktx_data_t *data);
+size_t ktx_get_slice_size(const ktx_data_t *data, uint32_t mip_level);
 
 void ktx_data_destroy(ktx_data_t *data);
 
@@ -0,0 +1,571 @@
+#include <motor/graphics/graph_compiler.h>
+
+#include <motor/base/array.h>
+#include <motor/base/allocator.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct Edge
+{
+    uint32_t to;
+    // Read after write, the only kind that makes a pass produce something needed
+    bool raw;
+} Edge;
+
+typedef struct PassNode
+{
+    /*array*/ Edge *edges;
+    uint32_t dep_count;
+} PassNode;
+
+static void add_edge(MtAllocator *alloc, PassNode *nodes, uint32_t from, uint32_t to, bool raw)
+{
+    if (from == UINT32_MAX || from == to) return;
+    mt_array_push(alloc, nodes[from].edges, ((Edge){.to = to, .raw = raw}));
+    nodes[to].dep_count++;
+}
+
+// Edges always go forward in declaration order. Passes set in skip are left out,
+// as if they were never declared.
+static PassNode *build_nodes(
+    MtAllocator *alloc,
+    const MtGraphCompilerPass *passes,
+    uint32_t pass_count,
+    uint32_t resource_count,
+    const bool *skip)
+{
+    PassNode *nodes = mt_alloc(alloc, sizeof(PassNode) * pass_count);
+    memset(nodes, 0, sizeof(PassNode) * pass_count);
+
+    uint32_t *last_writers = mt_alloc(alloc, sizeof(uint32_t) * resource_count);
+    memset(last_writers, 0xff, sizeof(uint32_t) * resource_count);
+
+    // Passes that read each resource since it was last written
+    /*array*/ uint32_t **readers = mt_alloc(alloc, sizeof(uint32_t *) * resource_count);
+    memset(readers, 0, sizeof(uint32_t *) * resource_count);
+
+    for (uint32_t p = 0; p < pass_count; p++)
+    {
+        const MtGraphCompilerPass *pass = &passes[p];
+        if (skip && skip[p]) continue;
+
+        for (uint32_t i = 0; i < pass->read_count; i++)
+        {
+            uint32_t res = pass->reads[i];
+            assert(res < resource_count);
+
+            add_edge(alloc, nodes, last_writers[res], p, true);
+            mt_array_push(alloc, readers[res], p);
+        }
+
+        for (uint32_t i = 0; i < pass->write_count; i++)
+        {
+            uint32_t res = pass->writes[i];
+            assert(res < resource_count);
+
+            add_edge(alloc, nodes, last_writers[res], p, false);
+            for (uint32_t j = 0; j < mt_array_size(readers[res]); j++)
+            {
+                add_edge(alloc, nodes, readers[res][j], p, false);
+            }
+
+            mt_array_set_size(readers[res], 0);
+            last_writers[res] = p;
+        }
+    }
+
+    for (uint32_t i = 0; i < resource_count; i++)
+    {
+        mt_array_free(alloc, readers[i]);
+    }
+    mt_free(alloc, readers);
+    mt_free(alloc, last_writers);
+
+    return nodes;
+}
+
+static void destroy_nodes(MtAllocator *alloc, PassNode *nodes, uint32_t pass_count)
+{
+    for (uint32_t p = 0; p < pass_count; p++)
+    {
+        mt_array_free(alloc, nodes[p].edges);
+    }
+    mt_free(alloc, nodes);
+}
+
+static bool depends_on(PassNode *nodes, uint32_t pass, uint32_t dependency)
+{
+    for (uint32_t i = 0; i < mt_array_size(nodes[dependency].edges); i++)
+    {
+        if (nodes[dependency].edges[i].to == pass) return true;
+    }
+    return false;
+}
+
+static uint32_t
+group_queue(const MtGraphCompilerPass *passes, const MtGraphSchedule *schedule, uint32_t group)
+{
+    return passes[schedule->order[schedule->group_starts[group]]].queue;
+}
+
+// Finds the wait, among the ones of a group starting at first_wait, on the queue of
+// wait_for. Waiting for a group also waits for the groups before it on its queue.
+static MtGraphGroupWait *find_group_wait(
+    const MtGraphCompilerPass *passes,
+    MtGraphSchedule *schedule,
+    uint32_t first_wait,
+    uint32_t wait_for)
+{
+    uint32_t queue = group_queue(passes, schedule, wait_for);
+    for (uint32_t i = first_wait; i < mt_array_size(schedule->group_waits); i++)
+    {
+        MtGraphGroupWait *wait = &schedule->group_waits[i];
+        if (group_queue(passes, schedule, wait->wait_for) == queue) return wait;
+    }
+    return NULL;
+}
+
+static void add_group_wait(
+    MtAllocator *alloc,
+    const MtGraphCompilerPass *passes,
+    MtGraphSchedule *schedule,
+    uint32_t first_wait,
+    uint32_t group,
+    uint32_t wait_for)
+{
+    MtGraphGroupWait *wait = find_group_wait(passes, schedule, first_wait, wait_for);
+    if (!wait)
+    {
+        MtGraphGroupWait new_wait = {.group = group, .wait_for = wait_for};
+        mt_array_push(alloc, schedule->group_waits, new_wait);
+    }
+    else if (wait->wait_for < wait_for)
+    {
+        wait->wait_for = wait_for;
+    }
+}
+
+// Splits the order into groups, and finds the groups of other queues they wait for
+static void build_groups(
+    MtAllocator *alloc,
+    const MtGraphCompilerPass *passes,
+    uint32_t pass_count,
+    PassNode *nodes,
+    MtGraphSchedule *schedule)
+{
+    uint32_t *group_of = mt_alloc(alloc, sizeof(uint32_t) * pass_count);
+    uint32_t order_size = (uint32_t)mt_array_size(schedule->order);
+    uint32_t group = 0;
+    uint32_t first_wait = 0;
+
+    for (uint32_t i = 0; i < order_size; i++)
+    {
+        uint32_t p = schedule->order[i];
+        bool new_group = i == 0 || passes[p].queue != passes[schedule->order[i - 1]].queue;
+
+        for (uint32_t j = 0; !new_group && j < i; j++)
+        {
+            uint32_t q = schedule->order[j];
+            if (passes[q].queue == passes[p].queue || !depends_on(nodes, p, q)) continue;
+
+            MtGraphGroupWait *wait = find_group_wait(passes, schedule, first_wait, group_of[q]);
+            new_group = !wait || wait->wait_for < group_of[q];
+        }
+
+        if (new_group)
+        {
+            group = (uint32_t)mt_array_size(schedule->group_starts);
+            first_wait = (uint32_t)mt_array_size(schedule->group_waits);
+            mt_array_push(alloc, schedule->group_starts, i);
+        }
+
+        for (uint32_t j = 0; j < i; j++)
+        {
+            uint32_t q = schedule->order[j];
+            if (passes[q].queue == passes[p].queue || !depends_on(nodes, p, q)) continue;
+            add_group_wait(alloc, passes, schedule, first_wait, group, group_of[q]);
+        }
+
+        group_of[p] = group;
+    }
+
+    // The last group only starts once all the queues are done with the frame
+    for (uint32_t g = 0; g < group; g++)
+    {
+        if (group_queue(passes, schedule, g) == group_queue(passes, schedule, group)) continue;
+        add_group_wait(alloc, passes, schedule, first_wait, group, g);
+    }
+
+    mt_free(alloc, group_of);
+}
+
+void mt_graph_compile(
+    MtAllocator *alloc,
+    const MtGraphCompilerPass *passes,
+    uint32_t pass_count,
+    uint32_t resource_count,
+    MtGraphSchedule *schedule)
+{
+    memset(schedule, 0, sizeof(*schedule));
+    if (pass_count == 0) return;
+
+    //
+    // Cull passes whose results are never read by a live pass
+    //
+
+    PassNode *nodes = build_nodes(alloc, passes, pass_count, resource_count, NULL);
+
+    mt_array_add_zeroed(alloc, schedule->culled, pass_count);
+
+    uint32_t live_count = 0;
+    for (uint32_t p = pass_count; p-- > 0;)
+    {
+        bool live = passes[p].root || p == pass_count - 1;
+        for (uint32_t i = 0; !live && i < mt_array_size(nodes[p].edges); i++)
+        {
+            Edge *edge = &nodes[p].edges[i];
+            live = edge->raw && !schedule->culled[edge->to];
+        }
+
+        schedule->culled[p] = !live;
+        live_count += live;
+    }
+
+    destroy_nodes(alloc, nodes, pass_count);
+
+    // Culled passes must not hide the hazards between the passes around them
+    nodes = build_nodes(alloc, passes, pass_count, resource_count, schedule->culled);
+
+    //
+    // Schedule: among the passes whose dependencies are done, stay on the current queue
+    // as long as possible, and take the earliest declared first
+    //
+
+    bool *scheduled = mt_alloc(alloc, sizeof(bool) * pass_count);
+    memset(scheduled, 0, sizeof(bool) * pass_count);
+
+    uint32_t current_queue = UINT32_MAX;
+    for (uint32_t n = 0; n < live_count; n++)
+    {
+        uint32_t first = UINT32_MAX;
+        uint32_t same_queue = UINT32_MAX;
+        uint32_t async = UINT32_MAX;
+        for (uint32_t p = 0; p < pass_count; p++)
+        {
+            if (schedule->culled[p] || scheduled[p] || nodes[p].dep_count > 0) continue;
+            // The output pass waits for everything else
+            if (p == pass_count - 1 && n < live_count - 1) continue;
+
+            if (first == UINT32_MAX) first = p;
+            if (same_queue == UINT32_MAX && passes[p].queue == current_queue) same_queue = p;
+            if (async == UINT32_MAX && passes[p].async) async = p;
+        }
+
+        // Edges only go forward, so there is always a pass ready
+        assert(first != UINT32_MAX);
+
+        uint32_t best = (same_queue != UINT32_MAX) ? same_queue : first;
+        if (async != UINT32_MAX && passes[async].queue != current_queue) best = async;
+
+        current_queue = passes[best].queue;
+        mt_array_push(alloc, schedule->order, best);
+        scheduled[best] = true;
+
+        for (uint32_t i = 0; i < mt_array_size(nodes[best].edges); i++)
+        {
+            nodes[nodes[best].edges[i].to].dep_count--;
+        }
+    }
+
+    build_groups(alloc, passes, pass_count, nodes, schedule);
+
+    mt_free(alloc, scheduled);
+    destroy_nodes(alloc, nodes, pass_count);
+}
+
+void mt_graph_schedule_destroy(MtAllocator *alloc, MtGraphSchedule *schedule)
+{
+    mt_array_free(alloc, schedule->order);
+    mt_array_free(alloc, schedule->group_starts);
+    mt_array_free(alloc, schedule->group_waits);
+    mt_array_free(alloc, schedule->culled);
+}
+
+typedef struct AliasOrder
+{
+    uint64_t size;
+    uint32_t index;
+} AliasOrder;
+
+typedef struct MemoryRange
+{
+    uint64_t begin;
+    uint64_t end;
+} MemoryRange;
+
+static int compare_alias_order(const void *a, const void *b)
+{
+    const AliasOrder *x = a;
+    const AliasOrder *y = b;
+    if (x->size != y->size) return (x->size < y->size) ? 1 : -1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+static int compare_memory_ranges(const void *a, const void *b)
+{
+    const MemoryRange *x = a;
+    const MemoryRange *y = b;
+    return (x->begin > y->begin) - (x->begin < y->begin);
+}
+
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    if (alignment == 0) return value;
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static void
+mark_use(MtGraphAliasPlacement *placement, bool *read_first, uint32_t position, bool read)
+{
+    if (placement->first_use == UINT32_MAX)
+    {
+        placement->first_use = position;
+        *read_first = read;
+    }
+    placement->last_use = position;
+}
+
+static bool lifetimes_overlap(const MtGraphAliasPlacement *a, const MtGraphAliasPlacement *b)
+{
+    return a->first_use <= b->last_use && b->first_use <= a->last_use;
+}
+
+// Lowest offset in heap where resource does not overlap the memory of the resources
+// that are alive at the same time
+static uint64_t find_heap_offset(
+    MtAllocator *alloc,
+    const MtGraphAliasResource *resources,
+    const MtGraphAliasing *aliasing,
+    /*array*/ uint32_t *members,
+    /*array*/ MemoryRange **ranges,
+    uint32_t resource)
+{
+    const MtGraphAliasPlacement *placement = &aliasing->placements[resource];
+
+    mt_array_set_size(*ranges, 0);
+    for (uint32_t i = 0; i < mt_array_size(members); i++)
+    {
+        const MtGraphAliasPlacement *other = &aliasing->placements[members[i]];
+        if (!lifetimes_overlap(placement, other)) continue;
+
+        MemoryRange range = {other->offset, other->offset + resources[members[i]].size};
+        mt_array_push(alloc, *ranges, range);
+    }
+
+    if (*ranges)
+    {
+        qsort(*ranges, mt_array_size(*ranges), sizeof(MemoryRange), compare_memory_ranges);
+    }
+
+    uint64_t size = resources[resource].size;
+    uint64_t alignment = resources[resource].alignment;
+
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < mt_array_size(*ranges); i++)
+    {
+        if (offset + size <= (*ranges)[i].begin) break;
+        if ((*ranges)[i].end > offset) offset = align_up((*ranges)[i].end, alignment);
+    }
+
+    return offset;
+}
+
+void mt_graph_alias(
+    MtAllocator *alloc,
+    const MtGraphCompilerPass *passes,
+    const MtGraphSchedule *schedule,
+    const MtGraphAliasResource *resources,
+    uint32_t resource_count,
+    MtGraphAliasing *aliasing)
+{
+    memset(aliasing, 0, sizeof(*aliasing));
+    if (resource_count == 0) return;
+
+    mt_array_add(alloc, aliasing->placements, resource_count);
+    for (uint32_t r = 0; r < resource_count; r++)
+    {
+        aliasing->placements[r] = (MtGraphAliasPlacement){
+            .heap = UINT32_MAX,
+            .first_use = UINT32_MAX,
+            .last_use = UINT32_MAX,
+        };
+    }
+
+    //
+    // Lifetimes
+    //
+
+    bool *read_first = mt_alloc(alloc, sizeof(bool) * resource_count);
+    memset(read_first, 0, sizeof(bool) * resource_count);
+
+    uint32_t order_size = (uint32_t)mt_array_size(schedule->order);
+    for (uint32_t i = 0; i < order_size; i++)
+    {
+        const MtGraphCompilerPass *pass = &passes[schedule->order[i]];
+
+        // Reads first, a pass that reads and writes a resource needs its contents
+        for (uint32_t j = 0; j < pass->read_count; j++)
+        {
+            uint32_t res = pass->reads[j];
+            mark_use(&aliasing->placements[res], &read_first[res], i, true);
+        }
+        for (uint32_t j = 0; j < pass->write_count; j++)
+        {
+            uint32_t res = pass->writes[j];
+            mark_use(&aliasing->placements[res], &read_first[res], i, false);
+        }
+    }
+
+    /*array*/ AliasOrder *transients = NULL;
+    for (uint32_t r = 0; r < resource_count; r++)
+    {
+        MtGraphAliasPlacement *placement = &aliasing->placements[r];
+        if (!resources[r].can_alias || placement->first_use == UINT32_MAX || read_first[r] ||
+            placement->last_use == order_size - 1)
+        {
+            continue;
+        }
+
+        mt_array_push(alloc, transients, ((AliasOrder){resources[r].size, r}));
+        aliasing->transient_size += resources[r].size;
+    }
+
+    mt_free(alloc, read_first);
+
+    for (uint32_t i = 0; i < order_size; i++)
+    {
+        uint64_t live_size = 0;
+        for (uint32_t t = 0; t < mt_array_size(transients); t++)
+        {
+            MtGraphAliasPlacement *placement = &aliasing->placements[transients[t].index];
+            if (placement->first_use <= i && i <= placement->last_use)
+            {
+                live_size += transients[t].size;
+            }
+        }
+        if (live_size > aliasing->peak_size) aliasing->peak_size = live_size;
+    }
+
+    //
+    // Placement: biggest resources first, each at the lowest offset that does not
+    // overlap anything alive at the same time, in the heap it grows the least
+    //
+
+    if (transients)
+    {
+        qsort(transients, mt_array_size(transients), sizeof(AliasOrder), compare_alias_order);
+    }
+
+    /*array*/ uint32_t *heap_kinds = NULL;
+    /*array*/ uint32_t **heap_members = NULL;
+    /*array*/ MemoryRange *ranges = NULL;
+
+    for (uint32_t t = 0; t < mt_array_size(transients); t++)
+    {
+        uint32_t r = transients[t].index;
+        const MtGraphAliasResource *resource = &resources[r];
+        MtGraphAliasPlacement *placement = &aliasing->placements[r];
+
+        uint32_t best_heap = UINT32_MAX;
+        uint64_t best_offset = 0;
+        uint64_t best_growth = UINT64_MAX;
+
+        for (uint32_t h = 0; h < mt_array_size(aliasing->heaps); h++)
+        {
+            MtGraphAliasHeap *heap = &aliasing->heaps[h];
+            if (heap_kinds[h] != resource->kind ||
+                !(heap->memory_type_bits & resource->memory_type_bits))
+            {
+                continue;
+            }
+
+            uint64_t offset =
+                find_heap_offset(alloc, resources, aliasing, heap_members[h], &ranges, r);
+            uint64_t end = offset + resource->size;
+            uint64_t growth = (end > heap->size) ? end - heap->size : 0;
+
+            if (growth < best_growth)
+            {
+                best_heap = h;
+                best_offset = offset;
+                best_growth = growth;
+            }
+        }
+
+        if (best_heap == UINT32_MAX)
+        {
+            best_heap = (uint32_t)mt_array_size(aliasing->heaps);
+            mt_array_push(
+                alloc,
+                aliasing->heaps,
+                ((MtGraphAliasHeap){.memory_type_bits = resource->memory_type_bits}));
+            mt_array_push(alloc, heap_kinds, resource->kind);
+            mt_array_push(alloc, heap_members, NULL);
+        }
+
+        MtGraphAliasHeap *heap = &aliasing->heaps[best_heap];
+        heap->memory_type_bits &= resource->memory_type_bits;
+        if (resource->alignment > heap->alignment) heap->alignment = resource->alignment;
+        if (best_offset + resource->size > heap->size) heap->size = best_offset + resource->size;
+
+        placement->heap = best_heap;
+        placement->offset = best_offset;
+        mt_array_push(alloc, heap_members[best_heap], r);
+    }
+
+    //
+    // Waits: the first use of a resource follows every use of its memory, either earlier
+    // in the same frame or, once the frame wraps around, in the previous one
+    //
+
+    for (uint32_t r = 0; r < resource_count; r++)
+    {
+        const MtGraphAliasPlacement *placement = &aliasing->placements[r];
+        if (placement->heap == UINT32_MAX) continue;
+
+        uint32_t *members = heap_members[placement->heap];
+        for (uint32_t i = 0; i < mt_array_size(members); i++)
+        {
+            const MtGraphAliasPlacement *other = &aliasing->placements[members[i]];
+            if (other->offset < placement->offset + resources[r].size &&
+                placement->offset < other->offset + resources[members[i]].size)
+            {
+                MtGraphAliasWait wait = {
+                    .resource = r,
+                    .wait_for = members[i],
+                    .previous_frame = other->last_use >= placement->first_use,
+                };
+                mt_array_push(alloc, aliasing->waits, wait);
+            }
+        }
+    }
+
+    for (uint32_t h = 0; h < mt_array_size(aliasing->heaps); h++)
+    {
+        aliasing->heap_size += aliasing->heaps[h].size;
+        mt_array_free(alloc, heap_members[h]);
+    }
+
+    mt_array_free(alloc, heap_members);
+    mt_array_free(alloc, heap_kinds);
+    mt_array_free(alloc, ranges);
+    mt_array_free(alloc, transients);
+}
+
+void mt_graph_aliasing_destroy(MtAllocator *alloc, MtGraphAliasing *aliasing)
+{
+    mt_array_free(alloc, aliasing->heaps);
+    mt_array_free(alloc, aliasing->placements);
+    mt_array_free(alloc, aliasing->waits);
+}
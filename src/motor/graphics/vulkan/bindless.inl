@@ -0,0 +1,229 @@
+static bool bindless_check_support(MtDevice *dev)
+{
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &indexing_features,
+    };
+    vkGetPhysicalDeviceFeatures2(dev->physical_device, &features);
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT,
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &indexing_properties,
+    };
+    vkGetPhysicalDeviceProperties2(dev->physical_device, &properties);
+
+    return indexing_features.runtimeDescriptorArray &&
+           indexing_features.descriptorBindingPartiallyBound &&
+           indexing_features.descriptorBindingSampledImageUpdateAfterBind &&
+           indexing_features.descriptorBindingUpdateUnusedWhilePending &&
+           indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages >=
+               BINDLESS_IMAGE_CAPACITY &&
+           indexing_properties.maxDescriptorSetUpdateAfterBindSamplers >=
+               BINDLESS_SAMPLER_CAPACITY;
+}
+
+static void bindless_table_init(MtDevice *dev)
+{
+    BindlessTable *t = &dev->bindless;
+    memset(t, 0, sizeof(*t));
+
+    VkDescriptorSetLayoutBinding bindings[2] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            .descriptorCount = BINDLESS_IMAGE_CAPACITY,
+            .stageFlags = VK_SHADER_STAGE_ALL,
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+            .descriptorCount = BINDLESS_SAMPLER_CAPACITY,
+            .stageFlags = VK_SHADER_STAGE_ALL,
+        },
+    };
+
+    VkDescriptorBindingFlagsEXT binding_flags[2] = {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT,
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+        .bindingCount = MT_LENGTH(binding_flags),
+        .pBindingFlags = binding_flags,
+    };
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &binding_flags_info,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+        .bindingCount = MT_LENGTH(bindings),
+        .pBindings = bindings,
+    };
+
+    VK_CHECK(vkCreateDescriptorSetLayout(dev->device, &set_layout_info, NULL, &t->set_layout));
+
+    VkDescriptorPoolSize pool_sizes[2] = {
+        {.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = BINDLESS_IMAGE_CAPACITY},
+        {.type = VK_DESCRIPTOR_TYPE_SAMPLER, .descriptorCount = BINDLESS_SAMPLER_CAPACITY},
+    };
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+        .maxSets = 1,
+        .poolSizeCount = MT_LENGTH(pool_sizes),
+        .pPoolSizes = pool_sizes,
+    };
+
+    VK_CHECK(vkCreateDescriptorPool(dev->device, &pool_info, NULL, &t->pool));
+
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = t->pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &t->set_layout,
+    };
+
+    VK_CHECK(vkAllocateDescriptorSets(dev->device, &alloc_info, &t->set));
+}
+
+static void bindless_table_destroy(MtDevice *dev)
+{
+    BindlessTable *t = &dev->bindless;
+
+    vkDestroyDescriptorPool(dev->device, t->pool, NULL);
+    vkDestroyDescriptorSetLayout(dev->device, t->set_layout, NULL);
+
+    mt_array_free(dev->alloc, t->free_images);
+    mt_array_free(dev->alloc, t->free_samplers);
+}
+
+static bool device_bindless_enabled(MtDevice *dev)
+{
+    return dev->bindless_enabled;
+}
+
+static void write_bindless_image(MtDevice *dev, uint32_t index, MtImage *image)
+{
+    VkDescriptorImageInfo image_info = {
+        .imageView = image->image_view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    if (image->aspect & VK_IMAGE_ASPECT_DEPTH_BIT)
+    {
+        image_info.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    }
+
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = dev->bindless.set,
+        .dstBinding = 0,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        .pImageInfo = &image_info,
+    };
+    vkUpdateDescriptorSets(dev->device, 1, &write, 0, NULL);
+}
+
+static uint32_t register_bindless_image(MtDevice *dev, MtImage *image)
+{
+    assert(dev->bindless_enabled);
+    BindlessTable *t = &dev->bindless;
+
+    mt_mutex_lock(&dev->device_mutex);
+
+    uint32_t index = UINT32_MAX;
+    if (mt_array_size(t->free_images) > 0)
+    {
+        index = *mt_array_pop(t->free_images);
+    }
+    else if (t->image_count < BINDLESS_IMAGE_CAPACITY)
+    {
+        index = t->image_count++;
+    }
+
+    if (index == UINT32_MAX)
+    {
+        mt_mutex_unlock(&dev->device_mutex);
+        mt_log_error("Bindless image table is full (%u images)", BINDLESS_IMAGE_CAPACITY);
+        return UINT32_MAX;
+    }
+
+    write_bindless_image(dev, index, image);
+
+    mt_mutex_unlock(&dev->device_mutex);
+
+    return index;
+}
+
+static void unregister_bindless_image(MtDevice *dev, uint32_t index)
+{
+    if (index == UINT32_MAX) return;
+
+    mt_mutex_lock(&dev->device_mutex);
+    mt_array_push(dev->alloc, dev->bindless.free_images, index);
+    mt_mutex_unlock(&dev->device_mutex);
+}
+
+static uint32_t register_bindless_sampler(MtDevice *dev, MtSampler *sampler)
+{
+    assert(dev->bindless_enabled);
+    BindlessTable *t = &dev->bindless;
+
+    mt_mutex_lock(&dev->device_mutex);
+
+    uint32_t index = UINT32_MAX;
+    if (mt_array_size(t->free_samplers) > 0)
+    {
+        index = *mt_array_pop(t->free_samplers);
+    }
+    else if (t->sampler_count < BINDLESS_SAMPLER_CAPACITY)
+    {
+        index = t->sampler_count++;
+    }
+
+    if (index == UINT32_MAX)
+    {
+        mt_mutex_unlock(&dev->device_mutex);
+        mt_log_error("Bindless sampler table is full (%u samplers)", BINDLESS_SAMPLER_CAPACITY);
+        return UINT32_MAX;
+    }
+
+    VkDescriptorImageInfo image_info = {.sampler = sampler->sampler};
+
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = t->set,
+        .dstBinding = 1,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+        .pImageInfo = &image_info,
+    };
+    vkUpdateDescriptorSets(dev->device, 1, &write, 0, NULL);
+
+    mt_mutex_unlock(&dev->device_mutex);
+
+    return index;
+}
+
+static void unregister_bindless_sampler(MtDevice *dev, uint32_t index)
+{
+    if (index == UINT32_MAX) return;
+
+    mt_mutex_lock(&dev->device_mutex);
+    mt_array_push(dev->alloc, dev->bindless.free_samplers, index);
+    mt_mutex_unlock(&dev->device_mutex);
+}
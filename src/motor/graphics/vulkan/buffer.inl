@@ -1,4 +1,6 @@
-static MtBuffer *create_buffer(MtDevice *dev, MtBufferCreateInfo *ci)
+// Creates the VkBuffer without any memory bound to it.
+// Buffers used by async compute passes are shared with the compute queue family.
+static MtBuffer *create_unbound_buffer(MtDevice *dev, MtBufferCreateInfo *ci, bool async_compute)
 {
     MtBuffer *buffer = mt_alloc(dev->alloc, sizeof(MtBuffer));
     assert(ci->size > 0);
@@ -7,9 +9,7 @@ static MtBuffer *create_buffer(MtDevice *dev, MtBufferCreateInfo *ci)
     buffer->usage  = ci->usage;
     buffer->memory = ci->memory;
 
-    VkBufferUsageFlags buffer_usage       = 0;
-    VmaMemoryUsage memory_usage           = 0;
-    VkMemoryPropertyFlags memory_property = 0;
+    VkBufferUsageFlags buffer_usage = 0;
 
     switch (buffer->usage)
     {
@@ -38,8 +38,45 @@ static MtBuffer *create_buffer(MtDevice *dev, MtBufferCreateInfo *ci)
             buffer_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
             break;
         }
+        case MT_BUFFER_USAGE_INDIRECT:
+        {
+            buffer_usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            break;
+        }
+    }
+
+    if (buffer->memory == MT_BUFFER_MEMORY_DEVICE)
+    {
+        buffer_usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    VkBufferCreateInfo create_info = {
+        .sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size        = buffer->size,
+        .usage       = buffer_usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    // Async compute uses buffers from a queue family of its own
+    uint32_t queue_family_indices[2] = {dev->indices.graphics, dev->indices.compute};
+    if (async_compute && dev->indices.graphics != dev->indices.compute)
+    {
+        create_info.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+        create_info.queueFamilyIndexCount = 2;
+        create_info.pQueueFamilyIndices   = queue_family_indices;
     }
 
+    buffer->allocation = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateBuffer(dev->device, &create_info, NULL, &buffer->buffer));
+
+    return buffer;
+}
+
+static void allocate_buffer_memory(MtDevice *dev, MtBuffer *buffer)
+{
+    VmaMemoryUsage memory_usage           = 0;
+    VkMemoryPropertyFlags memory_property = 0;
+
     switch (buffer->memory)
     {
         case MT_BUFFER_MEMORY_HOST:
@@ -52,31 +89,24 @@ static MtBuffer *create_buffer(MtDevice *dev, MtBufferCreateInfo *ci)
         {
             memory_usage    = VMA_MEMORY_USAGE_GPU_ONLY;
             memory_property = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-            buffer_usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
             break;
         }
     }
 
-    VkBufferCreateInfo create_info = {
-        .sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size        = buffer->size,
-        .usage       = buffer_usage,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-    };
-
     VmaAllocationCreateInfo alloc_create_info = {
         .usage         = memory_usage,
         .requiredFlags = memory_property,
     };
 
-    VK_CHECK(vmaCreateBuffer(
-        dev->gpu_allocator,
-        &create_info,
-        &alloc_create_info,
-        &buffer->buffer,
-        &buffer->allocation,
-        NULL));
+    VK_CHECK(vmaAllocateMemoryForBuffer(
+        dev->gpu_allocator, buffer->buffer, &alloc_create_info, &buffer->allocation, NULL));
+    VK_CHECK(vmaBindBufferMemory(dev->gpu_allocator, buffer->allocation, buffer->buffer));
+}
 
+static MtBuffer *create_buffer(MtDevice *dev, MtBufferCreateInfo *ci)
+{
+    MtBuffer *buffer = create_unbound_buffer(dev, ci, false);
+    allocate_buffer_memory(dev, buffer);
     return buffer;
 }
 
@@ -87,7 +117,8 @@ static void destroy_buffer(MtDevice *dev, MtBuffer *buffer)
 
     device_wait_idle(dev);
 
-    if (buffer->buffer != VK_NULL_HANDLE && buffer->allocation != VK_NULL_HANDLE)
+    // Buffers placed in the memory of a render graph have no allocation of their own
+    if (buffer->buffer != VK_NULL_HANDLE)
     {
         vmaDestroyBuffer(dev->gpu_allocator, buffer->buffer, buffer->allocation);
     }
@@ -33,6 +33,13 @@ static void end_cmd_buffer(MtCmdBuffer *cb)
     {
         buffer_block_reset(block);
     }
+
+    for (BufferBlock *block = cb->sbo_blocks;
+         block != cb->sbo_blocks + mt_array_size(cb->sbo_blocks);
+         ++block)
+    {
+        buffer_block_reset(block);
+    }
 }
 
 static void get_viewport(MtCmdBuffer *cb, MtViewport *viewport)
@@ -46,6 +53,9 @@ static void bind_descriptor_sets(MtCmdBuffer *cb)
 
     for (uint32_t i = 0; i < cb->bound_pipeline_instance->pipeline->layout->set_count; i++)
     {
+        // Bound once in cmd_bind_pipeline
+        if (i == cb->bound_pipeline_instance->pipeline->layout->bindless_set) continue;
+
         uint32_t binding_count =
             cb->bound_pipeline_instance->pipeline->layout->sets[i].binding_count;
         assert(binding_count > 0);
@@ -286,6 +296,36 @@ static void cmd_bind_pipeline(MtCmdBuffer *cb, MtPipeline *pipeline)
 
         default: assert(0);
     }
+
+    PipelineLayout *layout = pipeline->layout;
+    if (layout->bindless_set != UINT32_MAX)
+    {
+        vkCmdBindDescriptorSets(
+            cb->cmd_buffer,
+            cb->bound_pipeline_instance->bind_point,
+            layout->layout,
+            layout->bindless_set,
+            1,
+            &cb->dev->bindless.set,
+            0,
+            NULL);
+    }
+}
+
+static void cmd_push_constants(MtCmdBuffer *cb, const void *data, size_t size)
+{
+    assert(cb->bound_pipeline_instance);
+
+    PipelineLayout *layout = cb->bound_pipeline_instance->pipeline->layout;
+    assert(size <= layout->push_constant_range.size);
+
+    vkCmdPushConstants(
+        cb->cmd_buffer,
+        layout->layout,
+        layout->push_constant_range.stageFlags,
+        0,
+        (uint32_t)size,
+        data);
 }
 
 static void cmd_begin_render_pass(MtCmdBuffer *cmd_buffer, MtRenderGraphPass *pass)
@@ -382,6 +422,41 @@ cmd_bind_storage_buffer(MtCmdBuffer *cb, MtBuffer *buffer, uint32_t set, uint32_
     cb->bound_descriptors[set][binding].buffer.range = VK_WHOLE_SIZE;
 }
 
+static void *
+cmd_alloc_transient_data(MtCmdBuffer *cb, size_t size, MtBuffer **buffer, size_t *offset)
+{
+    mt_mutex_lock(&cb->dev->device_mutex);
+
+    BufferBlock *block = ensure_buffer_block(&cb->dev->sbo_pool, &cb->sbo_blocks, size);
+    assert(block->buffer->buffer);
+
+    BufferBlockAllocation allocation = buffer_block_allocate(block, size);
+    assert(allocation.mapping);
+
+    mt_mutex_unlock(&cb->dev->device_mutex);
+
+    *buffer = block->buffer;
+    *offset = allocation.offset;
+
+    return allocation.mapping;
+}
+
+static void *cmd_bind_storage_data(MtCmdBuffer *cb, size_t size, uint32_t set, uint32_t binding)
+{
+    assert(MT_LENGTH(cb->bound_descriptors) > set);
+    assert(MT_LENGTH(cb->bound_descriptors[set]) > binding);
+
+    MtBuffer *buffer;
+    size_t offset;
+    void *mapping = cmd_alloc_transient_data(cb, size, &buffer, &offset);
+
+    cb->bound_descriptors[set][binding].buffer.buffer = buffer->buffer;
+    cb->bound_descriptors[set][binding].buffer.offset = offset;
+    cb->bound_descriptors[set][binding].buffer.range = size;
+
+    return mapping;
+}
+
 static void cmd_bind_sampler(MtCmdBuffer *cb, MtSampler *sampler, uint32_t set, uint32_t binding)
 {
     assert(MT_LENGTH(cb->bound_descriptors) > set);
@@ -475,6 +550,50 @@ static void cmd_draw_indexed(
         cb->cmd_buffer, index_count, instance_count, first_index, vertex_offset, first_instance);
 }
 
+static void cmd_draw_indexed_indirect(
+    MtCmdBuffer *cb, MtBuffer *buffer, size_t offset, uint32_t draw_count)
+{
+    bind_descriptor_sets(cb);
+
+    uint32_t stride = sizeof(MtDrawIndexedIndirectCommand);
+    if (cb->dev->physical_device_features.multiDrawIndirect)
+    {
+        vkCmdDrawIndexedIndirect(cb->cmd_buffer, buffer->buffer, offset, draw_count, stride);
+        return;
+    }
+
+    for (uint32_t i = 0; i < draw_count; i++)
+    {
+        vkCmdDrawIndexedIndirect(
+            cb->cmd_buffer, buffer->buffer, offset + (size_t)i * stride, 1, stride);
+    }
+}
+
+static void cmd_draw_indexed_indirect_count(
+    MtCmdBuffer *cb,
+    MtBuffer *buffer,
+    size_t offset,
+    MtBuffer *count_buffer,
+    size_t count_offset,
+    uint32_t max_draw_count)
+{
+    if (!cb->dev->draw_indirect_count_enabled)
+    {
+        cmd_draw_indexed_indirect(cb, buffer, offset, max_draw_count);
+        return;
+    }
+
+    bind_descriptor_sets(cb);
+    vkCmdDrawIndexedIndirectCountKHR(
+        cb->cmd_buffer,
+        buffer->buffer,
+        offset,
+        count_buffer->buffer,
+        count_offset,
+        max_draw_count,
+        sizeof(MtDrawIndexedIndirectCommand));
+}
+
 static void cmd_dispatch(
     MtCmdBuffer *cb, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z)
 {
@@ -1,19 +1,655 @@
 static void graph_bake(MtRenderGraph *graph);
 static void graph_unbake(MtRenderGraph *graph);
 
-static inline bool find_in_array(uint32_t *array, uint32_t to_find)
+// Barriers {{{
+enum {
+    WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT |
+                   VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+};
+
+// How a pass uses one of its resources
+typedef struct ResourceAccess
 {
-    for (uint32_t i = 0; i < mt_array_size(array); ++i)
+    uint32_t resource;
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    // Undefined for buffers
+    VkImageLayout layout;
+    bool write;
+} ResourceAccess;
+
+typedef struct ResourceState
+{
+    VkImageLayout layout;
+    // Last write or layout transition
+    VkPipelineStageFlags write_stages;
+    VkAccessFlags write_access;
+    // Where the last write was made visible
+    VkPipelineStageFlags visible_stages;
+    VkAccessFlags visible_access;
+    // Stages that read the resource since the last write
+    VkPipelineStageFlags read_stages;
+    // Positions in the schedule of the passes the next barrier waits for,
+    // UINT32_MAX when some of them belong to the previous frame
+    uint32_t first_source;
+    uint32_t last_source;
+} ResourceState;
+
+typedef struct PendingBarrier
+{
+    uint32_t resource;
+    VkPipelineStageFlags src_stages;
+    VkPipelineStageFlags dst_stages;
+    VkAccessFlags src_access;
+    VkAccessFlags dst_access;
+    VkImageLayout old_layout;
+    VkImageLayout new_layout;
+    uint32_t first_source;
+    uint32_t last_source;
+} PendingBarrier;
+
+static VkImageLayout image_read_layout(MtImage *image)
+{
+    if (image->aspect & VK_IMAGE_ASPECT_DEPTH_BIT)
+    {
+        return VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    }
+    return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+// Queue the pass is recorded for, as opposed to the kind of work it does
+static MtQueueType pass_queue(MtRenderGraphPass *pass)
+{
+    if (pass->queue_type == MT_QUEUE_COMPUTE && !pass->async_compute) return MT_QUEUE_GRAPHICS;
+    return pass->queue_type;
+}
+
+// Restricts a barrier to what the compute queue supports, which may be in a family of its own
+static void fit_barrier_to_queue(PendingBarrier *barrier, MtQueueType queue_type)
+{
+    if (queue_type != MT_QUEUE_COMPUTE) return;
+
+    const VkPipelineStageFlags stages =
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT |
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT |
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    const VkAccessFlags access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT |
+                                 VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                                 VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT |
+                                 VK_ACCESS_HOST_READ_BIT | VK_ACCESS_HOST_WRITE_BIT |
+                                 VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    // The work of the other queues was waited for with semaphores at every stage
+    barrier->dst_stages &= stages;
+    barrier->dst_access &= access;
+    if (barrier->dst_stages == 0) barrier->dst_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    if (barrier->src_stages & ~stages)
+    {
+        barrier->src_stages = (barrier->src_stages & stages) | barrier->dst_stages;
+        barrier->src_access &= access;
+    }
+}
+
+static void add_access(MtAllocator *alloc, ResourceAccess **accesses, ResourceAccess access)
+{
+    for (uint32_t i = 0; i < mt_array_size(*accesses); i++)
+    {
+        ResourceAccess *other = &(*accesses)[i];
+        if (other->resource != access.resource) continue;
+
+        // A pass can't use an image in two layouts at once
+        assert(other->layout == access.layout);
+        other->stages |= access.stages;
+        other->access |= access.access;
+        other->write |= access.write;
+        return;
+    }
+
+    mt_array_push(alloc, *accesses, access);
+}
+
+static void get_pass_accesses(
+    MtRenderGraph *graph, MtRenderGraphPass *pass, /*array*/ ResourceAccess **accesses)
+{
+    MtAllocator *alloc = graph->dev->alloc;
+    mt_array_set_size(*accesses, 0);
+
+    VkPipelineStageFlags shader_stages = 0;
+    VkPipelineStageFlags buffer_read_stages = 0;
+    VkAccessFlags buffer_read_access = 0;
+    VkAccessFlags buffer_write_access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    switch (pass->queue_type)
+    {
+        case MT_QUEUE_GRAPHICS: {
+            shader_stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            buffer_read_stages = shader_stages | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+            buffer_read_access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                                 VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                 VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            break;
+        }
+        case MT_QUEUE_COMPUTE: {
+            shader_stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            buffer_read_stages = shader_stages;
+            buffer_read_access = VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            break;
+        }
+        case MT_QUEUE_TRANSFER: {
+            shader_stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            buffer_read_stages = shader_stages;
+            buffer_read_access = VK_ACCESS_TRANSFER_READ_BIT;
+            buffer_write_access = VK_ACCESS_TRANSFER_WRITE_BIT;
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(pass->image_transfer_inputs); i++)
+    {
+        add_access(
+            alloc,
+            accesses,
+            (ResourceAccess){
+                .resource = pass->image_transfer_inputs[i],
+                .stages = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                .access = VK_ACCESS_TRANSFER_READ_BIT,
+                .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            });
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(pass->image_sampled_inputs); i++)
     {
-        if (array[i] == to_find)
+        GraphResource *resource = &graph->resources[pass->image_sampled_inputs[i]];
+        add_access(
+            alloc,
+            accesses,
+            (ResourceAccess){
+                .resource = resource->index,
+                .stages = shader_stages,
+                .access = VK_ACCESS_SHADER_READ_BIT,
+                .layout = image_read_layout(resource->image),
+            });
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(pass->buffer_reads); i++)
+    {
+        add_access(
+            alloc,
+            accesses,
+            (ResourceAccess){
+                .resource = pass->buffer_reads[i],
+                .stages = buffer_read_stages,
+                .access = buffer_read_access,
+            });
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(pass->color_outputs); i++)
+    {
+        add_access(
+            alloc,
+            accesses,
+            (ResourceAccess){
+                .resource = pass->color_outputs[i],
+                .stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                .access =
+                    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .write = true,
+            });
+    }
+
+    if (pass->depth_output != UINT32_MAX)
+    {
+        add_access(
+            alloc,
+            accesses,
+            (ResourceAccess){
+                .resource = pass->depth_output,
+                .stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                .access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                .write = true,
+            });
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(pass->image_transfer_outputs); i++)
+    {
+        add_access(
+            alloc,
+            accesses,
+            (ResourceAccess){
+                .resource = pass->image_transfer_outputs[i],
+                .stages = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .write = true,
+            });
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(pass->buffer_writes); i++)
+    {
+        add_access(
+            alloc,
+            accesses,
+            (ResourceAccess){
+                .resource = pass->buffer_writes[i],
+                .stages = shader_stages,
+                .access = buffer_write_access,
+                .write = true,
+            });
+    }
+}
+
+static VkPipelineStageFlags pass_access_stages(MtRenderGraph *graph, MtRenderGraphPass *pass)
+{
+    ResourceAccess *accesses = NULL;
+    get_pass_accesses(graph, pass, &accesses);
+
+    VkPipelineStageFlags stages = pass->stage;
+    for (uint32_t i = 0; i < mt_array_size(accesses); i++)
+    {
+        stages |= accesses[i].stages;
+    }
+
+    mt_array_free(graph->dev->alloc, accesses);
+    return stages;
+}
+
+// Updates state for access by the pass at position, returns whether a barrier is needed
+static bool transition_resource(
+    ResourceState *state, const ResourceAccess *access, uint32_t position, PendingBarrier *barrier)
+{
+    bool image = access->layout != VK_IMAGE_LAYOUT_UNDEFINED;
+    bool layout_change = image && state->layout != access->layout;
+
+    *barrier = (PendingBarrier){
+        .resource = access->resource,
+        .src_stages = state->write_stages,
+        .src_access = state->write_access,
+        .dst_stages = access->stages,
+        .dst_access = access->access,
+        .old_layout = state->layout,
+        .new_layout = access->layout,
+        .first_source = state->first_source,
+        .last_source = state->last_source,
+    };
+
+    bool needed = false;
+
+    if (access->write || layout_change)
+    {
+        // Also waits for the reads since the last write, and for nothing but the
+        // layout transition if the resource was never used
+        barrier->src_stages |= state->read_stages;
+        needed = barrier->src_stages != 0 || layout_change;
+        if (barrier->src_stages == 0) barrier->src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+        state->write_stages = access->stages;
+        state->write_access = access->write ? (access->access & WRITE_ACCESS) : 0;
+        state->visible_stages = access->write ? 0 : access->stages;
+        state->visible_access = access->write ? 0 : access->access;
+        state->read_stages = access->write ? 0 : access->stages;
+        state->first_source = position;
+        state->last_source = position;
+    }
+    else
+    {
+        needed = state->write_stages != 0 && ((access->stages & ~state->visible_stages) ||
+                                              (access->access & ~state->visible_access));
+        if (needed)
         {
-            return true;
+            state->visible_stages |= access->stages;
+            state->visible_access |= access->access;
         }
+
+        state->read_stages |= access->stages;
+        if (state->first_source != UINT32_MAX) state->last_source = position;
+    }
+
+    if (image) state->layout = access->layout;
+
+    return needed;
+}
+
+static void
+push_barrier(MtRenderGraph *graph, PassBarriers *barriers, const PendingBarrier *pending)
+{
+    GraphResource *resource = &graph->resources[pending->resource];
+
+    barriers->src_stages |= pending->src_stages;
+    barriers->dst_stages |= pending->dst_stages;
+
+    if (pending->new_layout != VK_IMAGE_LAYOUT_UNDEFINED)
+    {
+        MtImage *image = resource->image;
+        VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = pending->src_access,
+            .dstAccessMask = pending->dst_access,
+            .oldLayout = pending->old_layout,
+            .newLayout = pending->new_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image->image,
+            .subresourceRange =
+                {
+                    .aspectMask = image->aspect,
+                    .baseMipLevel = 0,
+                    .levelCount = image->mip_count,
+                    .baseArrayLayer = 0,
+                    .layerCount = image->layer_count,
+                },
+        };
+        mt_array_push(graph->dev->alloc, barriers->image_barriers, barrier);
+    }
+    else
+    {
+        VkBufferMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = pending->src_access,
+            .dstAccessMask = pending->dst_access,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = resource->buffer->buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+        };
+        mt_array_push(graph->dev->alloc, barriers->buffer_barriers, barrier);
     }
+}
+
+static void destroy_pass_barriers(MtAllocator *alloc, PassBarriers *barriers)
+{
+    mt_array_free(alloc, barriers->memory_barriers);
+    mt_array_free(alloc, barriers->buffer_barriers);
+    mt_array_free(alloc, barriers->image_barriers);
+    memset(barriers, 0, sizeof(*barriers));
+}
+
+static bool pass_barriers_empty(PassBarriers *barriers)
+{
+    return mt_array_size(barriers->memory_barriers) == 0 &&
+           mt_array_size(barriers->buffer_barriers) == 0 &&
+           mt_array_size(barriers->image_barriers) == 0;
+}
+
+static void cmd_pass_barriers(MtCmdBuffer *cb, PassBarriers *barriers)
+{
+    if (pass_barriers_empty(barriers)) return;
 
-    return false;
+    vkCmdPipelineBarrier(
+        cb->cmd_buffer,
+        barriers->src_stages,
+        barriers->dst_stages,
+        0,
+        (uint32_t)mt_array_size(barriers->memory_barriers),
+        barriers->memory_barriers,
+        (uint32_t)mt_array_size(barriers->buffer_barriers),
+        barriers->buffer_barriers,
+        (uint32_t)mt_array_size(barriers->image_barriers),
+        barriers->image_barriers);
 }
 
+// Walks the schedule twice: the first time to know what state every resource ends a
+// frame in, the second time to compute the barriers of a frame that follows another one.
+// Barriers waiting for a single earlier pass of the same execution group, with other
+// passes in between, are split into an event set after that pass.
+// Transient resources start a frame in the state their memory was left in by the
+// previous frame, as given by the waits of the aliasing.
+static void bake_barriers(
+    MtRenderGraph *graph,
+    const uint32_t *order,
+    uint32_t order_size,
+    /*array*/ const MtGraphAliasWait *alias_waits)
+{
+    MtAllocator *alloc = graph->dev->alloc;
+    uint32_t resource_count = (uint32_t)mt_array_size(graph->resources);
+
+    ResourceState *states = mt_alloc(alloc, sizeof(ResourceState) * resource_count);
+    memset(states, 0, sizeof(ResourceState) * resource_count);
+    ResourceState *frame_end_states = mt_alloc(alloc, sizeof(ResourceState) * resource_count);
+
+    // First access of each resource in a frame, and the position of the last one
+    ResourceAccess *first_accesses = mt_alloc(alloc, sizeof(ResourceAccess) * resource_count);
+    memset(first_accesses, 0, sizeof(ResourceAccess) * resource_count);
+    uint32_t *first_uses = mt_alloc(alloc, sizeof(uint32_t) * resource_count);
+    memset(first_uses, 0xff, sizeof(uint32_t) * resource_count);
+    uint32_t *last_uses = mt_alloc(alloc, sizeof(uint32_t) * resource_count);
+    memset(last_uses, 0xff, sizeof(uint32_t) * resource_count);
+
+    ResourceAccess *accesses = NULL;
+
+    for (uint32_t i = 0; i < order_size; i++)
+    {
+        get_pass_accesses(graph, &graph->passes[order[i]], &accesses);
+        for (uint32_t j = 0; j < mt_array_size(accesses); j++)
+        {
+            uint32_t r = accesses[j].resource;
+            if (first_uses[r] == UINT32_MAX)
+            {
+                first_accesses[r] = accesses[j];
+                first_uses[r] = i;
+            }
+            last_uses[r] = i;
+        }
+    }
+
+    for (uint32_t frame = 0; frame < 2; frame++)
+    {
+        bool record = frame == 1;
+
+        if (record)
+        {
+            memcpy(frame_end_states, states, sizeof(ResourceState) * resource_count);
+
+            for (uint32_t r = 0; r < resource_count; r++)
+            {
+                // The memory was used by other resources in the meantime
+                if (graph->resources[r].transient)
+                {
+                    memset(&states[r], 0, sizeof(states[r]));
+                }
+                states[r].first_source = UINT32_MAX;
+                states[r].last_source = UINT32_MAX;
+
+                // Done by the first pass using the image, on the queue that uses it first
+                if (!graph->resources[r].transient &&
+                    states[r].layout != VK_IMAGE_LAYOUT_UNDEFINED)
+                {
+                    MtRenderGraphPass *first_pass = &graph->passes[order[first_uses[r]]];
+                    push_barrier(
+                        graph,
+                        &first_pass->initial_barriers,
+                        &(PendingBarrier){
+                            .resource = r,
+                            .src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            .dst_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                            .dst_access = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+                            .old_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                            .new_layout = states[r].layout,
+                        });
+                }
+            }
+        }
+
+        for (uint32_t i = 0; record && i < mt_array_size(alias_waits); i++)
+        {
+            const MtGraphAliasWait *wait = &alias_waits[i];
+            if (!wait->previous_frame) continue;
+
+            // The first barrier of the resource waits for the last users of its memory
+            ResourceState *state = &states[wait->resource];
+            ResourceState *end = &frame_end_states[wait->wait_for];
+            state->write_stages |= end->write_stages;
+            state->write_access |= end->write_access;
+            state->read_stages |= end->read_stages;
+
+            // Their writes to other resources are made available by the alias wait
+            if (wait->wait_for != wait->resource)
+            {
+                MtRenderGraphPass *first_pass = &graph->passes[order[first_uses[wait->resource]]];
+                first_pass->alias_wait_stages |= end->write_stages | end->read_stages;
+            }
+        }
+
+        for (uint32_t i = 0; i < order_size; i++)
+        {
+            MtRenderGraphPass *pass = &graph->passes[order[i]];
+            get_pass_accesses(graph, pass, &accesses);
+
+            VkPipelineStageFlags pass_stages = 0;
+
+            for (uint32_t j = 0; j < mt_array_size(accesses); j++)
+            {
+                ResourceAccess *access = &accesses[j];
+                ResourceState *state = &states[access->resource];
+                pass_stages |= access->stages;
+
+                PendingBarrier pending;
+                bool needed = transition_resource(state, access, i, &pending);
+
+                // Attachments are cleared or overwritten by the render pass
+                if (access->write && (access->layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL ||
+                                      access->layout ==
+                                          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL))
+                {
+                    pending.old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+                }
+
+                if (!record || !needed) continue;
+
+                // The passes of other queues were waited for with a semaphore at the stages
+                // of this pass, the barrier must come after that wait
+                bool other_queue = false;
+                for (uint32_t k = pending.first_source;
+                     pending.first_source != UINT32_MAX && k <= pending.last_source;
+                     k++)
+                {
+                    other_queue |= graph->passes[order[k]].group->queue_type !=
+                                   pass->group->queue_type;
+                }
+                if (other_queue) pending.src_stages |= pending.dst_stages;
+                fit_barrier_to_queue(&pending, pass->group->queue_type);
+
+                MtRenderGraphPass *source = NULL;
+                if (!other_queue && pending.first_source != UINT32_MAX &&
+                    pending.first_source == pending.last_source)
+                {
+                    source = &graph->passes[order[pending.first_source]];
+                }
+
+                if (!source || source->group != pass->group || source == pass->prev)
+                {
+                    push_barrier(graph, &pass->barriers, &pending);
+                    continue;
+                }
+
+                uint32_t event_index = UINT32_MAX;
+                for (uint32_t k = 0; k < mt_array_size(pass->wait_events); k++)
+                {
+                    if (graph->split_events[pass->wait_events[k]].source_pass == source->index)
+                    {
+                        event_index = pass->wait_events[k];
+                    }
+                }
+
+                if (event_index == UINT32_MAX)
+                {
+                    event_index = (uint32_t)mt_array_size(graph->split_events);
+                    mt_array_push(
+                        alloc, graph->split_events, ((SplitEvent){.source_pass = source->index}));
+                    mt_array_push(alloc, pass->wait_events, event_index);
+                    mt_array_push(alloc, source->set_events, event_index);
+                }
+
+                graph->split_events[event_index].stages |= pending.src_stages;
+                push_barrier(graph, &pass->split_barriers, &pending);
+            }
+
+            if (record && pass->alias_wait_stages)
+            {
+                VkMemoryBarrier barrier = {
+                    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                    .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+                };
+                mt_array_push(alloc, pass->barriers.memory_barriers, barrier);
+                pass->barriers.src_stages |= pass->alias_wait_stages;
+                pass->barriers.dst_stages |= pass_stages;
+            }
+
+            //
+            // Images that other graphs or the next frame may sample go back to a read
+            // layout after their last use
+            //
+
+            for (uint32_t j = 0; j < mt_array_size(accesses); j++)
+            {
+                uint32_t r = accesses[j].resource;
+                GraphResource *resource = &graph->resources[r];
+                if (last_uses[r] != i || resource->type != GRAPH_RESOURCE_IMAGE ||
+                    resource->transient ||
+                    !(resource->image_info.usage & MT_IMAGE_USAGE_SAMPLED_BIT))
+                {
+                    continue;
+                }
+
+                ResourceAccess rest = {
+                    .resource = r,
+                    .stages = first_accesses[r].stages,
+                    .access = first_accesses[r].access,
+                    .layout = image_read_layout(resource->image),
+                };
+
+                PendingBarrier pending;
+                if (transition_resource(&states[r], &rest, i, &pending) && record)
+                {
+                    fit_barrier_to_queue(&pending, pass->group->queue_type);
+                    push_barrier(graph, &pass->end_barriers, &pending);
+                }
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(graph->split_events); i++)
+    {
+        SplitEvent *split_event = &graph->split_events[i];
+        for (uint32_t f = 0; f < graph->frame_count; f++)
+        {
+            VkEventCreateInfo create_info = {.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO};
+            VK_CHECK(
+                vkCreateEvent(graph->dev->device, &create_info, NULL, &split_event->events[f]));
+        }
+    }
+
+    for (uint32_t i = 0; i < order_size; i++)
+    {
+        MtRenderGraphPass *pass = &graph->passes[order[i]];
+
+        // vkCmdWaitEvents waits for the stages all of its events were set with
+        pass->split_barriers.src_stages = 0;
+        for (uint32_t k = 0; k < mt_array_size(pass->wait_events); k++)
+        {
+            pass->split_barriers.src_stages |= graph->split_events[pass->wait_events[k]].stages;
+        }
+    }
+
+    mt_array_free(alloc, accesses);
+    mt_free(alloc, first_uses);
+    mt_free(alloc, last_uses);
+    mt_free(alloc, first_accesses);
+    mt_free(alloc, frame_end_states);
+    mt_free(alloc, states);
+}
+// }}}
+
 static bool default_color_clearer(uint32_t render_target_index, MtClearColorValue *color)
 {
     if (color)
@@ -36,23 +672,29 @@ static bool default_depth_stencil_clearer(MtClearDepthStencilValue *depth_stenci
     return true;
 }
 
-static void
-add_group(MtRenderGraph *graph, MtQueueType queue_type, uint32_t *pass_indices, bool last)
+static void init_group(
+    MtRenderGraph *graph, ExecutionGroup *group, MtQueueType queue_type, uint32_t *pass_indices)
 {
-    ExecutionGroup group = {0};
-    group.pass_indices = pass_indices;
-    group.queue_type = queue_type;
+    memset(group, 0, sizeof(*group));
+    group->pass_indices = pass_indices;
+    group->queue_type = queue_type;
+
+    // Baking happens with the device idle, so every frame before the current one is done
+    VkSemaphoreTypeCreateInfoKHR type_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+        .initialValue = graph->frame_number > 0 ? graph->frame_number - 1 : 0,
+    };
+    VkSemaphoreCreateInfo timeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_create_info,
+    };
+    VK_CHECK(
+        vkCreateSemaphore(graph->dev->device, &timeline_create_info, NULL, &group->timeline));
 
     for (uint32_t i = 0; i < graph->frame_count; ++i)
     {
-        allocate_cmd_buffers(graph->dev, group.queue_type, 1, &group.frames[i].cmd_buffer);
-
-        VkFenceCreateInfo fence_create_info = {
-            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-            .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-        };
-        VK_CHECK(
-            vkCreateFence(graph->dev->device, &fence_create_info, NULL, &group.frames[i].fence));
+        allocate_cmd_buffers(graph->dev, group->queue_type, 1, &group->frames[i].cmd_buffer);
 
         VkSemaphoreCreateInfo semaphore_create_info = {
             .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
@@ -61,50 +703,67 @@ add_group(MtRenderGraph *graph, MtQueueType queue_type, uint32_t *pass_indices,
             graph->dev->device,
             &semaphore_create_info,
             NULL,
-            &group.frames[i].execution_finished_semaphore));
-
-        if (last && graph->present)
-        {
-            mt_array_push(
-                graph->dev->alloc,
-                group.frames[i].wait_semaphores,
-                graph->image_available_semaphores[i]);
-            mt_array_push(
-                graph->dev->alloc,
-                group.frames[i].wait_stages,
-                MT_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT);
-        }
+            &group->frames[i].execution_finished_semaphore));
     }
+}
+
+static void add_group(MtRenderGraph *graph, MtQueueType queue_type, uint32_t *pass_indices)
+{
+    ExecutionGroup group;
+    init_group(graph, &group, queue_type, pass_indices);
+    mt_array_push(graph->dev->alloc, graph->execution_groups, group);
+}
 
-    if (mt_array_size(graph->execution_groups) > 0)
+static VkPipelineStageFlags group_access_stages(MtRenderGraph *graph, ExecutionGroup *group)
+{
+    VkPipelineStageFlags stages = 0;
+    for (uint32_t *pass = group->pass_indices;
+         pass != group->pass_indices + mt_array_size(group->pass_indices);
+         ++pass)
     {
-        ExecutionGroup *prev_group = mt_array_last(graph->execution_groups);
+        stages |= pass_access_stages(graph, &graph->passes[*pass]);
+    }
+    return stages;
+}
 
-        VkPipelineStageFlags wait_stages = 0;
-        for (uint32_t *pass = group.pass_indices;
-             pass != group.pass_indices + mt_array_size(group.pass_indices);
-             ++pass)
-        {
-            wait_stages |= graph->passes[*pass].stage;
-        }
+// Makes waiter wait for group, in the same frame or in the previous one
+static void add_group_wait(
+    MtRenderGraph *graph,
+    ExecutionGroup *group,
+    ExecutionGroup *waiter,
+    VkPipelineStageFlags wait_stages,
+    bool previous_frame)
+{
+    GroupWait wait = {
+        .group = (uint32_t)(group - graph->execution_groups),
+        .stages = wait_stages,
+        .previous_frame = previous_frame,
+    };
+    mt_array_push(graph->dev->alloc, waiter->waits, wait);
+}
 
-        for (uint32_t i = 0; i < graph->frame_count; ++i)
-        {
-            mt_array_push(
-                graph->dev->alloc,
-                group.frames[i].wait_semaphores,
-                prev_group->frames[i].execution_finished_semaphore);
-            mt_array_push(graph->dev->alloc, group.frames[i].wait_stages, wait_stages);
-        }
+// Passes of a group are recorded one after the other in its command buffer,
+// so barriers are only chained between them
+static void link_group_passes(MtRenderGraph *graph, ExecutionGroup *group)
+{
+    MtRenderGraphPass *prev = NULL;
+    for (uint32_t *index = group->pass_indices;
+         index != group->pass_indices + mt_array_size(group->pass_indices);
+         ++index)
+    {
+        MtRenderGraphPass *pass = &graph->passes[*index];
+        pass->group = group;
+        pass->prev = prev;
+        if (prev) prev->next = pass;
+        prev = pass;
     }
+}
 
-    mt_array_push(graph->dev->alloc, graph->execution_groups, group);
-    ExecutionGroup *last_group = mt_array_last(graph->execution_groups);
-    for (uint32_t *pass = last_group->pass_indices;
-         pass != last_group->pass_indices + mt_array_size(last_group->pass_indices);
-         ++pass)
+static void push_indices(MtAllocator *alloc, uint32_t **dst, uint32_t *src)
+{
+    for (uint32_t i = 0; i < mt_array_size(src); i++)
     {
-        graph->passes[*pass].group = last_group;
+        mt_array_push(alloc, *dst, src[i]);
     }
 }
 
@@ -113,13 +772,11 @@ static void destroy_group(MtRenderGraph *graph, ExecutionGroup *group)
     for (uint32_t i = 0; i < graph->frame_count; ++i)
     {
         free_cmd_buffers(graph->dev, group->queue_type, 1, &group->frames[i].cmd_buffer);
-        vkDestroyFence(graph->dev->device, group->frames[i].fence, NULL);
         vkDestroySemaphore(graph->dev->device, group->frames[i].execution_finished_semaphore, NULL);
-
-        mt_array_free(graph->dev->alloc, group->frames[i].wait_semaphores);
-        mt_array_free(graph->dev->alloc, group->frames[i].wait_stages);
     }
 
+    vkDestroySemaphore(graph->dev->device, group->timeline, NULL);
+    mt_array_free(graph->dev->alloc, group->waits);
     mt_array_free(graph->dev->alloc, group->pass_indices);
 }
 
@@ -138,8 +795,9 @@ static MtRenderGraph *create_graph(MtDevice *dev, MtSwapchain *swapchain, bool p
 
     if (graph->present)
     {
-        graph->frame_count = FRAMES_IN_FLIGHT;
-        for (uint32_t i = 0; i < graph->frame_count; ++i)
+        // All of them are created, so the number of frames in flight can change later
+        graph->frame_count = dev->frames_in_flight;
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
         {
             VkSemaphoreCreateInfo semaphore_create_info = {
                 .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
@@ -204,9 +862,9 @@ static void destroy_graph(MtRenderGraph *graph)
     // Destory semaphores
     //
 
-    for (uint32_t i = 0; i < graph->frame_count; ++i)
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
     {
-        if (graph->image_available_semaphores[i] != NULL)
+        if (graph->image_available_semaphores[i] != VK_NULL_HANDLE)
         {
             vkDestroySemaphore(graph->dev->device, graph->image_available_semaphores[i], NULL);
         }
@@ -216,60 +874,192 @@ static void destroy_graph(MtRenderGraph *graph)
     // Destroy hashmaps
     //
 
-    mt_hash_destroy(&graph->pass_indices);
-    mt_hash_destroy(&graph->resource_indices);
+    mt_hash_destroy(&graph->pass_indices);
+    mt_hash_destroy(&graph->resource_indices);
+
+    mt_array_free(graph->dev->alloc, graph->transient_heaps);
+    mt_array_free(graph->dev->alloc, graph->split_events);
+    mt_array_free(graph->dev->alloc, graph->wait_events);
+    mt_array_free(graph->dev->alloc, graph->wait_semaphores);
+    mt_array_free(graph->dev->alloc, graph->wait_values);
+    mt_array_free(graph->dev->alloc, graph->wait_stages);
+    mt_array_free(graph->dev->alloc, graph->signal_semaphores);
+    mt_array_free(graph->dev->alloc, graph->signal_values);
+    mt_array_free(graph->dev->alloc, graph->query_results);
+    mt_free(graph->dev->alloc, graph);
+}
+
+static void create_pass_renderpass(MtRenderGraph *graph, MtRenderGraphPass *pass);
+
+static void graph_bake(MtRenderGraph *graph)
+{
+    graph->baked = true;
+
+    MtAllocator *alloc = graph->dev->alloc;
+    uint32_t pass_count = (uint32_t)mt_array_size(graph->passes);
+
+    //
+    // Compile the pass dependencies into execution groups
+    //
+
+    MtGraphCompilerPass *compiler_passes =
+        mt_alloc(alloc, sizeof(MtGraphCompilerPass) * pass_count);
+    memset(compiler_passes, 0, sizeof(MtGraphCompilerPass) * pass_count);
+
+    for (uint32_t i = 0; i < pass_count; i++)
+    {
+        MtRenderGraphPass *pass = &graph->passes[i];
+        MtGraphCompilerPass *compiler_pass = &compiler_passes[i];
+
+        pass->group = NULL;
+        pass->prev = NULL;
+        pass->next = NULL;
+        pass->alias_wait_stages = 0;
+
+        uint32_t *reads = NULL;
+        push_indices(alloc, &reads, pass->image_transfer_inputs);
+        push_indices(alloc, &reads, pass->image_sampled_inputs);
+        push_indices(alloc, &reads, pass->buffer_reads);
+
+        uint32_t *writes = NULL;
+        push_indices(alloc, &writes, pass->color_outputs);
+        push_indices(alloc, &writes, pass->image_transfer_outputs);
+        push_indices(alloc, &writes, pass->buffer_writes);
+        if (pass->depth_output != UINT32_MAX)
+        {
+            mt_array_push(alloc, writes, pass->depth_output);
+        }
+
+        compiler_pass->queue = (uint32_t)pass_queue(pass);
+        compiler_pass->async = pass->async_compute;
+        compiler_pass->reads = reads;
+        compiler_pass->read_count = (uint32_t)mt_array_size(reads);
+        compiler_pass->writes = writes;
+        compiler_pass->write_count = (uint32_t)mt_array_size(writes);
+
+        // Buffers that can be read outside of the graph
+        for (uint32_t j = 0; j < mt_array_size(pass->buffer_writes); j++)
+        {
+            GraphResource *resource = &graph->resources[pass->buffer_writes[j]];
+            if (resource->type == GRAPH_RESOURCE_EXTERNAL_BUFFER ||
+                (resource->type == GRAPH_RESOURCE_BUFFER &&
+                 resource->buffer_info.memory == MT_BUFFER_MEMORY_HOST))
+            {
+                compiler_pass->root = true;
+            }
+        }
+    }
+
+    uint32_t resource_count = (uint32_t)mt_array_size(graph->resources);
+
+    MtGraphSchedule schedule;
+    mt_graph_compile(alloc, compiler_passes, pass_count, resource_count, &schedule);
+
+    MtRenderGraphPass *last_pass = mt_array_last(graph->passes);
+
+    if (graph->present)
+    {
+        assert(last_pass->queue_type == MT_QUEUE_GRAPHICS);
+        last_pass->present = true;
+    }
+
+    uint32_t group_count = (uint32_t)mt_array_size(schedule.group_starts);
+    for (uint32_t g = 0; g < group_count; g++)
+    {
+        uint32_t start = schedule.group_starts[g];
+        uint32_t end = (g + 1 < group_count) ? schedule.group_starts[g + 1]
+                                             : (uint32_t)mt_array_size(schedule.order);
+
+        uint32_t *pass_indices = NULL;
+        for (uint32_t i = start; i < end; i++)
+        {
+            mt_array_push(alloc, pass_indices, schedule.order[i]);
+        }
 
-    mt_array_free(graph->dev->alloc, graph->buffer_barriers);
-    mt_array_free(graph->dev->alloc, graph->image_barriers);
-    mt_free(graph->dev->alloc, graph);
-}
+        MtQueueType queue_type = pass_queue(&graph->passes[schedule.order[start]]);
+        add_group(graph, queue_type, pass_indices);
+    }
 
-static void create_pass_renderpass(MtRenderGraph *graph, MtRenderGraphPass *pass);
+    for (uint32_t g = 0; g < group_count; g++)
+    {
+        link_group_passes(graph, &graph->execution_groups[g]);
+    }
 
-static void graph_bake(MtRenderGraph *graph)
-{
-    graph->baked = true;
+    // Groups only wait for the ones of other queues they depend on. The last group waits
+    // for everything, and the first group of every other queue waits for the last group
+    // of the previous frame, so frames do not overlap on the resources they share.
+    ExecutionGroup *last_group = mt_array_last(graph->execution_groups);
 
-    //
-    // Create execution groups
-    //
+    for (uint32_t i = 0; i < mt_array_size(schedule.group_waits); i++)
+    {
+        MtGraphGroupWait *wait = &schedule.group_waits[i];
+        ExecutionGroup *group = &graph->execution_groups[wait->group];
 
-    uint32_t *pass_indices = NULL;
+        VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        if (group != last_group) wait_stages = group_access_stages(graph, group);
 
-    for (MtRenderGraphPass *pass = graph->passes;
-         pass != graph->passes + mt_array_size(graph->passes);
-         ++pass)
+        add_group_wait(graph, &graph->execution_groups[wait->wait_for], group, wait_stages, false);
+    }
+
+    for (uint32_t g = 0; g < group_count; g++)
     {
-        if (pass->prev)
+        ExecutionGroup *group = &graph->execution_groups[g];
+        bool first_of_queue = true;
+        for (uint32_t h = 0; h < g; h++)
         {
-            if (pass->prev->stage != pass->stage)
-            {
-                // Consolidate group
-                add_group(graph, pass->prev->queue_type, pass_indices, false);
-                pass_indices = NULL;
-            }
+            first_of_queue &= graph->execution_groups[h].queue_type != group->queue_type;
         }
 
-        mt_array_push(graph->dev->alloc, pass_indices, pass->index);
+        if (first_of_queue && group->queue_type != last_group->queue_type)
+        {
+            add_group_wait(graph, last_group, group, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, true);
+        }
     }
 
-    MtRenderGraphPass *last_pass = mt_array_last(graph->passes);
-
-    if (graph->present)
+    uint32_t *culled_indices = NULL;
+    for (uint32_t i = 0; i < pass_count; i++)
     {
-        assert(last_pass->queue_type == MT_QUEUE_GRAPHICS);
-        last_pass->present = true;
+        if (schedule.culled[i]) mt_array_push(alloc, culled_indices, i);
     }
 
-    add_group(graph, last_pass->queue_type, pass_indices, true);
+    if (culled_indices)
+    {
+        graph->culled_group = mt_alloc(alloc, sizeof(ExecutionGroup));
+        init_group(graph, graph->culled_group, MT_QUEUE_GRAPHICS, culled_indices);
+        link_group_passes(graph, graph->culled_group);
+    }
 
     //
     // Create resources
     //
-    for (GraphResource *resource = graph->resources;
-         resource != graph->resources + mt_array_size(graph->resources);
-         ++resource)
+
+    MtGraphAliasResource *alias_resources =
+        mt_alloc(alloc, sizeof(MtGraphAliasResource) * resource_count);
+    memset(alias_resources, 0, sizeof(MtGraphAliasResource) * resource_count);
+
+    // Queues each resource is used from, as bits of MtQueueType
+    uint32_t *resource_queues = mt_alloc(alloc, sizeof(uint32_t) * resource_count);
+    memset(resource_queues, 0, sizeof(uint32_t) * resource_count);
+    for (uint32_t i = 0; i < pass_count; i++)
+    {
+        uint32_t queue_bit = 1u << pass_queue(&graph->passes[i]);
+        for (uint32_t j = 0; j < compiler_passes[i].read_count; j++)
+        {
+            resource_queues[compiler_passes[i].reads[j]] |= queue_bit;
+        }
+        for (uint32_t j = 0; j < compiler_passes[i].write_count; j++)
+        {
+            resource_queues[compiler_passes[i].writes[j]] |= queue_bit;
+        }
+    }
+
+    for (uint32_t i = 0; i < resource_count; i++)
     {
+        GraphResource *resource = &graph->resources[i];
+        MtGraphAliasResource *alias_resource = &alias_resources[i];
+        VkMemoryRequirements requirements = {0};
+        bool async = resource_queues[i] & (1u << MT_QUEUE_COMPUTE);
+
         switch (resource->type)
         {
             case GRAPH_RESOURCE_IMAGE: {
@@ -300,21 +1090,160 @@ static void graph_bake(MtRenderGraph *graph)
                     }
                 }
 
-                resource->image = mt_render.create_image(graph->dev, &image_create_info);
+                resource->image = create_unbound_image(graph->dev, &image_create_info, async);
+                vkGetImageMemoryRequirements(
+                    graph->dev->device, resource->image->image, &requirements);
+                alias_resource->can_alias = true;
+                break;
+            }
+            case GRAPH_RESOURCE_BUFFER: {
+                resource->buffer =
+                    create_unbound_buffer(graph->dev, &resource->buffer_info, async);
+                vkGetBufferMemoryRequirements(
+                    graph->dev->device, resource->buffer->buffer, &requirements);
+                alias_resource->can_alias = resource->buffer_info.memory == MT_BUFFER_MEMORY_DEVICE;
+                break;
+            }
+            case GRAPH_RESOURCE_EXTERNAL_BUFFER: break;
+        }
+
+        alias_resource->size = requirements.size;
+        alias_resource->alignment = requirements.alignment;
+        alias_resource->memory_type_bits = requirements.memoryTypeBits;
+        // Keeps images and buffers in different heaps, so bufferImageGranularity never matters
+        alias_resource->kind = (uint32_t)resource->type;
+        // Memory is only handed over between passes of the graphics queue, where barriers
+        // are enough to order them
+        if (resource_queues[i] & ~(1u << MT_QUEUE_GRAPHICS)) alias_resource->can_alias = false;
+    }
+
+    mt_free(alloc, resource_queues);
+
+    //
+    // Place the transient resources in shared memory
+    //
+
+    MtGraphAliasing aliasing;
+    mt_graph_alias(alloc, compiler_passes, &schedule, alias_resources, resource_count, &aliasing);
+
+    for (uint32_t h = 0; h < mt_array_size(aliasing.heaps); h++)
+    {
+        VkMemoryRequirements requirements = {
+            .size = aliasing.heaps[h].size,
+            .alignment = aliasing.heaps[h].alignment,
+            .memoryTypeBits = aliasing.heaps[h].memory_type_bits,
+        };
+        VmaAllocationCreateInfo alloc_create_info = {.usage = VMA_MEMORY_USAGE_GPU_ONLY};
+
+        VmaAllocation heap;
+        VK_CHECK(vmaAllocateMemory(
+            graph->dev->gpu_allocator, &requirements, &alloc_create_info, &heap, NULL));
+        mt_array_push(alloc, graph->transient_heaps, heap);
+    }
+
+    for (uint32_t i = 0; i < resource_count; i++)
+    {
+        GraphResource *resource = &graph->resources[i];
+        MtGraphAliasPlacement *placement = &aliasing.placements[i];
+        resource->transient = placement->heap != UINT32_MAX;
+
+        switch (resource->type)
+        {
+            case GRAPH_RESOURCE_IMAGE: {
+                if (resource->transient)
+                {
+                    VK_CHECK(vmaBindImageMemory2(
+                        graph->dev->gpu_allocator,
+                        graph->transient_heaps[placement->heap],
+                        placement->offset,
+                        resource->image->image,
+                        NULL));
+                }
+                else
+                {
+                    allocate_image_memory(graph->dev, resource->image);
+                }
+                create_image_view(graph->dev, resource->image);
                 break;
             }
             case GRAPH_RESOURCE_BUFFER: {
-                resource->buffer = mt_render.create_buffer(graph->dev, &resource->buffer_info);
+                if (resource->transient)
+                {
+                    VK_CHECK(vmaBindBufferMemory2(
+                        graph->dev->gpu_allocator,
+                        graph->transient_heaps[placement->heap],
+                        placement->offset,
+                        resource->buffer->buffer,
+                        NULL));
+                }
+                else
+                {
+                    allocate_buffer_memory(graph->dev, resource->buffer);
+                }
                 break;
             }
             case GRAPH_RESOURCE_EXTERNAL_BUFFER: break;
         }
     }
 
+    // The first pass using a resource waits for the last passes that used the same memory
+    // before it in the frame. Uses from the previous frame are waited for by its barriers.
+    for (uint32_t i = 0; i < mt_array_size(aliasing.waits); i++)
+    {
+        MtGraphAliasWait *wait = &aliasing.waits[i];
+        if (wait->previous_frame) continue;
+
+        MtGraphAliasPlacement *placement = &aliasing.placements[wait->resource];
+        MtGraphAliasPlacement *other = &aliasing.placements[wait->wait_for];
+        MtRenderGraphPass *first_pass = &graph->passes[schedule.order[placement->first_use]];
+        MtRenderGraphPass *last_pass = &graph->passes[schedule.order[other->last_use]];
+        first_pass->alias_wait_stages |= last_pass->stage;
+    }
+
+    if (aliasing.transient_size > 0)
+    {
+        const double mib = 1024.0 * 1024.0;
+        mt_log_debug(
+            "Render graph transient memory: %.2f MiB in %u heaps instead of %.2f MiB, "
+            "%.2f MiB saved (peak in use: %.2f MiB)",
+            (double)aliasing.heap_size / mib,
+            (uint32_t)mt_array_size(aliasing.heaps),
+            (double)aliasing.transient_size / mib,
+            (double)(aliasing.transient_size - aliasing.heap_size) / mib,
+            (double)aliasing.peak_size / mib);
+    }
+
+    mt_free(alloc, alias_resources);
+
+    //
+    // Barriers
+    //
+
+    bake_barriers(graph, schedule.order, (uint32_t)mt_array_size(schedule.order), aliasing.waits);
+    mt_graph_aliasing_destroy(alloc, &aliasing);
+    graph->first_frame = true;
+
+    // The frames before include the time it took to bake
+    memset(graph->frame_start_ns, 0, sizeof(graph->frame_start_ns));
+
+    profiler_init(graph);
+
+    mt_graph_schedule_destroy(alloc, &schedule);
+
+    for (uint32_t i = 0; i < pass_count; i++)
+    {
+        uint32_t *reads = (uint32_t *)compiler_passes[i].reads;
+        uint32_t *writes = (uint32_t *)compiler_passes[i].writes;
+        mt_array_free(alloc, reads);
+        mt_array_free(alloc, writes);
+    }
+    mt_free(alloc, compiler_passes);
+
     //
     // Create render passes
     //
 
+    MtRenderPass **render_passes = NULL;
     for (MtRenderGraphPass *pass = graph->passes;
          pass != graph->passes + mt_array_size(graph->passes);
          ++pass)
@@ -322,9 +1251,13 @@ static void graph_bake(MtRenderGraph *graph)
         if (pass->queue_type == MT_QUEUE_GRAPHICS)
         {
             create_pass_renderpass(graph, pass);
+            mt_array_push(alloc, render_passes, &pass->render_pass);
         }
     }
 
+    warm_pipeline_instances(graph->dev, render_passes, mt_array_size(render_passes));
+    mt_array_free(alloc, render_passes);
+
     /* mt_log_debug( */
     /*     "Baked render graph with %lu execution groups", mt_array_size(graph->execution_groups));
      */
@@ -334,6 +1267,11 @@ static void graph_unbake(MtRenderGraph *graph)
 {
     graph->baked = false;
 
+    // Semaphores and events may still be in use by the last frames
+    if (mt_array_size(graph->execution_groups) > 0) device_wait_idle(graph->dev);
+
+    profiler_destroy(graph);
+
     //
     // Destroy the execution groups
     //
@@ -344,6 +1282,37 @@ static void graph_unbake(MtRenderGraph *graph)
     }
     mt_array_free(graph->dev->alloc, graph->execution_groups);
 
+    if (graph->culled_group)
+    {
+        destroy_group(graph, graph->culled_group);
+        mt_free(graph->dev->alloc, graph->culled_group);
+        graph->culled_group = NULL;
+    }
+
+    //
+    // Destroy the barriers
+    //
+    for (uint32_t i = 0; i < mt_array_size(graph->split_events); ++i)
+    {
+        for (uint32_t f = 0; f < graph->frame_count; f++)
+        {
+            vkDestroyEvent(graph->dev->device, graph->split_events[i].events[f], NULL);
+        }
+    }
+    mt_array_set_size(graph->split_events, 0);
+
+    for (MtRenderGraphPass *pass = graph->passes;
+         pass != graph->passes + mt_array_size(graph->passes);
+         ++pass)
+    {
+        destroy_pass_barriers(graph->dev->alloc, &pass->initial_barriers);
+        destroy_pass_barriers(graph->dev->alloc, &pass->barriers);
+        destroy_pass_barriers(graph->dev->alloc, &pass->split_barriers);
+        destroy_pass_barriers(graph->dev->alloc, &pass->end_barriers);
+        mt_array_free(graph->dev->alloc, pass->set_events);
+        mt_array_free(graph->dev->alloc, pass->wait_events);
+    }
+
     //
     // Destroy passes
     //
@@ -391,7 +1360,15 @@ static void graph_unbake(MtRenderGraph *graph)
             }
             case GRAPH_RESOURCE_EXTERNAL_BUFFER: break;
         }
+
+        resource->transient = false;
+    }
+
+    for (uint32_t i = 0; i < mt_array_size(graph->transient_heaps); i++)
+    {
+        vmaFreeMemory(graph->dev->gpu_allocator, graph->transient_heaps[i]);
     }
+    mt_array_set_size(graph->transient_heaps, 0);
 }
 
 static void graph_on_resize(MtRenderGraph *graph)
@@ -399,15 +1376,69 @@ static void graph_on_resize(MtRenderGraph *graph)
     graph->framebuffer_resized = true;
 }
 
+// Blocks until every group finished the frame with the given number
+static void graph_wait_frame(MtRenderGraph *graph, uint64_t frame_number)
+{
+    uint32_t group_count = (uint32_t)mt_array_size(graph->execution_groups);
+    if (group_count == 0 || frame_number == 0) return;
+
+    mt_array_set_size(graph->wait_semaphores, 0);
+    mt_array_set_size(graph->wait_values, 0);
+    for (uint32_t i = 0; i < group_count; i++)
+    {
+        mt_array_push(
+            graph->dev->alloc, graph->wait_semaphores, graph->execution_groups[i].timeline);
+        mt_array_push(graph->dev->alloc, graph->wait_values, frame_number);
+    }
+
+    VkSemaphoreWaitInfoKHR wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+        .semaphoreCount = group_count,
+        .pSemaphores = graph->wait_semaphores,
+        .pValues = graph->wait_values,
+    };
+    VK_CHECK(vkWaitSemaphoresKHR(graph->dev->device, &wait_info, UINT64_MAX));
+}
+
 static void graph_wait_all(MtRenderGraph *graph)
 {
-    for (ExecutionGroup *group = graph->execution_groups;
-         group != graph->execution_groups + mt_array_size(graph->execution_groups);
-         ++group)
+    // The frame being recorded was not submitted yet
+    graph_wait_frame(graph, graph->recording ? graph->frame_number - 1 : graph->frame_number);
+}
+
+static void graph_set_frames_in_flight(MtRenderGraph *graph, uint32_t frames_in_flight)
+{
+    assert(!graph->recording);
+    if (!graph->present) return;
+
+    frames_in_flight = MT_MAX(frames_in_flight, 1u);
+    frames_in_flight = MT_MIN(frames_in_flight, (uint32_t)MAX_FRAMES_IN_FLIGHT);
+    if (frames_in_flight == graph->frame_count) return;
+
+    // Command buffers and events are made for each frame slot, so they are made again
+    graph_unbake(graph);
+    graph->frame_count = frames_in_flight;
+    graph->framebuffer_resized = true;
+}
+
+static void graph_get_frame_stats(MtRenderGraph *graph, MtFrameStats *stats)
+{
+    *stats = graph->frame_stats;
+    stats->frames_in_flight = graph->frame_count;
+}
+
+// Called once the previous frame of the current slot is finished
+static void update_frame_stats(MtRenderGraph *graph, uint64_t now)
+{
+    uint32_t slot = graph->current_frame;
+    MtFrameStats *stats = &graph->frame_stats;
+
+    if (graph->frame_start_ns[slot] != 0)
     {
-        vkWaitForFences(
-            graph->dev->device, 1, &group->frames[graph->current_frame].fence, VK_TRUE, UINT64_MAX);
+        stats->present_latency_ms = (double)(now - graph->frame_start_ns[slot]) / 1e6;
     }
+
+    profiler_read_results(graph);
 }
 
 static MtCmdBuffer *pass_begin(MtRenderGraph *graph, const char *name)
@@ -419,7 +1450,8 @@ static MtCmdBuffer *pass_begin(MtRenderGraph *graph, const char *name)
         //
 
         graph->recording = true;
-        graph->current_frame = (graph->current_frame + 1) % graph->frame_count;
+        graph->frame_number++;
+        graph->current_frame = (uint32_t)(graph->frame_number % graph->frame_count);
 
         if (graph->framebuffer_resized || !graph->baked)
         {
@@ -429,17 +1461,22 @@ static MtCmdBuffer *pass_begin(MtRenderGraph *graph, const char *name)
             graph_bake(graph);
         }
 
-        if (graph->present)
+        // The resources of the slot are free once the frame that used them last is done
+        uint64_t wait_start = mt_time_ns();
+        if (graph->frame_number > graph->frame_count)
         {
-            ExecutionGroup *swapchain_group = mt_array_last(graph->execution_groups);
-
-            vkWaitForFences(
-                graph->dev->device,
-                1,
-                &swapchain_group->frames[graph->current_frame].fence,
-                VK_TRUE,
-                UINT64_MAX);
+            graph_wait_frame(graph, graph->frame_number - graph->frame_count);
+        }
+        update_frame_stats(graph, mt_time_ns());
 
+        if (graph->present && swapchain_is_offscreen(graph->swapchain))
+        {
+            MtSwapchain *swapchain = graph->swapchain;
+            swapchain->current_image_index =
+                (swapchain->current_image_index + 1) % swapchain->swapchain_image_count;
+        }
+        else if (graph->present)
+        {
             VkResult res;
             while (1)
             {
@@ -459,12 +1496,17 @@ static MtCmdBuffer *pass_begin(MtRenderGraph *graph, const char *name)
                 swapchain_destroy_resizables(graph->swapchain);
                 swapchain_create_resizables(graph->swapchain);
 
-                graph->framebuffer_resized = true;
-                return pass_begin(graph, name);
+                graph_unbake(graph);
+                graph_bake(graph);
             }
 
             VK_CHECK(res);
         }
+
+        uint64_t now = mt_time_ns();
+        graph->cpu_wait_ns = now - wait_start;
+        graph->frame_stats.cpu_wait_ms = (double)graph->cpu_wait_ns / 1e6;
+        graph->frame_start_ns[graph->current_frame] = now;
     }
 
     uint64_t pass_index = mt_hash_get_uint(&graph->pass_indices, mt_hash_str(name));
@@ -476,91 +1518,55 @@ static MtCmdBuffer *pass_begin(MtRenderGraph *graph, const char *name)
 
     if (!group->recording)
     {
-        vkWaitForFences(
-            graph->dev->device, 1, &group->frames[graph->current_frame].fence, VK_TRUE, UINT64_MAX);
-
         begin_cmd_buffer(cb);
         group->recording = true;
+
+        profiler_cmd_begin_group(graph, group);
     }
 
+    profiler_cmd_begin_pass(graph, pass);
+
     //
-    // Apply some barriers
+    // Apply the barriers
     //
 
-    VkPipelineStageFlags src_stage_mask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-    VkPipelineStageFlags dst_stage_mask = pass->stage;
-    if (pass->prev) src_stage_mask = pass->prev->stage;
-
-    mt_array_set_size(graph->buffer_barriers, 0);
-    mt_array_set_size(graph->image_barriers, 0);
-
-    for (uint32_t *res = pass->image_transfer_outputs;
-         res != pass->image_transfer_outputs + mt_array_size(pass->image_transfer_outputs);
-         ++res)
+    if (graph->first_frame)
     {
-        MtImage *image = graph->resources[*res].image;
-
-        VkImageMemoryBarrier barrier = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .srcAccessMask = 0,
-            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .image = image->image,
-            .subresourceRange =
-                {
-                    .aspectMask = image->aspect,
-                    .baseMipLevel = 0,
-                    .levelCount = image->mip_count,
-                    .baseArrayLayer = 0,
-                    .layerCount = image->layer_count,
-                },
-        };
-        mt_array_push(graph->dev->alloc, graph->image_barriers, barrier);
+        cmd_pass_barriers(cb, &pass->initial_barriers);
     }
 
-    for (uint32_t *res = pass->buffer_writes;
-         res != pass->buffer_writes + mt_array_size(pass->buffer_writes);
-         ++res)
-    {
-        VkBufferMemoryBarrier barrier = {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .srcAccessMask = 0,
-            .dstAccessMask = 0,
-            .buffer = graph->resources[*res].buffer->buffer,
-            .offset = 0,
-            .size = VK_WHOLE_SIZE,
-        };
+    cmd_pass_barriers(cb, &pass->barriers);
 
-        if (src_stage_mask & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+    if (mt_array_size(pass->wait_events) > 0)
+    {
+        mt_array_set_size(graph->wait_events, 0);
+        for (uint32_t i = 0; i < mt_array_size(pass->wait_events); i++)
         {
-            barrier.srcAccessMask |= VK_ACCESS_SHADER_READ_BIT;
+            SplitEvent *split_event = &graph->split_events[pass->wait_events[i]];
+            mt_array_push(
+                graph->dev->alloc, graph->wait_events, split_event->events[graph->current_frame]);
         }
 
-        if (dst_stage_mask & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+        PassBarriers *barriers = &pass->split_barriers;
+        vkCmdWaitEvents(
+            cb->cmd_buffer,
+            (uint32_t)mt_array_size(graph->wait_events),
+            graph->wait_events,
+            barriers->src_stages,
+            barriers->dst_stages,
+            (uint32_t)mt_array_size(barriers->memory_barriers),
+            barriers->memory_barriers,
+            (uint32_t)mt_array_size(barriers->buffer_barriers),
+            barriers->buffer_barriers,
+            (uint32_t)mt_array_size(barriers->image_barriers),
+            barriers->image_barriers);
+
+        for (uint32_t i = 0; i < mt_array_size(graph->wait_events); i++)
         {
-            barrier.srcAccessMask |= VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdResetEvent(cb->cmd_buffer, graph->wait_events[i], barriers->dst_stages);
         }
-
-        mt_array_push(graph->dev->alloc, graph->buffer_barriers, barrier);
     }
 
-    vkCmdPipelineBarrier(
-        cb->cmd_buffer,
-        src_stage_mask,
-        dst_stage_mask,
-        0,
-        0,
-        NULL,
-        (uint32_t)mt_array_size(graph->buffer_barriers),
-        graph->buffer_barriers,
-        (uint32_t)mt_array_size(graph->image_barriers),
-        graph->image_barriers);
-
     //
     // Begin render pass (if applicable)
     //
@@ -605,83 +1611,21 @@ static void pass_end(MtRenderGraph *graph, const char *name)
     // Apply more barriers
     //
 
-    VkPipelineStageFlags src_stage_mask = pass->stage;
-    VkPipelineStageFlags dst_stage_mask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-    if (pass->next) dst_stage_mask = pass->next->stage;
-
-    mt_array_set_size(graph->buffer_barriers, 0);
-    mt_array_set_size(graph->image_barriers, 0);
-
-    for (uint32_t *res = pass->image_transfer_outputs;
-         res != pass->image_transfer_outputs + mt_array_size(pass->image_transfer_outputs);
-         ++res)
-    {
-        MtImage *image = graph->resources[*res].image;
-
-        VkImageMemoryBarrier barrier = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            .image = image->image,
-            .subresourceRange =
-                {
-                    .aspectMask = image->aspect,
-                    .baseMipLevel = 0,
-                    .levelCount = image->mip_count,
-                    .baseArrayLayer = 0,
-                    .layerCount = image->layer_count,
-                },
-        };
-        mt_array_push(graph->dev->alloc, graph->image_barriers, barrier);
-    }
+    cmd_pass_barriers(cb, &pass->end_barriers);
 
-    for (uint32_t *res = pass->buffer_writes;
-         res != pass->buffer_writes + mt_array_size(pass->buffer_writes);
-         ++res)
+    for (uint32_t i = 0; i < mt_array_size(pass->set_events); i++)
     {
-        VkBufferMemoryBarrier barrier = {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .srcAccessMask = 0,
-            .dstAccessMask = 0,
-            .buffer = graph->resources[*res].buffer->buffer,
-            .offset = 0,
-            .size = VK_WHOLE_SIZE,
-        };
-
-        if (src_stage_mask & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
-        {
-            barrier.srcAccessMask |= VK_ACCESS_SHADER_WRITE_BIT;
-        }
-
-        if (dst_stage_mask & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
-        {
-            barrier.srcAccessMask |= VK_ACCESS_SHADER_READ_BIT;
-        }
-
-        mt_array_push(graph->dev->alloc, graph->buffer_barriers, barrier);
+        SplitEvent *split_event = &graph->split_events[pass->set_events[i]];
+        vkCmdSetEvent(
+            cb->cmd_buffer, split_event->events[graph->current_frame], split_event->stages);
     }
 
-    vkCmdPipelineBarrier(
-        cb->cmd_buffer,
-        src_stage_mask,
-        dst_stage_mask,
-        0,
-        0,
-        NULL,
-        (uint32_t)mt_array_size(graph->buffer_barriers),
-        graph->buffer_barriers,
-        (uint32_t)mt_array_size(graph->image_barriers),
-        graph->image_barriers);
+    profiler_cmd_end_pass(graph, pass);
 
     if (*mt_array_last(group->pass_indices) == pass->index)
     {
         assert(group->recording);
+        profiler_cmd_end_group(graph, group);
         end_cmd_buffer(cb);
         group->recording = false;
     }
@@ -689,39 +1633,76 @@ static void pass_end(MtRenderGraph *graph, const char *name)
 
 static void graph_execute(MtRenderGraph *graph)
 {
+    MtAllocator *alloc = graph->dev->alloc;
+
     for (ExecutionGroup *group = graph->execution_groups;
          group != graph->execution_groups + mt_array_size(graph->execution_groups);
          ++group)
     {
-        VK_CHECK(vkResetFences(graph->dev->device, 1, &group->frames[graph->current_frame].fence));
+        bool presents = graph->present && group == mt_array_last(graph->execution_groups) &&
+                        !swapchain_is_offscreen(graph->swapchain);
+
+        mt_array_set_size(graph->wait_semaphores, 0);
+        mt_array_set_size(graph->wait_values, 0);
+        mt_array_set_size(graph->wait_stages, 0);
+        for (uint32_t i = 0; i < mt_array_size(group->waits); i++)
+        {
+            GroupWait *wait = &group->waits[i];
+            uint64_t value = graph->frame_number - (wait->previous_frame ? 1 : 0);
+            mt_array_push(
+                alloc, graph->wait_semaphores, graph->execution_groups[wait->group].timeline);
+            mt_array_push(alloc, graph->wait_values, value);
+            mt_array_push(alloc, graph->wait_stages, wait->stages);
+        }
+
+        // Values are ignored for binary semaphores
+        if (presents)
+        {
+            mt_array_push(
+                alloc,
+                graph->wait_semaphores,
+                graph->image_available_semaphores[graph->current_frame]);
+            mt_array_push(alloc, graph->wait_values, 0);
+            mt_array_push(
+                alloc, graph->wait_stages, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        }
 
-        uint32_t signal_semaphore_count = 1;
-        VkSemaphore *signal_semaphores =
-            &group->frames[graph->current_frame].execution_finished_semaphore;
+        mt_array_set_size(graph->signal_semaphores, 0);
+        mt_array_set_size(graph->signal_values, 0);
+        mt_array_push(alloc, graph->signal_semaphores, group->timeline);
+        mt_array_push(alloc, graph->signal_values, graph->frame_number);
 
-        if (group == mt_array_last(graph->execution_groups) && !graph->present)
+        if (presents)
         {
-            signal_semaphore_count = 0;
-            signal_semaphores = NULL;
+            mt_array_push(
+                alloc,
+                graph->signal_semaphores,
+                group->frames[graph->current_frame].execution_finished_semaphore);
+            mt_array_push(alloc, graph->signal_values, 0);
         }
 
+        uint32_t wait_count = (uint32_t)mt_array_size(graph->wait_semaphores);
         MtCmdBuffer *cb = group->frames[graph->current_frame].cmd_buffer;
 
         submit_cmd(
             graph->dev,
             &(SubmitInfo){
                 .cmd_buffer = cb,
-                .wait_semaphore_count =
-                    mt_array_size(group->frames[graph->current_frame].wait_semaphores),
-                .wait_semaphores = group->frames[graph->current_frame].wait_semaphores,
-                .wait_stages = group->frames[graph->current_frame].wait_stages,
-                .signal_semaphore_count = signal_semaphore_count,
-                .signal_semaphores = signal_semaphores,
-                .fence = group->frames[graph->current_frame].fence,
+                .wait_semaphore_count = wait_count,
+                .wait_semaphores = wait_count > 0 ? graph->wait_semaphores : NULL,
+                .wait_stages = wait_count > 0 ? graph->wait_stages : NULL,
+                .wait_values = wait_count > 0 ? graph->wait_values : NULL,
+                .signal_semaphore_count = (uint32_t)mt_array_size(graph->signal_semaphores),
+                .signal_semaphores = graph->signal_semaphores,
+                .signal_values = graph->signal_values,
             });
     }
 
-    if (graph->present)
+    if (graph->present && swapchain_is_offscreen(graph->swapchain))
+    {
+        swapchain_end_frame(graph->swapchain);
+    }
+    else if (graph->present)
     {
         ExecutionGroup *group = mt_array_last(graph->execution_groups);
 
@@ -751,6 +1732,7 @@ static void graph_execute(MtRenderGraph *graph)
     }
 
     graph->recording = false;
+    graph->first_frame = false;
 }
 
 static uint32_t add_graph_resource(MtRenderGraph *graph, const char *name, GraphResourceType type)
@@ -801,6 +1783,8 @@ static MtImage *graph_consume_image(MtRenderGraph *graph, const char *name)
     uint64_t index = mt_hash_get_uint(&graph->resource_indices, mt_hash_str(name));
     assert(index != MT_HASH_NOT_FOUND);
     assert(graph->resources[index].type == GRAPH_RESOURCE_IMAGE);
+    // The memory of transient images belongs to the graph
+    assert(!graph->resources[index].transient);
     MtImage *image = graph->resources[index].image;
     graph->resources[index].image = NULL;
     return image;
@@ -854,12 +1838,6 @@ graph_add_pass(MtRenderGraph *graph, const char *name, MtPipelineStage stage)
     pass->name = name;
     pass->depth_output = UINT32_MAX;
 
-    if (pass->index > 0)
-    {
-        graph->passes[pass->index].prev = &graph->passes[pass->index - 1];
-        graph->passes[pass->index - 1].next = &graph->passes[pass->index];
-    }
-
     mt_hash_set_uint(&graph->pass_indices, mt_hash_str(name), index);
     return pass;
 }
@@ -875,6 +1853,12 @@ pass_set_depth_stencil_clearer(MtRenderGraphPass *pass, MtRenderGraphDepthStenci
     pass->depth_stencil_clearer = clearer;
 }
 
+static void pass_set_async_compute(MtRenderGraphPass *pass, bool async_compute)
+{
+    assert(pass->queue_type == MT_QUEUE_COMPUTE);
+    pass->async_compute = async_compute;
+}
+
 static void pass_read(MtRenderGraphPass *pass, MtRenderGraphPassRead type, const char *name)
 {
     uint64_t index = mt_hash_get_uint(&pass->graph->resource_indices, mt_hash_str(name));
@@ -999,6 +1983,11 @@ static void create_pass_renderpass(MtRenderGraph *graph, MtRenderGraphPass *pass
             .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
         };
 
+        if (swapchain_is_offscreen(graph->swapchain))
+        {
+            color_attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        }
+
         if (pass->color_clearer((uint32_t)mt_array_size(rp_attachments), NULL))
         {
             color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
@@ -1027,6 +2016,7 @@ static void create_pass_renderpass(MtRenderGraph *graph, MtRenderGraphPass *pass
         GraphResource *resource = &graph->resources[pass->color_outputs[i]];
         assert(resource->type == GRAPH_RESOURCE_IMAGE);
 
+        // Layout transitions happen in the barriers around the pass
         VkAttachmentDescription color_attachment = {
             .format = resource->image->format,
             .samples = resource->image->sample_count,
@@ -1034,8 +2024,8 @@ static void create_pass_renderpass(MtRenderGraph *graph, MtRenderGraphPass *pass
             .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
             .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
         };
 
         if (pass->color_clearer((uint32_t)mt_array_size(rp_attachments), NULL))
@@ -1043,15 +2033,6 @@ static void create_pass_renderpass(MtRenderGraph *graph, MtRenderGraphPass *pass
             color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         }
 
-        if (pass->next && pass->next->queue_type == MT_QUEUE_TRANSFER)
-        {
-            // TODO: the pass that needs this might not be the immediate next one...
-            if (find_in_array(pass->next->image_transfer_inputs, resource->index))
-            {
-                color_attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            }
-        }
-
         mt_array_push(graph->dev->alloc, rp_attachments, color_attachment);
         mt_array_push(graph->dev->alloc, fb_image_views, resource->image->image_view);
     }
@@ -1070,8 +2051,8 @@ static void create_pass_renderpass(MtRenderGraph *graph, MtRenderGraphPass *pass
             .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
             .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            .initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
         };
 
         if (pass->depth_stencil_clearer(NULL))
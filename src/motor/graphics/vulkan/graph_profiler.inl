@@ -0,0 +1,281 @@
+// The timestamps of a frame slot are a pair for the whole frame, then a pair for every
+// execution group, then a pair for every pass, each written at the start and at the end.
+// Results are read back when the slot is reused, frame_count frames after being recorded.
+
+static uint32_t profiler_group_query(MtRenderGraph *graph, ExecutionGroup *group)
+{
+    return 2 + 2 * (uint32_t)(group - graph->execution_groups);
+}
+
+static uint32_t profiler_pass_query(MtRenderGraph *graph, MtRenderGraphPass *pass)
+{
+    return 2 + 2 * (uint32_t)mt_array_size(graph->execution_groups) + 2 * pass->index;
+}
+
+static uint32_t profiler_slot_query(MtRenderGraph *graph, uint32_t query)
+{
+    return graph->current_frame * graph->timestamps_per_frame + query;
+}
+
+static void profiler_init(MtRenderGraph *graph)
+{
+    MtDevice *dev = graph->dev;
+    if (!dev->timestamps_supported || mt_array_size(graph->execution_groups) == 0) return;
+
+    uint32_t pass_count = (uint32_t)mt_array_size(graph->passes);
+    graph->timestamps_per_frame =
+        2 + 2 * (uint32_t)mt_array_size(graph->execution_groups) + 2 * pass_count;
+
+    VkQueryPoolCreateInfo timestamp_create_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = graph->timestamps_per_frame * graph->frame_count,
+    };
+    VK_CHECK(
+        vkCreateQueryPool(dev->device, &timestamp_create_info, NULL, &graph->timestamp_pool));
+
+    if (dev->physical_device_features.pipelineStatisticsQuery)
+    {
+        VkQueryPoolCreateInfo statistics_create_info = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+            .queryCount = pass_count * graph->frame_count,
+            .pipelineStatistics =
+                VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+                VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,
+        };
+        VK_CHECK(vkCreateQueryPool(
+            dev->device, &statistics_create_info, NULL, &graph->statistics_pool));
+    }
+
+    // Queries have an undefined state until they are reset, and passes that are not
+    // recorded every frame would never be
+    VkFence fence = VK_NULL_HANDLE;
+    VkFenceCreateInfo fence_create_info = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    VK_CHECK(vkCreateFence(dev->device, &fence_create_info, NULL, &fence));
+
+    MtCmdBuffer *cb;
+    allocate_cmd_buffers(dev, MT_QUEUE_GRAPHICS, 1, &cb);
+    begin_cmd_buffer(cb);
+
+    vkCmdResetQueryPool(
+        cb->cmd_buffer, graph->timestamp_pool, 0, timestamp_create_info.queryCount);
+    if (graph->statistics_pool != VK_NULL_HANDLE && pass_count > 0)
+    {
+        vkCmdResetQueryPool(
+            cb->cmd_buffer, graph->statistics_pool, 0, pass_count * graph->frame_count);
+    }
+
+    end_cmd_buffer(cb);
+    submit_cmd(dev, &(SubmitInfo){.cmd_buffer = cb, .fence = fence});
+    vkWaitForFences(dev->device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+    free_cmd_buffers(dev, MT_QUEUE_GRAPHICS, 1, &cb);
+    vkDestroyFence(dev->device, fence, NULL);
+}
+
+static void profiler_destroy(MtRenderGraph *graph)
+{
+    if (graph->timestamp_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(graph->dev->device, graph->timestamp_pool, NULL);
+        graph->timestamp_pool = VK_NULL_HANDLE;
+    }
+
+    if (graph->statistics_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(graph->dev->device, graph->statistics_pool, NULL);
+        graph->statistics_pool = VK_NULL_HANDLE;
+    }
+
+    graph->timestamps_per_frame = 0;
+}
+
+static void profiler_cmd_timestamp(
+    MtRenderGraph *graph, MtCmdBuffer *cb, VkPipelineStageFlagBits stage, uint32_t query)
+{
+    uint32_t slot_query = profiler_slot_query(graph, query);
+    vkCmdWriteTimestamp(cb->cmd_buffer, stage, graph->timestamp_pool, slot_query);
+}
+
+static void profiler_cmd_begin_group(MtRenderGraph *graph, ExecutionGroup *group)
+{
+    if (graph->timestamp_pool == VK_NULL_HANDLE || group == graph->culled_group) return;
+
+    MtCmdBuffer *cb = group->frames[graph->current_frame].cmd_buffer;
+    uint32_t query = profiler_group_query(graph, group);
+
+    // The last group waits for every other one, so the frame pair is only reset by the first
+    if (group == graph->execution_groups)
+    {
+        vkCmdResetQueryPool(
+            cb->cmd_buffer, graph->timestamp_pool, profiler_slot_query(graph, 0), 2);
+        profiler_cmd_timestamp(graph, cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+    }
+
+    vkCmdResetQueryPool(
+        cb->cmd_buffer, graph->timestamp_pool, profiler_slot_query(graph, query), 2);
+    profiler_cmd_timestamp(graph, cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query);
+}
+
+static void profiler_cmd_end_group(MtRenderGraph *graph, ExecutionGroup *group)
+{
+    if (graph->timestamp_pool == VK_NULL_HANDLE || group == graph->culled_group) return;
+
+    MtCmdBuffer *cb = group->frames[graph->current_frame].cmd_buffer;
+    uint32_t query = profiler_group_query(graph, group);
+    profiler_cmd_timestamp(graph, cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query + 1);
+
+    if (group == mt_array_last(graph->execution_groups))
+    {
+        profiler_cmd_timestamp(graph, cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+    }
+}
+
+// Called outside of the render pass of the pass, both of them
+static void profiler_cmd_begin_pass(MtRenderGraph *graph, MtRenderGraphPass *pass)
+{
+    if (graph->timestamp_pool == VK_NULL_HANDLE || pass->group == graph->culled_group) return;
+
+    MtCmdBuffer *cb = pass->group->frames[graph->current_frame].cmd_buffer;
+    uint32_t query = profiler_pass_query(graph, pass);
+
+    vkCmdResetQueryPool(
+        cb->cmd_buffer, graph->timestamp_pool, profiler_slot_query(graph, query), 2);
+    profiler_cmd_timestamp(graph, cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query);
+
+    // The statistics counted are those of the graphics pipelines
+    if (graph->statistics_pool != VK_NULL_HANDLE && pass->queue_type == MT_QUEUE_GRAPHICS)
+    {
+        uint32_t stats_query =
+            graph->current_frame * (uint32_t)mt_array_size(graph->passes) + pass->index;
+        vkCmdResetQueryPool(cb->cmd_buffer, graph->statistics_pool, stats_query, 1);
+        vkCmdBeginQuery(cb->cmd_buffer, graph->statistics_pool, stats_query, 0);
+    }
+}
+
+static void profiler_cmd_end_pass(MtRenderGraph *graph, MtRenderGraphPass *pass)
+{
+    if (graph->timestamp_pool == VK_NULL_HANDLE || pass->group == graph->culled_group) return;
+
+    MtCmdBuffer *cb = pass->group->frames[graph->current_frame].cmd_buffer;
+
+    if (graph->statistics_pool != VK_NULL_HANDLE && pass->queue_type == MT_QUEUE_GRAPHICS)
+    {
+        uint32_t stats_query =
+            graph->current_frame * (uint32_t)mt_array_size(graph->passes) + pass->index;
+        vkCmdEndQuery(cb->cmd_buffer, graph->statistics_pool, stats_query);
+    }
+
+    uint32_t query = profiler_pass_query(graph, pass);
+    profiler_cmd_timestamp(graph, cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query + 1);
+}
+
+// results holds a value and its availability for every query
+static bool profiler_elapsed_ms(MtRenderGraph *graph, uint64_t *results, uint32_t query, double *ms)
+{
+    uint64_t *start = &results[query * 2];
+    uint64_t *end = &results[(query + 1) * 2];
+    if (!start[1] || !end[1] || end[0] < start[0]) return false;
+
+    float period = graph->dev->physical_device_properties.limits.timestampPeriod;
+    *ms = (double)(end[0] - start[0]) * period / 1e6;
+    return true;
+}
+
+// Called once the previous frame of the current slot is finished
+static void profiler_read_results(MtRenderGraph *graph)
+{
+    if (graph->timestamp_pool == VK_NULL_HANDLE) return;
+
+    MtDevice *dev = graph->dev;
+    uint32_t count = graph->timestamps_per_frame;
+    uint32_t pass_count = (uint32_t)mt_array_size(graph->passes);
+
+    mt_array_set_size(graph->query_results, 0);
+    mt_array_add(dev->alloc, graph->query_results, count * 2);
+
+    // Queries that were not written in that frame are simply unavailable
+    VkResult res = vkGetQueryPoolResults(
+        dev->device,
+        graph->timestamp_pool,
+        profiler_slot_query(graph, 0),
+        count,
+        sizeof(uint64_t) * 2 * count,
+        graph->query_results,
+        sizeof(uint64_t) * 2,
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (res != VK_NOT_READY) VK_CHECK(res);
+
+    profiler_elapsed_ms(graph, graph->query_results, 0, &graph->frame_stats.gpu_busy_ms);
+
+    for (ExecutionGroup *group = graph->execution_groups;
+         group != graph->execution_groups + mt_array_size(graph->execution_groups);
+         ++group)
+    {
+        uint32_t query = profiler_group_query(graph, group);
+        profiler_elapsed_ms(graph, graph->query_results, query, &group->gpu_ms);
+    }
+
+    for (MtRenderGraphPass *pass = graph->passes; pass != graph->passes + pass_count; ++pass)
+    {
+        uint32_t query = profiler_pass_query(graph, pass);
+        profiler_elapsed_ms(graph, graph->query_results, query, &pass->stats.gpu_ms);
+    }
+
+    if (graph->statistics_pool == VK_NULL_HANDLE || pass_count == 0) return;
+
+    // Primitives and fragment invocations, then the availability
+    mt_array_set_size(graph->query_results, 0);
+    mt_array_add(dev->alloc, graph->query_results, pass_count * 3);
+
+    res = vkGetQueryPoolResults(
+        dev->device,
+        graph->statistics_pool,
+        graph->current_frame * pass_count,
+        pass_count,
+        sizeof(uint64_t) * 3 * pass_count,
+        graph->query_results,
+        sizeof(uint64_t) * 3,
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (res != VK_NOT_READY) VK_CHECK(res);
+
+    for (uint32_t i = 0; i < pass_count; i++)
+    {
+        uint64_t *result = &graph->query_results[i * 3];
+        if (graph->passes[i].queue_type != MT_QUEUE_GRAPHICS || !result[2]) continue;
+
+        graph->passes[i].stats.primitives = result[0];
+        graph->passes[i].stats.fragment_invocations = result[1];
+    }
+}
+
+static void graph_get_pass_stats(MtRenderGraph *graph, uint32_t *count, MtPassStats *stats)
+{
+    *count = (uint32_t)mt_array_size(graph->passes);
+    if (!stats) return;
+
+    for (uint32_t i = 0; i < *count; i++)
+    {
+        MtRenderGraphPass *pass = &graph->passes[i];
+        stats[i] = pass->stats;
+        stats[i].name = pass->name;
+        stats[i].queue_type = pass->queue_type;
+    }
+}
+
+static void graph_get_group_stats(MtRenderGraph *graph, uint32_t *count, MtGroupStats *stats)
+{
+    *count = (uint32_t)mt_array_size(graph->execution_groups);
+    if (!stats) return;
+
+    for (uint32_t i = 0; i < *count; i++)
+    {
+        ExecutionGroup *group = &graph->execution_groups[i];
+        stats[i] = (MtGroupStats){
+            .queue_type = group->queue_type,
+            .pass_count = (uint32_t)mt_array_size(group->pass_indices),
+            .gpu_ms = group->gpu_ms,
+        };
+    }
+}
@@ -0,0 +1,138 @@
+#include <motor/graphics/vulkan/headless_window.h>
+
+#include <string.h>
+#include "internal.h"
+#include <motor/base/api_types.h>
+#include <motor/base/allocator.h>
+#include <motor/graphics/window.h>
+
+typedef struct MtWindow
+{
+    MtAllocator *alloc;
+    uint32_t width;
+    uint32_t height;
+    MtCursorMode cursor_mode;
+} MtWindow;
+
+static bool should_close(MtWindow *window)
+{
+    return false;
+}
+
+static bool next_event(MtWindow *window, MtEvent *event)
+{
+    memset(event, 0, sizeof(*event));
+    return false;
+}
+
+static void wait_events(MtWindow *window)
+{
+}
+
+static MtWindow *
+create_window(uint32_t width, uint32_t height, const char *title, MtAllocator *alloc)
+{
+    MtWindow *window = mt_alloc(alloc, sizeof(MtWindow));
+    memset(window, 0, sizeof(*window));
+
+    window->alloc = alloc;
+    window->width = width;
+    window->height = height;
+
+    return window;
+}
+
+static void destroy_window(MtWindow *window)
+{
+    mt_free(window->alloc, window);
+}
+
+static void get_size(MtWindow *window, uint32_t *width, uint32_t *height)
+{
+    *width = window->width;
+    *height = window->height;
+}
+
+static void get_cursor_pos(MtWindow *w, int32_t *x, int32_t *y)
+{
+    *x = 0;
+    *y = 0;
+}
+
+static void set_cursor_pos(MtWindow *w, int32_t x, int32_t y)
+{
+}
+
+static void get_cursor_pos_normalized(MtWindow *w, float *nx, float *ny)
+{
+    *nx = -1.0f;
+    *ny = -1.0f;
+}
+
+static MtCursorMode get_cursor_mode(MtWindow *w)
+{
+    return w->cursor_mode;
+}
+
+static void set_cursor_mode(MtWindow *w, MtCursorMode mode)
+{
+    w->cursor_mode = mode;
+}
+
+static void set_cursor_type(MtWindow *w, MtCursorType type)
+{
+}
+
+static MtInputState get_key(MtWindow *w, MtKey key_code)
+{
+    return MT_INPUT_STATE_RELEASE;
+}
+
+static MtInputState get_mouse_button(MtWindow *w, MtMouseButton button)
+{
+    return MT_INPUT_STATE_RELEASE;
+}
+
+static void poll_events(void)
+{
+}
+
+static void destroy_window_system(void)
+{
+}
+
+static MtWindowSystem g_headless_window_system = {
+    .poll_events = poll_events,
+    .destroy_window_system = destroy_window_system,
+
+    .should_close = should_close,
+    .next_event = next_event,
+    .wait_events = wait_events,
+
+    .get_size = get_size,
+
+    .get_cursor_pos = get_cursor_pos,
+    .set_cursor_pos = set_cursor_pos,
+
+    .get_cursor_pos_normalized = get_cursor_pos_normalized,
+
+    .get_cursor_mode = get_cursor_mode,
+    .set_cursor_mode = set_cursor_mode,
+
+    .set_cursor_type = set_cursor_type,
+
+    .get_key = get_key,
+    .get_mouse_button = get_mouse_button,
+
+    .create = create_window,
+    .destroy = destroy_window,
+
+    // There is no surface to present to, so the native handles are never asked for
+};
+
+void mt_headless_vulkan_window_system_init(void)
+{
+    VK_CHECK(volkInitialize());
+
+    mt_window = g_headless_window_system;
+}
@@ -1,4 +1,6 @@
-static MtImage *create_image(MtDevice *dev, MtImageCreateInfo *ci)
+// Creates the VkImage without any memory bound to it, nor a view.
+// Images used by async compute passes are shared with the compute queue family.
+static MtImage *create_unbound_image(MtDevice *dev, MtImageCreateInfo *ci, bool async_compute)
 {
     MtImage *image = mt_alloc(dev->alloc, sizeof(MtImage));
     memset(image, 0, sizeof(*image));
@@ -81,6 +83,15 @@ static MtImage *create_image(MtDevice *dev, MtImageCreateInfo *ci)
             .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
         };
 
+        // Async compute uses images from a queue family of its own
+        uint32_t queue_family_indices[2] = {dev->indices.graphics, dev->indices.compute};
+        if (async_compute && dev->indices.graphics != dev->indices.compute)
+        {
+            image_create_info.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+            image_create_info.queueFamilyIndexCount = 2;
+            image_create_info.pQueueFamilyIndices   = queue_family_indices;
+        }
+
         // Usages
         if (ci->usage & MT_IMAGE_USAGE_SAMPLED_BIT)
             image_create_info.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
@@ -100,60 +111,73 @@ static MtImage *create_image(MtDevice *dev, MtImageCreateInfo *ci)
             image_create_info.flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
         }
 
-        VmaAllocationCreateInfo image_alloc_create_info = {0};
-        image_alloc_create_info.usage                   = VMA_MEMORY_USAGE_GPU_ONLY;
-
-        VK_CHECK(vmaCreateImage(
-            dev->gpu_allocator,
-            &image_create_info,
-            &image_alloc_create_info,
-            &image->image,
-            &image->allocation,
-            NULL));
+        VK_CHECK(vkCreateImage(dev->device, &image_create_info, NULL, &image->image));
     }
 
-    // Create image view
-    {
-        VkImageViewCreateInfo image_view_create_info = {
-            .sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-            .image    = image->image,
-            .viewType = VK_IMAGE_VIEW_TYPE_2D,
-            .format   = image->format,
-            .components =
-                {
-                    .r = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .a = VK_COMPONENT_SWIZZLE_IDENTITY,
-                },
-            .subresourceRange =
-                {
-                    .aspectMask     = image->aspect,
-                    .baseMipLevel   = 0,
-                    .levelCount     = image->mip_count,
-                    .baseArrayLayer = 0,
-                    .layerCount     = image->layer_count,
-                },
-        };
+    return image;
+}
 
-        if (image->layer_count == 6)
-        {
-            image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-        }
+static void allocate_image_memory(MtDevice *dev, MtImage *image)
+{
+    VmaAllocationCreateInfo image_alloc_create_info = {0};
+    image_alloc_create_info.usage                   = VMA_MEMORY_USAGE_GPU_ONLY;
 
-        VK_CHECK(vkCreateImageView(dev->device, &image_view_create_info, NULL, &image->image_view));
+    VK_CHECK(vmaAllocateMemoryForImage(
+        dev->gpu_allocator, image->image, &image_alloc_create_info, &image->allocation, NULL));
+    VK_CHECK(vmaBindImageMemory(dev->gpu_allocator, image->allocation, image->image));
+}
+
+static void create_image_view(MtDevice *dev, MtImage *image)
+{
+    VkImageViewCreateInfo image_view_create_info = {
+        .sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image    = image->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format   = image->format,
+        .components =
+            {
+                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+            },
+        .subresourceRange =
+            {
+                .aspectMask     = image->aspect,
+                .baseMipLevel   = 0,
+                .levelCount     = image->mip_count,
+                .baseArrayLayer = 0,
+                .layerCount     = image->layer_count,
+            },
+    };
+
+    if (image->layer_count == 6)
+    {
+        image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
     }
 
-    return image;
+    VK_CHECK(vkCreateImageView(dev->device, &image_view_create_info, NULL, &image->image_view));
 }
 
-static void destroy_image(MtDevice *dev, MtImage *image)
+static MtImage *create_image(MtDevice *dev, MtImageCreateInfo *ci)
 {
-    device_wait_idle(dev);
+    MtImage *image = create_unbound_image(dev, ci, false);
+    allocate_image_memory(dev, image);
+    create_image_view(dev, image);
+    return image;
+}
 
+static void destroy_image_no_wait(MtDevice *dev, MtImage *image)
+{
     if (image->image_view)
         vkDestroyImageView(dev->device, image->image_view, NULL);
     if (image->image)
         vmaDestroyImage(dev->gpu_allocator, image->image, image->allocation);
     mt_free(dev->alloc, image);
 }
+
+static void destroy_image(MtDevice *dev, MtImage *image)
+{
+    device_wait_idle(dev);
+    destroy_image_no_wait(dev, image);
+}
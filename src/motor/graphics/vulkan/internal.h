@@ -9,7 +9,10 @@
 #include <motor/graphics/renderer.h>
 #include <motor/graphics/vulkan/vulkan_device.h>
 
-enum { FRAMES_IN_FLIGHT = 2 };
+enum {
+    MAX_FRAMES_IN_FLIGHT = MT_MAX_FRAMES_IN_FLIGHT,
+    DEFAULT_FRAMES_IN_FLIGHT = 2,
+};
 
 #define VK_CHECK(exp)                                                                              \
     do                                                                                             \
@@ -57,6 +60,41 @@ typedef struct BufferPool
     /*array*/ BufferBlock *blocks;
 } BufferPool;
 
+enum {
+    BINDLESS_IMAGE_CAPACITY = 4096,
+    BINDLESS_SAMPLER_CAPACITY = 128,
+};
+
+// Global descriptor set holding every registered image and sampler.
+// Layout: binding 0 = Texture2D[], binding 1 = SamplerState[]
+typedef struct BindlessTable
+{
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+
+    uint32_t image_count;
+    /*array*/ uint32_t *free_images;
+
+    uint32_t sampler_count;
+    /*array*/ uint32_t *free_samplers;
+} BindlessTable;
+
+typedef struct ThreadPipelineCache
+{
+    VkPipelineCache cache;
+    // Time spent creating pipelines on this thread
+    uint64_t create_ns;
+    uint32_t create_count;
+} ThreadPipelineCache;
+
+typedef struct PipelinePair
+{
+    uint64_t pipeline_hash;
+    // 0 for compute pipelines
+    uint64_t render_pass_hash;
+} PipelinePair;
+
 typedef struct MtDevice
 {
     MtAllocator *alloc;
@@ -79,6 +117,13 @@ typedef struct MtDevice
     VmaAllocator gpu_allocator;
 
     VkPhysicalDeviceProperties physical_device_properties;
+    VkPhysicalDeviceFeatures physical_device_features;
+    bool draw_indirect_count_enabled;
+    // Graphics and compute queues can write timestamps
+    bool timestamps_supported;
+
+    // Used by the graphs that present
+    uint32_t frames_in_flight;
 
     VkFormat preferred_depth_format;
 
@@ -89,9 +134,29 @@ typedef struct MtDevice
 
     MtHashMap pipeline_layout_map;
 
+    // One per thread, merged and saved to pipeline_cache_path when the device is destroyed
+    ThreadPipelineCache *pipeline_caches;
+    char *pipeline_cache_path;
+    bool pipeline_cache_warm;
+
+    // Live pipelines by hash
+    MtHashMap pipeline_map;
+    // Pipeline instances created in this run, saved to pipeline_manifest_path
+    /*array*/ PipelinePair *pipeline_manifest;
+    MtHashMap pipeline_manifest_map;
+    char *pipeline_manifest_path;
+    // Pipeline instances created in the previous run, created ahead of their first use
+    /*array*/ PipelinePair *pipeline_warm_pairs;
+
+    MtThreadPool *thread_pool;
+
     BufferPool ubo_pool;
     BufferPool vbo_pool;
     BufferPool ibo_pool;
+    BufferPool sbo_pool;
+
+    bool bindless_enabled;
+    BindlessTable bindless;
 } MtDevice;
 
 typedef struct MtRenderPass
@@ -121,6 +186,8 @@ typedef struct MtSwapchain
     VkFormat swapchain_image_format;
     VkImage *swapchain_images;
     VkImageView *swapchain_image_views;
+    // Only for headless devices, whose swapchain images are plain images with no surface
+    VmaAllocation *offscreen_allocations;
 
     VkImage depth_image;
     VmaAllocation depth_image_allocation;
@@ -144,6 +211,11 @@ typedef struct SubmitInfo
     uint32_t signal_semaphore_count;
     VkSemaphore *signal_semaphores;
 
+    // Values of the timeline semaphores, ignored for binary ones. NULL when all the
+    // semaphores are binary.
+    const uint64_t *wait_values;
+    const uint64_t *signal_values;
+
     VkFence fence;
 } SubmitInfo;
 
@@ -172,6 +244,7 @@ typedef struct Shader
 
     uint32_t set_count;
     uint32_t vertex_attribute_count;
+    uint32_t push_constant_size;
 
     char *entry_point;
 
@@ -209,6 +282,11 @@ typedef struct PipelineLayout
     SetInfo sets[MAX_DESCRIPTOR_SETS];
     uint32_t set_count;
 
+    // Set index that maps to the device's bindless table, or UINT32_MAX
+    uint32_t bindless_set;
+
+    VkPushConstantRange push_constant_range;
+
     uint64_t hash;
     uint32_t ref_count;
 } PipelineLayout;
@@ -262,6 +340,7 @@ typedef struct MtCmdBuffer
     /*array*/ BufferBlock *ubo_blocks;
     /*array*/ BufferBlock *vbo_blocks;
     /*array*/ BufferBlock *ibo_blocks;
+    /*array*/ BufferBlock *sbo_blocks;
 } MtCmdBuffer;
 
 typedef struct MtBuffer
@@ -304,6 +383,8 @@ typedef struct GraphResource
 {
     GraphResourceType type;
     uint32_t index;
+    // Placed in one of the graph's transient heaps, sharing memory with other resources
+    bool transient;
 
     uint32_t *read_in_passes;
     uint32_t *written_in_passes;
@@ -323,18 +404,49 @@ typedef struct GraphResource
     };
 } GraphResource;
 
+// Barriers recorded together, computed when the graph is baked
+typedef struct PassBarriers
+{
+    VkPipelineStageFlags src_stages;
+    VkPipelineStageFlags dst_stages;
+    /*array*/ VkMemoryBarrier *memory_barriers;
+    /*array*/ VkBufferMemoryBarrier *buffer_barriers;
+    /*array*/ VkImageMemoryBarrier *image_barriers;
+} PassBarriers;
+
+// Set at the end of a pass and waited on by a later pass of the same execution group,
+// so the passes in between can overlap with the first one
+typedef struct SplitEvent
+{
+    VkEvent events[MAX_FRAMES_IN_FLIGHT];
+    VkPipelineStageFlags stages;
+    uint32_t source_pass;
+} SplitEvent;
+
+typedef struct GroupWait
+{
+    // Index of the execution group waited for
+    uint32_t group;
+    VkPipelineStageFlags stages;
+    // Waits for the group in the previous frame instead of the current one
+    bool previous_frame;
+} GroupWait;
+
 typedef struct ExecutionGroup
 {
     MtQueueType queue_type;
     struct
     {
         MtCmdBuffer *cmd_buffer;
+        // Waited on by the presentation
         VkSemaphore execution_finished_semaphore;
-        /*array*/ VkSemaphore *wait_semaphores;
-        /*array*/ VkPipelineStageFlags *wait_stages;
-        VkFence fence;
-    } frames[FRAMES_IN_FLIGHT];
+    } frames[MAX_FRAMES_IN_FLIGHT];
+    // Timeline semaphore, set to the frame number when the group finishes a frame
+    VkSemaphore timeline;
+    /*array*/ GroupWait *waits;
     uint32_t *pass_indices;
+    // Measured by the profiler
+    double gpu_ms;
     bool recording;
 } ExecutionGroup;
 
@@ -342,12 +454,14 @@ typedef struct MtRenderGraph
 {
     MtDevice *dev;
     MtSwapchain *swapchain;
-    VkSemaphore image_available_semaphores[FRAMES_IN_FLIGHT];
+    VkSemaphore image_available_semaphores[MAX_FRAMES_IN_FLIGHT];
     bool present;
     bool recording;
 
     uint32_t current_frame;
     uint32_t frame_count;
+    // Number of the frame being recorded, or of the last one submitted, starting at 1
+    uint64_t frame_number;
     bool framebuffer_resized;
     bool baked;
 
@@ -357,10 +471,35 @@ typedef struct MtRenderGraph
     MtHashMap pass_indices;
     MtHashMap resource_indices;
 
-    /*array*/ VkBufferMemoryBarrier *buffer_barriers;
-    /*array*/ VkImageMemoryBarrier *image_barriers;
-
     /*array*/ ExecutionGroup *execution_groups;
+    // Passes nothing depends on are still recorded in here, but never submitted
+    ExecutionGroup *culled_group;
+
+    /*array*/ VmaAllocation *transient_heaps;
+
+    /*array*/ SplitEvent *split_events;
+    /*array*/ VkEvent *wait_events;
+    // Scratch arrays for the submissions
+    /*array*/ VkSemaphore *wait_semaphores;
+    /*array*/ uint64_t *wait_values;
+    /*array*/ VkPipelineStageFlags *wait_stages;
+    /*array*/ VkSemaphore *signal_semaphores;
+    /*array*/ uint64_t *signal_values;
+
+    // Frame pacing measurements, for each frame slot
+    uint64_t frame_start_ns[MAX_FRAMES_IN_FLIGHT];
+    uint64_t cpu_wait_ns;
+    MtFrameStats frame_stats;
+
+    // GPU profiler queries, made when baking with a range for each frame slot
+    VkQueryPool timestamp_pool;
+    VkQueryPool statistics_pool;
+    uint32_t timestamps_per_frame;
+    /*array*/ uint64_t *query_results;
+
+    // Images start every frame in the layout the previous one left them in, except on
+    // the first frame after baking, where the passes first transition them from undefined
+    bool first_frame;
 } MtRenderGraph;
 
 typedef struct MtRenderGraphPass
@@ -373,6 +512,11 @@ typedef struct MtRenderGraphPass
     uint32_t index;
     VkPipelineStageFlags stage;
     MtQueueType queue_type;
+    // Compute pass recorded for the compute queue, instead of with the graphics passes
+    bool async_compute;
+    // Stages of the passes that used the memory of the transient resources this pass
+    // is the first to use
+    VkPipelineStageFlags alias_wait_stages;
 
     MtRenderGraph *graph;
     MtRenderGraphColorClearer color_clearer;
@@ -389,4 +533,19 @@ typedef struct MtRenderGraphPass
 
     MtRenderPass render_pass;
     /*array*/ VkFramebuffer *framebuffers;
+
+    // Recorded before everything else on the first frame after baking
+    PassBarriers initial_barriers;
+    // Recorded before the pass begins
+    PassBarriers barriers;
+    // Waited for with wait_events before the pass begins
+    PassBarriers split_barriers;
+    // Recorded after the pass ends, putting images back in the layout they rest in
+    PassBarriers end_barriers;
+    // Indices in the graph's split events
+    /*array*/ uint32_t *set_events;
+    /*array*/ uint32_t *wait_events;
+
+    // Measured by the profiler
+    MtPassStats stats;
 } MtRenderGraphPass;
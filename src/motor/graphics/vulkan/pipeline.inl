@@ -5,9 +5,20 @@ typedef struct CombinedSetLayouts
 {
     SetInfo sets[MAX_DESCRIPTOR_SETS];
     uint32_t set_count;
+    VkPushConstantRange push_constant_range;
     uint64_t hash;
 } CombinedSetLayouts;
 
+// A set is treated as the bindless table if it declares runtime-sized descriptor arrays
+static bool set_info_is_bindless(SetInfo *set)
+{
+    for (uint32_t b = 0; b < set->binding_count; ++b)
+    {
+        if (set->bindings[b].descriptorCount > 1) return true;
+    }
+    return false;
+}
+
 static void
 combined_set_layouts_init(CombinedSetLayouts *c, MtPipeline *pipeline, MtAllocator *alloc)
 {
@@ -30,7 +41,9 @@ combined_set_layouts_init(CombinedSetLayouts *c, MtPipeline *pipeline, MtAllocat
                 {
                     continue;
                 }
-                assert(shader_set->bindings[b].descriptorCount == 1);
+                assert(
+                    shader_set->bindings[b].descriptorCount == 1 ||
+                    set_info_is_bindless(shader_set));
 
                 set->bindings[b].binding = shader_set->bindings[b].binding;
                 set->bindings[b].stageFlags |= shader_set->bindings[b].stageFlags;
@@ -38,6 +51,13 @@ combined_set_layouts_init(CombinedSetLayouts *c, MtPipeline *pipeline, MtAllocat
                 set->bindings[b].descriptorCount = shader_set->bindings[b].descriptorCount;
             }
         }
+
+        if (shader->push_constant_size > 0)
+        {
+            c->push_constant_range.stageFlags |= shader->stage;
+            c->push_constant_range.size =
+                MT_MAX(c->push_constant_range.size, shader->push_constant_size);
+        }
     }
 
     XXH64_state_t state = {0};
@@ -48,6 +68,8 @@ combined_set_layouts_init(CombinedSetLayouts *c, MtPipeline *pipeline, MtAllocat
             &state, set_info->bindings, set_info->binding_count * sizeof(*set_info->bindings));
     }
 
+    XXH64_update(&state, &c->push_constant_range, sizeof(c->push_constant_range));
+
     c->hash = (uint64_t)XXH64_digest(&state);
 }
 
@@ -198,6 +220,24 @@ static void shader_init(MtDevice *dev, Shader *shader, uint8_t *code, size_t cod
             uint32_t binding =
                 spvc_compiler_get_decoration(compiler, resource_list[i].id, SpvDecorationBinding);
 
+            uint32_t descriptor_count = 1;
+            spvc_type type = spvc_compiler_get_type_handle(compiler, resource_list[i].type_id);
+            if (spvc_type_get_num_array_dimensions(type) > 0 &&
+                spvc_type_get_array_dimension(type, 0) == 0)
+            {
+                // Runtime array: only valid as part of the bindless table
+                switch (resource_types[r])
+                {
+                    case SPVC_RESOURCE_TYPE_SEPARATE_IMAGE:
+                        descriptor_count = BINDLESS_IMAGE_CAPACITY;
+                        break;
+                    case SPVC_RESOURCE_TYPE_SEPARATE_SAMPLERS:
+                        descriptor_count = BINDLESS_SAMPLER_CAPACITY;
+                        break;
+                    default: assert(!"Unsupported runtime descriptor array"); break;
+                }
+            }
+
             VkDescriptorType descriptor_type = 0;
             switch (resource_types[r])
             {
@@ -225,12 +265,29 @@ static void shader_init(MtDevice *dev, Shader *shader, uint8_t *code, size_t cod
             shader->sets[set].bindings[binding] = (VkDescriptorSetLayoutBinding){
                 .binding = binding,
                 .descriptorType = descriptor_type,
-                .descriptorCount = 1,
+                .descriptorCount = descriptor_count,
                 .stageFlags = shader->stage,
             };
         }
     }
 
+    {
+        const spvc_reflected_resource *push_constant_list = NULL;
+        size_t push_constant_count = 0;
+        spvc_resources_get_resource_list_for_type(
+            resources, SPVC_RESOURCE_TYPE_PUSH_CONSTANT, &push_constant_list, &push_constant_count);
+        assert(push_constant_count <= 1);
+
+        if (push_constant_count > 0)
+        {
+            spvc_type type =
+                spvc_compiler_get_type_handle(compiler, push_constant_list[0].base_type_id);
+            size_t size = 0;
+            spvc_compiler_get_declared_struct_size(compiler, type, &size);
+            shader->push_constant_size = (uint32_t)size;
+        }
+    }
+
     spvc_context_destroy(context);
 }
 
@@ -252,10 +309,28 @@ create_pipeline_layout(MtDevice *dev, CombinedSetLayouts *combined, VkPipelineBi
     l->set_count = combined->set_count;
     memcpy(l->sets, combined->sets, sizeof(l->sets));
 
+    l->push_constant_range = combined->push_constant_range;
+    l->bindless_set = UINT32_MAX;
+
     VkDescriptorSetLayout *set_layouts = NULL;
     mt_array_add_zeroed(dev->alloc, l->pools, l->set_count);
     for (uint32_t i = 0; i < mt_array_size(l->pools); i++)
     {
+        if (set_info_is_bindless(&l->sets[i]))
+        {
+            if (!dev->bindless_enabled)
+            {
+                mt_log_error("Pipeline uses a bindless descriptor set but bindless is disabled");
+                assert(0);
+            }
+            assert(l->bindless_set == UINT32_MAX);
+
+            // The pool stays zeroed, the set is owned by the device
+            l->bindless_set = i;
+            mt_array_push(dev->alloc, set_layouts, dev->bindless.set_layout);
+            continue;
+        }
+
         descriptor_pool_init(dev, &l->pools[i], l, i);
         mt_array_push(dev->alloc, set_layouts, l->pools[i].set_layout);
     }
@@ -268,6 +343,12 @@ create_pipeline_layout(MtDevice *dev, CombinedSetLayouts *combined, VkPipelineBi
         .pPushConstantRanges = NULL,
     };
 
+    if (l->push_constant_range.size > 0)
+    {
+        pipeline_layout_info.pushConstantRangeCount = 1;
+        pipeline_layout_info.pPushConstantRanges = &l->push_constant_range;
+    }
+
     VK_CHECK(vkCreatePipelineLayout(dev->device, &pipeline_layout_info, NULL, &l->layout));
 
     mt_array_free(dev->alloc, set_layouts);
@@ -515,8 +596,12 @@ static void create_graphics_pipeline_instance(
         .basePipelineIndex = -1,
     };
 
+    ThreadPipelineCache *cache = &dev->pipeline_caches[renderer_thread_id];
+    uint64_t start = mt_time_ns();
     VK_CHECK(vkCreateGraphicsPipelines(
-        dev->device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &instance->vk_pipeline));
+        dev->device, cache->cache, 1, &pipeline_info, NULL, &instance->vk_pipeline));
+    cache->create_ns += mt_time_ns() - start;
+    cache->create_count++;
 
     mt_array_free(dev->alloc, attributes);
     mt_array_free(dev->alloc, stages);
@@ -544,17 +629,18 @@ create_compute_pipeline_instance(MtDevice *dev, PipelineInstance *instance, MtPi
         .basePipelineIndex = 0,
     };
 
+    ThreadPipelineCache *cache = &dev->pipeline_caches[renderer_thread_id];
+    uint64_t start = mt_time_ns();
     VK_CHECK(vkCreateComputePipelines(
-        dev->device, VK_NULL_HANDLE, 1, &create_info, NULL, &instance->vk_pipeline));
+        dev->device, cache->cache, 1, &create_info, NULL, &instance->vk_pipeline));
+    cache->create_ns += mt_time_ns() - start;
+    cache->create_count++;
 }
 
 static PipelineInstance *
 request_graphics_pipeline_instance(MtDevice *dev, MtPipeline *pipeline, MtRenderPass *render_pass)
 {
-    XXH64_state_t state = {0};
-    XXH64_update(&state, &pipeline->hash, sizeof(pipeline->hash));
-    XXH64_update(&state, &render_pass->hash, sizeof(render_pass->hash));
-    uint64_t hash = (uint64_t)XXH64_digest(&state);
+    uint64_t hash = pipeline_instance_hash(pipeline->hash, render_pass->hash);
 
     PipelineInstance *instance = mt_hash_get_ptr(&pipeline->instances, hash);
     if (instance) return instance;
@@ -562,6 +648,7 @@ request_graphics_pipeline_instance(MtDevice *dev, MtPipeline *pipeline, MtRender
     instance = mt_alloc(dev->alloc, sizeof(PipelineInstance));
     instance->hash = hash;
     create_graphics_pipeline_instance(dev, instance, render_pass, pipeline);
+    pipeline_manifest_record(dev, pipeline->hash, render_pass->hash);
     return mt_hash_set_ptr(&pipeline->instances, instance->hash, instance);
 }
 
@@ -574,9 +661,132 @@ static PipelineInstance *request_compute_pipeline_instance(MtDevice *dev, MtPipe
     instance->hash = pipeline->hash;
 
     create_compute_pipeline_instance(dev, instance, pipeline);
+    pipeline_manifest_record(dev, pipeline->hash, 0);
     return mt_hash_set_ptr(&pipeline->instances, instance->hash, instance);
 }
 
+typedef struct WarmJob
+{
+    MtDevice *dev;
+    MtPipeline *pipeline;
+    MtRenderPass *render_pass;
+    PipelineInstance *instance;
+} WarmJob;
+
+static int32_t warm_job_run(void *arg)
+{
+    WarmJob *job = arg;
+    renderer_thread_id = mt_thread_pool_get_task_id();
+    assert(renderer_thread_id < job->dev->num_threads);
+
+    if (job->render_pass)
+    {
+        create_graphics_pipeline_instance(
+            job->dev, job->instance, job->render_pass, job->pipeline);
+    }
+    else
+    {
+        create_compute_pipeline_instance(job->dev, job->instance, job->pipeline);
+    }
+    return 0;
+}
+
+static void add_warm_job(MtDevice *dev, WarmJob **jobs, PipelinePair *pair, MtRenderPass *rp)
+{
+    uint64_t hash = pipeline_instance_hash(pair->pipeline_hash, pair->render_pass_hash);
+
+    MtPipeline *pipeline = mt_hash_get_ptr(&dev->pipeline_map, pair->pipeline_hash);
+    if (!pipeline || mt_hash_get_ptr(&pipeline->instances, hash)) return;
+
+    for (uint32_t i = 0; i < mt_array_size(*jobs); i++)
+    {
+        if ((*jobs)[i].instance->hash == hash && (*jobs)[i].pipeline == pipeline) return;
+    }
+
+    PipelineInstance *instance = mt_alloc(dev->alloc, sizeof(PipelineInstance));
+    instance->hash = hash;
+
+    WarmJob job = {
+        .dev = dev,
+        .pipeline = pipeline,
+        .render_pass = rp,
+        .instance = instance,
+    };
+    mt_array_push(dev->alloc, *jobs, job);
+}
+
+// Creates the pipeline instances that the previous run used with these render passes,
+// and the compute ones, before they get bound for the first time
+static void
+warm_pipeline_instances(MtDevice *dev, MtRenderPass **render_passes, uint32_t render_pass_count)
+{
+    if (mt_array_size(dev->pipeline_warm_pairs) == 0) return;
+
+    uint64_t start = mt_time_ns();
+
+    WarmJob *jobs = NULL;
+
+    mt_mutex_lock(&dev->device_mutex);
+    for (uint32_t i = 0; i < mt_array_size(dev->pipeline_warm_pairs); i++)
+    {
+        PipelinePair *pair = &dev->pipeline_warm_pairs[i];
+        if (pair->render_pass_hash == 0)
+        {
+            add_warm_job(dev, &jobs, pair, NULL);
+            continue;
+        }
+
+        for (uint32_t j = 0; j < render_pass_count; j++)
+        {
+            if (render_passes[j]->hash == pair->render_pass_hash)
+            {
+                add_warm_job(dev, &jobs, pair, render_passes[j]);
+                break;
+            }
+        }
+    }
+    mt_mutex_unlock(&dev->device_mutex);
+
+    // Waiting on a group also works from one of the pool's own tasks
+    MtThreadPool *pool = dev->thread_pool;
+    uint32_t thread_id = renderer_thread_id;
+
+    // Only waits for the warm jobs, not for unrelated work like asset loads
+    MtTaskGroup group = {0};
+    for (uint32_t i = 0; i < mt_array_size(jobs); i++)
+    {
+        if (pool)
+        {
+            mt_thread_pool_enqueue_group(pool, &group, warm_job_run, &jobs[i]);
+        }
+        else
+        {
+            warm_job_run(&jobs[i]);
+        }
+    }
+
+    if (pool) mt_thread_pool_wait_group(pool, &group);
+    renderer_thread_id = thread_id;
+
+    for (uint32_t i = 0; i < mt_array_size(jobs); i++)
+    {
+        WarmJob *job = &jobs[i];
+        mt_hash_set_ptr(&job->pipeline->instances, job->instance->hash, job->instance);
+        pipeline_manifest_record(
+            dev, job->pipeline->hash, job->render_pass ? job->render_pass->hash : 0);
+    }
+
+    if (mt_array_size(jobs) > 0)
+    {
+        mt_log_debug(
+            "Created %u pipeline instances ahead of time in %.2f ms",
+            (uint32_t)mt_array_size(jobs),
+            (double)(mt_time_ns() - start) / 1e6);
+    }
+
+    mt_array_free(dev->alloc, jobs);
+}
+
 static void destroy_pipeline_instance(MtDevice *dev, PipelineInstance *instance)
 {
     device_wait_idle(dev);
@@ -634,6 +844,10 @@ static MtPipeline *create_graphics_pipeline(
 
     mt_hash_init(&pipeline->instances, 5, dev->alloc);
 
+    mt_mutex_lock(&dev->device_mutex);
+    mt_hash_set_ptr(&dev->pipeline_map, pipeline->hash, pipeline);
+    mt_mutex_unlock(&dev->device_mutex);
+
     return pipeline;
 }
 
@@ -656,11 +870,22 @@ static MtPipeline *create_compute_pipeline(MtDevice *dev, uint8_t *code, size_t
 
     mt_hash_init(&pipeline->instances, 5, dev->alloc);
 
+    mt_mutex_lock(&dev->device_mutex);
+    mt_hash_set_ptr(&dev->pipeline_map, pipeline->hash, pipeline);
+    mt_mutex_unlock(&dev->device_mutex);
+
     return pipeline;
 }
 
 static void destroy_pipeline(MtDevice *dev, MtPipeline *pipeline)
 {
+    mt_mutex_lock(&dev->device_mutex);
+    if (mt_hash_get_ptr(&dev->pipeline_map, pipeline->hash) == pipeline)
+    {
+        mt_hash_remove(&dev->pipeline_map, pipeline->hash);
+    }
+    mt_mutex_unlock(&dev->device_mutex);
+
     for (uint32_t i = 0; i < pipeline->instances.size; i++)
     {
         if (pipeline->instances.keys[i] != MT_HASH_UNUSED)
@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <motor/base/time.h>
+
+enum {
+    PIPELINE_CACHE_MAGIC = 0x4350544d, // "MTPC"
+    PIPELINE_CACHE_VERSION = 1,
+};
+
+// Written before the data returned by vkGetPipelineCacheData
+typedef struct PipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t cache_uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+    // Catches files that were cut short while being written
+    uint64_t data_hash;
+} PipelineCacheFileHeader;
+
+static void pipeline_cache_fill_header(MtDevice *dev, PipelineCacheFileHeader *header)
+{
+    VkPhysicalDeviceProperties *props = &dev->physical_device_properties;
+
+    memset(header, 0, sizeof(*header));
+    header->magic = PIPELINE_CACHE_MAGIC;
+    header->version = PIPELINE_CACHE_VERSION;
+    header->vendor_id = props->vendorID;
+    header->device_id = props->deviceID;
+    header->driver_version = props->driverVersion;
+    memcpy(header->cache_uuid, props->pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+// Returns the cache data stored at path if it was made by this device and driver
+static void *pipeline_cache_read_file(MtDevice *dev, const char *path, size_t *data_size)
+{
+    *data_size = 0;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    long file_size = -1;
+    if (fseek(f, 0, SEEK_END) == 0)
+    {
+        file_size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+    }
+
+    PipelineCacheFileHeader expected;
+    pipeline_cache_fill_header(dev, &expected);
+
+    PipelineCacheFileHeader header;
+    void *data = NULL;
+
+    if (file_size < (long)sizeof(header) || fread(&header, sizeof(header), 1, f) != 1 ||
+        header.magic != expected.magic || header.version != expected.version)
+    {
+        mt_log_warn("Ignoring invalid pipeline cache: %s", path);
+        goto end;
+    }
+
+    if (header.vendor_id != expected.vendor_id || header.device_id != expected.device_id ||
+        header.driver_version != expected.driver_version ||
+        memcmp(header.cache_uuid, expected.cache_uuid, VK_UUID_SIZE) != 0)
+    {
+        mt_log_info("Pipeline cache was made by another device or driver, starting over");
+        goto end;
+    }
+
+    // A corrupt size must not turn into a huge allocation
+    if (header.data_size > (uint64_t)file_size - sizeof(header))
+    {
+        mt_log_warn("Ignoring truncated pipeline cache: %s", path);
+        goto end;
+    }
+
+    data = mt_alloc(dev->alloc, header.data_size);
+    if (fread(data, header.data_size, 1, f) != 1 ||
+        XXH64(data, header.data_size, 0) != header.data_hash)
+    {
+        mt_log_warn("Ignoring corrupted pipeline cache: %s", path);
+        mt_free(dev->alloc, data);
+        data = NULL;
+        goto end;
+    }
+
+    *data_size = header.data_size;
+
+end:
+    fclose(f);
+    return data;
+}
+
+static void pipeline_cache_init(MtDevice *dev, const char *path)
+{
+    uint64_t start = mt_time_ns();
+
+    size_t data_size = 0;
+    void *data = NULL;
+    if (path)
+    {
+        dev->pipeline_cache_path = mt_alloc(dev->alloc, strlen(path) + 1);
+        strcpy(dev->pipeline_cache_path, path);
+        data = pipeline_cache_read_file(dev, path, &data_size);
+    }
+
+    // Every thread creates its pipelines in a cache of its own, so they never contend for
+    // it. They all start from the saved data, and are merged back when saving.
+    dev->pipeline_caches = mt_alloc(dev->alloc, sizeof(ThreadPipelineCache) * dev->num_threads);
+    memset(dev->pipeline_caches, 0, sizeof(ThreadPipelineCache) * dev->num_threads);
+
+    for (uint32_t i = 0; i < dev->num_threads; i++)
+    {
+        VkPipelineCacheCreateInfo create_info = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .initialDataSize = data_size,
+            .pInitialData = data,
+        };
+        VK_CHECK(
+            vkCreatePipelineCache(dev->device, &create_info, NULL, &dev->pipeline_caches[i].cache));
+    }
+
+    dev->pipeline_cache_warm = data != NULL;
+
+    if (path)
+    {
+        mt_log_debug(
+            "Pipeline cache: %s, %.1f KiB loaded in %.2f ms",
+            dev->pipeline_cache_warm ? "warm" : "cold",
+            (double)data_size / 1024.0,
+            (double)(mt_time_ns() - start) / 1e6);
+    }
+
+    if (data) mt_free(dev->alloc, data);
+}
+
+static void pipeline_cache_save(MtDevice *dev)
+{
+    if (!dev->pipeline_cache_path) return;
+
+    VkPipelineCache cache = dev->pipeline_caches[0].cache;
+    if (dev->num_threads > 1)
+    {
+        VkPipelineCache *sources = mt_alloc(dev->alloc, sizeof(VkPipelineCache) * dev->num_threads);
+        for (uint32_t i = 1; i < dev->num_threads; i++)
+        {
+            sources[i - 1] = dev->pipeline_caches[i].cache;
+        }
+        VK_CHECK(vkMergePipelineCaches(dev->device, cache, dev->num_threads - 1, sources));
+        mt_free(dev->alloc, sources);
+    }
+
+    size_t data_size = 0;
+    VK_CHECK(vkGetPipelineCacheData(dev->device, cache, &data_size, NULL));
+    void *data = mt_alloc(dev->alloc, data_size);
+    VK_CHECK(vkGetPipelineCacheData(dev->device, cache, &data_size, data));
+
+    PipelineCacheFileHeader header;
+    pipeline_cache_fill_header(dev, &header);
+    header.data_size = data_size;
+    header.data_hash = XXH64(data, data_size, 0);
+
+    // Written next to the old file first, so a crash never leaves half a cache behind
+    size_t path_size = strlen(dev->pipeline_cache_path) + 5;
+    char *tmp_path = mt_alloc(dev->alloc, path_size);
+    snprintf(tmp_path, path_size, "%s.tmp", dev->pipeline_cache_path);
+
+    FILE *f = fopen(tmp_path, "wb");
+    bool written = f && fwrite(&header, sizeof(header), 1, f) == 1 &&
+                   fwrite(data, data_size, 1, f) == 1;
+    if (f) written &= fclose(f) == 0;
+
+    if (written)
+    {
+        remove(dev->pipeline_cache_path);
+        written = rename(tmp_path, dev->pipeline_cache_path) == 0;
+    }
+
+    if (!written)
+    {
+        mt_log_warn("Failed to write pipeline cache: %s", dev->pipeline_cache_path);
+        remove(tmp_path);
+    }
+
+    mt_free(dev->alloc, tmp_path);
+    mt_free(dev->alloc, data);
+}
+
+static void pipeline_cache_destroy(MtDevice *dev)
+{
+    uint64_t create_ns = 0;
+    uint32_t create_count = 0;
+    for (uint32_t i = 0; i < dev->num_threads; i++)
+    {
+        create_ns += dev->pipeline_caches[i].create_ns;
+        create_count += dev->pipeline_caches[i].create_count;
+    }
+
+    if (create_count > 0)
+    {
+        mt_log_debug(
+            "Created %u pipelines in %.2f ms with a %s pipeline cache",
+            create_count,
+            (double)create_ns / 1e6,
+            dev->pipeline_cache_warm ? "warm" : "cold");
+    }
+
+    pipeline_cache_save(dev);
+
+    for (uint32_t i = 0; i < dev->num_threads; i++)
+    {
+        vkDestroyPipelineCache(dev->device, dev->pipeline_caches[i].cache, NULL);
+    }
+    mt_free(dev->alloc, dev->pipeline_caches);
+
+    if (dev->pipeline_cache_path) mt_free(dev->alloc, dev->pipeline_cache_path);
+}
+
+// Pipeline manifest {{{
+enum {
+    PIPELINE_MANIFEST_MAGIC = 0x4d50544d, // "MTPM"
+    PIPELINE_MANIFEST_VERSION = 1,
+};
+
+typedef struct PipelineManifestHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t pair_count;
+} PipelineManifestHeader;
+
+static uint64_t pipeline_instance_hash(uint64_t pipeline_hash, uint64_t render_pass_hash)
+{
+    // Compute pipelines have a single instance, with the hash of the pipeline
+    if (render_pass_hash == 0) return pipeline_hash;
+
+    XXH64_state_t state = {0};
+    XXH64_update(&state, &pipeline_hash, sizeof(pipeline_hash));
+    XXH64_update(&state, &render_pass_hash, sizeof(render_pass_hash));
+    return (uint64_t)XXH64_digest(&state);
+}
+
+static void pipeline_manifest_init(MtDevice *dev, const char *path)
+{
+    mt_hash_init(&dev->pipeline_map, 51, dev->alloc);
+    mt_hash_init(&dev->pipeline_manifest_map, 51, dev->alloc);
+
+    if (!path) return;
+
+    dev->pipeline_manifest_path = mt_alloc(dev->alloc, strlen(path) + 1);
+    strcpy(dev->pipeline_manifest_path, path);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return;
+
+    long file_size = -1;
+    if (fseek(f, 0, SEEK_END) == 0)
+    {
+        file_size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+    }
+
+    PipelineManifestHeader header;
+    bool valid = file_size >= (long)sizeof(header) && fread(&header, sizeof(header), 1, f) == 1 &&
+                 header.magic == PIPELINE_MANIFEST_MAGIC &&
+                 header.version == PIPELINE_MANIFEST_VERSION;
+
+    // A corrupt count must not turn into a huge allocation
+    valid = valid &&
+            header.pair_count <= ((uint64_t)file_size - sizeof(header)) / sizeof(PipelinePair);
+
+    if (valid)
+    {
+        mt_array_add(dev->alloc, dev->pipeline_warm_pairs, header.pair_count);
+        valid = fread(dev->pipeline_warm_pairs, sizeof(PipelinePair), header.pair_count, f) ==
+                header.pair_count;
+    }
+
+    if (!valid)
+    {
+        mt_log_warn("Ignoring invalid pipeline manifest: %s", path);
+        mt_array_set_size(dev->pipeline_warm_pairs, 0);
+    }
+
+    fclose(f);
+}
+
+// Remembers that an instance of pipeline was created for render_pass, 0 for compute pipelines
+static void
+pipeline_manifest_record(MtDevice *dev, uint64_t pipeline_hash, uint64_t render_pass_hash)
+{
+    uint64_t hash = pipeline_instance_hash(pipeline_hash, render_pass_hash);
+
+    mt_mutex_lock(&dev->device_mutex);
+    if (mt_hash_get_uint(&dev->pipeline_manifest_map, hash) == MT_HASH_NOT_FOUND)
+    {
+        mt_hash_set_uint(&dev->pipeline_manifest_map, hash, 1);
+
+        PipelinePair pair = {pipeline_hash, render_pass_hash};
+        mt_array_push(dev->alloc, dev->pipeline_manifest, pair);
+    }
+    mt_mutex_unlock(&dev->device_mutex);
+}
+
+static void pipeline_manifest_destroy(MtDevice *dev)
+{
+    if (dev->pipeline_manifest_path)
+    {
+        // Only what was created in this run is kept, so that pairs that are not used
+        // anymore go away
+        PipelineManifestHeader header = {
+            .magic = PIPELINE_MANIFEST_MAGIC,
+            .version = PIPELINE_MANIFEST_VERSION,
+            .pair_count = mt_array_size(dev->pipeline_manifest),
+        };
+
+        size_t count = header.pair_count;
+        FILE *f = fopen(dev->pipeline_manifest_path, "wb");
+        bool written = f && fwrite(&header, sizeof(header), 1, f) == 1;
+        written =
+            written && fwrite(dev->pipeline_manifest, sizeof(PipelinePair), count, f) == count;
+        if (f) written &= fclose(f) == 0;
+
+        if (!written)
+        {
+            mt_log_warn("Failed to write pipeline manifest: %s", dev->pipeline_manifest_path);
+        }
+
+        mt_free(dev->alloc, dev->pipeline_manifest_path);
+    }
+
+    mt_array_free(dev->alloc, dev->pipeline_warm_pairs);
+    mt_array_free(dev->alloc, dev->pipeline_manifest);
+    mt_hash_destroy(&dev->pipeline_manifest_map);
+    mt_hash_destroy(&dev->pipeline_map);
+}
+// }}}
@@ -349,6 +349,76 @@ static void swapchain_create_swapchain_image_views(MtSwapchain *swapchain)
     }
 }
 
+// One for each frame that may be in flight, so frames never render to an image in use
+enum { OFFSCREEN_IMAGE_COUNT = MAX_FRAMES_IN_FLIGHT };
+
+static bool swapchain_is_offscreen(MtSwapchain *swapchain)
+{
+    return swapchain->surface == VK_NULL_HANDLE;
+}
+
+// Images left in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL by the graph, so they can be read back
+static void swapchain_create_offscreen_images(MtSwapchain *swapchain)
+{
+    MtDevice *dev = swapchain->dev;
+
+    uint32_t width, height;
+    mt_window.get_size(swapchain->window, &width, &height);
+
+    swapchain->swapchain_image_count = OFFSCREEN_IMAGE_COUNT;
+    swapchain->swapchain_image_format = VK_FORMAT_R8G8B8A8_UNORM;
+    swapchain->extent = (VkExtent2D){width, height};
+
+    swapchain->swapchain_images = mt_realloc(
+        swapchain->alloc, swapchain->swapchain_images, sizeof(VkImage) * OFFSCREEN_IMAGE_COUNT);
+    swapchain->offscreen_allocations = mt_realloc(
+        swapchain->alloc,
+        swapchain->offscreen_allocations,
+        sizeof(VmaAllocation) * OFFSCREEN_IMAGE_COUNT);
+
+    for (uint32_t i = 0; i < OFFSCREEN_IMAGE_COUNT; i++)
+    {
+        VkImageCreateInfo image_create_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = swapchain->swapchain_image_format,
+            .extent = {width, height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        VK_CHECK(
+            vkCreateImage(dev->device, &image_create_info, NULL, &swapchain->swapchain_images[i]));
+
+        VmaAllocationCreateInfo alloc_create_info = {.usage = VMA_MEMORY_USAGE_GPU_ONLY};
+        VK_CHECK(vmaAllocateMemoryForImage(
+            dev->gpu_allocator,
+            swapchain->swapchain_images[i],
+            &alloc_create_info,
+            &swapchain->offscreen_allocations[i],
+            NULL));
+        VK_CHECK(vmaBindImageMemory(
+            dev->gpu_allocator,
+            swapchain->offscreen_allocations[i],
+            swapchain->swapchain_images[i]));
+    }
+}
+
+static void swapchain_destroy_offscreen_images(MtSwapchain *swapchain)
+{
+    MtDevice *dev = swapchain->dev;
+
+    for (uint32_t i = 0; i < swapchain->swapchain_image_count; i++)
+    {
+        vkDestroyImage(dev->device, swapchain->swapchain_images[i], NULL);
+        vmaFreeMemory(dev->gpu_allocator, swapchain->offscreen_allocations[i]);
+    }
+}
+
 static void swapchain_create_resizables(MtSwapchain *swapchain)
 {
     MtDevice *dev = swapchain->dev;
@@ -364,7 +434,14 @@ static void swapchain_create_resizables(MtSwapchain *swapchain)
     VK_CHECK(vkDeviceWaitIdle(dev->device));
     mt_mutex_unlock(&dev->device_mutex);
 
-    swapchain_create_swapchain(swapchain);
+    if (swapchain_is_offscreen(swapchain))
+    {
+        swapchain_create_offscreen_images(swapchain);
+    }
+    else
+    {
+        swapchain_create_swapchain(swapchain);
+    }
     swapchain_create_swapchain_image_views(swapchain);
 }
 
@@ -391,6 +468,11 @@ static void swapchain_destroy_resizables(MtSwapchain *swapchain)
         vkDestroySwapchainKHR(dev->device, swapchain->swapchain, NULL);
         swapchain->swapchain = VK_NULL_HANDLE;
     }
+
+    if (swapchain_is_offscreen(swapchain))
+    {
+        swapchain_destroy_offscreen_images(swapchain);
+    }
 }
 
 /*
@@ -416,6 +498,15 @@ static MtSwapchain *create_swapchain(MtDevice *dev, MtWindow *window, MtAllocato
 
     swapchain->present_family_index = UINT32_MAX;
 
+    if (dev->flags & MT_DEVICE_HEADLESS)
+    {
+        // Nothing is presented, frames end on the graphics queue
+        swapchain->present_family_index = dev->indices.graphics;
+        swapchain->present_queue = dev->graphics_queue;
+        swapchain_create_resizables(swapchain);
+        return swapchain;
+    }
+
     swapchain_create_surface(dev, window, &swapchain->surface);
 
     uint32_t queue_family_count = 0;
@@ -469,10 +560,14 @@ static void destroy_swapchain(MtSwapchain *swapchain)
 
     swapchain_destroy_resizables(swapchain);
 
-    vkDestroySurfaceKHR(dev->instance, swapchain->surface, NULL);
+    if (swapchain->surface != VK_NULL_HANDLE)
+    {
+        vkDestroySurfaceKHR(dev->instance, swapchain->surface, NULL);
+    }
 
     mt_free(dev->alloc, swapchain->swapchain_images);
     mt_free(dev->alloc, swapchain->swapchain_image_views);
+    mt_free(dev->alloc, swapchain->offscreen_allocations);
 
     mt_free(dev->alloc, swapchain);
 }
@@ -7,7 +7,9 @@
 #include <motor/base/api_types.h>
 #include <motor/base/log.h>
 #include <motor/base/allocator.h>
+#include <motor/base/thread_pool.h>
 #include <motor/graphics/window.h>
+#include <motor/graphics/graph_compiler.h>
 
 #include "internal.h"
 #include "vk_mem_alloc.h"
@@ -20,20 +22,6 @@ static void allocate_cmd_buffers(
 static void
 free_cmd_buffers(MtDevice *dev, MtQueueType queue_type, uint32_t count, MtCmdBuffer **cmd_buffers);
 
-#include "conversions.inl"
-#include "hashing.inl"
-#include "buffer.inl"
-#include "buffer_pool.inl"
-#include "descriptor_pool.inl"
-#include "pipeline.inl"
-#include "image.inl"
-#include "sampler.inl"
-#include "cmd_buffer.inl"
-
-#include "swapchain.inl"
-
-#include "graph.inl"
-
 // clang-format off
 #if !(defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201102L)) && !defined(_Thread_local)
     #if defined(__GNUC__) || defined(__INTEL_COMPILER) || defined(__SUNPRO_CC) || defined(__IBMCPP__)
@@ -51,6 +39,23 @@ free_cmd_buffers(MtDevice *dev, MtQueueType queue_type, uint32_t count, MtCmdBuf
 
 static MT_THREAD_LOCAL uint32_t renderer_thread_id = 0;
 
+#include "conversions.inl"
+#include "hashing.inl"
+#include "buffer.inl"
+#include "buffer_pool.inl"
+#include "descriptor_pool.inl"
+#include "bindless.inl"
+#include "pipeline_cache.inl"
+#include "pipeline.inl"
+#include "image.inl"
+#include "sampler.inl"
+#include "cmd_buffer.inl"
+
+#include "swapchain.inl"
+
+#include "graph_profiler.inl"
+#include "graph.inl"
+
 #if !defined(NDEBUG)
 // Debug mode
 #define MT_ENABLE_VALIDATION
@@ -250,6 +255,18 @@ static QueueFamilyIndices find_queue_families(MtDevice *dev, VkPhysicalDevice ph
         if (are_indices_complete(dev, &indices)) break;
     }
 
+    // A compute family without graphics lets async compute run next to the graphics work
+    for (uint32_t i = 0; i < queue_family_count; i++)
+    {
+        VkQueueFamilyProperties *queue_family = &queue_families[i];
+        if (queue_family->queueCount > 0 && (queue_family->queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+            !(queue_family->queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            indices.compute = i;
+            break;
+        }
+    }
+
     mt_free(dev->alloc, queue_families);
     return indices;
 }
@@ -288,13 +305,45 @@ static bool check_device_extension_support(MtDevice *dev, VkPhysicalDevice physi
     return found_all;
 }
 
+static bool
+has_device_extension(MtDevice *dev, VkPhysicalDevice physical_device, const char *extension)
+{
+    uint32_t extension_count;
+    vkEnumerateDeviceExtensionProperties(physical_device, NULL, &extension_count, NULL);
+
+    VkExtensionProperties *available_extensions =
+        mt_alloc(dev->alloc, sizeof(VkExtensionProperties) * extension_count);
+
+    vkEnumerateDeviceExtensionProperties(
+        physical_device, NULL, &extension_count, available_extensions);
+
+    bool found = false;
+    for (uint32_t i = 0; i < extension_count; i++)
+    {
+        if (strcmp(available_extensions[i].extensionName, extension) == 0)
+        {
+            found = true;
+            break;
+        }
+    }
+
+    mt_free(dev->alloc, available_extensions);
+    return found;
+}
+
 static bool is_device_suitable(MtDevice *dev, VkPhysicalDevice physical_device)
 {
     QueueFamilyIndices indices = find_queue_families(dev, physical_device);
 
-    bool extensions_supported = check_device_extension_support(dev, physical_device);
+    // Headless devices do not need the swapchain extension
+    bool extensions_supported = (dev->flags & MT_DEVICE_HEADLESS) ||
+                                check_device_extension_support(dev, physical_device);
 
-    return are_indices_complete(dev, &indices) && extensions_supported;
+    // Frames are paced with timeline semaphores
+    bool timeline_supported = has_device_extension(
+        dev, physical_device, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+    return are_indices_complete(dev, &indices) && extensions_supported && timeline_supported;
 }
 
 static void pick_physical_device(MtDevice *dev)
@@ -328,6 +377,8 @@ static void pick_physical_device(MtDevice *dev)
     }
 
     vkGetPhysicalDeviceProperties(dev->physical_device, &dev->physical_device_properties);
+    dev->timestamps_supported =
+        dev->physical_device_properties.limits.timestampComputeAndGraphics;
 
     mt_free(dev->alloc, devices);
 }
@@ -355,7 +406,8 @@ static void create_device(MtDevice *dev)
         queue_create_infos[queue_create_info_count - 1].pQueuePriorities = &queue_priority;
     }
 
-    if (dev->indices.graphics != dev->indices.compute)
+    if (dev->indices.graphics != dev->indices.compute &&
+        dev->indices.transfer != dev->indices.compute)
     {
         queue_create_info_count++;
         queue_create_infos[queue_create_info_count - 1].sType =
@@ -367,6 +419,7 @@ static void create_device(MtDevice *dev)
 
     VkPhysicalDeviceFeatures device_features = {0};
     vkGetPhysicalDeviceFeatures(dev->physical_device, &device_features);
+    dev->physical_device_features = device_features;
 
     if (!device_features.fillModeNonSolid || !device_features.samplerAnisotropy ||
         !device_features.textureCompressionBC)
@@ -387,14 +440,63 @@ static void create_device(MtDevice *dev)
     create_info.ppEnabledLayerNames = VALIDATION_LAYERS;
 #endif
 
+    const char **extensions = NULL;
+
     if (!(dev->flags & MT_DEVICE_HEADLESS))
     {
-        create_info.enabledExtensionCount = MT_LENGTH(DEVICE_EXTENSIONS);
-        create_info.ppEnabledExtensionNames = DEVICE_EXTENSIONS;
+        for (uint32_t i = 0; i < MT_LENGTH(DEVICE_EXTENSIONS); i++)
+        {
+            mt_array_push(dev->alloc, extensions, DEVICE_EXTENSIONS[i]);
+        }
+    }
+
+    mt_array_push(dev->alloc, extensions, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+        .timelineSemaphore = VK_TRUE,
+    };
+    create_info.pNext = &timeline_features;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+    };
+
+    if (dev->flags & MT_DEVICE_BINDLESS)
+    {
+        if (has_device_extension(
+                dev, dev->physical_device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+            bindless_check_support(dev))
+        {
+            dev->bindless_enabled = true;
+
+            mt_array_push(dev->alloc, extensions, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+            indexing_features.runtimeDescriptorArray = VK_TRUE;
+            indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+            indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            indexing_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            timeline_features.pNext = &indexing_features;
+        }
+        else
+        {
+            mt_log_warn("Descriptor indexing not supported, falling back to bound descriptors");
+        }
+    }
+
+    if (has_device_extension(dev, dev->physical_device, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+    {
+        dev->draw_indirect_count_enabled = true;
+        mt_array_push(dev->alloc, extensions, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
     }
 
+    create_info.enabledExtensionCount = mt_array_size(extensions);
+    create_info.ppEnabledExtensionNames = extensions;
+
     VK_CHECK(vkCreateDevice(dev->physical_device, &create_info, NULL, &dev->device));
 
+    mt_array_free(dev->alloc, extensions);
+
     vkGetDeviceQueue(dev->device, dev->indices.graphics, 0, &dev->graphics_queue);
     vkGetDeviceQueue(dev->device, dev->indices.transfer, 0, &dev->transfer_queue);
     vkGetDeviceQueue(dev->device, dev->indices.compute, 0, &dev->compute_queue);
@@ -627,9 +729,17 @@ free_cmd_buffers(MtDevice *dev, MtQueueType queue_type, uint32_t count, MtCmdBuf
             buffer_pool_recycle(&dev->ibo_pool, block);
         }
 
+        for (BufferBlock *block = cb->sbo_blocks;
+             block != cb->sbo_blocks + mt_array_size(cb->sbo_blocks);
+             ++block)
+        {
+            buffer_pool_recycle(&dev->sbo_pool, block);
+        }
+
         mt_array_free(dev->alloc, cb->ubo_blocks);
         mt_array_free(dev->alloc, cb->vbo_blocks);
         mt_array_free(dev->alloc, cb->ibo_blocks);
+        mt_array_free(dev->alloc, cb->sbo_blocks);
 
         mt_free(dev->alloc, cb);
     }
@@ -673,6 +783,15 @@ static void submit_cmd(MtDevice *dev, SubmitInfo *info)
         .pSignalSemaphores = info->signal_semaphores,
     };
 
+    VkTimelineSemaphoreSubmitInfoKHR timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+        .waitSemaphoreValueCount = info->wait_values ? info->wait_semaphore_count : 0,
+        .pWaitSemaphoreValues = info->wait_values,
+        .signalSemaphoreValueCount = info->signal_values ? info->signal_semaphore_count : 0,
+        .pSignalSemaphoreValues = info->signal_values,
+    };
+    if (info->wait_values || info->signal_values) submit_info.pNext = &timeline_info;
+
     mt_mutex_lock(&dev->device_mutex);
     VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, info->fence));
     mt_mutex_unlock(&dev->device_mutex);
@@ -703,7 +822,7 @@ transfer_to_buffer(MtDevice *dev, MtBuffer *buffer, size_t offset, size_t size,
 
     // TODO: maybe we need barriers here
 
-    cmd_copy_buffer_to_buffer(cb, staging, 0, buffer, 0, size);
+    cmd_copy_buffer_to_buffer(cb, staging, 0, buffer, offset, size);
 
     end_cmd_buffer(cb);
 
@@ -827,6 +946,174 @@ transfer_to_image(MtDevice *dev, const MtImageCopyView *dst, size_t size, const
     vkDestroyFence(dev->device, fence, NULL);
 }
 
+static void generate_mipmaps(MtDevice *dev, MtImage *image)
+{
+    if (image->mip_count <= 1) return;
+
+    // Mandatory for the uncompressed formats loaders use, not for block compressed ones
+    VkFormatProperties format_props;
+    vkGetPhysicalDeviceFormatProperties(dev->physical_device, image->format, &format_props);
+    assert(
+        format_props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+    VkFence fence = VK_NULL_HANDLE;
+    VkFenceCreateInfo fence_create_info = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    VK_CHECK(vkCreateFence(dev->device, &fence_create_info, NULL, &fence));
+
+    // Blits need a graphics queue
+    MtCmdBuffer *cb;
+    allocate_cmd_buffers(dev, MT_QUEUE_GRAPHICS, 1, &cb);
+
+    begin_cmd_buffer(cb);
+
+    // Mip 0 was uploaded and is read by the first blit, the rest gets overwritten
+    VkImageMemoryBarrier barriers[2] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .image = image->image,
+            .subresourceRange =
+                {
+                    .aspectMask = image->aspect,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = image->layer_count,
+                },
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .image = image->image,
+            .subresourceRange =
+                {
+                    .aspectMask = image->aspect,
+                    .baseMipLevel = 1,
+                    .levelCount = image->mip_count - 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = image->layer_count,
+                },
+        },
+    };
+
+    vkCmdPipelineBarrier(
+        cb->cmd_buffer,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0,
+        NULL,
+        0,
+        NULL,
+        2,
+        barriers);
+
+    for (uint32_t mip = 1; mip < image->mip_count; mip++)
+    {
+        VkImageBlit blit = {
+            .srcSubresource =
+                {
+                    .aspectMask = image->aspect,
+                    .mipLevel = mip - 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = image->layer_count,
+                },
+            .srcOffsets =
+                {
+                    {0, 0, 0},
+                    {
+                        (int32_t)MT_MAX(image->width >> (mip - 1), 1u),
+                        (int32_t)MT_MAX(image->height >> (mip - 1), 1u),
+                        1,
+                    },
+                },
+            .dstSubresource =
+                {
+                    .aspectMask = image->aspect,
+                    .mipLevel = mip,
+                    .baseArrayLayer = 0,
+                    .layerCount = image->layer_count,
+                },
+            .dstOffsets =
+                {
+                    {0, 0, 0},
+                    {
+                        (int32_t)MT_MAX(image->width >> mip, 1u),
+                        (int32_t)MT_MAX(image->height >> mip, 1u),
+                        1,
+                    },
+                },
+        };
+
+        vkCmdBlitImage(
+            cb->cmd_buffer,
+            image->image,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            image->image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1,
+            &blit,
+            VK_FILTER_LINEAR);
+
+        // The mip just written is the source of the next blit
+        VkImageMemoryBarrier barrier = barriers[0];
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.subresourceRange.baseMipLevel = mip;
+
+        vkCmdPipelineBarrier(
+            cb->cmd_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0,
+            NULL,
+            0,
+            NULL,
+            1,
+            &barrier);
+    }
+
+    VkImageMemoryBarrier barrier = barriers[0];
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.subresourceRange.levelCount = image->mip_count;
+
+    vkCmdPipelineBarrier(
+        cb->cmd_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        0,
+        NULL,
+        0,
+        NULL,
+        1,
+        &barrier);
+
+    end_cmd_buffer(cb);
+
+    submit_cmd(dev, &(SubmitInfo){.cmd_buffer = cb, .fence = fence});
+
+    vkWaitForFences(dev->device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+    free_cmd_buffers(dev, MT_QUEUE_GRAPHICS, 1, &cb);
+
+    vkDestroyFence(dev->device, fence, NULL);
+}
+
 static void device_wait_idle(MtDevice *dev)
 {
     mt_mutex_lock(&dev->device_mutex);
@@ -834,6 +1121,11 @@ static void device_wait_idle(MtDevice *dev)
     mt_mutex_unlock(&dev->device_mutex);
 }
 
+static bool device_draw_indirect_count_enabled(MtDevice *dev)
+{
+    return dev->draw_indirect_count_enabled;
+}
+
 static void destroy_device(MtDevice *dev)
 {
     MtAllocator *alloc = dev->alloc;
@@ -842,9 +1134,18 @@ static void destroy_device(MtDevice *dev)
     buffer_pool_destroy(&dev->ubo_pool);
     buffer_pool_destroy(&dev->vbo_pool);
     buffer_pool_destroy(&dev->ibo_pool);
+    buffer_pool_destroy(&dev->sbo_pool);
 
     mt_hash_destroy(&dev->pipeline_layout_map);
 
+    pipeline_manifest_destroy(dev);
+    pipeline_cache_destroy(dev);
+
+    if (dev->bindless_enabled)
+    {
+        bindless_table_destroy(dev);
+    }
+
     // Destroy transfer command pools
     for (uint32_t i = 0; i < dev->num_threads; i++)
     {
@@ -902,6 +1203,7 @@ static uint32_t get_thread_id(void)
 static MtRenderer g_vulkan_renderer = {
     .destroy_device = destroy_device,
     .device_wait_idle = device_wait_idle,
+    .device_draw_indirect_count_enabled = device_draw_indirect_count_enabled,
 
     .create_swapchain = create_swapchain,
     .destroy_swapchain = destroy_swapchain,
@@ -919,12 +1221,20 @@ static MtRenderer g_vulkan_renderer = {
 
     .create_image = create_image,
     .destroy_image = destroy_image,
+    .destroy_image_no_wait = destroy_image_no_wait,
 
     .create_sampler = create_sampler,
     .destroy_sampler = destroy_sampler,
 
     .transfer_to_buffer = transfer_to_buffer,
     .transfer_to_image = transfer_to_image,
+    .generate_mipmaps = generate_mipmaps,
+
+    .device_bindless_enabled = device_bindless_enabled,
+    .register_bindless_image = register_bindless_image,
+    .unregister_bindless_image = unregister_bindless_image,
+    .register_bindless_sampler = register_bindless_sampler,
+    .unregister_bindless_sampler = unregister_bindless_sampler,
 
     .create_graphics_pipeline = create_graphics_pipeline,
     .create_compute_pipeline = create_compute_pipeline,
@@ -943,11 +1253,13 @@ static MtRenderer g_vulkan_renderer = {
     .cmd_set_scissor = cmd_set_scissor,
 
     .cmd_bind_pipeline = cmd_bind_pipeline,
+    .cmd_push_constants = cmd_push_constants,
 
     .cmd_bind_uniform = cmd_bind_uniform,
     .cmd_bind_image = cmd_bind_image,
     .cmd_bind_sampler = cmd_bind_sampler,
     .cmd_bind_storage_buffer = cmd_bind_storage_buffer,
+    .cmd_bind_storage_data = cmd_bind_storage_data,
 
     .cmd_bind_vertex_buffer = cmd_bind_vertex_buffer,
     .cmd_bind_index_buffer = cmd_bind_index_buffer,
@@ -955,8 +1267,12 @@ static MtRenderer g_vulkan_renderer = {
     .cmd_bind_vertex_data = cmd_bind_vertex_data,
     .cmd_bind_index_data = cmd_bind_index_data,
 
+    .cmd_alloc_transient_data = cmd_alloc_transient_data,
+
     .cmd_draw = cmd_draw,
     .cmd_draw_indexed = cmd_draw_indexed,
+    .cmd_draw_indexed_indirect = cmd_draw_indexed_indirect,
+    .cmd_draw_indexed_indirect_count = cmd_draw_indexed_indirect_count,
 
     .cmd_dispatch = cmd_dispatch,
 
@@ -966,6 +1282,10 @@ static MtRenderer g_vulkan_renderer = {
     .graph_execute = graph_execute,
     .graph_wait_all = graph_wait_all,
     .graph_on_resize = graph_on_resize,
+    .graph_set_frames_in_flight = graph_set_frames_in_flight,
+    .graph_get_frame_stats = graph_get_frame_stats,
+    .graph_get_pass_stats = graph_get_pass_stats,
+    .graph_get_group_stats = graph_get_group_stats,
 
     .graph_add_image = graph_add_image,
     .graph_add_buffer = graph_add_buffer,
@@ -978,6 +1298,7 @@ static MtRenderer g_vulkan_renderer = {
     .graph_add_pass = graph_add_pass,
     .pass_set_color_clearer = pass_set_color_clearer,
     .pass_set_depth_stencil_clearer = pass_set_depth_stencil_clearer,
+    .pass_set_async_compute = pass_set_async_compute,
 
     .pass_read = pass_read,
     .pass_write = pass_write,
@@ -1002,6 +1323,10 @@ MtDevice *mt_vulkan_device_init(MtVulkanDeviceCreateInfo *create_info, MtAllocat
         dev->num_threads = 1;
     }
 
+    dev->frames_in_flight = create_info->frames_in_flight;
+    if (dev->frames_in_flight == 0) dev->frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
+    dev->frames_in_flight = MT_MIN(dev->frames_in_flight, MAX_FRAMES_IN_FLIGHT);
+
     mt_mutex_init(&dev->device_mutex);
 
     create_instance(dev);
@@ -1020,6 +1345,15 @@ MtDevice *mt_vulkan_device_init(MtVulkanDeviceCreateInfo *create_info, MtAllocat
 
     mt_hash_init(&dev->pipeline_layout_map, 51, dev->alloc);
 
+    pipeline_cache_init(dev, create_info->pipeline_cache_path);
+    pipeline_manifest_init(dev, create_info->pipeline_manifest_path);
+    dev->thread_pool = create_info->thread_pool;
+
+    if (dev->bindless_enabled)
+    {
+        bindless_table_init(dev);
+    }
+
     buffer_pool_init(
         dev,
         &dev->ubo_pool,
@@ -1043,5 +1377,14 @@ MtDevice *mt_vulkan_device_init(MtVulkanDeviceCreateInfo *create_info, MtAllocat
         16,    /*alignment*/
         MT_BUFFER_USAGE_INDEX);
 
+    buffer_pool_init(
+        dev,
+        &dev->sbo_pool,
+        65536, /*block size*/
+        MT_MAX(
+            16u,
+            dev->physical_device_properties.limits.minStorageBufferOffsetAlignment), /*alignment*/
+        MT_BUFFER_USAGE_INDIRECT);
+
     return dev;
 }
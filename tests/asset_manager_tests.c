@@ -0,0 +1,385 @@
+#include <motor/base/allocator.h>
+#include <motor/base/async_io.h>
+#include <motor/base/hashmap.h>
+#include <motor/base/lz4.h>
+#include <motor/base/pack_format.h>
+#include <motor/base/threads.h>
+#include <motor/base/thread_pool.h>
+#include <motor/base/vfs.h>
+#include <motor/graphics/renderer.h>
+#include <motor/engine/engine.h>
+#include <motor/engine/asset_manager.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Assets of this test are text files holding one letter, init records the order of the loads.
+// Loading gate.txt blocks until the gate opens, which keeps the other loads queued.
+
+typedef struct TestAsset
+{
+    MtAsset asset;
+    char letter;
+} TestAsset;
+
+static char g_order[64];
+static uint32_t g_order_size;
+static uint32_t g_gate;
+static uint32_t g_gate_entered;
+
+static bool test_asset_init(
+    MtAssetManager *am, MtAsset *asset_, const char *path, const MtVfsFile *file)
+{
+    (void)am;
+    TestAsset *asset = (TestAsset *)asset_;
+
+    if (strstr(path, "gate"))
+    {
+        __atomic_store_n(&g_gate_entered, 1, __ATOMIC_RELEASE);
+        while (!__atomic_load_n(&g_gate, __ATOMIC_ACQUIRE))
+        {
+            mt_thread_sleep(1);
+        }
+    }
+
+    asset->letter = (char)file->data[0];
+    uint32_t index = __atomic_fetch_add(&g_order_size, 1, __ATOMIC_RELAXED);
+    g_order[index] = asset->letter;
+    return true;
+}
+
+static void test_asset_destroy(MtAsset *asset)
+{
+    (void)asset;
+}
+
+static const char *g_extensions[] = {".txt"};
+
+static MtAssetVT g_test_asset_vt = {
+    .name = "Test",
+    .extensions = g_extensions,
+    .extension_count = MT_LENGTH(g_extensions),
+    .size = sizeof(TestAsset),
+    .init = test_asset_init,
+    .destroy = test_asset_destroy,
+};
+
+static void set_thread_id(uint32_t thread_id)
+{
+    (void)thread_id;
+}
+
+typedef struct Completion
+{
+    uint32_t count;
+    MtAssetHandle handle;
+} Completion;
+
+static void on_load(MtAssetManager *am, MtAssetHandle handle, void *user_data)
+{
+    (void)am;
+    Completion *completion = user_data;
+    completion->handle = handle;
+    __atomic_add_fetch(&completion->count, 1, __ATOMIC_RELAXED);
+}
+
+static uint64_t request(
+    MtAssetManager *am, const char *path, MtAssetPriority priority, Completion *completion)
+{
+    return mt_asset_manager_request(am, path, priority, on_load, completion);
+}
+
+static uint32_t ref_count(MtAssetManager *am, MtAssetHandle handle)
+{
+    assert(handle.index != 0);
+    return am->slots[handle.index - 1].ref_count;
+}
+
+static void reset(uint32_t gate)
+{
+    memset(g_order, 0, sizeof(g_order));
+    g_order_size = 0;
+    __atomic_store_n(&g_gate, gate, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_gate_entered, 0, __ATOMIC_RELEASE);
+}
+
+static void wait_gate_entered(void)
+{
+    while (!__atomic_load_n(&g_gate_entered, __ATOMIC_ACQUIRE))
+    {
+        mt_thread_sleep(1);
+    }
+}
+
+static void open_gate(void)
+{
+    __atomic_store_n(&g_gate, 1, __ATOMIC_RELEASE);
+}
+
+static void test_dedup(MtAssetManager *am)
+{
+    reset(1);
+
+    // One load, one reference per request
+    Completion completions[4] = {0};
+    for (uint32_t i = 0; i < MT_LENGTH(completions); i++)
+    {
+        request(am, "am_test_a.txt", MT_ASSET_PRIORITY_VISIBLE, &completions[i]);
+    }
+    mt_asset_manager_wait(am);
+
+    assert(strcmp(g_order, "a") == 0);
+    for (uint32_t i = 0; i < MT_LENGTH(completions); i++)
+    {
+        assert(completions[i].count == 1);
+        assert(completions[i].handle.index == completions[0].handle.index);
+        assert(completions[i].handle.generation == completions[0].handle.generation);
+    }
+    assert(ref_count(am, completions[0].handle) == MT_LENGTH(completions));
+
+    // Loaded assets are only referenced
+    Completion loaded = {0};
+    uint64_t request_loaded = request(am, "am_test_a.txt", MT_ASSET_PRIORITY_PREFETCH, &loaded);
+    mt_asset_manager_wait(am);
+    assert(strcmp(g_order, "a") == 0);
+    assert(loaded.count == 1 && loaded.handle.index == completions[0].handle.index);
+    assert(ref_count(am, loaded.handle) == MT_LENGTH(completions) + 1);
+    assert(!mt_asset_manager_cancel(am, request_loaded));
+
+    for (uint32_t i = 0; i < MT_LENGTH(completions); i++)
+    {
+        mt_asset_manager_release(am, completions[i].handle);
+    }
+    mt_asset_manager_release(am, loaded.handle);
+    assert(ref_count(am, loaded.handle) == 0);
+
+    Completion missing = {0};
+    request(am, "am_test_missing.txt", MT_ASSET_PRIORITY_CRITICAL, &missing);
+    mt_asset_manager_wait(am);
+    assert(missing.count == 1 && missing.handle.index == 0);
+}
+
+static void test_priorities(MtAssetManager *am)
+{
+    reset(0);
+
+    // The gate runs alone, the others are queued behind it
+    Completion gate = {0}, b = {0}, c = {0}, x = {0}, y[2] = {0};
+    request(am, "am_test_gate.txt", MT_ASSET_PRIORITY_PREFETCH, &gate);
+    uint64_t request_x = request(am, "am_test_x.txt", MT_ASSET_PRIORITY_PREFETCH, &x);
+    request(am, "am_test_y.txt", MT_ASSET_PRIORITY_PREFETCH, &y[0]);
+    request(am, "am_test_b.txt", MT_ASSET_PRIORITY_VISIBLE, &b);
+    request(am, "am_test_c.txt", MT_ASSET_PRIORITY_CRITICAL, &c);
+
+    // Promoted by a call and by a more urgent request for the same path
+    mt_asset_manager_set_priority(am, request_x, MT_ASSET_PRIORITY_CRITICAL);
+    request(am, "am_test_y.txt", MT_ASSET_PRIORITY_CRITICAL, &y[1]);
+
+    open_gate();
+    mt_asset_manager_wait(am);
+
+    assert(strcmp(g_order, "gcxyb") == 0);
+    assert(gate.count == 1 && b.count == 1 && c.count == 1 && x.count == 1);
+    assert(y[0].count == 1 && y[1].count == 1);
+    assert(ref_count(am, y[0].handle) == 2);
+
+    Completion *completions[] = {&gate, &b, &c, &x, &y[0], &y[1]};
+    for (uint32_t i = 0; i < MT_LENGTH(completions); i++)
+    {
+        mt_asset_manager_release(am, completions[i]->handle);
+    }
+}
+
+static void test_cancel(MtAssetManager *am)
+{
+    reset(0);
+
+    Completion gate = {0}, queued = {0}, kept = {0}, dropped = {0};
+    uint64_t request_gate = request(am, "am_test_gate2.txt", MT_ASSET_PRIORITY_CRITICAL, &gate);
+    uint64_t request_queued = request(am, "am_test_d.txt", MT_ASSET_PRIORITY_CRITICAL, &queued);
+    request(am, "am_test_d.txt", MT_ASSET_PRIORITY_PREFETCH, &kept);
+    uint64_t request_dropped = request(am, "am_test_e.txt", MT_ASSET_PRIORITY_VISIBLE, &dropped);
+
+    // The running load completes without its callback
+    wait_gate_entered();
+    assert(mt_asset_manager_cancel(am, request_gate));
+    // Queued loads are dropped once no request needs them
+    assert(mt_asset_manager_cancel(am, request_queued));
+    assert(mt_asset_manager_cancel(am, request_dropped));
+    assert(!mt_asset_manager_cancel(am, request_dropped));
+
+    open_gate();
+    mt_asset_manager_wait(am);
+
+    assert(strcmp(g_order, "gd") == 0);
+    assert(gate.count == 0 && queued.count == 0 && dropped.count == 0);
+    assert(kept.count == 1 && ref_count(am, kept.handle) == 1);
+    mt_asset_manager_release(am, kept.handle);
+
+    Completion loaded = {0};
+    request(am, "am_test_gate2.txt", MT_ASSET_PRIORITY_CRITICAL, &loaded);
+    mt_asset_manager_wait(am);
+    assert(strcmp(g_order, "gd") == 0);
+    assert(loaded.count == 1 && ref_count(am, loaded.handle) == 1);
+    mt_asset_manager_release(am, loaded.handle);
+}
+
+static void test_destroy(MtEngine *engine)
+{
+    reset(0);
+
+    MtAssetManager am;
+    mt_asset_manager_init(&am, NULL, engine);
+    mt_hash_set_ptr(&am.asset_type_map, mt_hash_str(".txt"), &g_test_asset_vt);
+    am.max_running_loads = 1;
+
+    Completion gate = {0}, queued = {0};
+    request(&am, "am_test_gate3.txt", MT_ASSET_PRIORITY_CRITICAL, &gate);
+    request(&am, "am_test_f.txt", MT_ASSET_PRIORITY_CRITICAL, &queued);
+    wait_gate_entered();
+    open_gate();
+
+    // Queued loads are dropped, unless the gate completed first, the running one completes
+    mt_asset_manager_destroy(&am);
+    assert(gate.count == 1 && queued.count <= 1);
+}
+
+static void write_file(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "wb");
+    assert(f);
+    fputs(text, f);
+    fclose(f);
+}
+
+static const char *g_files[][2] = {
+    {"am_test_a.txt", "a"},
+    {"am_test_b.txt", "b"},
+    {"am_test_c.txt", "c"},
+    {"am_test_d.txt", "d"},
+    {"am_test_e.txt", "e"},
+    {"am_test_f.txt", "f"},
+    {"am_test_x.txt", "x"},
+    {"am_test_y.txt", "y"},
+    {"am_test_gate.txt", "g"},
+    {"am_test_gate2.txt", "g"},
+    {"am_test_gate3.txt", "g"},
+};
+
+static int compare_entries(const void *a, const void *b)
+{
+    uint64_t x = ((const MtPackEntry *)a)->path_hash;
+    uint64_t y = ((const MtPackEntry *)b)->path_hash;
+    return (x > y) - (x < y);
+}
+
+// Compressed entries have to be read whole, so only they go through the async I/O
+static void write_pack(const char *path)
+{
+    enum { FILE_COUNT = MT_LENGTH(g_files) };
+
+    MtPackEntry entries[FILE_COUNT];
+    char names[FILE_COUNT * 32];
+    uint8_t *pack = calloc(FILE_COUNT + 1, MT_PACK_ALIGNMENT);
+
+    uint32_t names_size = 0;
+    for (uint32_t i = 0; i < FILE_COUNT; i++)
+    {
+        const char *name = g_files[i][0];
+        const char *text = g_files[i][1];
+        uint64_t offset = (uint64_t)(i + 1) * MT_PACK_ALIGNMENT;
+
+        size_t compressed_size = mt_lz4_compress(
+            (const uint8_t *)text, strlen(text), pack + offset, MT_PACK_ALIGNMENT);
+        assert(compressed_size > 0);
+
+        entries[i] = (MtPackEntry){
+            .path_hash = mt_hash_str(name),
+            .offset = offset,
+            .size = strlen(text),
+            .stored_size = compressed_size,
+            .name_offset = names_size,
+            .compression = MT_PACK_COMPRESSION_LZ4,
+        };
+
+        strcpy(&names[names_size], name);
+        names_size += (uint32_t)strlen(name) + 1;
+    }
+    qsort(entries, FILE_COUNT, sizeof(MtPackEntry), compare_entries);
+
+    MtPackHeader header = {
+        .magic = MT_PACK_MAGIC,
+        .version = MT_PACK_VERSION,
+        .entry_count = FILE_COUNT,
+        .names_size = names_size,
+    };
+    assert(sizeof(header) + sizeof(entries) + names_size <= MT_PACK_ALIGNMENT);
+    memcpy(pack, &header, sizeof(header));
+    memcpy(pack + sizeof(header), entries, sizeof(entries));
+    memcpy(pack + sizeof(header) + sizeof(entries), names, names_size);
+
+    FILE *f = fopen(path, "wb");
+    assert(f);
+    fwrite(pack, MT_PACK_ALIGNMENT, FILE_COUNT + 1, f);
+    fclose(f);
+    free(pack);
+}
+
+static void run(bool async_io)
+{
+    MtEngine engine = {0};
+    mt_thread_pool_init(&engine.thread_pool, 4, NULL);
+    mt_vfs_init(&engine.vfs, NULL);
+    if (async_io)
+    {
+        engine.async_io = mt_async_io_create(NULL, &engine.thread_pool);
+        bool mounted = mt_vfs_mount_pack(&engine.vfs, "", "am_test.mtpack");
+        assert(mounted && mt_vfs_needs_read(&engine.vfs, "am_test_a.txt"));
+    }
+
+    MtAssetManager am;
+    mt_asset_manager_init(&am, NULL, &engine);
+    mt_hash_set_ptr(&am.asset_type_map, mt_hash_str(".txt"), &g_test_asset_vt);
+
+    test_dedup(&am);
+
+    am.max_running_loads = 1;
+    test_priorities(&am);
+    test_cancel(&am);
+
+    mt_asset_manager_destroy(&am);
+
+    test_destroy(&engine);
+
+    if (async_io) mt_async_io_destroy(engine.async_io);
+    mt_thread_pool_destroy(&engine.thread_pool);
+    mt_vfs_destroy(&engine.vfs);
+}
+
+int main()
+{
+    // No device, loading only sets the thread id
+    mt_render.set_thread_id = set_thread_id;
+
+    for (uint32_t i = 0; i < MT_LENGTH(g_files); i++)
+    {
+        write_file(g_files[i][0], g_files[i][1]);
+    }
+
+    write_pack("am_test.mtpack");
+
+    run(false);
+    run(true);
+
+    remove("am_test.mtpack");
+
+    for (uint32_t i = 0; i < MT_LENGTH(g_files); i++)
+    {
+        remove(g_files[i][0]);
+    }
+
+    printf("Success\n");
+
+    return 0;
+}
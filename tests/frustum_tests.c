@@ -0,0 +1,91 @@
+#include <motor/base/frustum.h>
+#include <motor/base/math.h>
+#include <motor/base/rand.h>
+#include <motor/base/thread_pool.h>
+#include <motor/base/allocator.h>
+#include <assert.h>
+#include <stdio.h>
+
+// Same projection as MtPerspectiveCamera
+static Mat4 camera_view_proj(Vec3 eye, Vec3 center)
+{
+    Mat4 view = mat4_look_at(eye, center, V3(0.0f, 1.0f, 0.0f));
+    Mat4 proj = mat4_perspective(MT_RAD(75.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+    Mat4 correction = {{
+        {1.0f, 0.0f, 0.0f, 0.0f},
+        {0.0f, -1.0f, 0.0f, 0.0f},
+        {0.0f, 0.0f, 0.5f, 0.0f},
+        {0.0f, 0.0f, 0.5f, 1.0f},
+    }};
+    proj = mat4_mul(proj, correction);
+    return mat4_mul(view, proj);
+}
+
+static MtAabb box_at(Vec3 pos, float size)
+{
+    return (MtAabb){.min = v3_subs(pos, size), .max = v3_adds(pos, size)};
+}
+
+int main()
+{
+    Mat4 view_proj = camera_view_proj(V3(0.0f, 0.0f, 0.0f), V3(0.0f, 0.0f, -1.0f));
+    MtFrustum frustum;
+    mt_frustum_from_matrix(&frustum, &view_proj);
+
+    MtAabb in_front = box_at(V3(0.0f, 0.0f, -10.0f), 1.0f);
+    MtAabb behind = box_at(V3(0.0f, 0.0f, 10.0f), 1.0f);
+    MtAabb too_far = box_at(V3(0.0f, 0.0f, -400.0f), 1.0f);
+    MtAabb left = box_at(V3(-100.0f, 0.0f, -10.0f), 1.0f);
+    MtAabb above = box_at(V3(0.0f, 100.0f, -10.0f), 1.0f);
+    MtAabb around_camera = box_at(V3(0.0f, 0.0f, 0.0f), 5.0f);
+
+    assert(mt_frustum_test_aabb(&frustum, &in_front));
+    assert(!mt_frustum_test_aabb(&frustum, &behind));
+    assert(!mt_frustum_test_aabb(&frustum, &too_far));
+    assert(!mt_frustum_test_aabb(&frustum, &left));
+    assert(!mt_frustum_test_aabb(&frustum, &above));
+    assert(mt_frustum_test_aabb(&frustum, &around_camera));
+
+    // Translated out of view, then back into view through a transform
+    Mat4 transform = mat4_translate(mat4_identity(), V3(0.0f, 0.0f, -20.0f));
+    MtAabb moved = mt_aabb_transform(&behind, &transform);
+    assert(mt_frustum_test_aabb(&frustum, &moved));
+
+    // SIMD and parallel paths agree with the scalar test
+    enum { BOX_COUNT = 10003 };
+    static MtAabb boxes[BOX_COUNT];
+    static uint8_t visible[BOX_COUNT];
+    static uint8_t visible_parallel[BOX_COUNT];
+
+    MtXorShift rng;
+    mt_xor_shift_init(&rng, 42);
+    for (uint32_t i = 0; i < BOX_COUNT; i++)
+    {
+        Vec3 pos = V3(
+            mt_xor_shift_float(&rng, -200.0f, 200.0f),
+            mt_xor_shift_float(&rng, -200.0f, 200.0f),
+            mt_xor_shift_float(&rng, -200.0f, 200.0f));
+        boxes[i] = box_at(pos, mt_xor_shift_float(&rng, 0.1f, 5.0f));
+    }
+
+    MtThreadPool pool;
+    mt_thread_pool_init(&pool, 4, NULL);
+
+    mt_frustum_cull_aabbs(&frustum, boxes, BOX_COUNT, visible);
+    mt_frustum_cull_aabbs_parallel(&pool, &frustum, boxes, BOX_COUNT, visible_parallel);
+
+    uint32_t visible_count = 0;
+    for (uint32_t i = 0; i < BOX_COUNT; i++)
+    {
+        assert(visible[i] == mt_frustum_test_aabb(&frustum, &boxes[i]));
+        assert(visible[i] == visible_parallel[i]);
+        visible_count += visible[i];
+    }
+    assert(visible_count > 0 && visible_count < BOX_COUNT);
+
+    mt_thread_pool_destroy(&pool);
+
+    printf("%u / %u boxes visible\n", visible_count, BOX_COUNT);
+
+    return 0;
+}
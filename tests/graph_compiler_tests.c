@@ -0,0 +1,566 @@
+#include <motor/graphics/graph_compiler.h>
+#include <motor/base/array.h>
+#include <motor/base/rand.h>
+#include <assert.h>
+#include <stdio.h>
+
+enum { GRAPHICS, COMPUTE, TRANSFER };
+
+#define PASS(q, r, w)                                                                              \
+    ((MtGraphCompilerPass){                                                                        \
+        .queue = (q),                                                                              \
+        .reads = (r),                                                                              \
+        .read_count = sizeof(r) / sizeof(uint32_t),                                                \
+        .writes = (w),                                                                             \
+        .write_count = sizeof(w) / sizeof(uint32_t),                                               \
+    })
+
+static uint32_t position_of(MtGraphSchedule *schedule, uint32_t pass)
+{
+    for (uint32_t i = 0; i < mt_array_size(schedule->order); i++)
+    {
+        if (schedule->order[i] == pass) return i;
+    }
+    return UINT32_MAX;
+}
+
+static uint32_t
+group_queue(const MtGraphCompilerPass *passes, MtGraphSchedule *schedule, uint32_t group)
+{
+    return passes[schedule->order[schedule->group_starts[group]]].queue;
+}
+
+static uint32_t group_of(MtGraphSchedule *schedule, uint32_t position)
+{
+    uint32_t group = 0;
+    while (group + 1 < mt_array_size(schedule->group_starts) &&
+           schedule->group_starts[group + 1] <= position)
+    {
+        group++;
+    }
+    return group;
+}
+
+// Whether pass b accesses what pass a, declared before it, accesses, one of them writing
+static bool hazard(const MtGraphCompilerPass *passes, uint32_t a, uint32_t b)
+{
+    bool hazard = false;
+    for (uint32_t i = 0; i < passes[a].write_count; i++)
+    {
+        for (uint32_t j = 0; j < passes[b].read_count; j++)
+            hazard |= passes[a].writes[i] == passes[b].reads[j];
+        for (uint32_t j = 0; j < passes[b].write_count; j++)
+            hazard |= passes[a].writes[i] == passes[b].writes[j];
+    }
+    for (uint32_t i = 0; i < passes[a].read_count; i++)
+    {
+        for (uint32_t j = 0; j < passes[b].write_count; j++)
+            hazard |= passes[a].reads[i] == passes[b].writes[j];
+    }
+    return hazard;
+}
+
+static void test_cull_unused(void)
+{
+    uint32_t r0[] = {0}, r1[] = {1}, r2[] = {2};
+
+    MtGraphCompilerPass passes[] = {
+        PASS(GRAPHICS, r2, r0),
+        PASS(COMPUTE, r2, r1),
+        PASS(GRAPHICS, r0, r2),
+    };
+
+    MtGraphSchedule schedule;
+    mt_graph_compile(NULL, passes, 3, 3, &schedule);
+
+    assert(!schedule.culled[0]);
+    assert(schedule.culled[1]);
+    assert(!schedule.culled[2]);
+    assert(mt_array_size(schedule.order) == 2);
+    assert(schedule.order[0] == 0 && schedule.order[1] == 2);
+    assert(mt_array_size(schedule.group_starts) == 1);
+
+    // Writing host visible memory keeps it alive
+    passes[1].root = true;
+    mt_graph_schedule_destroy(NULL, &schedule);
+    mt_graph_compile(NULL, passes, 3, 3, &schedule);
+    assert(!schedule.culled[1]);
+    assert(mt_array_size(schedule.order) == 3);
+    assert(schedule.order[2] == 2);
+
+    mt_graph_schedule_destroy(NULL, &schedule);
+}
+
+static void test_cull_chain(void)
+{
+    uint32_t none[] = {0}, r1[] = {1}, r2[] = {2}, r3[] = {3};
+
+    // 0 -> 1 -> 2 feed nothing the last pass reads
+    MtGraphCompilerPass passes[] = {
+        PASS(COMPUTE, none, r1),
+        PASS(COMPUTE, r1, r2),
+        PASS(TRANSFER, r2, r3),
+        PASS(GRAPHICS, none, none),
+    };
+    passes[3].write_count = 0;
+
+    MtGraphSchedule schedule;
+    mt_graph_compile(NULL, passes, 4, 4, &schedule);
+
+    assert(schedule.culled[0] && schedule.culled[1] && schedule.culled[2]);
+    assert(mt_array_size(schedule.order) == 1 && schedule.order[0] == 3);
+
+    mt_graph_schedule_destroy(NULL, &schedule);
+}
+
+static void test_group_queues(void)
+{
+    uint32_t none[] = {0}, r1[] = {1}, r2[] = {2}, r3[] = {3}, r4[] = {4}, r34[] = {3, 4};
+
+    // Alternating queues in declaration order, but the graphics and compute chains
+    // are independent until the last pass
+    MtGraphCompilerPass passes[] = {
+        PASS(GRAPHICS, none, r1),
+        PASS(COMPUTE, none, r2),
+        PASS(GRAPHICS, r1, r3),
+        PASS(COMPUTE, r2, r4),
+        PASS(GRAPHICS, r34, none),
+    };
+    passes[0].read_count = 0;
+    passes[1].read_count = 0;
+    passes[4].write_count = 0;
+
+    MtGraphSchedule schedule;
+    mt_graph_compile(NULL, passes, 5, 5, &schedule);
+
+    uint32_t expected[] = {0, 2, 1, 3, 4};
+    assert(mt_array_size(schedule.order) == 5);
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        assert(schedule.order[i] == expected[i]);
+    }
+
+    assert(mt_array_size(schedule.group_starts) == 3);
+    assert(schedule.group_starts[0] == 0);
+    assert(schedule.group_starts[1] == 2);
+    assert(schedule.group_starts[2] == 4);
+
+    mt_graph_schedule_destroy(NULL, &schedule);
+}
+
+static void test_write_after_read(void)
+{
+    uint32_t depth[] = {0}, r1[] = {1}, r2[] = {2};
+
+    // Pass 1 reads last frame's depth, so it must run before pass 2 overwrites it
+    // even though staying on the graphics queue would favor pass 2
+    MtGraphCompilerPass passes[] = {
+        PASS(GRAPHICS, r2, r1),
+        PASS(COMPUTE, depth, r2),
+        PASS(GRAPHICS, r1, depth),
+        PASS(GRAPHICS, depth, r1),
+    };
+    passes[0].read_count = 0;
+    passes[1].root = true;
+
+    MtGraphSchedule schedule;
+    mt_graph_compile(NULL, passes, 4, 3, &schedule);
+
+    assert(mt_array_size(schedule.order) == 4);
+    assert(position_of(&schedule, 1) < position_of(&schedule, 2));
+
+    mt_graph_schedule_destroy(NULL, &schedule);
+}
+
+static void test_async_overlap(void)
+{
+    uint32_t none[] = {0}, shadow[] = {0}, env[] = {1}, gbuffer[] = {2}, lit[] = {3};
+    uint32_t env_gbuffer[] = {1, 2};
+
+    // The async environment pass overlaps with the shadow and gbuffer passes,
+    // only lighting waits for it
+    MtGraphCompilerPass passes[] = {
+        PASS(GRAPHICS, none, shadow),
+        PASS(COMPUTE, none, env),
+        PASS(GRAPHICS, shadow, gbuffer),
+        PASS(GRAPHICS, env_gbuffer, lit),
+        PASS(GRAPHICS, lit, none),
+    };
+    passes[0].read_count = 0;
+    passes[1].read_count = 0;
+    passes[1].async = true;
+    passes[4].write_count = 0;
+
+    MtGraphSchedule schedule;
+    mt_graph_compile(NULL, passes, 5, 4, &schedule);
+
+    uint32_t expected[] = {1, 0, 2, 3, 4};
+    assert(mt_array_size(schedule.order) == 5);
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        assert(schedule.order[i] == expected[i]);
+    }
+
+    assert(mt_array_size(schedule.group_starts) == 3);
+    assert(schedule.group_starts[1] == 1);
+    assert(schedule.group_starts[2] == 3);
+
+    assert(mt_array_size(schedule.group_waits) == 1);
+    assert(schedule.group_waits[0].group == 2 && schedule.group_waits[0].wait_for == 0);
+
+    mt_graph_schedule_destroy(NULL, &schedule);
+
+    // Without it, the environment pass is recorded with the graphics ones
+    passes[1].async = false;
+    passes[1].queue = GRAPHICS;
+    mt_graph_compile(NULL, passes, 5, 4, &schedule);
+    assert(mt_array_size(schedule.group_starts) == 1);
+    assert(mt_array_size(schedule.group_waits) == 0);
+    mt_graph_schedule_destroy(NULL, &schedule);
+}
+
+// 0 when first_use does not wait for wait_for, 1 when it does within the frame,
+// 2 when it does across the end of the frame
+static uint32_t alias_wait(const MtGraphAliasing *aliasing, uint32_t resource, uint32_t wait_for)
+{
+    for (uint32_t i = 0; i < mt_array_size(aliasing->waits); i++)
+    {
+        const MtGraphAliasWait *wait = &aliasing->waits[i];
+        if (wait->resource == resource && wait->wait_for == wait_for)
+        {
+            return wait->previous_frame ? 2 : 1;
+        }
+    }
+    return 0;
+}
+
+static void test_alias_chain(void)
+{
+    uint32_t none[] = {0}, a[] = {0}, b[] = {1}, c[] = {2}, d[] = {3};
+
+    MtGraphCompilerPass passes[] = {
+        PASS(GRAPHICS, none, a),
+        PASS(GRAPHICS, a, b),
+        PASS(GRAPHICS, b, c),
+        PASS(GRAPHICS, c, d),
+        PASS(GRAPHICS, d, none),
+    };
+    passes[0].read_count = 0;
+    passes[4].write_count = 0;
+
+    MtGraphAliasResource resources[4];
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        resources[i] = (MtGraphAliasResource){
+            .size = 1000,
+            .alignment = 256,
+            .memory_type_bits = 0xf,
+            .can_alias = true,
+        };
+    }
+
+    MtGraphSchedule schedule;
+    mt_graph_compile(NULL, passes, 5, 4, &schedule);
+
+    MtGraphAliasing aliasing;
+    mt_graph_alias(NULL, passes, &schedule, resources, 4, &aliasing);
+
+    // d is read by the last pass, so it is an output
+    assert(aliasing.placements[3].heap == UINT32_MAX);
+    assert(aliasing.placements[3].first_use == 3 && aliasing.placements[3].last_use == 4);
+
+    assert(mt_array_size(aliasing.heaps) == 1);
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        assert(aliasing.placements[i].heap == 0);
+    }
+
+    // a and c are never alive at the same time
+    assert(aliasing.placements[0].offset == aliasing.placements[2].offset);
+    assert(aliasing.placements[1].offset != aliasing.placements[0].offset);
+
+    assert(aliasing.transient_size == 3000);
+    assert(aliasing.peak_size == 2000);
+    assert(aliasing.heap_size == aliasing.heaps[0].size);
+    assert(aliasing.heap_size == 1024 + 1000);
+
+    // c waits for a within the frame. The next frame's a waits for c, and every resource
+    // waits for its own use in the previous frame.
+    assert(mt_array_size(aliasing.waits) == 5);
+    assert(alias_wait(&aliasing, 2, 0) == 1);
+    assert(alias_wait(&aliasing, 0, 2) == 2);
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        assert(alias_wait(&aliasing, i, i) == 2);
+    }
+    assert(alias_wait(&aliasing, 1, 0) == 0 && alias_wait(&aliasing, 0, 1) == 0);
+    assert(alias_wait(&aliasing, 3, 3) == 0);
+
+    mt_graph_aliasing_destroy(NULL, &aliasing);
+    mt_graph_schedule_destroy(NULL, &schedule);
+}
+
+static void test_alias_constraints(void)
+{
+    uint32_t none[] = {0}, a[] = {0}, b[] = {1}, c[] = {2}, e[] = {4}, ce[] = {2, 4};
+    uint32_t history[] = {3};
+
+    // a and b could share memory, but are of a different kind. history is read before
+    // it is written, so it holds the contents of the previous frame.
+    MtGraphCompilerPass passes[] = {
+        PASS(COMPUTE, history, a),
+        PASS(COMPUTE, a, c),
+        PASS(COMPUTE, none, b),
+        PASS(COMPUTE, b, e),
+        PASS(GRAPHICS, ce, history),
+    };
+    passes[2].read_count = 0;
+
+    MtGraphAliasResource resources[5];
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        resources[i] = (MtGraphAliasResource){
+            .size = 64,
+            .alignment = 16,
+            .memory_type_bits = 0x3,
+            .can_alias = true,
+        };
+    }
+    resources[1].kind = 1;
+
+    MtGraphSchedule schedule;
+    mt_graph_compile(NULL, passes, 5, 5, &schedule);
+
+    MtGraphAliasing aliasing;
+    mt_graph_alias(NULL, passes, &schedule, resources, 5, &aliasing);
+
+    assert(aliasing.placements[3].heap == UINT32_MAX);
+    assert(aliasing.placements[0].heap != UINT32_MAX);
+    assert(aliasing.placements[1].heap != UINT32_MAX);
+    assert(aliasing.placements[0].heap != aliasing.placements[1].heap);
+    assert(mt_array_size(aliasing.heaps) == 2);
+
+    mt_graph_aliasing_destroy(NULL, &aliasing);
+
+    // Same kind, but no memory type in common
+    resources[1].kind = 0;
+    resources[1].memory_type_bits = 0x4;
+    mt_graph_alias(NULL, passes, &schedule, resources, 5, &aliasing);
+    assert(aliasing.placements[0].heap != aliasing.placements[1].heap);
+    mt_graph_aliasing_destroy(NULL, &aliasing);
+
+    // Now they share
+    resources[1].memory_type_bits = 0x2;
+    mt_graph_alias(NULL, passes, &schedule, resources, 5, &aliasing);
+    assert(mt_array_size(aliasing.heaps) == 1);
+    assert(aliasing.heaps[0].memory_type_bits == 0x2);
+    assert(aliasing.placements[0].offset == aliasing.placements[1].offset);
+    mt_graph_aliasing_destroy(NULL, &aliasing);
+
+    resources[0].can_alias = false;
+    mt_graph_alias(NULL, passes, &schedule, resources, 5, &aliasing);
+    assert(aliasing.placements[0].heap == UINT32_MAX);
+    mt_graph_aliasing_destroy(NULL, &aliasing);
+
+    mt_graph_schedule_destroy(NULL, &schedule);
+}
+
+// Random graphs: every hazard between live passes is respected, and passes of a group
+// keep their declaration order since that is the order they get recorded in.
+static void test_random(void)
+{
+    enum { PASS_COUNT = 24, RESOURCE_COUNT = 12, MAX_ACCESSES = 3 };
+
+    MtXorShift rng;
+    mt_xor_shift_init(&rng, 1234);
+
+    for (uint32_t iteration = 0; iteration < 1000; iteration++)
+    {
+        uint32_t reads[PASS_COUNT][MAX_ACCESSES];
+        uint32_t writes[PASS_COUNT][MAX_ACCESSES];
+        MtGraphCompilerPass passes[PASS_COUNT] = {0};
+
+        for (uint32_t p = 0; p < PASS_COUNT; p++)
+        {
+            passes[p].queue = (uint32_t)(mt_xor_shift(&rng) % 3);
+            passes[p].root = mt_xor_shift(&rng) % 8 == 0;
+            passes[p].async = iteration % 2 == 1 && passes[p].queue == COMPUTE;
+            passes[p].read_count = (uint32_t)(mt_xor_shift(&rng) % (MAX_ACCESSES + 1));
+            passes[p].write_count = (uint32_t)(mt_xor_shift(&rng) % (MAX_ACCESSES + 1));
+            for (uint32_t i = 0; i < MAX_ACCESSES; i++)
+            {
+                reads[p][i] = (uint32_t)(mt_xor_shift(&rng) % RESOURCE_COUNT);
+                writes[p][i] = (uint32_t)(mt_xor_shift(&rng) % RESOURCE_COUNT);
+            }
+            passes[p].reads = reads[p];
+            passes[p].writes = writes[p];
+        }
+
+        MtGraphSchedule schedule;
+        mt_graph_compile(NULL, passes, PASS_COUNT, RESOURCE_COUNT, &schedule);
+
+        assert(!schedule.culled[PASS_COUNT - 1]);
+        assert(*mt_array_last(schedule.order) == PASS_COUNT - 1);
+
+        uint32_t live_count = 0;
+        for (uint32_t p = 0; p < PASS_COUNT; p++)
+        {
+            live_count += !schedule.culled[p];
+            if (passes[p].root) assert(!schedule.culled[p]);
+        }
+        assert(mt_array_size(schedule.order) == live_count);
+
+        for (uint32_t a = 0; a < PASS_COUNT; a++)
+        {
+            if (schedule.culled[a]) continue;
+            for (uint32_t b = a + 1; b < PASS_COUNT; b++)
+            {
+                if (schedule.culled[b]) continue;
+
+                if (hazard(passes, a, b))
+                {
+                    assert(position_of(&schedule, a) < position_of(&schedule, b));
+                }
+            }
+        }
+
+        for (uint32_t g = 0; g < mt_array_size(schedule.group_starts); g++)
+        {
+            uint32_t start = schedule.group_starts[g];
+            uint32_t end = g + 1 < mt_array_size(schedule.group_starts)
+                               ? schedule.group_starts[g + 1]
+                               : (uint32_t)mt_array_size(schedule.order);
+            assert(start < end);
+
+            for (uint32_t i = start + 1; i < end; i++)
+            {
+                assert(passes[schedule.order[i]].queue == passes[schedule.order[start]].queue);
+                assert(schedule.order[i] > schedule.order[i - 1]);
+            }
+
+            // A group only follows one of the same queue to avoid waiting for more
+            if (g > 0 && group_queue(passes, &schedule, g - 1) == group_queue(passes, &schedule, g))
+            {
+                bool waits = false;
+                for (uint32_t w = 0; w < mt_array_size(schedule.group_waits); w++)
+                {
+                    waits |= schedule.group_waits[w].group == g;
+                }
+                assert(waits);
+            }
+        }
+
+        // Every hazard between passes of different queues is covered by the waits,
+        // maybe through other groups, and the last group comes after everything
+        uint32_t group_count = (uint32_t)mt_array_size(schedule.group_starts);
+        int32_t done[PASS_COUNT][3];
+        for (uint32_t g = 0; g < group_count; g++)
+        {
+            for (uint32_t q = 0; q < 3; q++) done[g][q] = -1;
+
+            for (uint32_t h = 0; h < g; h++)
+            {
+                bool same_queue = group_queue(passes, &schedule, h) ==
+                                  group_queue(passes, &schedule, g);
+                bool waited = false;
+                for (uint32_t w = 0; w < mt_array_size(schedule.group_waits); w++)
+                {
+                    MtGraphGroupWait *wait = &schedule.group_waits[w];
+                    assert(wait->wait_for < wait->group);
+                    if (w > 0) assert(schedule.group_waits[w - 1].group <= wait->group);
+                    waited |= wait->group == g && wait->wait_for == h;
+                }
+                if (!same_queue && !waited) continue;
+
+                for (uint32_t q = 0; q < 3; q++)
+                {
+                    if (done[h][q] > done[g][q]) done[g][q] = done[h][q];
+                }
+                done[g][group_queue(passes, &schedule, h)] = (int32_t)h;
+            }
+        }
+
+        for (uint32_t i = 0; i < mt_array_size(schedule.order); i++)
+        {
+            uint32_t b = schedule.order[i];
+            uint32_t group_b = group_of(&schedule, i);
+            for (uint32_t j = 0; j < i; j++)
+            {
+                uint32_t a = schedule.order[j];
+                uint32_t group_a = group_of(&schedule, j);
+                bool last = group_b == group_count - 1;
+                if (group_a == group_b || (!last && !hazard(passes, a, b))) continue;
+                assert(done[group_b][passes[a].queue] >= (int32_t)group_a);
+            }
+        }
+
+        MtGraphAliasResource resources[RESOURCE_COUNT];
+        for (uint32_t r = 0; r < RESOURCE_COUNT; r++)
+        {
+            resources[r] = (MtGraphAliasResource){
+                .size = 1 + mt_xor_shift(&rng) % 4096,
+                .alignment = 1ull << (mt_xor_shift(&rng) % 9),
+                .memory_type_bits = 1 + (uint32_t)(mt_xor_shift(&rng) % 7),
+                .kind = (uint32_t)(mt_xor_shift(&rng) % 2),
+                .can_alias = mt_xor_shift(&rng) % 4 != 0,
+            };
+        }
+
+        MtGraphAliasing aliasing;
+        mt_graph_alias(NULL, passes, &schedule, resources, RESOURCE_COUNT, &aliasing);
+
+        assert(aliasing.heap_size >= aliasing.peak_size);
+        assert(aliasing.heap_size <= aliasing.transient_size + 256 * RESOURCE_COUNT);
+
+        for (uint32_t r = 0; r < RESOURCE_COUNT; r++)
+        {
+            MtGraphAliasPlacement *a = &aliasing.placements[r];
+            if (a->heap == UINT32_MAX) continue;
+
+            MtGraphAliasHeap *heap = &aliasing.heaps[a->heap];
+            assert(resources[r].can_alias);
+            assert(a->last_use < mt_array_size(schedule.order) - 1);
+            assert(a->offset % resources[r].alignment == 0);
+            assert(a->offset + resources[r].size <= heap->size);
+            assert(heap->memory_type_bits & resources[r].memory_type_bits);
+            assert(alias_wait(&aliasing, r, r) == 2);
+
+            for (uint32_t q = r + 1; q < RESOURCE_COUNT; q++)
+            {
+                MtGraphAliasPlacement *b = &aliasing.placements[q];
+                if (b->heap != a->heap) continue;
+
+                assert(resources[q].kind == resources[r].kind);
+                bool alive_together = a->first_use <= b->last_use && b->first_use <= a->last_use;
+                bool share_memory = a->offset < b->offset + resources[q].size &&
+                                    b->offset < a->offset + resources[r].size;
+                assert(!(alive_together && share_memory));
+
+                // Whichever is used first in a frame is waited for within the frame,
+                // the other one across the end of the frame
+                uint32_t r_first = a->last_use < b->first_use;
+                assert(alias_wait(&aliasing, q, r) == (share_memory ? 2 - r_first : 0));
+                assert(alias_wait(&aliasing, r, q) == (share_memory ? 1 + r_first : 0));
+            }
+        }
+
+        mt_graph_aliasing_destroy(NULL, &aliasing);
+        mt_graph_schedule_destroy(NULL, &schedule);
+    }
+}
+
+int main()
+{
+    test_cull_unused();
+    test_cull_chain();
+    test_group_queues();
+    test_write_after_read();
+    test_async_overlap();
+    test_alias_chain();
+    test_alias_constraints();
+    test_random();
+
+    printf("Graph compiler tests passed\n");
+
+    return 0;
+}
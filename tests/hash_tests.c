@@ -57,6 +57,32 @@ void test2(MtAllocator *alloc)
     mt_hash_destroy(&h);
 }
 
+void test3(MtAllocator *alloc)
+{
+    MtHashMap h;
+    mt_hash_init(&h, 8, alloc);
+
+    // 1, 9 and 17 share a bucket
+    assert(mt_hash_set_uint(&h, 1, 10) == 10);
+    assert(mt_hash_set_uint(&h, 9, 90) == 90);
+    assert(mt_hash_set_uint(&h, 17, 170) == 170);
+    assert(mt_hash_set_uint(&h, 2, 20) == 20);
+
+    mt_hash_remove(&h, 1);
+    assert(mt_hash_get_uint(&h, 1) == MT_HASH_NOT_FOUND);
+    assert(mt_hash_get_uint(&h, 9) == 90);
+    assert(mt_hash_get_uint(&h, 17) == 170);
+    assert(mt_hash_get_uint(&h, 2) == 20);
+
+    mt_hash_remove(&h, 5);
+    mt_hash_remove(&h, 17);
+    assert(mt_hash_get_uint(&h, 9) == 90);
+    assert(mt_hash_get_uint(&h, 2) == 20);
+    assert(mt_hash_get_uint(&h, 17) == MT_HASH_NOT_FOUND);
+
+    mt_hash_destroy(&h);
+}
+
 int main()
 {
     MtAllocator alloc;
@@ -64,6 +90,7 @@ int main()
 
     test1(&alloc);
     test2(&alloc);
+    test3(&alloc);
 
     mt_arena_destroy(&alloc);
 
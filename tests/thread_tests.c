@@ -11,6 +11,89 @@ int32_t thread_start(void *arg)
     return 0;
 }
 
+#define CHILD_COUNT 300
+
+typedef struct ParentTask
+{
+    MtThreadPool *pool;
+    uint32_t values[CHILD_COUNT];
+} ParentTask;
+
+int32_t child_start(void *arg)
+{
+    uint32_t *value = arg;
+    *value += 1;
+    return 0;
+}
+
+// Waits for its children from inside the pool, more of them than the initial queue holds
+int32_t parent_start(void *arg)
+{
+    ParentTask *parent = arg;
+
+    MtTaskGroup group = {0};
+    for (uint32_t i = 0; i < CHILD_COUNT; i++)
+    {
+        mt_thread_pool_enqueue_group(parent->pool, &group, child_start, &parent->values[i]);
+    }
+    mt_thread_pool_wait_group(parent->pool, &group);
+
+    for (uint32_t i = 0; i < CHILD_COUNT; i++)
+    {
+        assert(parent->values[i] == 1);
+    }
+
+    return 0;
+}
+
+static uint32_t g_gate;
+
+int32_t gate_start(void *arg)
+{
+    while (!__atomic_load_n(&g_gate, __ATOMIC_ACQUIRE))
+    {
+        mt_thread_sleep(1);
+    }
+    return 0;
+}
+
+int32_t task_id_start(void *arg)
+{
+    *(uint32_t *)arg = mt_thread_pool_get_task_id();
+    return 0;
+}
+
+// The only worker is blocked, so the waiting thread runs its own group and nothing else
+void test_wait_group_own_tasks()
+{
+    MtThreadPool pool;
+    mt_thread_pool_init(&pool, 1, NULL);
+
+    mt_thread_pool_enqueue(&pool, gate_start, NULL);
+
+    uint32_t other_id = 0;
+    uint32_t own_ids[4] = {1, 1, 1, 1};
+    MtTaskGroup other = {0}, own = {0};
+    mt_thread_pool_enqueue_group(&pool, &other, task_id_start, &other_id);
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        mt_thread_pool_enqueue_group(&pool, &own, task_id_start, &own_ids[i]);
+    }
+    mt_thread_pool_wait_group(&pool, &own);
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        assert(own_ids[i] == 0);
+    }
+    assert(other.pending == 1);
+
+    __atomic_store_n(&g_gate, 1, __ATOMIC_RELEASE);
+    mt_thread_pool_wait_all(&pool);
+    assert(other_id == 1);
+
+    mt_thread_pool_destroy(&pool);
+}
+
 int main()
 {
     MtThreadPool pool;
@@ -27,6 +110,16 @@ int main()
 
     printf("Hello\n");
 
+    static ParentTask parents[8];
+    MtTaskGroup group = {0};
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        parents[i].pool = &pool;
+        mt_thread_pool_enqueue_group(&pool, &group, parent_start, &parents[i]);
+    }
+    mt_thread_pool_wait_group(&pool, &group);
+    mt_thread_pool_wait_all(&pool);
+
     for (uint32_t i = 0; i < 16; i++)
     {
         mt_thread_pool_enqueue(&pool, thread_start, NULL);
@@ -34,5 +127,7 @@ int main()
 
     mt_thread_pool_destroy(&pool);
 
+    test_wait_group_own_tasks();
+
     return 0;
 }
@@ -0,0 +1,325 @@
+#include <motor/base/vfs.h>
+#include <motor/base/lz4.h>
+#include <motor/base/pack_format.h>
+#include <motor/base/hashmap.h>
+#include <motor/base/allocator.h>
+#include <motor/base/rand.h>
+#include <motor/base/thread_pool.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void round_trip(const uint8_t *data, size_t size)
+{
+    size_t bound = mt_lz4_compress_bound(size);
+    uint8_t *compressed = malloc(bound);
+    uint8_t *decompressed = malloc(size + 1);
+
+    size_t compressed_size = mt_lz4_compress(data, size, compressed, bound);
+    assert(compressed_size > 0);
+    assert(mt_lz4_decompress(compressed, compressed_size, decompressed, size));
+    assert(memcmp(data, decompressed, size) == 0);
+
+    // Sizes have to match exactly
+    assert(!mt_lz4_decompress(compressed, compressed_size, decompressed, size + 1));
+    if (compressed_size > 1)
+    {
+        assert(!mt_lz4_decompress(compressed, compressed_size - 1, decompressed, size));
+    }
+
+    free(compressed);
+    free(decompressed);
+}
+
+static void test_lz4(void)
+{
+    round_trip((const uint8_t *)"", 0);
+    round_trip((const uint8_t *)"abc", 3);
+
+    size_t size = 1 << 20;
+    uint8_t *data = malloc(size);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = (uint8_t)"the quick brown fox jumps over the lazy dog"[i % 43];
+    }
+    round_trip(data, size);
+
+    size_t bound = mt_lz4_compress_bound(size);
+    uint8_t *compressed = malloc(bound);
+    assert(mt_lz4_compress(data, size, compressed, bound) < size / 50);
+    assert(mt_lz4_compress(data, size, compressed, 16) == 0);
+    free(compressed);
+
+    MtXorShift rng;
+    mt_xor_shift_init(&rng, 1234);
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = (uint8_t)mt_xor_shift(&rng);
+    }
+    round_trip(data, size);
+
+    // Long runs of one byte, matches overlapping their own output
+    memset(data, 7, size);
+    round_trip(data, size);
+    round_trip(data, 13);
+
+    free(data);
+}
+
+static void write_file(const char *path, const void *data, size_t size)
+{
+    FILE *f = fopen(path, "wb");
+    assert(f);
+    fwrite(data, 1, size, f);
+    fclose(f);
+}
+
+static int32_t read_done(void *arg)
+{
+    MtAsyncRead *read = arg;
+    uint32_t *completed = read->user_data;
+    __atomic_add_fetch(completed, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static void test_async_io(void)
+{
+    size_t size = 3 << 20;
+    uint8_t *data = malloc(size);
+    MtXorShift rng;
+    mt_xor_shift_init(&rng, 42);
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = (uint8_t)mt_xor_shift(&rng);
+    }
+    write_file("async_io_test.bin", data, size);
+
+    MtThreadPool pool;
+    mt_thread_pool_init(&pool, 4, NULL);
+    MtAsyncIo *io = mt_async_io_create(NULL, &pool);
+    printf("Async I/O backend: %s\n", mt_async_io_backend(io));
+
+    // More reads than the backends keep in flight at once
+    enum { READ_COUNT = 300 };
+    static MtAsyncRead reads[READ_COUNT];
+    MtAsyncRead *read_ptrs[READ_COUNT];
+    uint32_t completed = 0;
+
+    for (uint32_t i = 0; i < READ_COUNT; i++)
+    {
+        uint64_t offset = mt_xor_shift(&rng) % size;
+        reads[i] = (MtAsyncRead){
+            .path = "async_io_test.bin",
+            .offset = offset,
+            .size = mt_xor_shift(&rng) % (size - offset),
+            .continuation = read_done,
+            .user_data = &completed,
+        };
+        read_ptrs[i] = &reads[i];
+    }
+    reads[0].offset = 0;
+    reads[0].size = MT_ASYNC_READ_WHOLE_FILE;
+    reads[1].offset = size;
+    reads[1].size = 0;
+    reads[2].size = size;
+    reads[3].path = "async_io_missing.bin";
+
+    MtTaskGroup group = {0};
+    mt_async_io_submit(io, read_ptrs, READ_COUNT, &group);
+    mt_thread_pool_wait_group(&pool, &group);
+    assert(completed == READ_COUNT);
+
+    assert(!reads[0].failed && reads[0].size == size);
+    assert(!reads[1].failed && reads[1].size == 0 && !reads[1].data);
+    assert(reads[2].failed && !reads[2].data);
+    assert(reads[3].failed && !reads[3].data);
+
+    for (uint32_t i = 0; i < READ_COUNT; i++)
+    {
+        if (reads[i].failed || reads[i].size == 0) continue;
+        assert(memcmp(reads[i].data, data + reads[i].offset, reads[i].size) == 0);
+        mt_free(NULL, reads[i].data);
+    }
+
+    mt_async_io_destroy(io);
+    mt_thread_pool_destroy(&pool);
+
+    free(data);
+    remove("async_io_test.bin");
+}
+
+static int32_t open_done(void *arg)
+{
+    MtVfsAsyncOpen *open = arg;
+    MtVfsFile *expected = open->user_data;
+
+    if (expected->data)
+    {
+        assert(open->file.size == expected->size);
+        assert(memcmp(open->file.data, expected->data, expected->size) == 0);
+    }
+    else
+    {
+        assert(!open->file.data);
+    }
+
+    mt_vfs_close(open->vfs, &open->file);
+    return 0;
+}
+
+static void test_pack(void)
+{
+    const char *stored = "stored entry";
+    char compressed_source[4096];
+    for (size_t i = 0; i < sizeof(compressed_source); i++)
+    {
+        compressed_source[i] = "abcd"[i % 4];
+    }
+    uint8_t compressed[4096];
+    size_t compressed_size = mt_lz4_compress(
+        (const uint8_t *)compressed_source,
+        sizeof(compressed_source),
+        compressed,
+        sizeof(compressed));
+    assert(compressed_size > 0);
+
+    const char names[] = "dir/stored.txt\0dir/compressed.txt";
+
+    MtPackEntry entries[2] = {
+        {
+            .path_hash = mt_hash_str("dir/stored.txt"),
+            .offset = MT_PACK_ALIGNMENT,
+            .size = strlen(stored),
+            .stored_size = strlen(stored),
+            .mtime = 42,
+            .name_offset = 0,
+        },
+        {
+            .path_hash = mt_hash_str("dir/compressed.txt"),
+            .offset = 2 * MT_PACK_ALIGNMENT,
+            .size = sizeof(compressed_source),
+            .stored_size = compressed_size,
+            .name_offset = 15,
+            .compression = MT_PACK_COMPRESSION_LZ4,
+        },
+    };
+    if (entries[0].path_hash > entries[1].path_hash)
+    {
+        MtPackEntry entry = entries[0];
+        entries[0] = entries[1];
+        entries[1] = entry;
+    }
+
+    MtPackHeader header = {
+        .magic = MT_PACK_MAGIC,
+        .version = MT_PACK_VERSION,
+        .entry_count = 2,
+        .names_size = sizeof(names),
+    };
+
+    static uint8_t pack[3 * MT_PACK_ALIGNMENT];
+    memcpy(pack, &header, sizeof(header));
+    memcpy(pack + sizeof(header), entries, sizeof(entries));
+    memcpy(pack + sizeof(header) + sizeof(entries), names, sizeof(names));
+    memcpy(pack + MT_PACK_ALIGNMENT, stored, strlen(stored));
+    memcpy(pack + 2 * MT_PACK_ALIGNMENT, compressed, compressed_size);
+    size_t pack_size = 2 * MT_PACK_ALIGNMENT + compressed_size;
+
+    assert(mt_pack_header(pack, pack_size) != NULL);
+    assert(mt_pack_header(pack, pack_size - 1) == NULL);
+
+    write_file("vfs_test.mtpack", pack, pack_size);
+    write_file("vfs_test.txt", "loose file", 10);
+
+    MtVfs vfs;
+    mt_vfs_init(&vfs, NULL);
+    mt_vfs_mount_dir(&vfs, "dir", ".");
+    assert(mt_vfs_mount_pack(&vfs, "", "vfs_test.mtpack"));
+    assert(!mt_vfs_mount_pack(&vfs, "", "vfs_test.txt"));
+
+    MtVfsFile file;
+    assert(mt_vfs_open(&vfs, "dir/stored.txt", &file));
+    assert(file.size == strlen(stored) && memcmp(file.data, stored, file.size) == 0);
+    mt_vfs_close(&vfs, &file);
+
+    assert(mt_vfs_open(&vfs, "dir/compressed.txt", &file));
+    assert(file.size == sizeof(compressed_source));
+    assert(memcmp(file.data, compressed_source, file.size) == 0);
+    mt_vfs_close(&vfs, &file);
+
+    // Not in the pack, found in the directory mounted before it
+    assert(mt_vfs_open(&vfs, "dir/vfs_test.txt", &file));
+    assert(file.size == 10 && memcmp(file.data, "loose file", 10) == 0);
+    mt_vfs_close(&vfs, &file);
+
+    // Not under any mount point, opened as is
+    assert(mt_vfs_open(&vfs, "vfs_test.txt", &file));
+    mt_vfs_close(&vfs, &file);
+
+    assert(!mt_vfs_open(&vfs, "dir/missing.txt", &file));
+
+    MtVfsStat st;
+    assert(mt_vfs_stat(&vfs, "dir/stored.txt", &st) && st.mtime == 42);
+    assert(mt_vfs_stat(&vfs, "dir/vfs_test.txt", &st) && st.size == 10);
+    assert(!mt_vfs_stat(&vfs, "dir/missing.txt", &st));
+
+    assert(mt_vfs_needs_read(&vfs, "dir/compressed.txt"));
+    assert(!mt_vfs_needs_read(&vfs, "dir/stored.txt"));
+    assert(!mt_vfs_needs_read(&vfs, "dir/vfs_test.txt"));
+    assert(!mt_vfs_needs_read(&vfs, "vfs_test.txt"));
+
+    MtThreadPool pool;
+    mt_thread_pool_init(&pool, 2, NULL);
+    MtAsyncIo *io = mt_async_io_create(NULL, &pool);
+
+    const char *paths[] = {
+        "dir/stored.txt",
+        "dir/compressed.txt",
+        "dir/vfs_test.txt",
+        "vfs_test.txt",
+        "dir/missing.txt",
+    };
+    MtVfsFile expected[MT_LENGTH(paths)] = {
+        {.data = (const uint8_t *)stored, .size = strlen(stored)},
+        {.data = (const uint8_t *)compressed_source, .size = sizeof(compressed_source)},
+        {.data = (const uint8_t *)"loose file", .size = 10},
+        {.data = (const uint8_t *)"loose file", .size = 10},
+        {0},
+    };
+    MtVfsAsyncOpen opens[MT_LENGTH(paths)];
+    MtVfsAsyncOpen *open_ptrs[MT_LENGTH(paths)];
+    for (uint32_t i = 0; i < MT_LENGTH(paths); i++)
+    {
+        opens[i] = (MtVfsAsyncOpen){
+            .path = paths[i],
+            .continuation = open_done,
+            .user_data = &expected[i],
+        };
+        open_ptrs[i] = &opens[i];
+    }
+
+    MtTaskGroup group = {0};
+    mt_vfs_open_async(&vfs, io, open_ptrs, MT_LENGTH(paths), &group);
+    mt_thread_pool_wait_group(&pool, &group);
+
+    mt_async_io_destroy(io);
+    mt_thread_pool_destroy(&pool);
+
+    mt_vfs_destroy(&vfs);
+
+    remove("vfs_test.mtpack");
+    remove("vfs_test.txt");
+}
+
+int main()
+{
+    test_lz4();
+    test_async_io();
+    test_pack();
+
+    printf("Success\n");
+
+    return 0;
+}
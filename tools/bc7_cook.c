@@ -0,0 +1,504 @@
+#include "bc7_cook.h"
+
+#include "bc7enc16.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <motor/base/api_types.h>
+#include <motor/base/buffer_writer.h>
+#include <motor/base/hashmap.h>
+#include <motor/base/math_types.h>
+#include <motor/base/thread_pool.h>
+#include <motor/base/time.h>
+
+#define KTX_UNSIGNED_BYTE 0x1401
+#define KTX_RGBA 0x1908
+#define KTX_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+
+// Block rows compressed by one task
+#define BAND_BLOCK_ROWS 8
+// Pixel rows filtered by one task
+#define BAND_ROWS 32
+
+#define KAISER_WIDTH 3.0f
+#define KAISER_ALPHA 4.0f
+// Source pixels under the kernel when halving
+#define KAISER_TAPS 12
+
+// Bump when the output changes for the same source and options
+#define COOK_VERSION 1
+
+static const char hash_key[] = "MtSourceHash";
+
+static const uint8_t ktx_identifier[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+typedef struct ktx_header_t
+{
+    uint8_t identifier[12];
+    uint32_t endianness;
+    uint32_t gl_type;
+    uint32_t gl_type_size;
+    uint32_t gl_format;
+    uint32_t gl_internal_format;
+    uint32_t gl_base_internal_format;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t number_of_array_elements;
+    uint32_t number_of_faces;
+    uint32_t number_of_mipmap_levels;
+    uint32_t bytes_of_key_value_data;
+} ktx_header_t;
+
+// Key and value of the source hash, padded to 4 bytes
+typedef struct KtxHashEntry
+{
+    uint32_t key_and_value_byte_size;
+    char key[sizeof(hash_key)];
+    uint8_t value[sizeof(uint64_t)];
+    uint8_t padding[3];
+} KtxHashEntry;
+
+typedef struct CompressBand
+{
+    const bc7enc16_compress_block_params *params;
+    const uint8_t *pixels;
+    uint32_t width;
+    uint32_t block_row_begin;
+    uint32_t block_row_end;
+    uint8_t *blocks;
+} CompressBand;
+
+typedef struct FilterBand
+{
+    const void *src;
+    void *dst;
+    uint32_t src_width;
+    uint32_t src_height;
+    // Output rows
+    uint32_t row_begin;
+    uint32_t row_end;
+} FilterBand;
+
+static float g_kaiser_weights[KAISER_TAPS];
+
+static float bessel_i0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (uint32_t k = 1; k < 32; k++)
+    {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static float kaiser(float t)
+{
+    float x = t / KAISER_WIDTH;
+    if (fabsf(x) >= 1.0f) return 0.0f;
+    return bessel_i0(KAISER_ALPHA * sqrtf(1.0f - x * x)) / bessel_i0(KAISER_ALPHA);
+}
+
+static float sinc(float t)
+{
+    if (fabsf(t) < 1e-6f) return 1.0f;
+    return sinf(MT_PI * t) / (MT_PI * t);
+}
+
+void bc7_cook_init(void)
+{
+    bc7enc16_compress_block_init();
+
+    // Halving puts every output pixel at the same phase, between source pixels
+    float sum = 0.0f;
+    for (int32_t i = 0; i < KAISER_TAPS; i++)
+    {
+        float t = ((float)(i - KAISER_TAPS / 2) + 0.5f) / 2.0f;
+        g_kaiser_weights[i] = sinc(t) * kaiser(t);
+        sum += g_kaiser_weights[i];
+    }
+    for (int32_t i = 0; i < KAISER_TAPS; i++)
+    {
+        g_kaiser_weights[i] /= sum;
+    }
+}
+
+int bc7_cook_parse_options(Bc7CookOptions *options, int argc, const char *argv[])
+{
+    *options = (Bc7CookOptions){.mips = true, .filter = BC7_MIP_FILTER_BOX};
+
+    int i = 1;
+    for (; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--no-mips") == 0)
+        {
+            options->mips = false;
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "box") == 0)
+            {
+                options->filter = BC7_MIP_FILTER_BOX;
+            }
+            else if (strcmp(argv[i], "kaiser") == 0)
+            {
+                options->filter = BC7_MIP_FILTER_KAISER;
+            }
+            else
+            {
+                printf("Unknown mip filter: %s\n", argv[i]);
+                exit(1);
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+uint64_t bc7_cook_hash(const Bc7CookOptions *options, const uint8_t *source, size_t source_size)
+{
+    struct
+    {
+        uint64_t source;
+        uint32_t mips;
+        uint32_t filter;
+        uint32_t version;
+        uint32_t pad;
+    } key;
+    memset(&key, 0, sizeof(key));
+
+    key.source = mt_hash_strn((const char *)source, source_size);
+    key.mips = options->mips;
+    key.filter = (uint32_t)options->filter;
+    key.version = COOK_VERSION;
+
+    return mt_hash_strn((const char *)&key, sizeof(key));
+}
+
+bool bc7_cook_ktx_hash(const uint8_t *ktx, size_t ktx_size, uint64_t *hash)
+{
+    ktx_header_t header;
+    if (ktx_size < sizeof(header)) return false;
+    memcpy(&header, ktx, sizeof(header));
+
+    if (memcmp(header.identifier, ktx_identifier, sizeof(ktx_identifier)) != 0 ||
+        ktx_size - sizeof(header) < header.bytes_of_key_value_data)
+    {
+        return false;
+    }
+
+    const uint8_t *kv = ktx + sizeof(header);
+    uint32_t pos = 0;
+    while (header.bytes_of_key_value_data - pos >= sizeof(uint32_t))
+    {
+        uint32_t size;
+        memcpy(&size, kv + pos, sizeof(size));
+        pos += sizeof(size);
+        if (header.bytes_of_key_value_data - pos < size) return false;
+
+        if (size == sizeof(hash_key) + sizeof(uint64_t) &&
+            memcmp(kv + pos, hash_key, sizeof(hash_key)) == 0)
+        {
+            memcpy(hash, kv + pos + sizeof(hash_key), sizeof(*hash));
+            return true;
+        }
+
+        pos += (size + 3) & ~3u;
+    }
+
+    return false;
+}
+
+static int32_t compress_band(void *arg)
+{
+    CompressBand *band = arg;
+    uint32_t blocks_x = band->width / 4;
+
+    for (uint32_t by = band->block_row_begin; by < band->block_row_end; by++)
+    {
+        for (uint32_t bx = 0; bx < blocks_x; bx++)
+        {
+            uint8_t pixels[16 * 4];
+            for (uint32_t row = 0; row < 4; row++)
+            {
+                memcpy(
+                    &pixels[row * 16],
+                    &band->pixels[((size_t)(by * 4 + row) * band->width + bx * 4) * 4],
+                    16);
+            }
+
+            bc7enc16_compress_block(
+                &band->blocks[((size_t)by * blocks_x + bx) * 16], pixels, band->params);
+        }
+    }
+
+    return 0;
+}
+
+// Averages 2x2 squares
+static int32_t box_band(void *arg)
+{
+    FilterBand *band = arg;
+    const uint8_t *src = band->src;
+    uint8_t *dst = band->dst;
+    uint32_t dst_width = band->src_width / 2;
+
+    for (uint32_t y = band->row_begin; y < band->row_end; y++)
+    {
+        const uint8_t *row0 = &src[(size_t)(y * 2 + 0) * band->src_width * 4];
+        const uint8_t *row1 = &src[(size_t)(y * 2 + 1) * band->src_width * 4];
+        uint8_t *out = &dst[(size_t)y * dst_width * 4];
+
+        for (uint32_t x = 0; x < dst_width * 4; x++)
+        {
+            uint32_t c = x % 4;
+            uint32_t i = (x - c) * 2 + c;
+            out[x] = (uint8_t)((row0[i] + row0[i + 4] + row1[i] + row1[i + 4] + 2) / 4);
+        }
+    }
+
+    return 0;
+}
+
+// Halves the width, from 8 bit to float rows
+static int32_t kaiser_horizontal_band(void *arg)
+{
+    FilterBand *band = arg;
+    const uint8_t *src = band->src;
+    float *dst = band->dst;
+    uint32_t dst_width = band->src_width / 2;
+
+    for (uint32_t y = band->row_begin; y < band->row_end; y++)
+    {
+        const uint8_t *row = &src[(size_t)y * band->src_width * 4];
+        float *out = &dst[(size_t)y * dst_width * 4];
+
+        for (uint32_t x = 0; x < dst_width; x++)
+        {
+            float sum[4] = {0};
+            for (int32_t t = 0; t < KAISER_TAPS; t++)
+            {
+                int32_t sx = (int32_t)(x * 2) + t - KAISER_TAPS / 2 + 1;
+                sx = MT_MIN(MT_MAX(sx, 0), (int32_t)band->src_width - 1);
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    sum[c] += g_kaiser_weights[t] * row[sx * 4 + c];
+                }
+            }
+            memcpy(&out[x * 4], sum, sizeof(sum));
+        }
+    }
+
+    return 0;
+}
+
+// Halves the height of the horizontal pass, back to 8 bit
+static int32_t kaiser_vertical_band(void *arg)
+{
+    FilterBand *band = arg;
+    const float *src = band->src;
+    uint8_t *dst = band->dst;
+    uint32_t width = band->src_width / 2;
+
+    for (uint32_t y = band->row_begin; y < band->row_end; y++)
+    {
+        for (uint32_t x = 0; x < width * 4; x++)
+        {
+            float sum = 0.0f;
+            for (int32_t t = 0; t < KAISER_TAPS; t++)
+            {
+                int32_t sy = (int32_t)(y * 2) + t - KAISER_TAPS / 2 + 1;
+                sy = MT_MIN(MT_MAX(sy, 0), (int32_t)band->src_height - 1);
+                sum += g_kaiser_weights[t] * src[(size_t)sy * width * 4 + x];
+            }
+            dst[(size_t)y * width * 4 + x] = (uint8_t)MT_MIN(MT_MAX(sum + 0.5f, 0.0f), 255.0f);
+        }
+    }
+
+    return 0;
+}
+
+static void run_filter_bands(
+    MtThreadPool *pool,
+    MtThreadStart routine,
+    const void *src,
+    void *dst,
+    uint32_t src_width,
+    uint32_t src_height,
+    uint32_t rows)
+{
+    uint32_t band_count = (rows + BAND_ROWS - 1) / BAND_ROWS;
+    FilterBand *bands = malloc(sizeof(*bands) * band_count);
+
+    MtTaskGroup group = {0};
+    for (uint32_t i = 0; i < band_count; i++)
+    {
+        bands[i] = (FilterBand){
+            .src = src,
+            .dst = dst,
+            .src_width = src_width,
+            .src_height = src_height,
+            .row_begin = i * BAND_ROWS,
+            .row_end = MT_MIN((i + 1) * BAND_ROWS, rows),
+        };
+        mt_thread_pool_enqueue_group(pool, &group, routine, &bands[i]);
+    }
+    mt_thread_pool_wait_group(pool, &group);
+
+    free(bands);
+}
+
+static uint8_t *downsample(
+    MtThreadPool *pool,
+    const Bc7CookOptions *options,
+    const uint8_t *pixels,
+    uint32_t width,
+    uint32_t height)
+{
+    uint8_t *result = malloc((size_t)(width / 2) * (height / 2) * 4);
+
+    switch (options->filter)
+    {
+        case BC7_MIP_FILTER_BOX: {
+            run_filter_bands(pool, box_band, pixels, result, width, height, height / 2);
+            break;
+        }
+        case BC7_MIP_FILTER_KAISER: {
+            float *tmp = malloc(sizeof(float) * (width / 2) * height * 4);
+            run_filter_bands(pool, kaiser_horizontal_band, pixels, tmp, width, height, height);
+            run_filter_bands(pool, kaiser_vertical_band, tmp, result, width, height, height / 2);
+            free(tmp);
+            break;
+        }
+    }
+
+    return result;
+}
+
+static void compress_level(
+    MtThreadPool *pool,
+    MtBufferWriter *bw,
+    const bc7enc16_compress_block_params *params,
+    const uint8_t *pixels,
+    uint32_t width,
+    uint32_t height)
+{
+    uint32_t blocks_y = height / 4;
+    uint32_t level_size = (width / 4) * blocks_y * 16;
+    uint8_t *blocks = malloc(level_size);
+
+    uint32_t band_count = (blocks_y + BAND_BLOCK_ROWS - 1) / BAND_BLOCK_ROWS;
+    CompressBand *bands = malloc(sizeof(*bands) * band_count);
+
+    MtTaskGroup group = {0};
+    for (uint32_t i = 0; i < band_count; i++)
+    {
+        bands[i] = (CompressBand){
+            .params = params,
+            .pixels = pixels,
+            .width = width,
+            .block_row_begin = i * BAND_BLOCK_ROWS,
+            .block_row_end = MT_MIN((i + 1) * BAND_BLOCK_ROWS, blocks_y),
+            .blocks = blocks,
+        };
+        mt_thread_pool_enqueue_group(pool, &group, compress_band, &bands[i]);
+    }
+    mt_thread_pool_wait_group(pool, &group);
+
+    // BC7 levels are multiples of 16 bytes, they need no padding
+    mt_buffer_writer_append(bw, &level_size, sizeof(level_size));
+    mt_buffer_writer_append(bw, blocks, level_size);
+
+    free(bands);
+    free(blocks);
+}
+
+void bc7_cook_ktx(
+    MtThreadPool *pool,
+    MtBufferWriter *bw,
+    const Bc7CookOptions *options,
+    uint64_t hash,
+    const uint8_t *pixels,
+    uint32_t width,
+    uint32_t height,
+    Bc7CookStats *stats)
+{
+    assert(width % 4 == 0);
+    assert(height % 4 == 0);
+
+    uint64_t start = mt_time_ns();
+
+    uint32_t mip_count = 1;
+    while (options->mips && width % (4u << mip_count) == 0 && height % (4u << mip_count) == 0)
+    {
+        mip_count++;
+    }
+
+    bc7enc16_compress_block_params params = {0};
+    bc7enc16_compress_block_params_init(&params);
+    bc7enc16_compress_block_params_init_linear_weights(&params);
+    params.m_max_partitions_mode1 = BC7ENC16_MAX_PARTITIONS1;
+    params.m_uber_level = 0;
+
+    KtxHashEntry hash_entry = {
+        .key_and_value_byte_size = sizeof(hash_key) + sizeof(uint64_t),
+    };
+    memcpy(hash_entry.key, hash_key, sizeof(hash_key));
+    memcpy(hash_entry.value, &hash, sizeof(hash));
+
+    ktx_header_t header = {0};
+    memcpy(&header.identifier, ktx_identifier, sizeof(ktx_identifier));
+    header.endianness = 0x04030201;
+    header.gl_type = KTX_UNSIGNED_BYTE;
+    header.gl_type_size = 1;
+    header.gl_format = KTX_RGBA;
+    header.gl_base_internal_format = header.gl_format;
+    header.gl_internal_format = KTX_COMPRESSED_RGBA_BPTC_UNORM;
+    header.pixel_width = width;
+    header.pixel_height = height;
+    header.pixel_depth = 1;
+    header.number_of_array_elements = 1;
+    header.number_of_faces = 1;
+    header.number_of_mipmap_levels = mip_count;
+    header.bytes_of_key_value_data = sizeof(hash_entry);
+
+    mt_buffer_writer_append(bw, &header, sizeof(header));
+    mt_buffer_writer_append(bw, &hash_entry, sizeof(hash_entry));
+
+    const uint8_t *level = pixels;
+    uint8_t *owned_level = NULL;
+    for (uint32_t mip = 0; mip < mip_count; mip++)
+    {
+        if (mip > 0)
+        {
+            uint8_t *next = downsample(pool, options, level, width, height);
+            free(owned_level);
+            level = owned_level = next;
+            width /= 2;
+            height /= 2;
+        }
+
+        compress_level(pool, bw, &params, level, width, height);
+        stats->pixels += (uint64_t)width * height;
+    }
+    free(owned_level);
+
+    stats->time_ns += mt_time_ns() - start;
+}
+
+double bc7_cook_throughput(const Bc7CookStats *stats)
+{
+    if (stats->time_ns == 0) return 0.0;
+    return ((double)stats->pixels / 1e6) / ((double)stats->time_ns / 1e9);
+}
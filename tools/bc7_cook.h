@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct MtThreadPool MtThreadPool;
+typedef struct MtBufferWriter MtBufferWriter;
+
+// Shared by the texture tools: BC7 compression of RGBA8 images into KTX files, split into
+// bands of block rows compressed on a thread pool
+
+typedef enum Bc7MipFilter {
+    BC7_MIP_FILTER_BOX,
+    // Kaiser windowed sinc, sharper than the box filter
+    BC7_MIP_FILTER_KAISER,
+} Bc7MipFilter;
+
+typedef struct Bc7CookOptions
+{
+    bool mips;
+    Bc7MipFilter filter;
+} Bc7CookOptions;
+
+typedef struct Bc7CookStats
+{
+    uint64_t pixels;
+    uint64_t time_ns;
+} Bc7CookStats;
+
+void bc7_cook_init(void);
+
+// Parses --no-mips and --filter box|kaiser, returns the index of the first other argument
+int bc7_cook_parse_options(Bc7CookOptions *options, int argc, const char *argv[]);
+
+// Identifies the result of cooking source with options, stored in the KTX it produces
+uint64_t bc7_cook_hash(const Bc7CookOptions *options, const uint8_t *source, size_t source_size);
+
+// Returns false if ktx was not cooked by these tools
+bool bc7_cook_ktx_hash(const uint8_t *ktx, size_t ktx_size, uint64_t *hash);
+
+// Appends a KTX file to bw, width and height have to be multiples of 4.
+// Mips go down while both dimensions stay multiples of 4.
+void bc7_cook_ktx(
+    MtThreadPool *pool,
+    MtBufferWriter *bw,
+    const Bc7CookOptions *options,
+    uint64_t hash,
+    const uint8_t *pixels,
+    uint32_t width,
+    uint32_t height,
+    Bc7CookStats *stats);
+
+// Megapixels per second
+double bc7_cook_throughput(const Bc7CookStats *stats);
@@ -4,33 +4,26 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#include "bc7enc16.h"
+#include "bc7_cook.h"
 
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <motor/base/api_types.h>
+#include <motor/base/allocator.h>
 #include <motor/base/buffer_writer.h>
 #include <motor/base/array.h>
+#include <motor/base/threads.h>
+#include <motor/base/thread_pool.h>
 
-#define KTX_UNSIGNED_BYTE 0x1401
-#define KTX_RGBA 0x1908
-
-#define KTX_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
-#define KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
-#define KTX_COMPRESSED_RGB_BPTC_SIGNED_FLOAT 0x8E8E
-#define KTX_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT 0x8E8F
-
-typedef struct BC7Block
-{
-    uint8_t vals[16];
-} BC7Block;
-
-typedef struct ColorQuadU8
+// KTX image of a previous output, reused when its source did not change
+typedef struct CookedImage
 {
-    uint8_t vals[4];
-} ColorQuadU8;
+    uint64_t hash;
+    const uint8_t *data;
+    size_t size;
+} CookedImage;
 
 static void buffer_writer_pad(MtBufferWriter *bw)
 {
@@ -38,39 +31,56 @@ static void buffer_writer_pad(MtBufferWriter *bw)
     mt_buffer_writer_append(bw, &zero, 4 - (bw->length % 4));
 }
 
-const static uint8_t ktx_identifier[12] = {
-    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
-
-typedef struct ktx_header_t
+static cgltf_data *load_cooked_images(const char *path, CookedImage **images)
 {
-    uint8_t identifier[12];
-    uint32_t endianness;
-    uint32_t gl_type;
-    uint32_t gl_type_size;
-    uint32_t gl_format;
-    uint32_t gl_internal_format;
-    uint32_t gl_base_internal_format;
-    uint32_t pixel_width;
-    uint32_t pixel_height;
-    uint32_t pixel_depth;
-    uint32_t number_of_array_elements;
-    uint32_t number_of_faces;
-    uint32_t number_of_mipmap_levels;
-    uint32_t bytes_of_key_value_data;
-} ktx_header_t;
+    cgltf_options gltf_options = {0};
+    cgltf_data *data = NULL;
+    if (cgltf_parse_file(&gltf_options, path, &data) != cgltf_result_success)
+    {
+        return NULL;
+    }
+
+    if (cgltf_load_buffers(&gltf_options, data, path) != cgltf_result_success)
+    {
+        cgltf_free(data);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < data->images_count; i++)
+    {
+        cgltf_image *image = &data->images[i];
+        if (!image->buffer_view || !image->mime_type || strcmp(image->mime_type, "image/ktx") != 0)
+        {
+            continue;
+        }
+
+        CookedImage cooked = {
+            .data = ((uint8_t *)image->buffer_view->buffer->data) + image->buffer_view->offset,
+            .size = image->buffer_view->size,
+        };
+        if (bc7_cook_ktx_hash(cooked.data, cooked.size, &cooked.hash))
+        {
+            mt_array_push(NULL, *images, cooked);
+        }
+    }
+
+    return data;
+}
 
 int main(int argc, const char *argv[])
 {
-    if (argc <= 2)
+    Bc7CookOptions options;
+    int first_arg = bc7_cook_parse_options(&options, argc, argv);
+    if (argc - first_arg < 2)
     {
-        printf("Usage: %s <file> <output>\n", argv[0]);
+        printf("Usage: %s [--no-mips] [--filter box|kaiser] <file> <output>\n", argv[0]);
         exit(0);
     }
 
-    const char *gltf_path = argv[1];
-    const char *out_path = argv[2];
+    const char *gltf_path = argv[first_arg];
+    const char *out_path = argv[first_arg + 1];
 
-    bc7enc16_compress_block_init();
+    bc7_cook_init();
 
     cgltf_options gltf_options = {0};
     cgltf_data *data = NULL;
@@ -89,11 +99,20 @@ int main(int argc, const char *argv[])
         exit(1);
     }
 
+    /*array*/ CookedImage *cooked_images = NULL;
+    cgltf_data *previous = load_cooked_images(out_path, &cooked_images);
+
+    MtThreadPool pool;
+    mt_thread_pool_init(&pool, mt_cpu_count(), NULL);
+
     MtBufferWriter bw = {0};
     mt_buffer_writer_init(&bw, NULL);
 
     cgltf_buffer_view **visited_buffer_views = NULL;
 
+    Bc7CookStats total_stats = {0};
+    uint32_t reused_count = 0;
+
     for (uint32_t i = 0; i < data->images_count; i++)
     {
         cgltf_image *image = &data->images[i];
@@ -105,96 +124,64 @@ int main(int argc, const char *argv[])
             uint8_t *buffer_data = ((uint8_t *)buffer_view->buffer->data) + buffer_view->offset;
             size_t buffer_size = buffer_view->size;
 
-            int width, height, n_channels;
-            ColorQuadU8 *image_pixels = (ColorQuadU8 *)stbi_load_from_memory(
-                buffer_data, (int)buffer_size, &width, &height, &n_channels, 4);
-            if (!image_pixels)
-            {
-                printf("Failed to load image\n");
-                exit(1);
-            }
-
-            assert(width % 4 == 0);
-            assert(height % 4 == 0);
-
-            uint32_t blocks_x = (uint32_t)width >> 2;
-            uint32_t blocks_y = (uint32_t)height >> 2;
-
-            BC7Block *packed_image = NULL;
-            mt_array_add(NULL, packed_image, blocks_x * blocks_y);
-
-            bool srgb = false;
-
-            bc7enc16_compress_block_params pack_params = {0};
-            bc7enc16_compress_block_params_init(&pack_params);
-            if (!srgb) bc7enc16_compress_block_params_init_linear_weights(&pack_params);
-            pack_params.m_max_partitions_mode1 = BC7ENC16_MAX_PARTITIONS1;
-            pack_params.m_uber_level = 0;
+            uint64_t hash = bc7_cook_hash(&options, buffer_data, buffer_size);
+            uint64_t offset = bw.length;
 
-            for (uint32_t by = 0; by < blocks_y; by++)
+            const CookedImage *cooked = NULL;
+            for (uint32_t j = 0; j < mt_array_size(cooked_images); j++)
             {
-                for (uint32_t bx = 0; bx < blocks_x; bx++)
+                if (cooked_images[j].hash == hash)
                 {
-                    ColorQuadU8 pixels[16];
-
-                    memcpy(
-                        pixels + 0,
-                        &image_pixels[bx * 4 + (uint32_t)width * (by * 4 + 0)],
-                        sizeof(ColorQuadU8) * 4);
-                    memcpy(
-                        pixels + 4,
-                        &image_pixels[bx * 4 + (uint32_t)width * (by * 4 + 1)],
-                        sizeof(ColorQuadU8) * 4);
-                    memcpy(
-                        pixels + 8,
-                        &image_pixels[bx * 4 + (uint32_t)width * (by * 4 + 2)],
-                        sizeof(ColorQuadU8) * 4);
-                    memcpy(
-                        pixels + 12,
-                        &image_pixels[bx * 4 + (uint32_t)width * (by * 4 + 3)],
-                        sizeof(ColorQuadU8) * 4);
-
-                    BC7Block *block = &packed_image[bx + by * blocks_x];
-
-                    bc7enc16_compress_block(block, pixels, &pack_params);
+                    cooked = &cooked_images[j];
+                    break;
                 }
             }
 
-            uint64_t offset = bw.length;
-
-            ktx_header_t header = {0};
-            memcpy(&header.identifier, ktx_identifier, sizeof(ktx_identifier));
-            header.endianness = 0x04030201;
-
-            header.gl_type = KTX_UNSIGNED_BYTE;
-            header.gl_type_size = 1;
-
-            header.gl_format = KTX_RGBA;
-            header.gl_base_internal_format = header.gl_format;
-            if (srgb)
+            if (cooked)
             {
-                header.gl_internal_format = KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+                mt_buffer_writer_append(&bw, cooked->data, cooked->size);
+                reused_count++;
             }
             else
             {
-                header.gl_internal_format = KTX_COMPRESSED_RGBA_BPTC_UNORM;
-            }
-
-            header.pixel_width = (uint32_t)width;
-            header.pixel_height = (uint32_t)height;
-            header.pixel_depth = 1;
-
-            header.number_of_array_elements = 1;
-            header.number_of_faces = 1;
-            header.number_of_mipmap_levels = 1;
-            header.bytes_of_key_value_data = 0;
-
-            mt_buffer_writer_append(&bw, &header, sizeof(header));
+                int width, height, n_channels;
+                uint8_t *image_pixels = stbi_load_from_memory(
+                    buffer_data, (int)buffer_size, &width, &height, &n_channels, 4);
+                if (!image_pixels)
+                {
+                    printf("Failed to load image\n");
+                    exit(1);
+                }
 
-            uint32_t image_size = mt_array_size(packed_image) * sizeof(*packed_image);
-            mt_buffer_writer_append(&bw, &image_size, sizeof(image_size));
+                if (width % 4 != 0 || height % 4 != 0)
+                {
+                    printf("Image size has to be a multiple of 4: %dx%d\n", width, height);
+                    exit(1);
+                }
 
-            mt_buffer_writer_append(&bw, packed_image, (uint64_t)image_size);
+                Bc7CookStats stats = {0};
+                bc7_cook_ktx(
+                    &pool,
+                    &bw,
+                    &options,
+                    hash,
+                    image_pixels,
+                    (uint32_t)width,
+                    (uint32_t)height,
+                    &stats);
+
+                printf(
+                    "Image %u: %dx%d, %.2f MP/s\n",
+                    i,
+                    width,
+                    height,
+                    bc7_cook_throughput(&stats));
+
+                total_stats.pixels += stats.pixels;
+                total_stats.time_ns += stats.time_ns;
+
+                free(image_pixels);
+            }
 
             buffer_writer_pad(&bw);
 
@@ -205,8 +192,6 @@ int main(int argc, const char *argv[])
             mt_array_push(NULL, visited_buffer_views, buffer_view);
 
             image->mime_type = "image/ktx";
-
-            free(image_pixels);
         }
         else
         {
@@ -215,6 +200,15 @@ int main(int argc, const char *argv[])
         }
     }
 
+    printf(
+        "Compressed %u images, reused %u: %.2f MP at %.2f MP/s\n",
+        (uint32_t)data->images_count - reused_count,
+        reused_count,
+        (double)total_stats.pixels / 1e6,
+        bc7_cook_throughput(&total_stats));
+
+    mt_thread_pool_destroy(&pool);
+
     for (uint32_t i = 0; i < data->buffer_views_count; i++)
     {
         bool visited = false;
@@ -304,5 +298,8 @@ int main(int argc, const char *argv[])
 
     fclose(f);
 
+    if (previous) cgltf_free(previous);
+    mt_array_free(NULL, cooked_images);
+
     return 0;
 }
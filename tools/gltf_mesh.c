@@ -0,0 +1,300 @@
+#define CGLTF_IMPLEMENTATION
+#include "cgltf.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <motor/base/api_types.h>
+#include <motor/base/math.h>
+#include <motor/base/allocator.h>
+#include <motor/base/array.h>
+#include <motor/base/buffer_writer.h>
+#include <motor/engine/api_types.h>
+#include <motor/engine/mesh_format.h>
+
+typedef struct Cooker
+{
+    cgltf_data *data;
+
+    /*array*/ MtMeshFileMesh *meshes;
+    /*array*/ MtMeshFilePrimitive *primitives;
+    /*array*/ MtStandardVertex *vertices;
+    /*array*/ uint32_t *indices;
+} Cooker;
+
+// Same as the glTF loader: node matrix, then scale, rotation and translation
+static Mat4 node_local_matrix(cgltf_node *node)
+{
+    Mat4 matrix = mat4_identity();
+    Vec3 translation = V3(0.0f, 0.0f, 0.0f);
+    Quat rotation = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    Vec3 scale = V3(1.0f, 1.0f, 1.0f);
+
+    if (node->has_translation) memcpy(&translation, node->translation, sizeof(Vec3));
+    if (node->has_rotation) memcpy(&rotation, node->rotation, sizeof(Quat));
+    if (node->has_scale) memcpy(&scale, node->scale, sizeof(Vec3));
+    if (node->has_matrix) memcpy(&matrix, node->matrix, sizeof(Mat4));
+
+    Mat4 result = mat4_identity();
+    result = mat4_mul(matrix, result);
+    result = mat4_scale(result, scale);
+    result = mat4_mul(quat_to_mat4(rotation), result);
+    result = mat4_translate(result, translation);
+    return result;
+}
+
+static uint8_t *accessor_data(cgltf_accessor *accessor)
+{
+    cgltf_buffer_view *view = accessor->buffer_view;
+    return &((uint8_t *)view->buffer->data)[accessor->offset + view->offset];
+}
+
+static void cook_primitive(Cooker *c, cgltf_primitive *primitive)
+{
+    cgltf_accessor *pos_accessor = NULL;
+    cgltf_accessor *normal_accessor = NULL;
+    cgltf_accessor *tangent_accessor = NULL;
+    cgltf_accessor *uv0_accessor = NULL;
+
+    for (uint32_t i = 0; i < primitive->attributes_count; i++)
+    {
+        cgltf_attribute *attribute = &primitive->attributes[i];
+        switch (attribute->type)
+        {
+            case cgltf_attribute_type_position: pos_accessor = attribute->data; break;
+            case cgltf_attribute_type_normal: normal_accessor = attribute->data; break;
+            case cgltf_attribute_type_tangent: tangent_accessor = attribute->data; break;
+            case cgltf_attribute_type_texcoord: uv0_accessor = attribute->data; break;
+            default: break;
+        }
+    }
+
+    if (!pos_accessor)
+    {
+        printf("Primitive without positions\n");
+        exit(1);
+    }
+
+    uint32_t vertex_start = (uint32_t)mt_array_size(c->vertices);
+    uint32_t vertex_count = (uint32_t)pos_accessor->count;
+
+    MtMeshFilePrimitive new_primitive = {0};
+    new_primitive.first_index = (uint32_t)mt_array_size(c->indices);
+    new_primitive.vertex_count = vertex_count;
+    new_primitive.normal_mapped = normal_accessor != NULL && tangent_accessor != NULL;
+    new_primitive.material_index = UINT32_MAX;
+    if (primitive->material)
+    {
+        new_primitive.material_index = (uint32_t)(primitive->material - c->data->materials);
+    }
+
+    mt_array_add_zeroed(NULL, c->vertices, vertex_count);
+    MtStandardVertex *vertices = &c->vertices[vertex_start];
+
+    // Interleave the attributes into the runtime vertex layout
+    for (uint32_t v = 0; v < vertex_count; v++)
+    {
+        memcpy(
+            &vertices[v].pos,
+            accessor_data(pos_accessor) + v * pos_accessor->stride,
+            sizeof(vertices[v].pos));
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            float p = vertices[v].pos.v[k];
+            if (v == 0 || p < new_primitive.bounds_min[k]) new_primitive.bounds_min[k] = p;
+            if (v == 0 || p > new_primitive.bounds_max[k]) new_primitive.bounds_max[k] = p;
+        }
+
+        if (normal_accessor)
+        {
+            memcpy(
+                &vertices[v].normal,
+                accessor_data(normal_accessor) + v * normal_accessor->stride,
+                sizeof(vertices[v].normal));
+        }
+        if (tangent_accessor)
+        {
+            memcpy(
+                &vertices[v].tangent,
+                accessor_data(tangent_accessor) + v * tangent_accessor->stride,
+                sizeof(vertices[v].tangent));
+        }
+        if (uv0_accessor)
+        {
+            memcpy(
+                &vertices[v].uv0,
+                accessor_data(uv0_accessor) + v * uv0_accessor->stride,
+                sizeof(vertices[v].uv0));
+        }
+    }
+
+    // Indices are widened to uint32 and offset to the start of the file's vertices
+    if (primitive->indices)
+    {
+        cgltf_accessor *accessor = primitive->indices;
+        new_primitive.index_count = (uint32_t)accessor->count;
+
+        mt_array_add(NULL, c->indices, new_primitive.index_count);
+        uint32_t *indices = &c->indices[new_primitive.first_index];
+        const uint8_t *data = accessor_data(accessor);
+        for (uint32_t i = 0; i < new_primitive.index_count; i++)
+        {
+            switch (accessor->component_type)
+            {
+                case cgltf_component_type_r_32u:
+                    indices[i] = ((const uint32_t *)data)[i] + vertex_start;
+                    break;
+                case cgltf_component_type_r_16u:
+                    indices[i] = (uint32_t)((const uint16_t *)data)[i] + vertex_start;
+                    break;
+                case cgltf_component_type_r_8u:
+                    indices[i] = (uint32_t)data[i] + vertex_start;
+                    break;
+                default: {
+                    printf("Invalid index component type\n");
+                    exit(1);
+                }
+            }
+        }
+    }
+    else
+    {
+        new_primitive.index_count = vertex_count;
+
+        mt_array_add(NULL, c->indices, vertex_count);
+        uint32_t *indices = &c->indices[new_primitive.first_index];
+        for (uint32_t i = 0; i < vertex_count; i++)
+        {
+            indices[i] = vertex_start + i;
+        }
+    }
+
+    mt_array_push(NULL, c->primitives, new_primitive);
+}
+
+// Children come before their parent, like the glTF loader's node list
+static void cook_node(Cooker *c, cgltf_node *node, Mat4 parent_matrix)
+{
+    Mat4 matrix = mat4_mul(node_local_matrix(node), parent_matrix);
+
+    for (uint32_t i = 0; i < node->children_count; i++)
+    {
+        cook_node(c, node->children[i], matrix);
+    }
+
+    if (!node->mesh) return;
+
+    MtMeshFileMesh mesh = {0};
+    memcpy(mesh.matrix, &matrix, sizeof(mesh.matrix));
+    mesh.first_primitive = (uint32_t)mt_array_size(c->primitives);
+    mesh.primitive_count = (uint32_t)node->mesh->primitives_count;
+
+    for (uint32_t i = 0; i < node->mesh->primitives_count; i++)
+    {
+        cook_primitive(c, &node->mesh->primitives[i]);
+    }
+
+    mt_array_push(NULL, c->meshes, mesh);
+}
+
+static void buffer_writer_align(MtBufferWriter *bw, size_t alignment)
+{
+    static const uint8_t zeros[MT_MESH_FILE_ALIGNMENT] = {0};
+    size_t padding = (alignment - (bw->length % alignment)) % alignment;
+    mt_buffer_writer_append(bw, zeros, padding);
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc <= 2)
+    {
+        printf("Usage: %s <file.glb> <output.mtmesh>\n", argv[0]);
+        exit(0);
+    }
+
+    const char *gltf_path = argv[1];
+    const char *out_path = argv[2];
+
+    cgltf_options gltf_options = {0};
+    cgltf_data *data = NULL;
+    cgltf_result result = cgltf_parse_file(&gltf_options, gltf_path, &data);
+    if (result != cgltf_result_success)
+    {
+        printf("Failed to parse GLTF\n");
+        exit(1);
+    }
+
+    result = cgltf_load_buffers(&gltf_options, data, gltf_path);
+    if (result != cgltf_result_success)
+    {
+        printf("Failed to load GLTF buffers\n");
+        exit(1);
+    }
+
+    Cooker c = {.data = data};
+
+    cgltf_scene *scene = data->scene ? data->scene : &data->scenes[0];
+    for (uint32_t i = 0; i < scene->nodes_count; i++)
+    {
+        cook_node(&c, scene->nodes[i], mat4_identity());
+    }
+
+    MtMeshFileHeader header = {
+        .magic = MT_MESH_FILE_MAGIC,
+        .version = MT_MESH_FILE_VERSION,
+        .vertex_stride = sizeof(MtStandardVertex),
+        .mesh_count = (uint32_t)mt_array_size(c.meshes),
+        .primitive_count = (uint32_t)mt_array_size(c.primitives),
+        .vertex_count = (uint32_t)mt_array_size(c.vertices),
+        .index_count = (uint32_t)mt_array_size(c.indices),
+    };
+
+    MtBufferWriter bw = {0};
+    mt_buffer_writer_init(&bw, NULL);
+
+    mt_buffer_writer_append(&bw, &header, sizeof(header));
+    mt_buffer_writer_append(&bw, c.meshes, sizeof(*c.meshes) * header.mesh_count);
+    mt_buffer_writer_append(&bw, c.primitives, sizeof(*c.primitives) * header.primitive_count);
+
+    buffer_writer_align(&bw, MT_MESH_FILE_ALIGNMENT);
+    header.vertex_offset = bw.length;
+    mt_buffer_writer_append(&bw, c.vertices, sizeof(*c.vertices) * header.vertex_count);
+
+    buffer_writer_align(&bw, MT_MESH_FILE_ALIGNMENT);
+    header.index_offset = bw.length;
+    mt_buffer_writer_append(&bw, c.indices, sizeof(*c.indices) * header.index_count);
+
+    memcpy(bw.buf, &header, sizeof(header));
+
+    assert(mt_mesh_file_header(bw.buf, bw.length) != NULL);
+
+    FILE *f = fopen(out_path, "wb");
+    if (!f)
+    {
+        printf("Failed to open output file: %s\n", out_path);
+        exit(1);
+    }
+
+    fwrite(bw.buf, 1, bw.length, f);
+    fclose(f);
+
+    printf(
+        "%s: %u meshes, %u primitives, %u vertices, %u indices\n",
+        out_path,
+        header.mesh_count,
+        header.primitive_count,
+        header.vertex_count,
+        header.index_count);
+
+    mt_buffer_writer_destroy(&bw);
+    mt_array_free(NULL, c.meshes);
+    mt_array_free(NULL, c.primitives);
+    mt_array_free(NULL, c.vertices);
+    mt_array_free(NULL, c.indices);
+    cgltf_free(data);
+
+    return 0;
+}
@@ -1,7 +1,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#include "bc7enc16.h"
+#include "bc7_cook.h"
 
 #include <stdint.h>
 #include <stdio.h>
@@ -9,159 +9,78 @@
 #include <string.h>
 #include <motor/base/api_types.h>
 #include <motor/base/buffer_writer.h>
-#include <motor/base/array.h>
-
-#define KTX_UNSIGNED_BYTE 0x1401
-#define KTX_RGBA 0x1908
-
-#define KTX_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
-#define KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
-#define KTX_COMPRESSED_RGB_BPTC_SIGNED_FLOAT 0x8E8E
-#define KTX_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT 0x8E8F
-
-typedef struct BC7Block
-{
-    uint8_t vals[16];
-} BC7Block;
-
-typedef struct ColorQuadU8
-{
-    uint8_t vals[4];
-} ColorQuadU8;
-
-static void buffer_writer_pad(MtBufferWriter *bw)
-{
-    uint64_t zero = 0;
-    mt_buffer_writer_append(bw, &zero, 4 - (bw->length % 4));
-}
-
-const static uint8_t ktx_identifier[12] = {
-    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
-
-typedef struct ktx_header_t
-{
-    uint8_t identifier[12];
-    uint32_t endianness;
-    uint32_t gl_type;
-    uint32_t gl_type_size;
-    uint32_t gl_format;
-    uint32_t gl_internal_format;
-    uint32_t gl_base_internal_format;
-    uint32_t pixel_width;
-    uint32_t pixel_height;
-    uint32_t pixel_depth;
-    uint32_t number_of_array_elements;
-    uint32_t number_of_faces;
-    uint32_t number_of_mipmap_levels;
-    uint32_t bytes_of_key_value_data;
-} ktx_header_t;
+#include <motor/base/filesystem.h>
+#include <motor/base/threads.h>
+#include <motor/base/thread_pool.h>
 
 int main(int argc, const char *argv[])
 {
-    if (argc <= 2)
+    Bc7CookOptions options;
+    int first_arg = bc7_cook_parse_options(&options, argc, argv);
+    if (argc - first_arg < 2)
     {
-        printf("Usage: %s <file> <output>\n", argv[0]);
+        printf("Usage: %s [--no-mips] [--filter box|kaiser] <file> <output>\n", argv[0]);
         exit(0);
     }
 
-    const char *img_path = argv[1];
-    const char *out_path = argv[2];
+    const char *img_path = argv[first_arg];
+    const char *out_path = argv[first_arg + 1];
 
-    bc7enc16_compress_block_init();
-
-    int width, height, n_channels;
-    ColorQuadU8 *image_pixels = (ColorQuadU8 *)stbi_load(img_path, &width, &height, &n_channels, 4);
-    if (!image_pixels)
+    MtFileMapping source;
+    if (!mt_file_map(&source, img_path))
     {
-        printf("Failed to load image\n");
+        printf("Failed to open image\n");
         exit(1);
     }
 
-    assert(width % 4 == 0);
-    assert(height % 4 == 0);
+    uint64_t hash = bc7_cook_hash(&options, source.data, source.size);
 
-    uint32_t blocks_x = (uint32_t)width >> 2;
-    uint32_t blocks_y = (uint32_t)height >> 2;
-
-    BC7Block *packed_image = NULL;
-    mt_array_add(NULL, packed_image, blocks_x * blocks_y);
-
-    bool srgb = false;
-
-    bc7enc16_compress_block_params pack_params = {0};
-    bc7enc16_compress_block_params_init(&pack_params);
-    if (!srgb) bc7enc16_compress_block_params_init_linear_weights(&pack_params);
-    pack_params.m_max_partitions_mode1 = BC7ENC16_MAX_PARTITIONS1;
-    pack_params.m_uber_level = 0;
-
-    for (uint32_t by = 0; by < blocks_y; by++)
+    // The output remembers what it was made from
+    MtFileMapping previous;
+    if (mt_file_map(&previous, out_path))
     {
-        for (uint32_t bx = 0; bx < blocks_x; bx++)
+        uint64_t previous_hash;
+        bool up_to_date = bc7_cook_ktx_hash(previous.data, previous.size, &previous_hash) &&
+                          previous_hash == hash;
+        mt_file_unmap(&previous);
+
+        if (up_to_date)
         {
-            ColorQuadU8 pixels[16];
-
-            memcpy(
-                pixels + 0,
-                &image_pixels[bx * 4 + (uint32_t)width * (by * 4 + 0)],
-                sizeof(ColorQuadU8) * 4);
-            memcpy(
-                pixels + 4,
-                &image_pixels[bx * 4 + (uint32_t)width * (by * 4 + 1)],
-                sizeof(ColorQuadU8) * 4);
-            memcpy(
-                pixels + 8,
-                &image_pixels[bx * 4 + (uint32_t)width * (by * 4 + 2)],
-                sizeof(ColorQuadU8) * 4);
-            memcpy(
-                pixels + 12,
-                &image_pixels[bx * 4 + (uint32_t)width * (by * 4 + 3)],
-                sizeof(ColorQuadU8) * 4);
-
-            BC7Block *block = &packed_image[bx + by * blocks_x];
-
-            bc7enc16_compress_block(block, pixels, &pack_params);
+            printf("%s is up to date\n", out_path);
+            mt_file_unmap(&source);
+            return 0;
         }
     }
 
-    ktx_header_t header = {0};
-    memcpy(&header.identifier, ktx_identifier, sizeof(ktx_identifier));
-    header.endianness = 0x04030201;
-
-    header.gl_type = KTX_UNSIGNED_BYTE;
-    header.gl_type_size = 1;
+    bc7_cook_init();
 
-    header.gl_format = KTX_RGBA;
-    header.gl_base_internal_format = header.gl_format;
-    if (srgb)
+    int width, height, n_channels;
+    uint8_t *image_pixels =
+        stbi_load_from_memory(source.data, (int)source.size, &width, &height, &n_channels, 4);
+    mt_file_unmap(&source);
+    if (!image_pixels)
     {
-        header.gl_internal_format = KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+        printf("Failed to load image\n");
+        exit(1);
     }
-    else
+
+    if (width % 4 != 0 || height % 4 != 0)
     {
-        header.gl_internal_format = KTX_COMPRESSED_RGBA_BPTC_UNORM;
+        printf("Image size has to be a multiple of 4: %dx%d\n", width, height);
+        exit(1);
     }
 
-    header.pixel_width = (uint32_t)width;
-    header.pixel_height = (uint32_t)height;
-    header.pixel_depth = 1;
-
-    header.number_of_array_elements = 1;
-    header.number_of_faces = 1;
-    header.number_of_mipmap_levels = 1;
-    header.bytes_of_key_value_data = 0;
+    MtThreadPool pool;
+    mt_thread_pool_init(&pool, mt_cpu_count(), NULL);
 
     MtBufferWriter bw = {0};
     mt_buffer_writer_init(&bw, NULL);
-    mt_buffer_writer_append(&bw, &header, sizeof(header));
-
-    uint32_t image_size = mt_array_size(packed_image) * sizeof(*packed_image);
-    mt_buffer_writer_append(&bw, &image_size, sizeof(image_size));
 
-    mt_buffer_writer_append(&bw, packed_image, (uint64_t)image_size);
+    Bc7CookStats stats = {0};
+    bc7_cook_ktx(
+        &pool, &bw, &options, hash, image_pixels, (uint32_t)width, (uint32_t)height, &stats);
 
-    buffer_writer_pad(&bw);
-
-    assert(bw.length % 4 == 0);
+    mt_thread_pool_destroy(&pool);
 
     size_t size;
     uint8_t *buf = mt_buffer_writer_build(&bw, &size);
@@ -175,6 +94,8 @@ int main(int argc, const char *argv[])
     fwrite(buf, 1, size, out_file);
     fclose(out_file);
 
+    printf("%s: %dx%d, %.2f MP/s\n", out_path, width, height, bc7_cook_throughput(&stats));
+
     free(image_pixels);
 
     return 0;
@@ -0,0 +1,271 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <motor/base/api_types.h>
+#include <motor/base/allocator.h>
+#include <motor/base/array.h>
+#include <motor/base/filesystem.h>
+#include <motor/base/hashmap.h>
+#include <motor/base/lz4.h>
+#include <motor/base/pack_format.h>
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+typedef struct SourceFile
+{
+    // Path in the pack
+    char *name;
+    char *path;
+} SourceFile;
+
+static void add_file(SourceFile **files, const char *name, const char *path)
+{
+    SourceFile file = {
+        .name = mt_strdup(NULL, name),
+        .path = mt_strdup(NULL, path),
+    };
+    mt_array_push(NULL, *files, file);
+}
+
+static bool is_dir(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+static void add_dir(SourceFile **files, const char *name, const char *dir)
+{
+    char path[1024];
+    char child_name[1024];
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+    char pattern[1024];
+    snprintf(pattern, sizeof(pattern), "%s/*", dir);
+
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    if (find == INVALID_HANDLE_VALUE) return;
+    do
+    {
+        const char *entry = data.cFileName;
+#else
+    DIR *dirp = opendir(dir);
+    if (!dirp) return;
+
+    struct dirent *ent;
+    while ((ent = readdir(dirp)) != NULL)
+    {
+        const char *entry = ent->d_name;
+#endif
+        if (strcmp(entry, ".") == 0 || strcmp(entry, "..") == 0) continue;
+
+        snprintf(path, sizeof(path), "%s/%s", dir, entry);
+        snprintf(child_name, sizeof(child_name), "%s/%s", name, entry);
+
+        if (is_dir(path))
+        {
+            add_dir(files, child_name, path);
+        }
+        else
+        {
+            add_file(files, child_name, path);
+        }
+#if defined(_WIN32) || defined(__WIN32__) || defined(__WINDOWS__)
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    }
+    closedir(dirp);
+#endif
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    const MtPackEntry *ea = a;
+    const MtPackEntry *eb = b;
+    if (ea->path_hash != eb->path_hash) return ea->path_hash < eb->path_hash ? -1 : 1;
+    return 0;
+}
+
+static void write_padding(FILE *f, uint64_t *offset)
+{
+    static const uint8_t zeros[MT_PACK_ALIGNMENT] = {0};
+    uint64_t padding = (MT_PACK_ALIGNMENT - *offset % MT_PACK_ALIGNMENT) % MT_PACK_ALIGNMENT;
+    fwrite(zeros, 1, padding, f);
+    *offset += padding;
+}
+
+int main(int argc, const char *argv[])
+{
+    bool lz4 = false;
+    int first_arg = 1;
+    if (argc > 1 && strcmp(argv[1], "--lz4") == 0)
+    {
+        lz4 = true;
+        first_arg++;
+    }
+
+    if (argc - first_arg < 2)
+    {
+        printf("Usage: %s [--lz4] <output> <dir>...\n", argv[0]);
+        printf("Files are packed as <dir name>/<path in dir>, e.g. assets/helmet_ktx.glb\n");
+        exit(0);
+    }
+
+    const char *out_path = argv[first_arg];
+
+    /*array*/ SourceFile *files = NULL;
+    for (int i = first_arg + 1; i < argc; i++)
+    {
+        const char *dir = argv[i];
+        if (!is_dir(dir))
+        {
+            printf("Not a directory: %s\n", dir);
+            exit(1);
+        }
+
+        // The last path component names the files in the pack
+        size_t dir_length = strlen(dir);
+        while (dir_length > 1 && (dir[dir_length - 1] == '/' || dir[dir_length - 1] == '\\'))
+        {
+            dir_length--;
+        }
+        size_t name_start = dir_length;
+        while (name_start > 0 && dir[name_start - 1] != '/' && dir[name_start - 1] != '\\')
+        {
+            name_start--;
+        }
+
+        char name[1024];
+        snprintf(name, sizeof(name), "%.*s", (int)(dir_length - name_start), &dir[name_start]);
+        add_dir(&files, name, dir);
+    }
+
+    uint32_t file_count = (uint32_t)mt_array_size(files);
+
+    uint32_t names_size = 0;
+    for (uint32_t i = 0; i < file_count; i++)
+    {
+        names_size += (uint32_t)strlen(files[i].name) + 1;
+    }
+
+    MtPackEntry *entries = mt_alloc(NULL, sizeof(MtPackEntry) * MT_MAX(file_count, 1u));
+    char *names = mt_alloc(NULL, MT_MAX(names_size, 1u));
+
+    uint32_t name_offset = 0;
+    for (uint32_t i = 0; i < file_count; i++)
+    {
+        size_t name_size = strlen(files[i].name) + 1;
+        entries[i] = (MtPackEntry){
+            .path_hash = mt_hash_str(files[i].name),
+            .name_offset = name_offset,
+        };
+        memcpy(&names[name_offset], files[i].name, name_size);
+        name_offset += (uint32_t)name_size;
+    }
+
+    MtPackHeader header = {
+        .magic = MT_PACK_MAGIC,
+        .version = MT_PACK_VERSION,
+        .entry_count = file_count,
+        .names_size = names_size,
+    };
+
+    FILE *f = fopen(out_path, "wb");
+    if (!f)
+    {
+        printf("Failed to open output file: %s\n", out_path);
+        exit(1);
+    }
+
+    // The table of contents is written last, once the entries know their offsets
+    uint64_t offset = sizeof(header) + sizeof(MtPackEntry) * file_count + header.names_size;
+    fseek(f, (long)offset, SEEK_SET);
+
+    uint64_t total_size = 0;
+    uint64_t total_stored_size = 0;
+    for (uint32_t i = 0; i < file_count; i++)
+    {
+        MtPackEntry *entry = &entries[i];
+
+        struct stat st;
+        MtFileMapping mapping;
+        if (stat(files[i].path, &st) != 0 || !mt_file_map(&mapping, files[i].path))
+        {
+            // Empty files can't be mapped, they are kept as empty entries
+            continue;
+        }
+
+        entry->mtime = (uint64_t)st.st_mtime;
+        entry->size = mapping.size;
+        entry->stored_size = mapping.size;
+
+        const uint8_t *stored = mapping.data;
+        uint8_t *compressed = NULL;
+        if (lz4)
+        {
+            size_t bound = mt_lz4_compress_bound(mapping.size);
+            compressed = mt_alloc(NULL, bound);
+            size_t compressed_size = mt_lz4_compress(mapping.data, mapping.size, compressed, bound);
+
+            // Already compressed data like BC7 or PNG stays stored, to be read in place
+            if (compressed_size > 0 && compressed_size <= mapping.size - mapping.size / 8)
+            {
+                entry->compression = MT_PACK_COMPRESSION_LZ4;
+                entry->stored_size = compressed_size;
+                stored = compressed;
+            }
+        }
+
+        write_padding(f, &offset);
+        entry->offset = offset;
+        fwrite(stored, 1, entry->stored_size, f);
+        offset += entry->stored_size;
+
+        total_size += entry->size;
+        total_stored_size += entry->stored_size;
+
+        if (compressed) mt_free(NULL, compressed);
+        mt_file_unmap(&mapping);
+    }
+
+    qsort(entries, file_count, sizeof(*entries), compare_entries);
+
+    fseek(f, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(entries, sizeof(*entries), file_count, f);
+    fwrite(names, 1, header.names_size, f);
+
+    if (fclose(f) != 0)
+    {
+        printf("Failed to write output file: %s\n", out_path);
+        exit(1);
+    }
+
+    printf(
+        "%s: %u files, %.2f MB stored as %.2f MB\n",
+        out_path,
+        file_count,
+        (double)total_size / (1024.0 * 1024.0),
+        (double)total_stored_size / (1024.0 * 1024.0));
+
+    for (uint32_t i = 0; i < file_count; i++)
+    {
+        mt_free(NULL, files[i].name);
+        mt_free(NULL, files[i].path);
+    }
+    mt_array_free(NULL, files);
+    mt_free(NULL, entries);
+    mt_free(NULL, names);
+
+    return 0;
+}